@@ -0,0 +1,118 @@
+@echo off
+
+title Compiler
+set "name=%~n0"
+
+REM Compiler & Linker of the headless server, without SDL, ImGui nor the window: HEADLESS leaves out the drawing and the keys
+@cls
+@echo -----------------------------------------------------------------------
+@echo  ESAT Curso 2022-2023 Asignatura PRG Primero
+@echo -----------------------------------------------------------------------
+@echo  Debug compiler Start
+@echo -----------------------------------------------------------------------
+@echo  Deleting some objects....
+del .\*.obj *.pdb *.ilk
+@echo  Objects deleted
+@echo -----------------------------------------------------------------------
+
+REM COMPILER
+  cl /nologo /Zi /EHs /GR- /MDd /W4 /c ..\deps\includes\Obj_Loader\*.cpp
+
+  cl /nologo /Zi /EHs /GR- /MDd /D HEADLESS ^
+  -I ..\includes ^
+  -I ..\deps\includes ^
+  -I ..\deps\includes\SDL2 ^
+  ..\src\bvh.cc ^
+  ..\src\collision.cc ^
+  ..\src\cube_3d.cc ^
+  ..\src\entity_3d.cc ^
+  ..\src\figures_3d.cc ^
+  ..\src\game_client.cc ^
+  ..\src\game_server.cc ^
+  ..\src\kepler.cc ^
+  ..\src\math_utils.cc ^
+  ..\src\matrix_2.cc ^
+  ..\src\matrix_3.cc ^
+  ..\src\matrix_4.cc ^
+  ..\src\mesh_simplify.cc ^
+  ..\src\net_interest.cc ^
+  ..\src\net_poller.cc ^
+  ..\src\net_protocol.cc ^
+  ..\src\net_record.cc ^
+  ..\src\net_replication.cc ^
+  ..\src\net_udp.cc ^
+  ..\src\obj_stream.cc ^
+  ..\src\particles.cc ^
+  ..\src\physics.cc ^
+  ..\src\quantize.cc ^
+  ..\src\registry.cc ^
+  ..\src\render.cc ^
+  ..\src\scene.cc ^
+  ..\src\sim_clock.cc ^
+  ..\src\sphere_3d.cc ^
+  ..\src\thread_pool.cc ^
+  ..\src\vector_2.cc ^
+  ..\src\vector_3.cc ^
+  ..\src\vector_4.cc ^
+  /c ..\server\server.cc
+
+ REM LINKER
+  cl /nologo /Zi /EHs /GR- /MDd /Fe:../bin/%name%_debug.exe *.obj /link /SUBSYSTEM:CONSOLE ws2_32.lib
+
+@echo -----------------------------------------------------------------------
+@echo  Debug Compiler Finish
+@echo -----------------------------------------------------------------------
+@echo  Release compiler Start
+@echo -----------------------------------------------------------------------
+@echo  Deleting some objects....
+del .\*.obj *.pdb *.ilk
+@echo  Objects deleted
+@echo -----------------------------------------------------------------------
+
+REM COMPILER
+  cl /nologo /O2 /EHs /GR- /MT /W4 /c ..\deps\includes\Obj_Loader\*.cpp
+
+  cl /nologo /O2 /EHs /GR- /MT /D HEADLESS ^
+  -I ..\includes ^
+  -I ..\deps\includes ^
+  -I ..\deps\includes\SDL2 ^
+  ..\src\bvh.cc ^
+  ..\src\collision.cc ^
+  ..\src\cube_3d.cc ^
+  ..\src\entity_3d.cc ^
+  ..\src\figures_3d.cc ^
+  ..\src\game_client.cc ^
+  ..\src\game_server.cc ^
+  ..\src\kepler.cc ^
+  ..\src\math_utils.cc ^
+  ..\src\matrix_2.cc ^
+  ..\src\matrix_3.cc ^
+  ..\src\matrix_4.cc ^
+  ..\src\mesh_simplify.cc ^
+  ..\src\net_interest.cc ^
+  ..\src\net_poller.cc ^
+  ..\src\net_protocol.cc ^
+  ..\src\net_record.cc ^
+  ..\src\net_replication.cc ^
+  ..\src\net_udp.cc ^
+  ..\src\obj_stream.cc ^
+  ..\src\particles.cc ^
+  ..\src\physics.cc ^
+  ..\src\quantize.cc ^
+  ..\src\registry.cc ^
+  ..\src\render.cc ^
+  ..\src\scene.cc ^
+  ..\src\sim_clock.cc ^
+  ..\src\sphere_3d.cc ^
+  ..\src\thread_pool.cc ^
+  ..\src\vector_2.cc ^
+  ..\src\vector_3.cc ^
+  ..\src\vector_4.cc ^
+  /c ..\server\server.cc
+
+ REM LINKER
+  cl /nologo /O2 /EHs /GR- /MT /Fe:../bin/%name%.exe *.obj /link /SUBSYSTEM:CONSOLE ws2_32.lib
+
+  @echo -----------------------------------------------------------------------
+  @echo  Release compiler Finish
+  @echo -----------------------------------------------------------------------
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Headless server for Linux, without SDL, ImGui nor the window: only a compiler is needed.
+# HEADLESS leaves out the drawing and the keys, only the types of the SDL headers are used.
+cd "$(dirname "$0")"
+
+g++ -O2 -std=c++17 -Wall -D_THREAD_SAFE -DHEADLESS \
+  -I../includes \
+  -I../deps/includes \
+  ../src/bvh.cc \
+  ../src/collision.cc \
+  ../src/cube_3d.cc \
+  ../src/entity_3d.cc \
+  ../src/figures_3d.cc \
+  ../src/game_client.cc \
+  ../src/game_server.cc \
+  ../src/kepler.cc \
+  ../src/math_utils.cc \
+  ../src/matrix_2.cc \
+  ../src/matrix_3.cc \
+  ../src/matrix_4.cc \
+  ../src/mesh_simplify.cc \
+  ../src/net_interest.cc \
+  ../src/net_poller.cc \
+  ../src/net_protocol.cc \
+  ../src/net_record.cc \
+  ../src/net_replication.cc \
+  ../src/net_udp.cc \
+  ../src/obj_stream.cc \
+  ../src/particles.cc \
+  ../src/physics.cc \
+  ../src/quantize.cc \
+  ../src/registry.cc \
+  ../src/render.cc \
+  ../src/scene.cc \
+  ../src/sim_clock.cc \
+  ../src/sphere_3d.cc \
+  ../src/thread_pool.cc \
+  ../src/vector_2.cc \
+  ../src/vector_3.cc \
+  ../src/vector_4.cc \
+  ../deps/includes/Obj_Loader/tiny_obj_loader.cpp \
+  ../server/server.cc \
+  -o ../bin/server.elf -lpthread
@@ -0,0 +1,345 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file Bvh.h
+
+////////////////////////
+#ifndef __BVH_H__
+#define __BVH_H__ 1
+////////////////////////
+
+#include <vector_3.h>
+#include <vector>
+#include <utility>
+
+#define BVH_NULL -1         ///< The index of no node.
+#define BVH_REFIT_RATIO 256 ///< From count / BVH_REFIT_RATIO items out of their box the whole tree is refitted instead of reinserting them.
+
+/**
+ * @struct Bvh_Settings.
+ *
+ * @brief Configuration of the bounding volume hierarchies.
+ */
+struct Bvh_Settings
+{
+  float margin;     ///< The growth of the leaf boxes relative to the radius, the items move inside without updating the tree.
+  float prediction; ///< The times the displacement of an item is added to its box when it leaves it.
+  float rebuild;    ///< The growth of the surface of the tree since it was built that rebuilds it.
+  bool culling;     ///< A flag indicating whether the registry draws only the entities inside the camera.
+};
+
+/**
+ * @struct Bvh_Box.
+ *
+ * @brief An axis aligned box, in floats so the nodes are copied and compared without calls.
+ */
+struct Bvh_Box
+{
+  float min[3]; ///< The minimum corner.
+  float max[3]; ///< The maximum corner.
+};
+
+/**
+ * @struct Bvh_Node.
+ *
+ * @brief A node of the hierarchy, a box with two children or the box of a proxy.
+ */
+struct Bvh_Node
+{
+  Bvh_Box box; ///< The box, the leaves are bigger than their item.
+  int parent;  ///< The parent node, or the next free node.
+  int left;    ///< The first child, BVH_NULL in the leaves.
+  int right;   ///< The second child, the proxy in the leaves.
+  int height;  ///< 0 for the leaves, -1 for the free nodes.
+};
+
+/**
+ * @struct Bvh_Proxy.
+ *
+ * @brief An item of the hierarchy, it keeps its index while the nodes are rebuilt.
+ */
+struct Bvh_Proxy
+{
+  float center[3]; ///< The center of the sphere of the item.
+  float radius;    ///< The radius of the sphere.
+  Bvh_Box box;     ///< The box of the leaf, moving an item doesn't read the nodes.
+  int item;        ///< The value returned by the queries, or the next free proxy.
+  int node;        ///< The leaf of the proxy, BVH_NULL if the proxy is free.
+  bool escaped;    ///< A flag indicating whether the item left its box since the last update.
+};
+
+/**
+ * @struct Bvh_Build.
+ *
+ * @brief A leaf while the tree is rebuilt.
+ */
+struct Bvh_Build
+{
+  float center[3]; ///< The center of the item, the leaves are split by it.
+  int proxy;       ///< The proxy of the leaf.
+};
+
+/**
+ * @class Bvh
+ *
+ * @brief Dynamic bounding volume hierarchy of spheres.
+ *
+ * Every item is a leaf with a box a bit bigger than its sphere. An item is inserted next to the
+ * sibling that grows the surface the least and the ancestors are rotated to keep the tree balanced,
+ * O(log N). Moving an item only marks it when it leaves its box; update reinserts the few marked
+ * leaves, or refits every box in a linear pass when many items move. The refitted tree is rebuilt
+ * by median splits once its surface grows settings_.rebuild times.
+ *
+ * The nodes live in an arena with a free list. A rebuild writes them in depth first order, every
+ * parent before its children, so the refit is a backwards linear pass until the tree changes again.
+ * The proxies returned by insert don't change when the nodes are rebuilt.
+ * The queries walk the tree with an explicit stack of the Bvh, they are not reentrant.
+ */
+class Bvh
+{
+public:
+  static Bvh_Settings settings_; ///< The configuration used by every hierarchy.
+
+  /**
+   * @brief Constructs an empty Bvh.
+   */
+  Bvh();
+
+  Bvh(const Bvh &) = delete; ///< The hierarchy owns its nodes, it can't be copied.
+  void operator=(const Bvh &) = delete;
+
+  /**
+   * @brief Inserts an item.
+   *
+   * @param center The center of the sphere of the item.
+   * @param radius The radius of the sphere.
+   * @param item The value returned by the queries.
+   *
+   * @return The proxy of the item.
+   */
+  int insert(Vec3 center, float radius, int item);
+
+  /**
+   * @brief Removes an item.
+   *
+   * @param proxy The proxy of the item.
+   */
+  void remove(int proxy);
+
+  /**
+   * @brief Moves an item, the tree changes in the next update only if its sphere leaves its box.
+   *
+   * @param proxy The proxy of the item.
+   * @param center The new center.
+   * @param radius The new radius.
+   * @param displacement The last movement of the item, the new box extends in its direction.
+   *
+   * @return True if the item left its box.
+   */
+  bool move(int proxy, Vec3 center, float radius, Vec3 displacement);
+
+  /**
+   * @brief Updates the tree with the items that left their box, it must be called before the queries.
+   */
+  void update();
+
+  /**
+   * @brief Removes every item.
+   */
+  void clear();
+
+  /**
+   * @brief Returns the item hit first by a ray.
+   *
+   * @param origin The origin of the ray.
+   * @param direction The direction of the ray, normalized.
+   * @param distance The maximum distance, it returns the distance to the hit.
+   *
+   * @return The item, BVH_NULL if nothing is hit.
+   */
+  int raycast(Vec3 origin, Vec3 direction, float &distance);
+
+  /**
+   * @brief Returns the items whose sphere touches a sphere.
+   *
+   * @param center The center of the sphere.
+   * @param radius The radius of the sphere.
+   * @param items Returns the items, up to max.
+   * @param max The size of items.
+   *
+   * @return The number of items found, it can be bigger than max.
+   */
+  int overlap(Vec3 center, float radius, int *items, int max);
+
+  /**
+   * @brief Returns the items with the center nearest to a point, by best first search.
+   *
+   * @param point The point.
+   * @param k The number of items.
+   * @param items Returns the items, nearest first.
+   * @param distances Returns the distance of each item, can be nullptr.
+   *
+   * @return The number of items found, k unless there are fewer items.
+   */
+  int nearest(Vec3 point, int k, int *items, float *distances);
+
+  /**
+   * @brief Returns the items inside a convex volume.
+   *
+   * A point p is inside a plane when DotProduct(p - point, normal) >= 0. The subtrees completely
+   * inside are added without testing their leaves.
+   *
+   * @param points A point of each plane.
+   * @param normals The normal of each plane, normalized, towards the inside.
+   * @param planes The number of planes.
+   * @param items Returns the items, it must fit count() items.
+   *
+   * @return The number of items inside.
+   */
+  int frustum(const Vec3 *points, const Vec3 *normals, int planes, int *items);
+
+  /**
+   * @brief Returns the number of items.
+   *
+   * @return The number of items.
+   */
+  int count();
+
+  /**
+   * @brief Returns the height of the tree.
+   *
+   * @return The height, 0 if there is one item or none.
+   */
+  int height();
+
+  /**
+   * @brief Returns the number of items that left their box since the last call.
+   *
+   * @return The number of items.
+   */
+  int escaped();
+
+  /**
+   * @brief Returns the number of rebuilds of the tree.
+   *
+   * @return The number of rebuilds.
+   */
+  int rebuilds();
+
+  /**
+   * @brief Destroys the Bvh and its nodes.
+   */
+  ~Bvh();
+
+private:
+  Bvh_Node *nodes_;     ///< The arena of the nodes.
+  int nNodes_;          ///< The number of nodes ever used of the arena.
+  int capNodes_;        ///< The number of nodes the arena can store.
+  int freeNode_;        ///< The first free node.
+  Bvh_Proxy *proxies_;  ///< The items.
+  int nProxies_;        ///< The number of proxies ever used.
+  int capProxies_;      ///< The number of proxies that can be stored.
+  int freeProxy_;       ///< The first free proxy.
+  int root_;            ///< The root node, BVH_NULL if there are no items.
+  bool ordered_;        ///< A flag indicating whether every parent is stored before its children.
+  int count_;           ///< The number of items.
+  int nEscaped_;        ///< The number of items that left their box since the last call to escaped.
+  int rebuilds_;        ///< The number of rebuilds.
+  float cost_;          ///< The surface of the internal boxes after the last build.
+
+  int *stack_;                              ///< The stack of the queries, and the order of the refit.
+  std::vector<int> escaped_;                ///< The proxies that left their box since the last update.
+  std::vector<std::pair<float, int>> heap_; ///< The nodes to visit of the nearest query, by distance.
+  std::vector<float> best_;                 ///< The squared distances of the nearest items found.
+
+  /**
+   * @brief Returns a free node, growing the arena if needed.
+   *
+   * @return The index of the node.
+   */
+  int allocate();
+
+  /**
+   * @brief Returns a node to the free list.
+   *
+   * @param node The index of the node.
+   */
+  void release(int node);
+
+  /**
+   * @brief Sets the box of a proxy and its leaf, bigger than its sphere.
+   *
+   * @param proxy The proxy, with its sphere set.
+   * @param displacement The movement of the item, the box extends in its direction.
+   */
+  void fatten(int proxy, Vec3 displacement);
+
+  /**
+   * @brief Inserts a leaf in the tree.
+   *
+   * @param leaf The index of the leaf, its box must be set.
+   */
+  void insertLeaf(int leaf);
+
+  /**
+   * @brief Removes a leaf from the tree, the leaf is not released.
+   *
+   * @param leaf The index of the leaf.
+   */
+  void removeLeaf(int leaf);
+
+  /**
+   * @brief Refits the boxes and heights from a node to the root, balancing them.
+   *
+   * @param node The first node to refit.
+   */
+  void refit(int node);
+
+  /**
+   * @brief Recomputes every internal box from its children, children first.
+   *
+   * @return The surface of the internal boxes.
+   */
+  float refitAll();
+
+  /**
+   * @brief Rebuilds the tree, splitting the leaves by the median of their longest axis.
+   */
+  void rebuild();
+
+  /**
+   * @brief Builds the subtree of some leaves in depth first order.
+   *
+   * @param leaves The leaves, they are reordered.
+   * @param count The number of leaves.
+   * @param parent The parent of the subtree.
+   *
+   * @return The root of the subtree.
+   */
+  int build(Bvh_Build *leaves, int count, int parent);
+
+  /**
+   * @brief Rotates a node if the heights of its children differ in more than one.
+   *
+   * @param node The index of the node.
+   *
+   * @return The index of the node that takes its place.
+   */
+  int balance(int node);
+};
+
+/**
+ * @brief Measures the updates and queries of a hierarchy, printing the results on the console.
+ *
+ * The items orbit a center, every frame they are moved and the queries are compared with a
+ * brute force search.
+ *
+ * @param items The number of items, 0 runs 1000, 10000 and 100000 items.
+ * @param frames The number of frames of every run.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A query doesn't match the brute force search.
+ */
+int Bvh_Benchmark(int items, int frames);
+
+////////////////////////
+#endif /* __BVH_H__ */
+////////////////////////
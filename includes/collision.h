@@ -0,0 +1,146 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file Collision.h
+
+////////////////////////
+#ifndef __COLLISION_H__
+#define __COLLISION_H__ 1
+////////////////////////
+
+#include <vector_3.h>
+#include <thread_pool.h>
+#include <vector>
+
+/**
+ * @struct Collision_Settings.
+ *
+ * @brief Configuration of the collisions between bodies.
+ */
+struct Collision_Settings
+{
+  bool enabled;     ///< A flag indicating whether the bodies that touch are merged.
+  float cell;       ///< The side of the cells of the grid relative to the mean radius of the bodies.
+  int min_parallel; ///< The number of bodies from which the search is split in threads.
+};
+
+/**
+ * @struct Collision_Pair.
+ *
+ * @brief Two bodies whose spheres touch, a is the lower index.
+ */
+struct Collision_Pair
+{
+  int a; ///< The first body.
+  int b; ///< The second body.
+};
+
+/**
+ * @class Collider
+ *
+ * @brief Finds the pairs of spheres that touch, with a uniform grid.
+ *
+ * The broad phase puts the center of every body in a cell of a grid hashed in a table, sorted by
+ * counting. A cell is at least the diameter of its bodies, so a body only touches the ones of the
+ * 27 cells around it; only those pairs reach the narrow phase, the distance between the centers.
+ * The hash keeps the cells of a row in consecutive buckets, so they are a single range of the
+ * sorted bodies. The few bodies bigger than a cell stay out of the grid, they scan the cells their
+ * radius reaches and find each other sweeping their spheres along x.
+ *
+ * The search is split in ranges of the sorted bodies, one per thread, and the pairs are sorted by their
+ * indices, so the result is the same with any number of threads.
+ */
+class Collider
+{
+public:
+  static Collision_Settings settings_; ///< The configuration used by every collider.
+
+  /**
+   * @brief Constructs an empty Collider.
+   */
+  Collider();
+
+  Collider(const Collider &) = delete; ///< The collider owns its buffers, it can't be copied.
+  void operator=(const Collider &) = delete;
+
+  /**
+   * @brief Finds the pairs of bodies that touch.
+   *
+   * @param positions The center of each body.
+   * @param radii The radius of each body.
+   * @param solid A flag per body indicating whether it collides, the others are skipped.
+   * @param count The number of bodies.
+   *
+   * @return The number of pairs, sorted by a and then by b.
+   */
+  int detect(const Vec3 *positions, const float *radii, const bool *solid, int count);
+
+  /**
+   * @brief Returns the pairs found by the last detect.
+   *
+   * @return The pairs.
+   */
+  const Collision_Pair *pairs();
+
+  /**
+   * @brief Returns the number of pairs found by the last detect.
+   *
+   * @return The number of pairs.
+   */
+  int count();
+
+  /**
+   * @brief Returns the number of pairs tested by the narrow phase in the last detect.
+   *
+   * @return The number of tests, the pairs in neighbour cells and the ones of the big bodies.
+   */
+  int checks();
+
+  /**
+   * @brief Destroys the Collider and its buffers.
+   */
+  ~Collider();
+
+private:
+  int *buckets_; ///< The bucket of the cell of each body, -1 for the big ones.
+  int *sorted_;  ///< The solid bodies sorted by bucket, followed by the big ones sorted by their start in x.
+  int *starts_;  ///< The first position in sorted_ of each bucket, and the end of the last one.
+  int nBuckets_; ///< The number of buckets, a power of 2 at least twice the bodies.
+  int capacity_; ///< The number of bodies the buffers can store.
+  int nSorted_;  ///< The number of bodies in the grid, the first ones of sorted_.
+  int nBig_;     ///< The number of bodies of sorted_, the grid ones and the big ones.
+  float size_;   ///< The side of the cells of the last detect.
+  int checks_;   ///< The narrow phase tests of the last detect.
+
+  std::vector<Collision_Pair> pairs_;               ///< The pairs found.
+  std::vector<std::vector<Collision_Pair>> ranges_; ///< The pairs found by each thread.
+  std::vector<int> rangeChecks_;                    ///< The narrow phase tests of each thread.
+  Thread_Pool pool_;                                ///< The threads of the sweep, kept between detects.
+
+  /**
+   * @brief Finds the pairs of a range of bodies with the bodies of higher index.
+   *
+   * @param first The first position of sorted_.
+   * @param last The position after the last one.
+   * @param positions The center of each body.
+   * @param radii The radius of each body.
+   * @param range The index of the range, its pairs and tests are written there.
+   */
+  void search(int first, int last, const Vec3 *positions, const float *radii, int range);
+};
+
+/**
+ * @brief Measures the collision detection, printing the results on the console.
+ *
+ * The bodies are in a disc moving around its center. The pairs are compared with a brute force
+ * search and the pairs found with threads with the ones found by one thread.
+ *
+ * @param bodies The number of bodies, 0 runs 1000, 10000 and 100000 bodies.
+ * @param steps The number of steps of every run.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The pairs don't match the brute force search or don't match with one thread.
+ */
+int Collision_Benchmark(int bodies, int steps);
+
+////////////////////////
+#endif /* __COLLISION_H__ */
+////////////////////////
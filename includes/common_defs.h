@@ -8,6 +8,9 @@
 
 #include <SDL2/SDL.h>
 
+// HEADLESS, defined by the builds of the server, leaves out the drawing and the keys: only the types
+// of SDL are used, nothing of it is linked
+
 #define RGBA(x) x.r, x.g, x.b, x.a
 
 enum
@@ -47,11 +47,6 @@ public:
    * @brief Function created to demostrate virtual inheritance.
    */
   void print ();
-
-  /**
-   * @brief Destructor of the Cube.
-   */
-  ~Cube(){};
 };
 
 ////////////////////////
@@ -17,6 +17,7 @@
 #include <render.h>
 #include <objects.h>
 #include <my_window.h>
+#include <net_replication.h>
 
 /**
  * @class Debug_Window
@@ -69,14 +70,20 @@ public:
 void Camera_Control(Render &drawRender, My_Window &win, Vec2 max_win, Vec3 &light);
 
 /**
- * @brief Modifies the given vector of Objects objects, two pointers to Vec3 objects, and Vec2 object to implement object control using ImGui.
+ * @brief Implements the control of the objects of the registry using ImGui.
  *
- * @param objects Reference to the vector of Objects objects.
- * @param objects_mov Pointer to the Vec3 object for object movement.
- * @param objects_scale Pointer to the Vec3 object for object scaling.
+ * @param registry Reference to the registry with the objects.
+ * @param drawRender Reference to the Render object, the objects are picked with its camera.
  * @param max_win Reference to the Vec2 object.
  */
-void Objects_Control(std::vector<Objects> &objects, Vec3 **objects_mov, Vec3 **objects_scale, Vec2 max_win);
+void Objects_Control(Registry &registry, Render &drawRender, Vec2 max_win);
+
+/**
+ * @brief Shows the snapshots received from a replication server and the state of the jitter buffer using ImGui.
+ *
+ * @param client Reference to the client connected to the server.
+ */
+void Network_Control(Replication_Client &client);
 
 ////////////////////////
 #endif /* __DEBUG_WINDOW_H__ */
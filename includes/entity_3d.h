@@ -9,10 +9,14 @@
 #include <SDL2/SDL.h>
 #include <iostream>
 #include <math_utils.h>
+#ifndef HEADLESS
 #include <SDL_event_control.h>
+#endif
 #include <common_defs.h>
 #include <render.h>
+#include <particles.h>
 #include <chrono>
+#include <vector>
 
 /**
  * @struct Faces.
@@ -28,6 +32,92 @@ struct Faces
   int *points;  ///< An array of indices pointing to the points that make up the face.
 };
 
+/**
+ * @struct Material_Group.
+ *
+ * @brief A range of consecutive faces that share the same material.
+ */
+struct Material_Group
+{
+  int material; ///< The material id of the faces, -1 if they have no material.
+  int first;    ///< The first face of the group.
+  int count;    ///< The number of faces in the group.
+};
+
+/**
+ * @struct Entity_Draw_Buffers.
+ *
+ * @brief The scratch of the draw of the entities, reused by every entity drawn with it.
+ */
+struct Entity_Draw_Buffers
+{
+  std::vector<float> distances;  ///< The distance from the camera to the center of every face.
+  std::vector<SDL_Vertex> batch; ///< The triangles of the batch being built.
+};
+
+#define MAX_LOD_LEVELS 4
+#define ORBIT_RATE 60.0f ///< The times per second an orbit applies its angle, the frame rate the orbits were made for.
+
+/**
+ * @struct Lod_Level.
+ *
+ * @brief A simplified version of the faces of an entity.
+ *
+ * The faces of a level index the same points as the full entity, so every transformation
+ * applied to the entity is applied to its levels for free.
+ */
+struct Lod_Level
+{
+  int nFaces;    ///< The number of faces in the level.
+  Faces *faces;  ///< The faces of the level.
+  int *storage;  ///< Flat storage for the point indices of every face.
+  int nVertex;   ///< The number of entity points used by the level.
+  int *vertices; ///< The indices of the entity points used by the level.
+  Vec3 *centers; ///< Center points of each face, refreshed when the level is drawn.
+  int *materials;         ///< The material id of each face, null if the entity has no materials.
+  SDL_Color *colors;      ///< The baked color of each face, null if the entity has no materials.
+  Material_Group *groups; ///< The faces grouped by material.
+  int nGroups;            ///< The number of material groups.
+};
+
+/**
+ * @struct Lod_Settings.
+ *
+ * @brief Shared thresholds to select the level of detail of the entities.
+ */
+struct Lod_Settings
+{
+  bool enabled; ///< A flag indicating whether the entities switch between levels.
+  float thresholds[MAX_LOD_LEVELS - 1]; ///< Projected radius in pixels under which the level i + 1 is used.
+};
+
+/**
+ * @struct Entity_Orbit.
+ *
+ * @brief The orbit of an entity around a point.
+ */
+struct Entity_Orbit
+{
+  Vec3 angle;  ///< The orbit angle per 1 / ORBIT_RATE seconds, multiplied by the velocity.
+  Vec3 center; ///< The center point of the orbit, there is no orbit if it is 0.
+  float vel;   ///< The velocity of the orbit.
+};
+
+/**
+ * @struct Entity_Material.
+ *
+ * @brief How an entity is drawn.
+ */
+struct Entity_Material
+{
+  SDL_Color fillColor;  ///< The color to fill the entity with.
+  SDL_Color linesColor; ///< The color of the lines drawn around the edges of the entity.
+  bool fill;            ///< A flag indicating whether to fill the entity.
+  bool lines;           ///< A flag indicating whether to draw lines around the edges of the entity.
+  bool renderLight;     ///< A flag indicating whether to render lighting on the entity.
+  bool materials;       ///< A flag indicating whether to draw the faces with their material colors.
+};
+
 /**
  * @class Entity
  *
@@ -51,11 +141,22 @@ protected:
 
   Faces *faces_; ///< A pointer to an array of faces that make up the entity.
   int nFaces_;   ///< The number of faces in the entity.
+  int *faceStorage_; ///< Flat storage of the face points when the faces are not allocated one by one.
 
   int *order_; ///< An array of indices used to specify the order in which the faces are rendered.
 
+  int *faceMaterials_;      ///< The material id of each face, null if the entity has no materials.
+  SDL_Color *faceColors_;   ///< The diffuse color baked for each face, null if the entity has no materials.
+  Material_Group *groups_;  ///< The faces grouped by material, faces are stored sorted by material.
+  int nGroups_;             ///< The number of material groups.
+
   int bytesSize; ///< The size of the entity in bytes.
 
+  Lod_Level lods_[MAX_LOD_LEVELS - 1]; ///< The simplified levels of the entity, the level 0 are the entity faces.
+  int nLods_;                          ///< The number of levels of detail, including the level 0.
+  int lod_;                            ///< The level selected in the last draw.
+  int batches_;                        ///< The SDL_RenderGeometry calls of the last draw.
+
   bool destroying_; ///< Flag that says if the entity are in the destroying cinematic
   bool destroyed_;  ///< Flag that say if the object is destroyed (Is useless try to draw a destroyed entity)
 
@@ -66,10 +167,57 @@ protected:
    * @brief Make the entity destruction cinematics
    *
    * This function is called in the draw function if the fla destroing are activated
+   *
+   * @param material The material being drawn, the cinematic fades it.
+   */
+  void destroying(Entity_Material &material);
+
+  /**
+   * @brief Stores a simplified level of the entity.
+   *
+   * @param level The level to store, between 1 and MAX_LOD_LEVELS - 1.
+   * @param n_points The number of points of every face.
+   * @param points The point indices of the faces, n_points per face.
+   * @param nFaces The number of faces.
+   * @param materials Optional material id of each face.
+   * @param colors Optional baked color of each face, required if there are materials.
+   */
+  void setLod(int level, int n_points, const int *points, int nFaces, const int *materials = nullptr, const SDL_Color *colors = nullptr);
+
+  /**
+   * @brief Releases the simplified levels of the entity.
+   */
+  void clearLods();
+
+  /**
+   * @brief Releases every buffer of the entity, leaving it without points and faces.
+   */
+  void release();
+
+  /**
+   * @brief Copies the values of another Entity that are not buffers.
+   *
+   * @param other The Entity to copy from.
    */
-  void destroying();
+  void copyState(const Entity &other);
+
+  /**
+   * @brief Returns the size in bytes of the simplified levels.
+   *
+   * @return The size in bytes of the simplified levels.
+   */
+  int lodSize();
+
+  /**
+   * @brief Sorts the faces by material and builds the material groups.
+   *
+   * The faceMaterials_ and faceColors_ arrays must be set, and are sorted with the faces.
+   */
+  void groupFaces();
 
 public:
+  static Lod_Settings lod_settings_; ///< The thresholds used by every entity to select its level.
+
   float dim_;            ///< The dimensions of the entity.
   Vec3 mov_;             ///< The movement of the entity.
   Vec3 orbit_;           ///< The orbit of the entity.
@@ -79,6 +227,7 @@ public:
   SDL_Color linesColor_; ///< The color of the lines drawn around the edges of the entity.
   bool fill_;            ///< A flag indicating whether to fill the entity.
   bool lines_;           ///< A flag indicating whether to draw lines around the edges of the entity.
+  bool materials_;       ///< A flag indicating whether to draw the faces with their material colors.
   float orbit_vel_;      ///< The velocity of the entity's orbit.
 
   /**
@@ -100,13 +249,72 @@ public:
    */
   bool isDestroyed();
 
+  /**
+   * @brief Returns if the destruction of the entity started.
+   *
+   * @return True while the destruction cinematic plays, and after it.
+   */
+  bool isDestroying();
+
+  /**
+   * @brief Emits the debris of the entity, from the center of its faces.
+   *
+   * @param particles The pool of the debris.
+   * @param velocity The velocity of the entity, the debris keeps it.
+   * @param material The material of the entity, the debris takes its colors.
+   *
+   * @return The number of particles emitted.
+   */
+  int debris(Particles &particles, Vec3 velocity, const Entity_Material &material);
+
+  /**
+   * @brief Constructs a copy of another Entity, with its own buffers.
+   *
+   * @param other The Entity to copy from.
+   */
+  Entity(const Entity &other);
+
+  /**
+   * @brief Constructs an Entity taking the buffers of another one, which is left empty.
+   *
+   * @param other The Entity to move from.
+   */
+  Entity(Entity &&other);
+
   /**
    * @brief Assigns the values of another Entity to this one.
    *
+   * The previous buffers of this Entity are released and the buffers of the other one are copied.
+   *
    * @param other The Entity to copy from.
    */
   void operator=(const Entity &other);
 
+  /**
+   * @brief Assigns the values of another Entity to this one taking its buffers.
+   *
+   * No point or face is copied, the other Entity is left empty.
+   *
+   * @param other The Entity to move from.
+   */
+  void operator=(Entity &&other);
+
+  /**
+   * @brief Sets the colors, orbit and transformation of an Entity copied from a standardized one.
+   *
+   * Does the same as the end of the init of the childs, so a single built Entity can be copied
+   * and placed many times.
+   *
+   * @param color The fill and lines color.
+   * @param fill A flag indicating whether to fill the Entity.
+   * @param scale The scale of the Entity.
+   * @param mov The position of the Entity.
+   * @param rot The rotation of the Entity.
+   * @param orbit The orbit angle of the Entity.
+   * @param orbit_center The center of the orbit.
+   */
+  void place(SDL_Color color, bool fill, Vec3 scale, Vec3 mov, Vec3 rot, Vec3 orbit, Vec3 orbit_center);
+
   /**
    * @brief Calculates the proportions of the Entity.
    */
@@ -138,6 +346,27 @@ public:
    */
   Vec3 getScale();
 
+  /**
+   * @brief Returns the rotation of the Entity.
+   *
+   * @return The degrees turned on each axis by rotation(), the orbits don't change it.
+   */
+  Vec3 getRotation();
+
+  /**
+   * @brief Returns the resolution of the Entity.
+   *
+   * @return The resolution.
+   */
+  int getRes();
+
+  /**
+   * @brief Returns the radius of the sphere around the position of the Entity that contains its vertices.
+   *
+   * @return The radius, with the current scale.
+   */
+  float getRadius();
+
   /**
    * @brief Returns the number of faces in the Entity.
    *
@@ -145,6 +374,55 @@ public:
    */
   int getFaces();
 
+  /**
+   * @brief Returns the number of material groups.
+   *
+   * @return The number of material groups, 0 if the entity has no materials.
+   */
+  int getMaterials();
+
+  /**
+   * @brief Returns the number of batches drawn in the last draw.
+   *
+   * The faces are drawn back to front with their material colors baked in the vertices, in a single
+   * SDL_RenderGeometry call.
+   *
+   * @return The number of SDL_RenderGeometry calls, 0 if the faces were not filled.
+   */
+  int getBatches();
+
+  /**
+   * @brief Returns the level of detail selected in the last draw.
+   *
+   * @return The level of detail, 0 is the full entity.
+   */
+  int getLod();
+
+  /**
+   * @brief Returns the number of levels of detail of the Entity.
+   *
+   * @return The number of levels, including the full entity.
+   */
+  int getLodLevels();
+
+  /**
+   * @brief Returns the number of faces of a level of detail.
+   *
+   * @param level The level of detail.
+   *
+   * @return The number of faces of the level.
+   */
+  int getLodFaces(int level);
+
+  /**
+   * @brief Selects the level of detail from the projected size of the Entity.
+   *
+   * @param drawRender The render with the camera used to project the Entity.
+   *
+   * @return The selected level.
+   */
+  int selectLod(const Render &drawRender);
+
   /**
    * @brief Returns the size of the Entity.
    *
@@ -164,6 +442,34 @@ public:
    */
   void orbit();
 
+  /**
+   * @brief Orbits the Entity with an orbit stored out of it.
+   *
+   * @param orbit The orbit to apply.
+   */
+  void orbit(const Entity_Orbit &orbit);
+
+  /**
+   * @brief Returns the orbit of the Entity.
+   *
+   * @return The orbit of the Entity.
+   */
+  Entity_Orbit getOrbit();
+
+  /**
+   * @brief Returns the material of the Entity.
+   *
+   * @return The material of the Entity.
+   */
+  Entity_Material getMaterial();
+
+  /**
+   * @brief Sets the material of the Entity.
+   *
+   * @param material The new material.
+   */
+  void setMaterial(const Entity_Material &material);
+
   /**
    * @brief Translates the Entity by a given amount.
    *
@@ -178,12 +484,14 @@ public:
    */
   void scale(Vec3 scale);
 
+#ifndef HEADLESS
   /**
    * @brief Processes input for the Entity.
    *
    * @param keys The Keys object to use for input processing.
    */
   void inputs();
+#endif
 
   /**
    * @brief Calculates the color of a point on the Entity under a given light.
@@ -206,6 +514,7 @@ public:
    */
   SDL_Vertex renderSDLVertex(Vec3 light, Vec2 draw, Vec3 point);
 
+#ifndef HEADLESS
   /**
    * @brief Draws the Entity object to the SDL window.
    *
@@ -213,9 +522,20 @@ public:
    * @param render The SDL renderer to use for drawing.
    * @param drawRender The rendering mode to use.
    * @param light The lighting vector for the Entity.
-   * @param id An optional identifier for the Entity.
    */
-  void draw(SDL_Renderer *render, Render drawRender, Vec3 light, int id = 0);
+  void draw(SDL_Renderer *render, const Render &drawRender, Vec3 light);
+
+  /**
+   * @brief Draws the Entity object with a material stored out of it.
+   *
+   * @param render The SDL renderer to use for drawing.
+   * @param drawRender The rendering mode to use.
+   * @param light The lighting vector for the Entity.
+   * @param material The material to draw with, the destruction cinematic modifies it.
+   * @param buffers The scratch of the draw.
+   */
+  void draw(SDL_Renderer *render, const Render &drawRender, Vec3 light, Entity_Material &material, Entity_Draw_Buffers &buffers);
+#endif
 
   /**
    * @brief Function created to demostrate virtual inheritance.
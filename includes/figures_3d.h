@@ -8,6 +8,7 @@
 ////////////////////////
 
 #include "entity_3d.h"
+#include <obj_stream.h>
 #include <Obj_Loader/tiny_obj_loader.h>
 
 /**
@@ -33,6 +34,19 @@ private:
    */
   void load_triangles(const struct tinyobj::shape_t &shape, int &cont);
 
+  /**
+   * @brief Bakes the diffuse color of the materials and the vertex colors in a color per face.
+   *
+   * @param vertex_colors The colors of the points, 3 floats per point, or null if there are no colors.
+   * @param materials The materials loaded from the .mtl files.
+   */
+  void bakeColors(const float *vertex_colors, const std::vector<tinyobj::material_t> &materials);
+
+  /**
+   * @brief Generates the levels of detail of the Figure by quadric edge-collapse.
+   */
+  void obtainLods();
+
   /**
    * @brief Load the Figure.
    *
@@ -43,7 +57,31 @@ private:
    */
   int charger(const char *path);
 
+  /**
+   * @brief Load the Figure streaming the file.
+   *
+   * The file is read twice through a window of stream_settings_.window bytes, the first pass
+   * counts the points and triangles and the second one writes them in the final buffers. The
+   * limit is checked after the first pass against the final buffers plus the largest of the copies
+   * that group the faces by material and the build of the levels of detail.
+   *
+   * @param path Get the location of the file in the Figure.
+   *
+   * @return 1 File not found.
+   * @return 2 A line of the file doesn't fit in the window.
+   * @return 3 The Figure needs more memory than stream_settings_.memory_limit.
+   * @return 0 Everything went OK.
+   */
+  int chargerStreamed(const char *path);
+
 public:
+  static Stream_Settings stream_settings_; ///< The configuration of the streaming import.
+
+  /**
+   * @brief Loads every bundled model with both importers and prints their peak memory.
+   */
+  static void LoadReport();
+
   /**
    * @brief Does nothing.
    */
@@ -70,11 +108,6 @@ public:
    * @brief Function created to demostrate virtual inheritance.
    */
   void print ();
-
-  /**
-   * @brief Destructor of the Figure.
-   */
-  ~Figure(){};
 };
 
 ////////////////////////
@@ -7,19 +7,21 @@
 ////////////////////////
 
 #include <iostream>
-#ifdef _WIN32
-#include <winsock2.h>
+#include <functional>
 #include <string>
-#elif __linux__
-#include <sys/socket.h>
-#include <netinet/in.h>
+#include <vector>
+#include <net_poller.h>
+#include <net_protocol.h>
+
+#ifdef __linux__
 #include <arpa/inet.h>
-#include <string>
-#include <unistd.h>
 #endif
 
 /**
  * @brief A class for connecting to a game server and sending/receiving data.
+ *
+ * The messages are frames of the binary protocol: the client says hello once connected, then the
+ * frames received are parsed in place from its input ring.
  */
 class GameClient
 {
@@ -35,24 +37,47 @@ public:
   ~GameClient();
 
   /**
-   * @brief Connects to a game server at the specified IP address and port.
+   * @brief Connects to a game server at the specified IP address and port, and says hello.
    *
    * @param ipAddress The IP address of the game server.
    * @param port The port number of the game server.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The connection failed.
    */
-  void connectToServer(const std::string &ipAddress, int port);
+  int connectToServer(const std::string &ipAddress, int port);
 
   /**
-   * @brief Sends data to and receives data from the game server.
+   * @brief Sends the frames of a writer and empties it.
+   *
+   * @param writer The frames.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The connection is closed.
    */
-  void sendReceive();
+  int send(Net_Writer &writer);
+
+  /**
+   * @brief Reads what the server sent, without waiting, and handles every complete frame.
+   *
+   * @param handler The function called with every frame, its payload is valid during the call.
+   *
+   * @return The number of frames handled, -1 if the connection is closed or a frame is corrupted.
+   */
+  int receive(const std::function<void(const Net_Message &message)> &handler);
+
+  /**
+   * @brief Returns the writer of the frames to the server, its sequence follows the connection.
+   *
+   * @return The writer.
+   */
+  Net_Writer &writer();
 
 private:
-#ifdef _WIN32
-  SOCKET m_socket; ///< The socket descriptor for the connection to the game server (Windows).
-#elif __linux__
-  int m_socket; ///< The socket descriptor for the connection to the game server (Linux).
-#endif
+  Net_Socket m_socket;            ///< The socket descriptor for the connection to the game server.
+  Net_Ring m_input;               ///< The bytes received, the frames are parsed in place.
+  std::vector<uint8_t> m_scratch; ///< The frames that wrap around the end of the ring.
+  Net_Writer m_writer;            ///< The frames to the server.
 };
 
 ////////////////////////
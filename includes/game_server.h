@@ -7,38 +7,100 @@
 ////////////////////////
 
 #include <iostream>
-
-#ifdef _WIN32
-#include <winsock2.h>
-#include <vector>
-#elif __linux__
-#include <sys/socket.h>
-#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <vector>
-#include <unistd.h>
-#endif
+#include <net_poller.h>
+#include <net_protocol.h>
+#include <net_record.h>
+
+class GameServer;
+
+/**
+ * @brief Configuration of the game servers.
+ */
+struct GameServer_Settings
+{
+  int port;           ///< The port the servers listen to.
+  int max_clients;    ///< The maximum number of connections, the next ones are closed as they are accepted.
+  int max_input;      ///< The bytes received and not consumed of a client, a longer message disconnects it.
+  int max_output;     ///< The bytes waiting to be sent to a client, a client that doesn't read is disconnected.
+  float idle_timeout; ///< The seconds a client can stay silent before it is disconnected, 0 never.
+};
 
 /**
  * @brief A structure representing a client connected to the game server.
  */
 struct Client
 {
-#ifdef _WIN32
-  SOCKET socket; ///< The socket descriptor for the connection to the client (Windows).
-#elif __linux__
-  int socket; ///< The socket descriptor for the connection to the client (Linux).
-#endif
-  sockaddr_in address; ///< The address of the client.
+  Net_Socket socket;        ///< The socket descriptor for the connection to the client, invalid if the slot is free.
+  sockaddr_in address;      ///< The address of the client.
+  Net_Ring input;           ///< The bytes received and not consumed yet, the socket is read straight into it.
+  std::vector<char> output; ///< The bytes waiting for the socket to send them.
+  int sent;                 ///< The bytes of output already sent.
+  double lastReceive;       ///< The time of the last bytes received, in seconds.
+};
+
+/**
+ * @brief The functions called by the event loop.
+ *
+ * Every one is optional; without received the server echoes the bytes back to the client.
+ */
+struct GameServer_Events
+{
+  std::function<void(GameServer &server, int client)> connected; ///< A client was accepted.
+
+  /**
+   * A client sent data, the bytes not consumed from the input stay there for the next ones.
+   */
+  std::function<void(GameServer &server, int client, Net_Ring &input)> received;
+
+  std::function<void(GameServer &server, int client)> disconnected; ///< A client was closed, its slot can be reused.
+};
+
+/**
+ * @brief A timer of the event loop.
+ */
+struct GameServer_Timer
+{
+  double due;                                 ///< The time it fires, in seconds.
+  float interval;                             ///< The seconds between firings.
+  bool repeat;                                ///< A flag indicating whether it fires again after the interval.
+  bool active;                                ///< A flag indicating whether the timer is used.
+  std::function<void(GameServer &)> callback; ///< The function called.
+};
+
+/**
+ * @brief The counters of a game server.
+ */
+struct GameServer_Stats
+{
+  long long accepted; ///< The connections accepted.
+  long long closed;   ///< The connections closed.
+  long long bytesIn;  ///< The bytes received.
+  long long bytesOut; ///< The bytes sent.
+  long long events;   ///< The events of the sockets handled.
+  int clients;        ///< The clients connected.
+  int peak;           ///< The most clients connected at once.
 };
 
 /**
  * @brief A class for listening for connections and sending/receiving data on a game server.
+ *
+ * A single event loop accepts, reads and writes every non-blocking socket as it becomes ready,
+ * so a silent client never stalls the others and the clients are only touched by the thread of
+ * the loop. Every client has an input ring, the socket is read straight into it and the frames
+ * are parsed in place, and an output buffer, with the bytes the socket couldn't take; they are
+ * sent when the socket is writable again. The timers fire from the same loop, between the events.
  */
 class GameServer
 {
 public:
+  static GameServer_Settings settings_; ///< The configuration used by every server.
+
   /**
-   * @brief Constructor for the GameServer class.
+   * @brief Constructor for the GameServer class, the server listens once opened.
    */
   GameServer();
 
@@ -47,25 +109,209 @@ public:
    */
   ~GameServer();
 
+  GameServer(const GameServer &) = delete; ///< The server owns its sockets, it can't be copied.
+  void operator=(const GameServer &) = delete;
+
+  /**
+   * @brief Starts listening for connections.
+   *
+   * @param port The port to listen to, 0 takes a free one.
+   * @param shared True to share the port with other servers, each one accepts some of the connections.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The socket can't be created, shared, bound or listened.
+   */
+  int open(int port, bool shared = false);
+
+  /**
+   * @brief Closes every client and stops listening.
+   */
+  void close();
+
+  /**
+   * @brief Returns the port the server listens to.
+   *
+   * @return The port, 0 if the server is not open.
+   */
+  int port();
+
+  /**
+   * @brief Sets the functions called by the event loop.
+   *
+   * @param events The functions.
+   */
+  void setEvents(const GameServer_Events &events);
+
+  /**
+   * @brief Waits for the events of the sockets and handles them, then fires the timers due.
+   *
+   * @param timeout The maximum wait in milliseconds, shortened to the next timer.
+   *
+   * @return The number of events handled, -1 if the server is not open or the wait failed.
+   */
+  int poll(int timeout);
+
+  /**
+   * @brief Runs the event loop until stop() is called.
+   */
+  void run();
+
+  /**
+   * @brief Makes run() return, it can be called from any thread.
+   */
+  void stop();
+
+  /**
+   * @brief Sends data to a client, what the socket can't take now is sent when it is writable.
+   *
+   * @param client The client.
+   * @param data The bytes.
+   * @param size The number of bytes.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The client is not connected, or it was disconnected because it doesn't read.
+   */
+  int send(int client, const void *data, int size);
+
+  /**
+   * @brief Closes the connection with a client.
+   *
+   * @param client The client.
+   */
+  void disconnect(int client);
+
+  /**
+   * @brief Returns whether a client is connected.
+   *
+   * @param client The client.
+   *
+   * @return True if the client is connected.
+   */
+  bool connected(int client);
+
+  /**
+   * @brief Adds a timer fired by the event loop.
+   *
+   * @param seconds The seconds until it fires.
+   * @param repeat True to fire it every seconds until it is removed.
+   * @param callback The function called.
+   *
+   * @return The timer.
+   */
+  int addTimer(float seconds, bool repeat, std::function<void(GameServer &)> callback);
+
+  /**
+   * @brief Removes a timer, it can be called from its own callback.
+   *
+   * @param timer The timer.
+   */
+  void removeTimer(int timer);
+
+  /**
+   * @brief Returns the time of the event loop.
+   *
+   * @return The seconds since the server was opened.
+   */
+  double time();
+
+  /**
+   * @brief Returns the counters of the server.
+   *
+   * @return The counters.
+   */
+  const GameServer_Stats &stats();
+
+  /**
+   * @brief Starts recording the connections, accepts, bytes and closes, in a log; it ends when the server closes.
+   *
+   * @param path The path of the log, an existing file is replaced.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The log can't be created.
+   */
+  int startRecording(const std::string &path);
+
   /**
-   * @brief Listens for incoming connections and adds them to a list of clients.
+   * @brief Stops recording and closes the log.
    */
-  void listenForConnections();
+  void stopRecording();
 
   /**
-   * @brief Sends data to and receives data from the clients.
+   * @brief Returns the log of the connections, the owner of the server adds its own events to it.
+   *
+   * @return The recorder, not recording if no log was started.
    */
-  void sendReceive();
+  Net_Recorder &recorder();
 
 private:
-#ifdef _WIN32
-  SOCKET m_socket; ///< The socket descriptor for the server (Windows).
-#elif __linux__
-  int m_socket; ///< The socket descriptor for the server (Linux).
+  Net_Socket m_socket;            ///< The socket descriptor for the server.
+#ifdef __linux__
+  int m_spare;                    ///< A descriptor held for the accepts out of descriptors, -1 if it can't be opened (Linux).
 #endif
-  std::vector<Client> m_clients; ///< A list of clients connected to the server.
+  Net_Poller m_poller;            ///< The readiness of the server socket and the clients.
+  std::vector<Client> m_clients;  ///< A list of clients connected to the server, the index is the client.
+  std::vector<int> m_free;        ///< The free slots of m_clients.
+  std::vector<Net_Event> m_ready; ///< The events of the last wait.
+
+  GameServer_Events m_events;             ///< The functions called by the event loop.
+  std::vector<GameServer_Timer> m_timers; ///< The timers, the index is the timer.
+  int m_idleTimer;                        ///< The timer that disconnects the silent clients, -1 if there is none.
+
+  std::atomic<bool> m_running;                   ///< A flag indicating whether run() goes on.
+  std::chrono::steady_clock::time_point m_start; ///< The time the server was opened.
+  GameServer_Stats m_stats;                      ///< The counters.
+  Net_Recorder m_recorder;                       ///< The log of the connections, closed if not recording.
+
+  /**
+   * @brief Accepts the pending connections, until the server socket would block.
+   *
+   * Out of descriptors the edge of the server socket would not come again: on Linux the spare
+   * descriptor is freed to accept the next connection and close it, so the queue keeps draining.
+   */
+  void accept();
+
+  /**
+   * @brief Reads a client until its socket would block, passing the bytes to the received event.
+   *
+   * @param client The client.
+   */
+  void receive(int client);
+
+  /**
+   * @brief Sends the output buffer of a client until its socket would block.
+   *
+   * @param client The client.
+   */
+  void flush(int client);
+
+  /**
+   * @brief Fires the timers due.
+   *
+   * @return The milliseconds until the next timer, -1 if there is none.
+   */
+  int fireTimers();
+
+  /**
+   * @brief Disconnects the clients silent for longer than settings_.idle_timeout.
+   */
+  void closeIdle();
 };
 
+/**
+ * @brief Generates load on a game server, printing the results on the console.
+ *
+ * The server runs its event loop on a thread while the generator connects every client at once
+ * through the loopback, then every client sends a message and waits for its echo, rounds times.
+ * The clients stay connected until the last one finishes, so all of them are served at once.
+ *
+ * @param clients The number of clients, 0 runs 100, 1000 and 5000 clients.
+ * @param rounds The round trips of every client.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A client couldn't connect, an echo didn't match or the server didn't see every client at once.
+ */
+int GameServer_Benchmark(int clients, int rounds);
+
 ////////////////////////
 #endif /* __GAME_SERVER_H__ */
 ////////////////////////
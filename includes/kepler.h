@@ -0,0 +1,99 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file Kepler.h
+
+////////////////////////
+#ifndef __KEPLER_H__
+#define __KEPLER_H__ 1
+////////////////////////
+
+#include <entity_3d.h>
+
+#define KEPLER_ITERATIONS 8   ///< The maximum Newton iterations of the Kepler equation.
+#define KEPLER_TOLERANCE 1e-6f ///< The eccentric anomaly error at which the solver stops.
+
+/**
+ * @struct Orbital_Elements.
+ *
+ * @brief A Keplerian orbit, the position of the body is a function of the time.
+ *
+ * The angles are in radians and the reference plane is the x-y plane of the scene.
+ * The perifocal axes are derived from the angles by Kepler_Init.
+ */
+struct Orbital_Elements
+{
+  float semi_major;     ///< The semi-major axis, half the longest diameter of the ellipse.
+  float eccentricity;   ///< The eccentricity, 0 for circles and under 1 for ellipses.
+  float inclination;    ///< The angle between the orbit plane and the reference plane.
+  float ascending_node; ///< The longitude of the ascending node.
+  float periapsis;      ///< The argument of periapsis, from the ascending node.
+  float mean_anomaly;   ///< The mean anomaly at the time 0.
+  float mean_motion;    ///< The mean anomaly travelled per second, 2 PI / period.
+  Vec3 center;          ///< The focus of the ellipse, the body orbited.
+  Vec3 p;               ///< Unit axis towards the periapsis.
+  Vec3 q;               ///< Unit axis in the orbit plane, 90 degrees ahead of p.
+};
+
+/**
+ * @brief Creates the elements of an orbit.
+ *
+ * @param semi_major The semi-major axis.
+ * @param eccentricity The eccentricity, clamped under 1.
+ * @param inclination The inclination in degrees.
+ * @param ascending_node The longitude of the ascending node in degrees.
+ * @param periapsis The argument of periapsis in degrees.
+ * @param mean_anomaly The mean anomaly at the time 0 in degrees.
+ * @param period The time of a revolution in seconds, negative periods orbit backwards.
+ * @param center The focus of the orbit.
+ *
+ * @return The elements, with the perifocal axes set.
+ */
+Orbital_Elements Kepler_Elements(float semi_major, float eccentricity, float inclination, float ascending_node,
+                                 float periapsis, float mean_anomaly, float period, Vec3 center);
+
+/**
+ * @brief Computes the perifocal axes of the elements from their angles.
+ *
+ * @param orbit The elements to update.
+ */
+void Kepler_Init(Orbital_Elements &orbit);
+
+/**
+ * @brief Solves the Kepler equation M = E - e sin(E) by Newton iterations.
+ *
+ * The first guess is M + e sin(M), or PI for very eccentric orbits, so most
+ * orbits converge in two or three iterations.
+ *
+ * @param mean_anomaly The mean anomaly M in radians.
+ * @param eccentricity The eccentricity e, under 1.
+ *
+ * @return The eccentric anomaly E in radians, between -PI and PI.
+ */
+float Kepler_Solve(float mean_anomaly, float eccentricity);
+
+/**
+ * @brief Returns the position of a body at a time, in O(1).
+ *
+ * @param orbit The elements of the orbit.
+ * @param time The time in seconds, in double so long simulations keep their precision.
+ *
+ * @return The position.
+ */
+Vec3 Kepler_Position(const Orbital_Elements &orbit, double time);
+
+/**
+ * @brief Returns the circular orbit that an incremental orbit describes.
+ *
+ * The orbit plane is perpendicular to the rotation of the orbit and the body keeps its distance to the center.
+ *
+ * @param position The current position of the body.
+ * @param orbit The incremental orbit, rotated every frame.
+ * @param frame_rate The frames per second, to convert the rotation per frame in a period.
+ * @param time The current time, the body is at its position at this time.
+ *
+ * @return The elements, a semi-major axis of 0 if the orbit doesn't move the body.
+ */
+Orbital_Elements Kepler_From_Orbit(Vec3 position, const Entity_Orbit &orbit, float frame_rate, double time);
+
+////////////////////////
+#endif /* __KEPLER_H__ */
+////////////////////////
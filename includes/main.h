@@ -23,8 +23,12 @@
 
 #include <render.h>
 #include <objects.h>
+#include <scene.h>
 #include <my_window.h>
 #include <debug_window.h>
+#include <net_replication.h>
+#include <net_shards.h>
+#include <quantize.h>
 
 const int k_TextHeight = 28;
 const int k_TextWitdh = ((float)(k_TextHeight * 4 / 7) - 1);
@@ -53,7 +57,7 @@ SDL_Color g_colors[MAX_COLORS] = {
     SDL_Color{000, 000, 000, 255}, // BLACK
 };
 
-void Basic_Objects_Init(std::vector<struct Objects> &objects, Vec3 &light, Render &drawRender, Vec3 **objects_mov, Vec3 **objects_scale);
+void Basic_Objects_Init(Registry &registry, Vec3 &light, Render &drawRender);
 
 ////////////////////////
 #endif /* __MAIN_H__ */
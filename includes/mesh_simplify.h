@@ -0,0 +1,56 @@
+/// @author Marcos Jiménez Saz <jimenezsa@esat-alumni.com>
+
+/// @file Mesh_simplify.h
+
+////////////////////////
+#ifndef __MESH_SIMPLIFY_H__
+#define __MESH_SIMPLIFY_H__ 1
+////////////////////////
+
+#include <cstddef>
+#include <math_utils.h>
+
+/**
+ * @brief Simplifies a triangle mesh by quadric edge-collapse.
+ *
+ * Every edge is collapsed onto one of its two vertices (half-edge collapse), choosing the
+ * endpoint with the lowest quadric error. The surviving triangles always index the original
+ * points, so every simplified level can share the vertex array of the full mesh.
+ *
+ * The collapse runs once and a snapshot of the surviving triangles is taken each time the
+ * triangle count drops under the next target, so the whole chain costs a single pass.
+ *
+ * @param points The mesh points.
+ * @param n_points The number of points.
+ * @param tris Triangle indices, 3 per triangle.
+ * @param n_tris The number of triangles.
+ * @param targets Target triangle counts of each level, in decreasing order.
+ * @param n_targets The number of levels to generate.
+ * @param out_tris For each level, a buffer of at least 3 * n_tris ints to store the level triangles.
+ * @param out_n_tris For each level, the number of triangles written.
+ * @param out_ids Optional, for each level a buffer of at least n_tris ints to store the index of the
+ *                original triangle every surviving triangle comes from.
+ *
+ * @return The number of levels generated (can be less than n_targets if the mesh can't be reduced more).
+ */
+int Simplify_Triangles(const Vec3 *points, int n_points, const int *tris, int n_tris,
+                       const int *targets, int n_targets, int **out_tris, int *out_n_tris,
+                       int **out_ids = nullptr);
+
+/**
+ * @brief Returns an upper estimate of the memory Simplify_Triangles allocates while it runs.
+ *
+ * Counts the copy of the triangles, the flags, stamps and quadrics of the points, the triangles of
+ * every point, the unique edges and the queue of collapses, with the growth of the vectors. The
+ * output buffers are not counted, the caller allocates them.
+ *
+ * @param n_points The number of points.
+ * @param n_tris The number of triangles.
+ *
+ * @return The bytes.
+ */
+size_t Simplify_Memory(int n_points, int n_tris);
+
+////////////////////////
+#endif /* __MESH_SIMPLIFY_H__ */
+////////////////////////
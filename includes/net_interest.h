@@ -0,0 +1,101 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_interest.h
+
+////////////////////////
+#ifndef __NET_INTEREST_H__
+#define __NET_INTEREST_H__
+////////////////////////
+
+#include <vector>
+#include <vector_3.h>
+
+/**
+ * @brief Configuration of the interest management of the replication server.
+ */
+struct Interest_Settings
+{
+  bool enabled;     ///< A flag indicating whether the clients that send their view only receive what it sees.
+  float cell;       ///< The side of the cells of the grid, in world units.
+  int max_entities; ///< The most entities a client receives, the most relevant ones.
+  int budget;       ///< The bytes of the snapshot of a client per tick, the most important changes go first.
+};
+
+/**
+ * @brief The bounds of the bodies of a bucket of the grid.
+ */
+struct Interest_Box
+{
+  Vec3 min; ///< The lowest corner.
+  Vec3 max; ///< The highest corner.
+};
+
+/**
+ * @class Interest_Grid
+ *
+ * @brief Finds the bodies inside the views of the clients, with a uniform grid.
+ *
+ * The grid is built once per tick and queried once per client. Every body goes to the cell of its
+ * center, hashed in a table sorted by counting as the Collider does. Every bucket keeps the box of
+ * its bodies, spheres included, so a body of any size is found from its cell and a bucket shared
+ * by far cells only culls worse. A query tests the boxes of the buckets used against the planes:
+ * the buckets outside are skipped, the ones inside are taken whole, only the bodies of the others
+ * are tested one by one.
+ */
+class Interest_Grid
+{
+public:
+  static Interest_Settings settings_; ///< The configuration used by every grid.
+
+  /**
+   * @brief Constructs an empty Interest_Grid.
+   */
+  Interest_Grid();
+
+  Interest_Grid(const Interest_Grid &) = delete; ///< The grid points to the arrays it was built with, it can't be copied.
+  void operator=(const Interest_Grid &) = delete;
+
+  /**
+   * @brief Puts the bodies in the grid, the arrays must live until the last query.
+   *
+   * The queries don't change the grid, many threads can query it at once.
+   *
+   * @param positions The center of each body.
+   * @param radii The radius of each body.
+   * @param count The number of bodies.
+   */
+  void build(const Vec3 *positions, const float *radii, int count);
+
+  /**
+   * @brief Finds the bodies inside a convex volume.
+   *
+   * A sphere is inside a plane when DotProduct(center - point, normal) >= -radius, as in Bvh::frustum.
+   *
+   * @param points A point of each plane.
+   * @param normals The normal of each plane, normalized, towards the inside.
+   * @param planes The number of planes.
+   * @param indices Returns the indices of the bodies inside, by bucket.
+   *
+   * @return The number of bodies inside.
+   */
+  int query(const Vec3 *points, const Vec3 *normals, int planes, std::vector<int> &indices) const;
+
+  /**
+   * @brief Returns the number of buckets with bodies.
+   *
+   * @return The buckets used by the last build.
+   */
+  int cells();
+
+private:
+  std::vector<int> m_sorted;          ///< The bodies sorted by bucket.
+  std::vector<int> m_starts;          ///< The first position in m_sorted of each bucket, and the end of the last one.
+  std::vector<int> m_used;            ///< The buckets with bodies.
+  std::vector<Interest_Box> m_boxes;  ///< The bounds of each bucket, valid for the used ones.
+  const Vec3 *m_positions;            ///< The centers of the last build.
+  const float *m_radii;               ///< The radii of the last build.
+  int m_count;                        ///< The bodies of the last build.
+};
+
+////////////////////////
+#endif /* __NET_INTEREST_H__ */
+////////////////////////
@@ -0,0 +1,184 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_poller.h
+
+////////////////////////
+#ifndef __NET_POLLER_H__
+#define __NET_POLLER_H__
+////////////////////////
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <unordered_map>
+#elif __linux__
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+typedef SOCKET Net_Socket; ///< A socket descriptor (Windows).
+typedef int Net_Length;    ///< The size of a socket address or option (Windows).
+#define NET_INVALID_SOCKET INVALID_SOCKET
+#elif __linux__
+typedef int Net_Socket;       ///< A socket descriptor (Linux).
+typedef socklen_t Net_Length; ///< The size of a socket address or option (Linux).
+#define NET_INVALID_SOCKET -1
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 ///< Only Linux raises SIGPIPE when sending to a closed socket.
+#endif
+
+/**
+ * @brief The readiness of a socket returned by Net_Poller::wait.
+ */
+struct Net_Event
+{
+  uint64_t id; ///< The id the socket was added with.
+  bool read;   ///< The socket has data to read, or a connection to accept.
+  bool write;  ///< The socket can send again.
+  bool error;  ///< The socket failed or the other side closed it.
+};
+
+/**
+ * @brief Waits for the readiness of many non-blocking sockets at once.
+ *
+ * On Linux it is an edge-triggered epoll: an event is returned once when a socket becomes ready,
+ * so the owner must read, accept or send until the socket would block. On Windows it is WSAPoll,
+ * which reports the sockets while they stay ready; the same draining loops work with both. With
+ * both, the writes are only reported for the sockets watched for them by watchWrite.
+ */
+class Net_Poller
+{
+public:
+  /**
+   * @brief Constructor for the Net_Poller class, the poller is opened by open().
+   */
+  Net_Poller();
+
+  /**
+   * @brief Destructor for the Net_Poller class.
+   */
+  ~Net_Poller();
+
+  Net_Poller(const Net_Poller &) = delete; ///< The poller owns its descriptor, it can't be copied.
+  void operator=(const Net_Poller &) = delete;
+
+  /**
+   * @brief Creates the poller.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The poller can't be created.
+   */
+  int open();
+
+  /**
+   * @brief Closes the poller, the sockets stay open.
+   */
+  void close();
+
+  /**
+   * @brief Starts watching a socket for reads and errors.
+   *
+   * @param socket A non-blocking socket.
+   * @param id The id returned with its events.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The socket can't be watched.
+   */
+  int add(Net_Socket socket, uint64_t id);
+
+  /**
+   * @brief Stops watching a socket, before it is closed.
+   *
+   * @param socket A watched socket.
+   */
+  void remove(Net_Socket socket);
+
+  /**
+   * @brief Sets whether the writes of a socket are reported, only while it has data waiting.
+   *
+   * Watching again reports the socket if it can already send, as edge-triggered events only
+   * report a change.
+   *
+   * @param socket A watched socket.
+   * @param id The id the socket was added with.
+   * @param write True to report when the socket can send.
+   */
+  void watchWrite(Net_Socket socket, uint64_t id, bool write);
+
+  /**
+   * @brief Waits for the events of the watched sockets.
+   *
+   * @param events The events returned.
+   * @param max The maximum number of events.
+   * @param timeout The maximum wait in milliseconds, -1 waits forever.
+   *
+   * @return The number of events, -1 if the wait failed.
+   */
+  int wait(Net_Event *events, int max, int timeout);
+
+private:
+#ifdef _WIN32
+  std::vector<WSAPOLLFD> m_fds;                ///< The watched sockets (Windows).
+  std::vector<uint64_t> m_ids;                 ///< The id of each watched socket.
+  std::unordered_map<SOCKET, int> m_positions; ///< The position of each socket in m_fds.
+#elif __linux__
+  int m_epoll;                              ///< The epoll descriptor (Linux).
+  std::vector<struct epoll_event> m_events; ///< The events of the last wait.
+#endif
+};
+
+/**
+ * @brief Starts the sockets of the system, Windows needs it before any socket.
+ */
+void Net_Startup();
+
+/**
+ * @brief Ends the sockets of the system, once per Net_Startup.
+ */
+void Net_Cleanup();
+
+/**
+ * @brief Makes the calls on a socket return instead of waiting.
+ *
+ * @param socket The socket.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The mode can't be changed.
+ */
+int Net_Set_Non_Blocking(Net_Socket socket);
+
+/**
+ * @brief Lets other sockets bind the same port, the system spreads the connections among them.
+ *
+ * It must be called before binding. Windows has no such option, the call fails there.
+ *
+ * @param socket The socket.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The port can't be shared.
+ */
+int Net_Share_Port(Net_Socket socket);
+
+/**
+ * @brief Closes a socket.
+ *
+ * @param socket The socket.
+ */
+void Net_Close(Net_Socket socket);
+
+/**
+ * @brief Returns whether the last call failed only because the socket would have waited.
+ *
+ * @return True if the call would block or a connection is in progress.
+ */
+bool Net_Would_Block();
+
+////////////////////////
+#endif /* __NET_POLLER_H__ */
+////////////////////////
@@ -0,0 +1,487 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_protocol.h
+
+////////////////////////
+#ifndef __NET_PROTOCOL_H__
+#define __NET_PROTOCOL_H__
+////////////////////////
+
+#include <SDL2/SDL.h>
+#include <vector_3.h>
+#include <cstdint>
+#include <vector>
+
+#define NET_VERSION 4             ///< The version of the protocol, a frame of another version is rejected.
+#define NET_HEADER 12             ///< The bytes of the header of a frame.
+#define NET_MAX_PAYLOAD (1 << 24) ///< The largest payload accepted, a longer length is taken as corrupted.
+#define NET_VIEW_PLANES 6         ///< The planes of the frustum of a view.
+#define NET_CREATE_BYTES 64       ///< The bytes of a Net_Create on the wire.
+#define NET_TRANSFORM_BYTES 40    ///< The bytes of a Net_Transform on the wire.
+
+/**
+ * @brief The types of the messages.
+ */
+enum Net_Type
+{
+  NET_HELLO = 1, ///< The first message of a connection, the payload is empty.
+  NET_CREATE,    ///< Entities created: count and Net_Create entries.
+  NET_DESTROY,   ///< Entities destroyed: count and their handles.
+  NET_TRANSFORM, ///< Entities moved: count and Net_Transform entries.
+  NET_CAMERA,    ///< The camera: a Net_Camera.
+  NET_SNAPSHOT,  ///< The transforms of the entities, delta encoded against an acknowledged snapshot.
+  NET_ACK,       ///< The last snapshot received: its id.
+  NET_VIEW,      ///< What a client sees: a Net_View.
+  NET_MAX_TYPE,
+};
+
+/**
+ * @brief The header of a frame, every field little endian on the wire.
+ *
+ * length u32 | version u8 | type u8 | reserved u16 | sequence u32, followed by length bytes of payload.
+ */
+struct Net_Header
+{
+  uint32_t length;   ///< The bytes of the payload.
+  uint8_t version;   ///< The version of the protocol.
+  uint8_t type;      ///< The type of the message, a Net_Type.
+  uint32_t sequence; ///< The number of the frame in its connection, from 0.
+};
+
+/**
+ * @brief A frame parsed, its payload points to the receive buffer.
+ */
+struct Net_Message
+{
+  Net_Header header;      ///< The header.
+  const uint8_t *payload; ///< The payload, valid until the frame is consumed.
+};
+
+/**
+ * @brief The transform of an entity, 40 bytes on the wire.
+ */
+struct Net_Transform
+{
+  uint32_t entity; ///< The handle of the entity.
+  Vec3 position;   ///< The position.
+  Vec3 rotation;   ///< The rotation.
+  Vec3 scale;      ///< The scale.
+};
+
+/**
+ * @brief An entity created, 64 bytes on the wire.
+ */
+struct Net_Create
+{
+  uint32_t entity;     ///< The handle of the entity.
+  uint8_t type;        ///< The object type, it is define in enum ObjectsType.
+  uint8_t fill;        ///< Non zero if the entity is filled.
+  uint8_t res;         ///< The resolution of a sphere.
+  int8_t subdivisions; ///< The subdivision level of an icosphere, -1 for the UV spheres.
+  int32_t mesh;        ///< The mesh of a figure, -1 for the other types.
+  SDL_Color color;     ///< The fill color.
+  Vec3 position;       ///< The position.
+  Vec3 rotation;       ///< The rotation.
+  Vec3 scale;          ///< The scale.
+  Vec3 spin;           ///< The degrees per second its orbit turns it, the receiver turns it on its own.
+};
+
+/**
+ * @brief The state of the camera, 44 bytes on the wire.
+ */
+struct Net_Camera
+{
+  Vec3 position; ///< The position.
+  Vec3 front;    ///< The front vector.
+  Vec3 up;       ///< The up vector.
+  float near;    ///< The near plane distance.
+  float far;     ///< The far plane distance.
+};
+
+/**
+ * @brief The view of a client, the server sends it what is inside, 156 bytes on the wire.
+ */
+struct Net_View
+{
+  Vec3 position;                 ///< The position of the camera.
+  Vec3 points[NET_VIEW_PLANES];  ///< A point of each plane of the frustum.
+  Vec3 normals[NET_VIEW_PLANES]; ///< The normal of each plane, normalized, towards the inside.
+};
+
+/**
+ * @brief A byte queue in a power of 2 circular buffer, the sockets are read straight into it.
+ *
+ * The bytes are taken from the front and added at the back. The free space and the queued bytes
+ * are one or two contiguous ranges, the second one from the start of the buffer when they wrap.
+ */
+class Net_Ring
+{
+public:
+  /**
+   * @brief Constructs an empty ring, the buffer is allocated by the first reserve.
+   */
+  Net_Ring();
+
+  Net_Ring(const Net_Ring &) = delete; ///< The ring owns its buffer, it can't be copied.
+  void operator=(const Net_Ring &) = delete;
+  Net_Ring(Net_Ring &&other);            ///< The buffer moves with the ring.
+  Net_Ring &operator=(Net_Ring &&other); ///< The buffer moves with the ring.
+
+  /**
+   * @brief Grows the buffer, the queued bytes are kept.
+   *
+   * @param capacity The minimum bytes, rounded up to a power of 2.
+   */
+  void reserve(int capacity);
+
+  /**
+   * @brief Releases the buffer.
+   */
+  void release();
+
+  /**
+   * @brief Returns the contiguous free space at the back, to write to it in place.
+   *
+   * @param contiguous The bytes that can be written.
+   *
+   * @return The first free byte.
+   */
+  uint8_t *back(int &contiguous);
+
+  /**
+   * @brief Adds to the queue the bytes written in place.
+   *
+   * @param bytes The bytes written, at most the contiguous free space.
+   */
+  void produce(int bytes);
+
+  /**
+   * @brief Copies bytes to the back, the ring grows if they don't fit.
+   *
+   * @param data The bytes.
+   * @param size The number of bytes.
+   */
+  void write(const void *data, int size);
+
+  /**
+   * @brief Returns queued bytes without taking them.
+   *
+   * The bytes are returned in place when they are contiguous; when they wrap they are copied
+   * to the scratch buffer.
+   *
+   * @param offset The first byte, from the front.
+   * @param size The number of bytes.
+   * @param scratch The buffer for the wrapped bytes.
+   *
+   * @return The bytes, nullptr if fewer are queued.
+   */
+  const uint8_t *peek(int offset, int size, std::vector<uint8_t> &scratch);
+
+  /**
+   * @brief Returns the contiguous queued bytes at the front.
+   *
+   * @param contiguous The bytes that can be read.
+   *
+   * @return The first byte.
+   */
+  const uint8_t *front(int &contiguous);
+
+  /**
+   * @brief Takes bytes from the front.
+   *
+   * @param bytes The bytes, at most size().
+   */
+  void consume(int bytes);
+
+  /**
+   * @brief Returns the queued bytes.
+   *
+   * @return The number of bytes.
+   */
+  int size();
+
+  /**
+   * @brief Returns the size of the buffer.
+   *
+   * @return The number of bytes, 0 until it is allocated.
+   */
+  int capacity();
+
+  /**
+   * @brief Destroys the ring and its buffer.
+   */
+  ~Net_Ring();
+
+private:
+  uint8_t *m_data; ///< The buffer.
+  int m_capacity;  ///< The bytes of the buffer, a power of 2.
+  int m_head;      ///< The position of the front byte.
+  int m_size;      ///< The queued bytes.
+};
+
+/**
+ * @brief Writes frames to a byte buffer, the numbers little endian.
+ */
+class Net_Writer
+{
+public:
+  /**
+   * @brief Constructs a writer with an empty buffer, the first frame is the sequence 0.
+   */
+  Net_Writer();
+
+  /**
+   * @brief Starts a frame, its length is written by end().
+   *
+   * @param type The type of the message.
+   */
+  void begin(Net_Type type);
+
+  /**
+   * @brief Ends the frame started.
+   */
+  void end();
+
+  void u8(uint8_t value);               ///< Writes a byte.
+  void u16(uint16_t value);             ///< Writes 2 bytes.
+  void u32(uint32_t value);             ///< Writes 4 bytes.
+  void f32(float value);                ///< Writes a float as its 4 bytes.
+  void vec3(Vec3 value);                ///< Writes the 3 floats of a vector.
+  void varint(uint32_t value);          ///< Writes 7 bits per byte, the small values take a single byte.
+  void raw(const void *data, int size); ///< Writes bytes as they are.
+
+  /**
+   * @brief Returns the frames written.
+   *
+   * @return The bytes.
+   */
+  const std::vector<uint8_t> &bytes();
+
+  /**
+   * @brief Empties the buffer, the sequence goes on.
+   */
+  void clear();
+
+  /**
+   * @brief Returns the sequence of the next frame.
+   *
+   * @return The sequence.
+   */
+  uint32_t sequence();
+
+private:
+  std::vector<uint8_t> m_bytes; ///< The frames.
+  size_t m_start;               ///< The position of the header of the frame started.
+  uint32_t m_sequence;          ///< The sequence of the next frame.
+};
+
+/**
+ * @brief Reads the fields of a payload, in place.
+ *
+ * A read past the end returns 0 and clears ok, so a message can be read whole and checked once.
+ */
+struct Net_Reader
+{
+  const uint8_t *data; ///< The payload.
+  uint32_t size;       ///< The bytes of the payload.
+  uint32_t offset;     ///< The next byte.
+  bool ok;             ///< False once a read went past the end.
+
+  uint8_t u8();      ///< Reads a byte.
+  uint16_t u16();    ///< Reads 2 bytes.
+  uint32_t u32();    ///< Reads 4 bytes.
+  float f32();       ///< Reads a float.
+  Vec3 vec3();       ///< Reads a vector.
+  uint32_t varint(); ///< Reads a value of 7 bits per byte.
+};
+
+/**
+ * @brief Returns a reader of the payload of a message.
+ *
+ * @param message The message.
+ *
+ * @return The reader, at the start of the payload.
+ */
+Net_Reader Net_Read(const Net_Message &message);
+
+/**
+ * @brief Parses the frame at the front of a ring, without taking it.
+ *
+ * The payload points into the ring unless the frame wraps around its end, then it is copied to
+ * the scratch buffer. Consume NET_HEADER + header.length bytes once the message is handled.
+ *
+ * @param ring The received bytes.
+ * @param message The frame parsed.
+ * @param scratch The buffer for the wrapped frames.
+ *
+ * @return 1 A frame was parsed.
+ * @return 0 The frame is not complete yet.
+ * @return -1 The frame has another version, an unknown type or a length over NET_MAX_PAYLOAD.
+ */
+int Net_Parse(Net_Ring &ring, Net_Message &message, std::vector<uint8_t> &scratch);
+
+/**
+ * @brief Parses the frame at the front of a buffer, the messages of a datagram hold whole frames.
+ *
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @param message The frame parsed, its payload points to the buffer.
+ *
+ * @return 1 A frame was parsed, it takes NET_HEADER + header.length bytes.
+ * @return 0 The buffer is empty.
+ * @return -1 The frame is cut, has another version, an unknown type or a length over NET_MAX_PAYLOAD.
+ */
+int Net_Parse(const uint8_t *data, int size, Net_Message &message);
+
+/**
+ * @brief Writes a hello frame.
+ *
+ * @param writer The writer.
+ */
+void Net_Write_Hello(Net_Writer &writer);
+
+/**
+ * @brief Writes a frame of created entities.
+ *
+ * @param writer The writer.
+ * @param entities The entities.
+ * @param count The number of entities.
+ */
+void Net_Write_Create(Net_Writer &writer, const Net_Create *entities, int count);
+
+/**
+ * @brief Writes a frame of destroyed entities.
+ *
+ * @param writer The writer.
+ * @param entities The handles of the entities.
+ * @param count The number of entities.
+ */
+void Net_Write_Destroy(Net_Writer &writer, const uint32_t *entities, int count);
+
+/**
+ * @brief Writes a frame of transforms.
+ *
+ * @param writer The writer.
+ * @param transforms The transforms.
+ * @param count The number of transforms.
+ */
+void Net_Write_Transform(Net_Writer &writer, const Net_Transform *transforms, int count);
+
+/**
+ * @brief Writes a camera frame.
+ *
+ * @param writer The writer.
+ * @param camera The camera.
+ */
+void Net_Write_Camera(Net_Writer &writer, const Net_Camera &camera);
+
+/**
+ * @brief Writes a view frame.
+ *
+ * @param writer The writer.
+ * @param view The view.
+ */
+void Net_Write_View(Net_Writer &writer, const Net_View &view);
+
+/**
+ * @brief Returns the number of entries of a create, destroy or transform message.
+ *
+ * @param message The message.
+ *
+ * @return The number of entries, -1 if the payload doesn't hold them.
+ */
+int Net_Count(const Net_Message &message);
+
+/**
+ * @brief Reads an entry of a create message.
+ *
+ * @param message A NET_CREATE message.
+ * @param index The entry, less than Net_Count.
+ * @param entity The entry read.
+ */
+void Net_Read_Create(const Net_Message &message, int index, Net_Create &entity);
+
+/**
+ * @brief Reads an entry of a destroy message.
+ *
+ * @param message A NET_DESTROY message.
+ * @param index The entry, less than Net_Count.
+ *
+ * @return The handle of the entity.
+ */
+uint32_t Net_Read_Destroy(const Net_Message &message, int index);
+
+/**
+ * @brief Reads an entry of a transform message.
+ *
+ * @param message A NET_TRANSFORM message.
+ * @param index The entry, less than Net_Count.
+ * @param transform The entry read.
+ */
+void Net_Read_Transform(const Net_Message &message, int index, Net_Transform &transform);
+
+/**
+ * @brief Reads a camera message.
+ *
+ * @param message A NET_CAMERA message.
+ * @param camera The camera read.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The payload is too short.
+ */
+int Net_Read_Camera(const Net_Message &message, Net_Camera &camera);
+
+/**
+ * @brief Reads a view message.
+ *
+ * @param message A NET_VIEW message.
+ * @param view The view read.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The payload is too short.
+ */
+int Net_Read_View(const Net_Message &message, Net_View &view);
+
+/**
+ * @brief Writes an acknowledgement.
+ *
+ * @param writer The writer.
+ * @param snapshot The id of the snapshot received.
+ */
+void Net_Write_Ack(Net_Writer &writer, uint32_t snapshot);
+
+/**
+ * @brief Maps a signed value to an unsigned one with the small magnitudes first, for varints.
+ *
+ * @param value The value.
+ *
+ * @return 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+ */
+uint32_t Net_Zigzag(int32_t value);
+
+/**
+ * @brief Returns the signed value of Net_Zigzag.
+ *
+ * @param value The mapped value.
+ *
+ * @return The signed value.
+ */
+int32_t Net_Unzigzag(uint32_t value);
+
+/**
+ * @brief Checks the protocol with random messages, printing the results on the console.
+ *
+ * Every iteration writes random frames of every type, feeds them to a ring in random pieces so
+ * the frames wrap around its end, and compares what is parsed with what was written. Then the
+ * stream is corrupted at random bytes: the parser must reject or bound every frame, never read
+ * out of the ring.
+ *
+ * @param iterations The number of streams.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A message parsed doesn't match the one written.
+ */
+int Net_Fuzz(int iterations);
+
+////////////////////////
+#endif /* __NET_PROTOCOL_H__ */
+////////////////////////
@@ -0,0 +1,185 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_record.h
+
+////////////////////////
+#ifndef __NET_RECORD_H__
+#define __NET_RECORD_H__
+////////////////////////
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <net_protocol.h>
+#include <quantize.h>
+
+#define NET_RECORD_MAGIC "SSNR" ///< The first bytes of a log.
+#define NET_RECORD_VERSION 2    ///< The version of the log, a log of another one is not read.
+
+/**
+ * @brief The events of a connection kept in a log.
+ */
+enum Net_Record_Kind
+{
+  NET_RECORD_CONNECTED = 1, ///< A client was accepted, without bytes.
+  NET_RECORD_IN,            ///< Bytes received from a client, as the socket gave them.
+  NET_RECORD_OUT,           ///< Bytes sent to a client, as the server queued them.
+  NET_RECORD_DISCONNECTED,  ///< A client was closed, without bytes.
+  NET_RECORD_WORLD,         ///< The transforms of every entity at a tick, by Quant_Write_Transforms; the client is -1.
+  NET_RECORD_MAX_KIND,
+};
+
+/**
+ * @brief An event of a log.
+ */
+struct Net_Record
+{
+  int kind;            ///< A Net_Record_Kind.
+  int client;          ///< The client of the server.
+  double time;         ///< The time of the server, in seconds.
+  const uint8_t *data; ///< The bytes, they point into the log.
+  int size;            ///< The number of bytes.
+};
+
+/**
+ * @class Net_Recorder
+ *
+ * @brief Appends the events of the connections of a server to a log file.
+ *
+ * The log is the magic and the version, then one record per event: its kind as a byte, then the
+ * client, the microseconds since the previous record and the number of bytes as varints, then the
+ * bytes. The bytes are the stream of the connection cut as the sockets gave it, so a replay sees
+ * exactly what the server saw; a record of a few frames costs a handful of bytes more than them.
+ * The world records keep the transforms of the simulation every few seconds, quantized, so a log
+ * says where the entities were without decoding the frames of a client.
+ */
+class Net_Recorder
+{
+public:
+  /**
+   * @brief Constructs a recorder without file.
+   */
+  Net_Recorder();
+
+  /**
+   * @brief Destructor for the Net_Recorder class, the log is closed.
+   */
+  ~Net_Recorder();
+
+  Net_Recorder(const Net_Recorder &) = delete; ///< The recorder owns its file, it can't be copied.
+  void operator=(const Net_Recorder &) = delete;
+
+  /**
+   * @brief Creates a log, an existing file is replaced.
+   *
+   * @param path The path of the log.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The file can't be created.
+   */
+  int open(const std::string &path);
+
+  /**
+   * @brief Writes what is buffered and closes the log.
+   */
+  void close();
+
+  /**
+   * @brief Returns whether a log is open.
+   *
+   * @return True if the events are recorded.
+   */
+  bool recording();
+
+  /**
+   * @brief Appends an event.
+   *
+   * @param kind The kind of the event.
+   * @param client The client.
+   * @param time The time of the server, in seconds, never less than the one of the previous event.
+   * @param data The bytes, nullptr for none.
+   * @param size The number of bytes.
+   */
+  void record(Net_Record_Kind kind, int client, double time, const void *data, int size);
+
+  /**
+   * @brief Appends the transforms of the entities as a NET_RECORD_WORLD event.
+   *
+   * @param time The time of the server, in seconds, never less than the one of the previous event.
+   * @param positions The positions.
+   * @param rotations The unit quaternions.
+   * @param count The number of entities.
+   * @param step The units of a step of the positions.
+   */
+  void recordWorld(double time, const Vec3 *positions, const Vec4 *rotations, int count, float step);
+
+  /**
+   * @brief Returns the size of the log.
+   *
+   * @return The bytes recorded, the header included.
+   */
+  long long bytes();
+
+private:
+  FILE *m_file;       ///< The log, nullptr if closed.
+  Net_Writer m_entry;        ///< The head of the record being written.
+  Quant_Bits_Writer m_world; ///< The bytes of the world record being written.
+  long long m_time;          ///< The time of the previous record, in microseconds.
+  long long m_bytes;         ///< The bytes recorded.
+};
+
+/**
+ * @class Net_Log
+ *
+ * @brief Reads the events of a log, the file is loaded at once.
+ */
+class Net_Log
+{
+public:
+  /**
+   * @brief Constructs an empty log.
+   */
+  Net_Log();
+
+  /**
+   * @brief Loads a log.
+   *
+   * @param path The path of the log.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The file can't be read.
+   * @return 2 The file is not a log, or it has another version.
+   */
+  int open(const std::string &path);
+
+  /**
+   * @brief Reads the next event.
+   *
+   * @param record The event, its bytes live as long as the log.
+   *
+   * @return 1 An event was read.
+   * @return 0 The log ended.
+   * @return -1 The log is cut or corrupted.
+   */
+  int next(Net_Record &record);
+
+  /**
+   * @brief Goes back to the first event.
+   */
+  void rewind();
+
+  /**
+   * @brief Returns the size of the log.
+   *
+   * @return The bytes of the file.
+   */
+  int size();
+
+private:
+  std::vector<uint8_t> m_data; ///< The file.
+  uint32_t m_offset;           ///< The next record.
+  long long m_time;            ///< The time of the previous record, in microseconds.
+};
+
+////////////////////////
+#endif /* __NET_RECORD_H__ */
+////////////////////////
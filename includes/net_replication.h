@@ -0,0 +1,664 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_replication.h
+
+////////////////////////
+#ifndef __NET_REPLICATION_H__
+#define __NET_REPLICATION_H__
+////////////////////////
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <game_server.h>
+#include <game_client.h>
+#include <net_interest.h>
+#include <net_protocol.h>
+#include <net_udp.h>
+#include <registry.h>
+
+#define REPLICATION_VALUES 9    ///< The quantized values of an entity: position, rotation and scale.
+#define REPLICATION_TURN 65536  ///< The steps of a quantized turn, 16 bits per axis of the rotation.
+
+/**
+ * @brief Configuration of the replication.
+ */
+struct Replication_Settings
+{
+  float tick_rate;     ///< The snapshots sent per second.
+  float position_step; ///< The units of a quantized position.
+  float scale_step;    ///< The units of a quantized scale.
+  int history;         ///< The snapshots kept to be the base of the deltas, an older ack gets a full snapshot.
+  float delay;         ///< The seconds the clients show the snapshots late, the first delay if adaptive.
+  bool adaptive;       ///< A flag indicating whether the delay follows the jitter of the snapshots.
+  float max_delay;     ///< The longest adaptive delay, in seconds.
+  float jitter_margin; ///< The adaptive delay is a tick plus this many times the jitter.
+  float extrapolation; ///< The seconds the entities go on moving when the snapshots stop, then they stop.
+  float record_world;  ///< The seconds between the transforms of the world kept by a recording, 0 never.
+};
+
+/**
+ * @brief The quantized transforms of every entity at a tick of the server.
+ */
+struct Replication_Snapshot
+{
+  uint32_t id;                   ///< The tick, 0 for no snapshot.
+  uint32_t time;                 ///< The time of the server, in milliseconds.
+  std::vector<uint32_t> handles; ///< The handles of the entities, sorted by their slot.
+  std::vector<int32_t> values;   ///< REPLICATION_VALUES per entity, in the order of the handles.
+};
+
+/**
+ * @brief What the clients need of the simulation at a tick.
+ *
+ * It is built after the registry is updated and never changes after, so the threads of the
+ * connections read it at once without locks. The snapshot is kept apart, the history of the
+ * deltas only keeps the snapshots.
+ */
+struct Replication_Tick
+{
+  std::shared_ptr<const Replication_Snapshot> snapshot; ///< The snapshot of every entity.
+  std::vector<Net_Create> creates;                      ///< The description of every entity, in the order of the snapshot.
+  std::vector<Vec3> positions;                          ///< The center of every entity, in the order of the snapshot.
+  std::vector<float> radii;                             ///< The radius of every entity, in the order of the snapshot.
+  Interest_Grid grid;                                   ///< The entities in cells, their indices are the ones of the snapshot.
+  bool gridded;                                         ///< A flag indicating whether the grid was built.
+};
+
+/**
+ * @brief The state of a client of the server.
+ */
+struct Replication_Peer
+{
+  bool ready;                                ///< The client said hello, it receives the snapshots.
+  uint32_t acked;                            ///< The last snapshot it received, 0 if none.
+  Net_Writer writer;                         ///< The frames to the client, its sequence follows the connection.
+  bool viewing;                              ///< The client sent a view while the interest was enabled, it only receives what it sees.
+  Net_View view;                             ///< The last view of the client.
+  std::vector<Replication_Snapshot> history; ///< The snapshots sent to it while viewing, the index is the id modulo the history.
+  std::vector<float> priorities;             ///< The relevance of every entity accumulated while its changes wait, by slot.
+  long long snapshots;                       ///< The snapshots sent to it.
+  long long bytes;                           ///< The bytes of the frames sent to it, descriptions and snapshots.
+};
+
+/**
+ * @brief The counters of the replication.
+ */
+struct Replication_Stats
+{
+  long long snapshots; ///< The snapshots sent or received.
+  long long bytes;     ///< The bytes of those snapshots.
+  long long full;      ///< The snapshots without base.
+  int lastBytes;       ///< The bytes of the last snapshot.
+  int entities;        ///< The entities of the last snapshot.
+  long long deferred;  ///< The changes the budget of the clients left for a later snapshot.
+  int interest;        ///< The entities of the last snapshot sent to a client with a view.
+  long long ticks;     ///< The ticks sent by a server.
+  double tickTime;     ///< The seconds of those ticks: simulating, building and encoding.
+  double simulation;   ///< The seconds of those ticks updating the registry and building the tick.
+  float lastTick;      ///< The milliseconds of the last tick.
+  float peakTick;      ///< The milliseconds of the longest tick.
+  long long overruns;  ///< The ticks longer than the interval between ticks, the next one was late.
+};
+
+/**
+ * @brief An entity replicated by a client.
+ */
+struct Replication_Entity
+{
+  int handle; ///< The handle in the registry of the client.
+  Vec3 spin;  ///< The degrees per second its orbit turns it.
+};
+
+/**
+ * @brief A snapshot waiting in the jitter buffer of a client.
+ */
+struct Replication_Frame
+{
+  Replication_Snapshot snapshot; ///< The snapshot.
+  std::vector<int> locals;       ///< The handle in the registry of the client of every entity, -1 if it has none.
+  double time;                   ///< The time of the server, in seconds.
+};
+
+/**
+ * @brief The state of the playback of a jitter buffer.
+ */
+struct Replication_Playback
+{
+  int depth;              ///< The snapshots received and not shown yet.
+  long long late;         ///< The snapshots received after their time was shown.
+  long long extrapolated; ///< The samples past the last snapshot, the entities went on moving.
+  long long held;         ///< The samples past the extrapolation, the entities stopped.
+  float delay;            ///< The seconds the snapshots are shown late.
+  float jitter;           ///< The variation of the transit of the snapshots, in seconds.
+  float interval;         ///< The seconds between snapshots.
+};
+
+/**
+ * @brief Quantizes the transforms of the entities of a registry.
+ *
+ * @param registry The registry.
+ * @param id The id of the snapshot.
+ * @param time The time of the server, in milliseconds.
+ * @param snapshot The snapshot filled.
+ */
+void Replication_Capture(Registry &registry, uint32_t id, uint32_t time, Replication_Snapshot &snapshot);
+
+/**
+ * @brief Captures the snapshot of a registry and describes its entities.
+ *
+ * An entity of the previous tick keeps its description, only its transform is taken from the snapshot.
+ *
+ * @param registry The registry.
+ * @param id The id of the snapshot.
+ * @param time The time of the server, in milliseconds.
+ * @param grid True to build the grid of the views of the clients.
+ * @param previous The previous tick, nullptr to describe every entity.
+ * @param tick The tick filled, another one than the previous.
+ */
+void Replication_Build(Registry &registry, uint32_t id, uint32_t time, bool grid, const Replication_Tick *previous, Replication_Tick &tick);
+
+/**
+ * @brief Writes a snapshot frame, delta encoded against a snapshot the receiver has.
+ *
+ * The payload is the id, the id of the base and the destroyed handles, then an entry per entity
+ * new or changed since the base: its handle, a mask of the values changed and their differences.
+ * The handles are differences to the previous one and every number is a zigzag varint, so the
+ * unchanged entities cost nothing and the changed ones a few bytes.
+ *
+ * @param writer The writer.
+ * @param snapshot The snapshot.
+ * @param base The snapshot of the last ack of the receiver, nullptr for a full snapshot.
+ */
+void Replication_Write(Net_Writer &writer, const Replication_Snapshot &snapshot, const Replication_Snapshot *base);
+
+/**
+ * @brief Returns the base of a snapshot frame.
+ *
+ * @param message The frame.
+ *
+ * @return The id of the base, 0 for a full snapshot.
+ */
+uint32_t Replication_Base(const Net_Message &message);
+
+/**
+ * @brief Reads a snapshot frame.
+ *
+ * @param message The frame.
+ * @param base The snapshot with the id of Replication_Base, nullptr for a full snapshot.
+ * @param snapshot The snapshot read.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The frame is corrupted or it doesn't match the base.
+ */
+int Replication_Read(const Net_Message &message, const Replication_Snapshot *base, Replication_Snapshot &snapshot);
+
+/**
+ * @brief Builds the snapshot of a client from what its view sees.
+ *
+ * The entities inside the view are ranked by their relevance, the size they are seen, and only the
+ * most relevant ones are kept. The ones the client already has keep the values it was last sent;
+ * the changes go by their accumulated relevance while they fit in the budget, the rest wait. The
+ * budget is the whole frame: its headers and the entities destroyed since the base are counted first.
+ *
+ * @param tick The tick, with its grid built.
+ * @param base The snapshot the client acked, nullptr if none.
+ * @param peer The state of the client: its view, the history the snapshot is stored in and its priorities.
+ * @param stats The counters, the changes deferred are added.
+ *
+ * @return The snapshot, with the id of the one of the tick.
+ */
+const Replication_Snapshot &Replication_Filter(const Replication_Tick &tick, const Replication_Snapshot *base, Replication_Peer &peer,
+                                               Replication_Stats &stats);
+
+/**
+ * @class Replication_Feed
+ *
+ * @brief Hands the last tick of a simulation to the servers of other threads.
+ *
+ * The pointer is swapped atomically: the simulation publishes a new tick and the servers take the
+ * last one when they are ready, the ticks they hold live until they drop them.
+ */
+class Replication_Feed
+{
+public:
+  /**
+   * @brief Makes a tick the last one, from any thread.
+   *
+   * @param tick The tick, it must not change anymore.
+   */
+  void publish(std::shared_ptr<const Replication_Tick> tick);
+
+  /**
+   * @brief Returns the last tick published, from any thread.
+   *
+   * @return The tick, nullptr before the first one.
+   */
+  std::shared_ptr<const Replication_Tick> latest() const;
+
+private:
+  std::shared_ptr<const Replication_Tick> m_latest; ///< The last tick, only used through the atomic functions.
+};
+
+/**
+ * @brief A server that sends the snapshots of a simulation to the clients.
+ *
+ * A timer of the event loop updates the registry and builds a tick, or takes the last tick of a
+ * feed when another thread owns the simulation. Every client
+ * gets the snapshot delta encoded against the last one it acknowledged, the entities it doesn't
+ * know yet are created first. A client that stops acknowledging only gets bigger deltas, until
+ * its base leaves the history and it gets a full snapshot. A client that sends its view only gets
+ * what it sees, within a budget of bytes per tick, and has a history of its own snapshots.
+ */
+class Replication_Server
+{
+public:
+  static Replication_Settings settings_; ///< The configuration used by every replication.
+
+  /**
+   * @brief Constructor for the Replication_Server class.
+   */
+  Replication_Server();
+
+  /**
+   * @brief Destructor for the Replication_Server class, the clients are closed before the peers go.
+   */
+  ~Replication_Server();
+
+  Replication_Server(const Replication_Server &) = delete; ///< The timer and the events point to the server, it can't be copied.
+  void operator=(const Replication_Server &) = delete;
+
+  /**
+   * @brief Starts listening, over TCP and over UDP on the same port number, and ticking the registry.
+   *
+   * @param port The port to listen to, 0 takes a free one.
+   * @param registry The registry simulated, it must outlive the server.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The server can't listen, or can't bind the UDP port.
+   */
+  int open(int port, Registry &registry);
+
+  /**
+   * @brief Starts listening and sending the ticks of a feed, the simulation goes on in another thread.
+   *
+   * @param port The port to listen to, 0 takes a free one.
+   * @param feed The ticks, it must outlive the server.
+   * @param shared True to share the port with the servers of the other threads.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The server can't listen, or can't bind the UDP port.
+   */
+  int open(int port, Replication_Feed &feed, bool shared);
+
+  /**
+   * @brief Stops the ticks and closes every client.
+   */
+  void close();
+
+  /**
+   * @brief Updates the registry, or takes a new tick of the feed, and sends a snapshot to every client; the timer calls it.
+   */
+  void tick();
+
+  /**
+   * @brief Returns the server of the connections, to run its event loop.
+   *
+   * @return The server.
+   */
+  GameServer &server();
+
+  /**
+   * @brief Returns the counters of the snapshots sent.
+   *
+   * @return The counters.
+   */
+  const Replication_Stats &stats();
+
+  /**
+   * @brief Calls a function for every client receiving snapshots, to read its counters.
+   *
+   * @param visit The function, with whether the client is over UDP, the client or the connection, and its state.
+   */
+  void peers(const std::function<void(bool udp, int client, const Replication_Peer &peer)> &visit);
+
+private:
+  GameServer m_server;                                                ///< The connections and the event loop.
+  Udp_Endpoint m_udp;                                                 ///< The connections over UDP, updated by a timer of the loop.
+  Registry *m_registry;                                               ///< The simulation, nullptr if it is the one of a feed.
+  Replication_Feed *m_feed;                                           ///< The ticks of a simulation of another thread, nullptr if none.
+  std::vector<std::shared_ptr<const Replication_Snapshot>> m_history; ///< The last snapshots, the index is the id modulo the history.
+  std::shared_ptr<const Replication_Tick> m_tick;                     ///< The last tick sent, the descriptions of the next one start from it.
+  uint32_t m_id;                                                      ///< The id of the last snapshot.
+  int m_timer;                                                        ///< The timer of the ticks, -1 if closed.
+  int m_udpTimer;                                                     ///< The timer of the UDP endpoint, -1 if closed.
+  std::vector<Replication_Peer> m_peers;                              ///< The state of every client, the index is the client.
+  std::vector<Replication_Peer> m_udpPeers;                           ///< The state of every UDP client, the index is the connection.
+  std::vector<uint8_t> m_scratch;                                     ///< The frames that wrap around the end of an input ring.
+  std::vector<Net_Create> m_creates;                                  ///< The entities new for a client, copied from the tick.
+  Replication_Stats m_stats;                                          ///< The counters.
+  std::vector<Vec4> m_rotations;                                      ///< The rotations of the last world recorded, as quaternions.
+  double m_recorded;                                                  ///< The time of the last world recorded, in seconds.
+
+  /**
+   * @brief Starts listening over TCP and over UDP on the same port number.
+   *
+   * @param port The port to listen to, 0 takes a free one.
+   * @param shared True to share the port with other servers.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The server can't listen, or can't bind the UDP port.
+   */
+  int listen(int port, bool shared);
+
+  /**
+   * @brief Sends the snapshot of a tick to every client and keeps it in the history.
+   *
+   * @param current The tick.
+   */
+  void send(const std::shared_ptr<const Replication_Tick> &current);
+
+  /**
+   * @brief Returns a snapshot of the history.
+   *
+   * @param id The id.
+   *
+   * @return The snapshot, nullptr if it is 0 or it left the history.
+   */
+  const Replication_Snapshot *snapshot(uint32_t id);
+
+  /**
+   * @brief Handles the frames of a client.
+   *
+   * @param client The client.
+   * @param input The bytes received.
+   */
+  void received(int client, Net_Ring &input);
+
+  /**
+   * @brief Handles a frame of a client, over either transport.
+   *
+   * @param peer The state of the client.
+   * @param message The frame.
+   */
+  void handle(Replication_Peer &peer, const Net_Message &message);
+
+  /**
+   * @brief Returns the base of the next snapshot of a client, the last one it acked.
+   *
+   * @param peer The state of the client.
+   *
+   * @return The snapshot, nullptr if it acked none still kept.
+   */
+  const Replication_Snapshot *base(Replication_Peer &peer);
+
+  /**
+   * @brief Writes the entities new for a client since its ack.
+   *
+   * @param peer The state of the client, the frames go to its writer.
+   * @param tick The tick, with the descriptions.
+   * @param current The snapshot sent to the client, the one of the tick or filtered from it.
+   * @param base The snapshot acked, nullptr if none.
+   */
+  void describe(Replication_Peer &peer, const Replication_Tick &tick, const Replication_Snapshot &current, const Replication_Snapshot *base);
+
+  /**
+   * @brief Writes the snapshot of a client and counts it.
+   *
+   * @param peer The state of the client, the frame goes to its writer.
+   * @param current The snapshot of this tick.
+   * @param base The snapshot acked, nullptr if none.
+   */
+  void write(Replication_Peer &peer, const Replication_Snapshot &current, const Replication_Snapshot *base);
+
+  /**
+   * @brief Adds the transforms of a tick to the log of the server, if it records and the last ones are old enough.
+   *
+   * @param tick The tick.
+   */
+  void record(const Replication_Tick &tick);
+};
+
+/**
+ * @brief Holds the snapshots of a client to show them at a steady pace.
+ *
+ * The snapshots arrive unevenly; the buffer shows the time of the server a delay behind the last
+ * one received, interpolating the entities between the two snapshots around it. When the
+ * snapshots stop the entities go on with their last velocity for a while, then stop.
+ *
+ * The clock of the server is the arrival of its snapshots minus their smallest transit. The
+ * variation of the transit is the jitter; the adaptive delay is a tick plus a margin of jitter,
+ * grown at once when a snapshot arrives late and shrunk slowly while none does.
+ */
+class Replication_Jitter
+{
+public:
+  /**
+   * @brief Constructor for the Replication_Jitter class.
+   */
+  Replication_Jitter();
+
+  /**
+   * @brief Empties the buffer and forgets the clock of the server.
+   */
+  void clear();
+
+  /**
+   * @brief Adds a snapshot received.
+   *
+   * @param snapshot The snapshot.
+   * @param locals The handle in the registry of the client of every entity of the snapshot.
+   * @param arrival The local time it was received, in seconds.
+   */
+  void push(const Replication_Snapshot &snapshot, std::vector<int> &&locals, double arrival);
+
+  /**
+   * @brief Computes the entities at a local time.
+   *
+   * @param now The local time, in seconds.
+   * @param place Called with every entity shown: its local handle and its position, rotation in degrees and scale.
+   * @param destroyed Called with every entity gone since the last sample: its handle in the server and its local handle.
+   */
+  void sample(double now, const std::function<void(int local, Vec3 position, Vec3 rotation, Vec3 scale)> &place,
+              const std::function<void(uint32_t entity, int local)> &destroyed);
+
+  /**
+   * @brief Returns the state of the playback.
+   *
+   * @return The state.
+   */
+  const Replication_Playback &playback();
+
+private:
+  std::deque<Replication_Frame> m_frames; ///< The snapshots from the one shown, by time.
+  Replication_Frame m_previous;           ///< The snapshot before the one shown, for the velocities.
+  double m_offset;                        ///< The local time minus the time of the server, the smallest transit.
+  double m_transit;                       ///< The transit of the last snapshot.
+  double m_shown;                         ///< The time of the server of the last sample.
+  double m_sampled;                       ///< The local time of the last sample, -1 before the first.
+  float m_bump;                           ///< The seconds the late snapshots add to the adaptive delay.
+  bool m_synced;                          ///< A flag indicating whether a snapshot was received.
+  bool m_adapting;                        ///< A flag indicating whether the delay is moving to its target.
+  Replication_Playback m_playback;        ///< The state of the playback.
+};
+
+/**
+ * @brief A client that mirrors the registry of a replication server.
+ *
+ * The entities are built from the description the server sends when they appear, then every
+ * snapshot is acknowledged and goes through a jitter buffer that moves, turns and scales them.
+ * The meshes of the figures are not sent, they are drawn as cubes. The spin of the orbits is
+ * applied by the client itself.
+ */
+class Replication_Client
+{
+public:
+  /**
+   * @brief Constructor for the Replication_Client class.
+   */
+  Replication_Client();
+
+  /**
+   * @brief Connects to a replication server.
+   *
+   * Over UDP the entities created travel on the reliable channel and the snapshots and the acks
+   * on the unreliable one; the handshake goes on in the updates.
+   *
+   * @param ipAddress The IP address of the server.
+   * @param port The port of the server.
+   * @param udp True to connect over UDP.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The connection failed.
+   */
+  int connect(const std::string &ipAddress, int port, bool udp = false);
+
+  /**
+   * @brief Tells the server what the camera sees, when it changed and now and then.
+   *
+   * @param render The camera.
+   */
+  void view(Render &render);
+
+  /**
+   * @brief Applies the frames received to the registry, without waiting.
+   *
+   * The registry of the client must not simulate: its entities don't orbit and the collider must
+   * be disabled, the server decides where they are and which ones merge.
+   *
+   * @param registry The registry.
+   *
+   * @return The number of snapshots received, -1 if the connection is closed or a frame is corrupted.
+   */
+  int update(Registry &registry);
+
+  /**
+   * @brief Applies frames from a log to the registry as update() does, without a connection nor acks.
+   *
+   * The time is the one of the log, so the same frames give the same registry every time.
+   *
+   * @param registry The registry.
+   * @param input The bytes the server sent, the whole frames are taken.
+   * @param now The time the bytes were sent, in seconds, never less than the previous one.
+   *
+   * @return The number of snapshots applied, -1 if a frame is corrupted.
+   */
+  int replay(Registry &registry, Net_Ring &input, double now);
+
+  /**
+   * @brief Returns the counters of the snapshots received.
+   *
+   * @return The counters.
+   */
+  const Replication_Stats &stats();
+
+  /**
+   * @brief Returns the state of the jitter buffer.
+   *
+   * @return The state.
+   */
+  const Replication_Playback &playback();
+
+private:
+  GameClient m_client;                                         ///< The connection.
+  Udp_Endpoint m_udp;                                          ///< The connection over UDP.
+  int m_connection;                                            ///< The connection of m_udp, -1 over TCP.
+  bool m_closed;                                               ///< A flag indicating whether the UDP connection ended.
+  std::vector<uint8_t> m_received;                             ///< The frames received over UDP since the last update.
+  Net_Writer m_writer;                                         ///< The frames to the server over UDP.
+  Net_View m_view;                                             ///< The last view sent.
+  double m_viewed;                                             ///< The local time the view was sent, -1 if never.
+  std::vector<Replication_Snapshot> m_history;                 ///< The last snapshots, the index is the id modulo the history.
+  Replication_Snapshot m_decoded;                              ///< The snapshot being read, swapped into the history.
+  std::vector<uint8_t> m_scratch;                              ///< The frames of a replay that wrap around the end of its ring.
+  Replication_Jitter m_jitter;                                 ///< The snapshots waiting to be shown.
+  std::unordered_map<uint32_t, Replication_Entity> m_entities; ///< The entities, by their handle in the server.
+  std::map<int, Sphere> m_spheres;                             ///< The spheres built, by their tessellation.
+  Cube m_cube;                                                 ///< The cube, also used for the figures.
+  bool m_hasCube;                                              ///< A flag indicating whether the cube is built.
+  std::chrono::steady_clock::time_point m_start;               ///< The local clock of the jitter buffer starts at the construction.
+  double m_last;                                               ///< The local time of the last update, for the spins.
+  Replication_Stats m_stats;                                   ///< The counters.
+
+  /**
+   * @brief Adds an entity described by the server.
+   *
+   * @param registry The registry.
+   * @param entity The description.
+   */
+  void create(Registry &registry, const Net_Create &entity);
+
+  /**
+   * @brief Handles a frame of the server.
+   *
+   * @param registry The registry.
+   * @param message The frame.
+   * @param now The local time, in seconds.
+   * @param latest Returns the id of the snapshot, if it is one.
+   *
+   * @return False if the frame is corrupted or its base is unknown.
+   */
+  bool handle(Registry &registry, const Net_Message &message, double now, uint32_t &latest);
+
+  /**
+   * @brief Moves the entities to the time of the jitter buffer and spins their orbits.
+   *
+   * @param registry The registry.
+   * @param now The local time, in seconds.
+   */
+  void present(Registry &registry, double now);
+};
+
+/**
+ * @brief Measures the snapshots of generated scenes, printing the results on the console.
+ *
+ * The registry is ticked and every snapshot is written against the one of two ticks before, the
+ * ack of a client with some latency, then read back and compared. It runs with every entity
+ * orbiting and with 1% of them, the rest at rest.
+ *
+ * @param entities The number of entities, 0 runs 1k and 100k.
+ * @param ticks The snapshots of every run.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A snapshot read doesn't match the one written.
+ */
+int Replication_Benchmark(int entities, int ticks);
+
+/**
+ * @brief Measures the interest management in generated scenes, printing the results on the console.
+ *
+ * A client looks from the camera of the scene and acks two ticks later. Every tick its snapshot is
+ * built from the grid, written and read back, and its bytes compared with the ones of a broadcast of
+ * every entity; the descriptions of the new entities are counted in both.
+ *
+ * @param entities The number of entities, 0 runs 1k, 10k and 100k.
+ * @param ticks The snapshots of every run.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The grid misses an entity, a snapshot is over the budget or a snapshot read doesn't match the one written.
+ */
+int Replication_Interest_Benchmark(int entities, int ticks);
+
+/**
+ * @brief Plays back a log of a replication server at full speed, printing the results on the console.
+ *
+ * The frames sent to a client are decoded twice: once only through the protocol, hashing every
+ * snapshot, and once through a Replication_Client that applies them to a registry at the times of
+ * the log, hashing its entities at the end. The frames of the client are parsed and counted, and
+ * the worlds recorded by the server are read back. Two replays of a log print the same hashes.
+ *
+ * @param path The path of the log, written by GameServer::startRecording.
+ * @param client The client of the server, -1 for the first one accepted.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The log can't be read, it has no such client, or a frame or a world is corrupted.
+ */
+int Replication_Replay(const std::string &path, int client);
+
+////////////////////////
+#endif /* __NET_REPLICATION_H__ */
+////////////////////////
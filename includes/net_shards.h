@@ -0,0 +1,126 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_shards.h
+
+////////////////////////
+#ifndef __NET_SHARDS_H__
+#define __NET_SHARDS_H__
+////////////////////////
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <net_replication.h>
+
+/**
+ * @class Replication_Shards
+ *
+ * @brief A replication server split in shards, one thread and one event loop per core.
+ *
+ * Every shard is a Replication_Server listening to the same port, the system spreads the TCP
+ * connections among them and keeps every UDP address on the same one. The simulation runs in its
+ * own thread: every tick it updates the registry, builds a Replication_Tick and publishes it in a
+ * feed. The shards take the last tick and encode the snapshots of their own clients, the tick is
+ * only read so they never wait for each other.
+ */
+class Replication_Shards
+{
+public:
+  /**
+   * @brief Constructor for the Replication_Shards class.
+   */
+  Replication_Shards();
+
+  /**
+   * @brief Destructor for the Replication_Shards class, the threads are joined.
+   */
+  ~Replication_Shards();
+
+  Replication_Shards(const Replication_Shards &) = delete; ///< The threads point to the shards, they can't be copied.
+  void operator=(const Replication_Shards &) = delete;
+
+  /**
+   * @brief Opens the shards and starts their threads, the simulation waits for run().
+   *
+   * @param port The port to listen to, 0 takes a free one.
+   * @param registry The registry simulated, it must outlive the shards.
+   * @param shards The number of shards, 0 takes one per core.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 A shard can't listen, or the port can't be shared.
+   */
+  int open(int port, Registry &registry, int shards);
+
+  /**
+   * @brief Runs the simulation in the calling thread until stop().
+   */
+  void run();
+
+  /**
+   * @brief Makes run() return, it can be called from any thread.
+   */
+  void stop();
+
+  /**
+   * @brief Stops the simulation and the shards, their counters are kept.
+   */
+  void close();
+
+  /**
+   * @brief Returns the port the shards listen to.
+   *
+   * @return The port, 0 if they are not open.
+   */
+  int port();
+
+  /**
+   * @brief Returns the number of shards.
+   *
+   * @return The shards opened.
+   */
+  int shards();
+
+  /**
+   * @brief Returns a shard, its counters must be read after close().
+   *
+   * @param index The shard.
+   *
+   * @return The server of the shard.
+   */
+  Replication_Server &shard(int index);
+
+private:
+  Registry *m_registry;                                      ///< The simulation.
+  Replication_Feed m_feed;                                   ///< The last tick, read by every shard.
+  std::vector<std::unique_ptr<Replication_Server>> m_shards; ///< The servers, one per thread.
+  std::vector<std::thread> m_threads;                        ///< The event loop of every shard.
+  std::atomic<bool> m_running;                               ///< A flag indicating whether the event loops go on.
+  std::atomic<bool> m_simulating;                            ///< A flag indicating whether run() goes on.
+  uint32_t m_id;                                             ///< The id of the last tick.
+
+  /**
+   * @brief Runs the event loop of a shard until close(), in its thread.
+   *
+   * @param index The shard.
+   */
+  void loop(int index);
+};
+
+/**
+ * @brief Measures the snapshots sent by a sharded server on loopback, printing the results on the console.
+ *
+ * A generated scene is simulated at a high tick rate and the clients ack every snapshot they get,
+ * read by as many threads as shards. The snapshots and bytes received per second are compared
+ * with the ones of a single shard.
+ *
+ * @param shards The number of shards, 0 runs 1, 2, 4... up to the cores.
+ * @param clients The number of clients, 0 runs 256.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A shard can't open, or a client lost its connection.
+ */
+int Replication_Shards_Benchmark(int shards, int clients);
+
+////////////////////////
+#endif /* __NET_SHARDS_H__ */
+////////////////////////
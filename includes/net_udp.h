@@ -0,0 +1,487 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_udp.h
+
+////////////////////////
+#ifndef __NET_UDP_H__
+#define __NET_UDP_H__
+////////////////////////
+
+#include <iostream>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <net_poller.h>
+#include <net_protocol.h>
+
+#define UDP_PROTOCOL (0x534F4C00u | NET_VERSION) ///< The first bytes of every datagram, the others are ignored.
+#define UDP_MTU 1200                             ///< The largest datagram sent, under the MTU of the paths of the internet.
+#define UDP_BATCH 64                             ///< The datagrams sent or received per system call.
+#define UDP_PACKETS 1024                         ///< The packets sent remembered until they are acked, a power of 2.
+#define UDP_WINDOW 1024                          ///< The reliable fragments in flight, and received out of order.
+#define UDP_JOINS 4                              ///< The unreliable messages joined at once, the fragments of the next ones interleave.
+#define UDP_ACK_EVERY 16                         ///< The packets received before an ack is sent, the bitfield covers 33.
+#define UDP_FIRST_RTT 0.1f                       ///< The round trip assumed until one is measured, in seconds.
+#define UDP_BACKOFF 5                            ///< The most times the wait of the resends doubles while nothing is acked.
+#define UDP_HANDSHAKE_BYTES 64                   ///< The bytes of the requests of the handshake, more than the answers.
+#define UDP_DATA_HEADER 18                       ///< The bytes of the header of a data packet.
+#define UDP_MESSAGE_HEADER 9                     ///< The bytes of the header of every message in a packet.
+#define UDP_FRAGMENT (UDP_MTU - UDP_DATA_HEADER - UDP_MESSAGE_HEADER) ///< The bytes of every fragment but the last one.
+
+class Udp_Endpoint;
+
+/**
+ * @brief The channels of the messages.
+ */
+enum Udp_Channel
+{
+  UDP_RELIABLE,   ///< Resent until acked and received in the order sent: the entities created and destroyed.
+  UDP_UNRELIABLE, ///< Sent once, an older message than the last one received is dropped: the transforms.
+  UDP_CHANNELS,
+};
+
+/**
+ * @brief Configuration of the UDP endpoints.
+ *
+ * The loss, latency, jitter and duplicate fields simulate a network on the datagrams sent, even
+ * through the loopback; the simulation is off with all of them at 0.
+ */
+struct Udp_Settings
+{
+  int max_connections; ///< The connections of an endpoint, the next handshakes are denied.
+  float timeout;       ///< The seconds without a packet before a connection is closed, or a handshake fails.
+  float handshake;     ///< The seconds between the handshake packets until they are answered.
+  float keepalive;     ///< The seconds without sending before an empty packet carries the acks.
+  float resend;        ///< The minimum seconds before a reliable fragment is sent again, 1.5 round trips if longer.
+  int max_packets;     ///< The packets sent to a connection per update, the rest of the unreliable ones are dropped.
+  float loss;          ///< The chance of a datagram sent being lost, from 0 to 1.
+  float latency;       ///< The seconds every datagram sent is delayed.
+  float jitter;        ///< The most seconds the latency wanders up, the bursts sent close together can arrive out of order.
+  float duplicate;     ///< The chance of a datagram sent being sent twice, from 0 to 1.
+};
+
+/**
+ * @brief The functions called by Udp_Endpoint::update.
+ *
+ * Every one is optional. A connection can be closed from any of them, but not opened.
+ */
+struct Udp_Events
+{
+  std::function<void(Udp_Endpoint &endpoint, int connection)> connected; ///< A handshake finished, on both sides.
+
+  /**
+   * A message arrived whole, the data is valid during the call.
+   */
+  std::function<void(Udp_Endpoint &endpoint, int connection, int channel, const uint8_t *data, int size)> received;
+
+  std::function<void(Udp_Endpoint &endpoint, int connection)> disconnected; ///< A connection or a handshake ended, its slot can be reused.
+};
+
+/**
+ * @brief The counters of an endpoint.
+ */
+struct Udp_Stats
+{
+  long long packetsSent;     ///< The datagrams sent, the ones the simulation drops too.
+  long long packetsReceived; ///< The datagrams received.
+  long long bytesSent;       ///< The bytes of the datagrams sent.
+  long long bytesReceived;   ///< The bytes of the datagrams received.
+  long long calls;           ///< The system calls that sent or received the datagrams.
+  long long resent;          ///< The reliable fragments sent again.
+  long long lost;            ///< The packets with reliable fragments never acked.
+  long long dropped;         ///< The datagrams the simulation lost.
+  long long stale;           ///< The unreliable messages dropped: older than the last one, incomplete or over max_packets.
+  long long invalid;         ///< The datagrams ignored: another protocol, a wrong token or a bad message.
+  int connections;           ///< The connections established.
+};
+
+/**
+ * @brief A packet sent, until it is acked or its slot is reused.
+ */
+struct Udp_Sent
+{
+  uint16_t sequence;              ///< The sequence of the packet.
+  bool used;                      ///< A flag indicating whether the slot holds a packet.
+  bool acked;                     ///< A flag indicating whether the packet was acked.
+  double time;                    ///< The time it was sent, in seconds.
+  std::vector<uint16_t> reliable; ///< The ids of the reliable fragments it carried.
+};
+
+/**
+ * @brief A fragment of a message: the whole message if it fits in a packet.
+ */
+struct Udp_Fragment
+{
+  uint16_t id;               ///< The id: every reliable fragment has its own, the unreliable fragments share the one of their message.
+  uint16_t fragment;         ///< The position in the message.
+  uint16_t fragments;        ///< The fragments of the message.
+  bool used;                 ///< A flag indicating whether the slot holds a fragment.
+  bool acked;                ///< A flag indicating whether the fragment was acked.
+  double sent;               ///< The last time it was sent, in seconds, -1 before the first.
+  std::vector<uint8_t> data; ///< The bytes.
+};
+
+/**
+ * @brief An unreliable message being joined.
+ */
+struct Udp_Join
+{
+  uint16_t id;                 ///< The id of the message.
+  bool used;                   ///< A flag indicating whether the slot holds a message.
+  int parts;                   ///< The fragments received.
+  int length;                  ///< The bytes of the message, known with its last fragment.
+  std::vector<uint8_t> pieces; ///< The fragments received, by position.
+  std::vector<uint8_t> data;   ///< The bytes.
+};
+
+/**
+ * @brief The state of the connection with another endpoint.
+ */
+struct Udp_Connection
+{
+  int state;           ///< UDP_FREE, UDP_CONNECTING or UDP_CONNECTED.
+  sockaddr_in address; ///< The address of the other endpoint.
+  uint32_t salt;       ///< The random number of the side that connects, it names the handshake.
+  uint32_t cookie;     ///< The number the listening side challenged with, 0 before the challenge.
+  uint32_t token;      ///< The salts of both sides mixed, every data packet carries it.
+  double started;      ///< The time the handshake started, in seconds.
+  double lastReceive;  ///< The time of the last packet received, in seconds.
+  double lastSend;     ///< The time of the last packet sent, in seconds.
+  float rtt;           ///< The smoothed round trip, in seconds, 0 until a packet is acked.
+  int backoff;         ///< The doublings of the wait of the resends: a resend grows it, an ack resets it.
+
+  uint16_t sequence;          ///< The sequence of the next packet sent.
+  uint16_t remote;            ///< The newest sequence received.
+  uint32_t remoteBits;        ///< The 32 sequences before remote received: bit n is remote - 1 - n.
+  bool received;              ///< A flag indicating whether a packet was received.
+  int acking;                 ///< The packets received and not acked yet.
+  std::vector<Udp_Sent> sent; ///< The packets sent, the index is the sequence modulo UDP_PACKETS.
+
+  uint16_t nextId;                    ///< The id of the next reliable fragment in the window.
+  uint16_t oldestId;                  ///< The oldest reliable fragment not acked.
+  std::vector<Udp_Fragment> outgoing; ///< The reliable fragments in flight, the index is the id modulo UDP_WINDOW.
+  std::deque<Udp_Fragment> queued;    ///< The reliable fragments waiting for room in the window.
+  uint16_t expectedId;                ///< The id of the next reliable fragment received in order.
+  std::vector<Udp_Fragment> incoming; ///< The reliable fragments received early, the index is the id modulo UDP_WINDOW.
+  std::vector<uint8_t> message;       ///< The reliable message being joined.
+
+  uint16_t unreliableId;                ///< The id of the next unreliable message.
+  std::vector<Udp_Fragment> unreliable; ///< The unreliable fragments to send in the next update.
+  uint16_t lastId;                      ///< The id of the last unreliable message received.
+  bool delivered;                       ///< A flag indicating whether an unreliable message was received.
+  std::vector<Udp_Join> joins;          ///< The unreliable messages being joined.
+};
+
+/**
+ * @brief A datagram waiting to be sent.
+ */
+struct Udp_Datagram
+{
+  double due;             ///< The time it is sent, later than now while the simulation delays it.
+  long long order;        ///< The order it was queued in, the datagrams due at once keep it.
+  sockaddr_in address;    ///< The destination.
+  int size;               ///< The bytes.
+  uint8_t bytes[UDP_MTU]; ///< The datagram.
+};
+
+/**
+ * @brief A UDP endpoint: a socket with connections to other endpoints, both to listen and to connect.
+ *
+ * The handshake keeps no state until the side that connects proves its address: it sends a
+ * random salt, padded so the answer is not bigger than the request, the listening side
+ * challenges it with a cookie hashed from the address, the salt and a secret, and only the
+ * response with the right cookie opens a connection. Then both sides send data packets with
+ * a token mixed from both salts.
+ *
+ * Every packet has a sequence and acks the newest sequence received and, in a bitfield, the 32
+ * before it, so every ack is repeated in the next 32 packets. The reliable channel splits the
+ * messages into fragments with their own ids, resends them until a packet carrying them is
+ * acked and joins them in order; the unreliable channel sends the fragments of a message once
+ * and drops a message once a newer one arrived. The datagrams are sent and received in batches,
+ * with sendmmsg and recvmmsg on Linux.
+ */
+class Udp_Endpoint
+{
+public:
+  static Udp_Settings settings_; ///< The configuration used by every endpoint.
+
+  /**
+   * @brief Constructor for the Udp_Endpoint class, the endpoint works once opened.
+   */
+  Udp_Endpoint();
+
+  /**
+   * @brief Destructor for the Udp_Endpoint class.
+   */
+  ~Udp_Endpoint();
+
+  Udp_Endpoint(const Udp_Endpoint &) = delete; ///< The endpoint owns its socket, it can't be copied.
+  void operator=(const Udp_Endpoint &) = delete;
+
+  /**
+   * @brief Binds the socket.
+   *
+   * @param port The port, 0 takes a free one.
+   * @param shared True to share the port with other endpoints, the system keeps every address on the same one.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The socket can't be created, shared or bound.
+   */
+  int open(int port, bool shared = false);
+
+  /**
+   * @brief Says goodbye to every connection and closes the socket.
+   */
+  void close();
+
+  /**
+   * @brief Returns the port of the socket.
+   *
+   * @return The port, 0 if the endpoint is not open.
+   */
+  int port();
+
+  /**
+   * @brief Sets the functions called by update().
+   *
+   * @param events The functions.
+   */
+  void setEvents(const Udp_Events &events);
+
+  /**
+   * @brief Starts the handshake with another endpoint, the connected event tells when it is done.
+   *
+   * @param ipAddress The IP address of the other endpoint.
+   * @param port Its port.
+   *
+   * @return The connection, -1 if the endpoint is not open or it is full.
+   */
+  int connect(const std::string &ipAddress, int port);
+
+  /**
+   * @brief Closes a connection, telling the other side.
+   *
+   * @param connection The connection.
+   */
+  void disconnect(int connection);
+
+  /**
+   * @brief Returns whether a connection finished its handshake.
+   *
+   * @param connection The connection.
+   *
+   * @return True if it is connected.
+   */
+  bool connected(int connection);
+
+  /**
+   * @brief Queues a message, sent by the next update().
+   *
+   * @param connection The connection.
+   * @param channel The channel, an Udp_Channel.
+   * @param data The bytes.
+   * @param size The number of bytes.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The connection is not connected.
+   */
+  int send(int connection, int channel, const void *data, int size);
+
+  /**
+   * @brief Receives the datagrams waiting, runs the handshakes and timeouts, and sends the packets.
+   */
+  void update();
+
+  /**
+   * @brief Waits for a datagram, or for the simulation to have one due.
+   *
+   * @param timeout The maximum wait in milliseconds.
+   */
+  void wait(int timeout);
+
+  /**
+   * @brief Returns the round trip of a connection.
+   *
+   * @param connection The connection.
+   *
+   * @return The smoothed round trip in seconds, 0 until a packet is acked.
+   */
+  float rtt(int connection);
+
+  /**
+   * @brief Returns the time of the endpoint.
+   *
+   * @return The seconds since the endpoint was created.
+   */
+  double time();
+
+  /**
+   * @brief Returns the counters of the endpoint.
+   *
+   * @return The counters.
+   */
+  const Udp_Stats &stats();
+
+private:
+  Net_Socket m_socket;                           ///< The socket.
+  Net_Poller m_poller;                           ///< The readiness of the socket, for wait().
+  std::vector<Udp_Connection> m_connections;     ///< The connections, the index is the connection; never resized while open.
+  std::unordered_map<uint64_t, int> m_addresses; ///< The connection of every address.
+  std::vector<Udp_Datagram> m_outgoing;          ///< The datagrams sent by the next flush.
+  std::vector<Udp_Datagram> m_delayed;           ///< The datagrams the simulation delays, a heap by due time.
+  long long m_queued;                            ///< The datagrams queued, the order of the next one.
+  std::vector<uint8_t> m_input;                  ///< The datagrams of a batch received, UDP_MTU bytes each.
+  Net_Writer m_packet;                           ///< The packet being written.
+  Udp_Sent *m_record;                            ///< The record of the data packet being written, nullptr if none.
+  int m_messages;                                ///< The messages of the data packet being written.
+  Udp_Events m_events;                           ///< The functions called by update().
+  std::mt19937 m_random;                         ///< The salts, the secret and the simulation.
+  float m_delay;                                 ///< The delay the simulation gives to the datagrams of this update.
+  uint64_t m_secret;                             ///< The key of the cookies.
+  std::chrono::steady_clock::time_point m_start; ///< The time the endpoint was created.
+  Udp_Stats m_stats;                             ///< The counters.
+
+  /**
+   * @brief Handles a datagram received.
+   *
+   * @param address The sender.
+   * @param data The bytes.
+   * @param size The number of bytes.
+   * @param now The time of the endpoint.
+   */
+  void handle(const sockaddr_in &address, const uint8_t *data, int size, double now);
+
+  /**
+   * @brief Handles the acks and the messages of a data packet.
+   *
+   * @param connection The connection.
+   * @param reader The packet, after the token.
+   * @param now The time of the endpoint.
+   */
+  void packet(int connection, Net_Reader &reader, double now);
+
+  /**
+   * @brief Marks a packet sent as acked, and the reliable fragments it carried.
+   *
+   * @param connection The connection.
+   * @param sequence The sequence of the packet.
+   * @param now The time of the endpoint.
+   */
+  void acknowledge(Udp_Connection &connection, uint16_t sequence, double now);
+
+  /**
+   * @brief Takes a reliable fragment, passing every message completed in order to the received event.
+   *
+   * @param connection The connection.
+   * @param fragment The id and the position of the fragment.
+   * @param data The bytes of the fragment.
+   * @param size The number of bytes.
+   *
+   * @return True if the connection is still open after the events.
+   */
+  bool reliable(int connection, const Udp_Fragment &fragment, const uint8_t *data, int size);
+
+  /**
+   * @brief Takes an unreliable fragment, passing its message to the received event once it is whole.
+   *
+   * @param connection The connection.
+   * @param fragment The id and the position of the fragment.
+   * @param data The bytes of the fragment.
+   * @param size The number of bytes.
+   *
+   * @return True if the connection is still open after the events.
+   */
+  bool unreliable(int connection, const Udp_Fragment &fragment, const uint8_t *data, int size);
+
+  /**
+   * @brief Writes the packets of a connection: the reliable fragments due, the unreliable ones and the acks.
+   *
+   * @param connection The connection.
+   * @param now The time of the endpoint.
+   */
+  void write(Udp_Connection &connection, double now);
+
+  /**
+   * @brief Starts a data packet, the messages are written to m_packet.
+   *
+   * @param connection The connection.
+   * @param now The time of the endpoint.
+   */
+  void begin(Udp_Connection &connection, double now);
+
+  /**
+   * @brief Sends the data packet written.
+   *
+   * @param connection The connection.
+   * @param now The time of the endpoint.
+   */
+  void finish(Udp_Connection &connection, double now);
+
+  /**
+   * @brief Queues a datagram, through the simulation of the network.
+   *
+   * @param address The destination.
+   * @param data The bytes.
+   * @param size The number of bytes, at most UDP_MTU.
+   * @param now The time of the endpoint.
+   */
+  void emit(const sockaddr_in &address, const uint8_t *data, int size, double now);
+
+  /**
+   * @brief Sends a packet of the handshake, or the goodbye; the requests are padded to UDP_HANDSHAKE_BYTES.
+   *
+   * @param address The destination.
+   * @param type The type of the packet.
+   * @param first Its first number: the salt, or the token of the goodbye.
+   * @param second Its second number: the cookie, or the salt of the listening side.
+   * @param now The time of the endpoint.
+   */
+  void handshake(const sockaddr_in &address, int type, uint32_t first, uint32_t second, double now);
+
+  /**
+   * @brief Sends the datagrams due.
+   *
+   * @param now The time of the endpoint.
+   */
+  void flush(double now);
+
+  /**
+   * @brief Returns a cookie of a handshake, only this endpoint can compute it.
+   *
+   * @param address The address of the side that connects.
+   * @param salt Its salt.
+   *
+   * @return The cookie, never 0.
+   */
+  uint32_t cookie(const sockaddr_in &address, uint32_t salt);
+
+  /**
+   * @brief Frees the slot of a connection, calling the disconnected event.
+   *
+   * @param connection The connection.
+   */
+  void drop(int connection);
+};
+
+/**
+ * @brief Sends reliable and unreliable frames between two endpoints through the loopback, printing the results on the console.
+ *
+ * Both endpoints run the simulation of the network. Every tick the server sends a reliable
+ * frame of entities created, some of them split into many fragments, and an unreliable frame
+ * of transforms, and the client acks it unreliably. The reliable frames must all arrive, in
+ * order and whole; the unreliable ones in order, the late ones dropped.
+ *
+ * @param loss The percentage of the datagrams lost, a negative one runs 0%, 5% and 20%.
+ * @param latency The milliseconds of latency, a quarter of it is added at random as jitter.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The handshake failed, or a frame was lost, corrupted or out of order.
+ */
+int Udp_Benchmark(int loss, int latency);
+
+////////////////////////
+#endif /* __NET_UDP_H__ */
+////////////////////////
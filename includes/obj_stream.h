@@ -0,0 +1,62 @@
+/// @author Marcos Jiménez Saz <jimenezsa@esat-alumni.com>
+
+/// @file Obj_stream.h
+
+////////////////////////
+#ifndef __OBJ_STREAM_H__
+#define __OBJ_STREAM_H__ 1
+////////////////////////
+
+#include <functional>
+#include <cstddef>
+
+/**
+ * @struct Stream_Settings.
+ *
+ * @brief Configuration of the streaming import of .obj files.
+ */
+struct Stream_Settings
+{
+  bool enabled;        ///< A flag indicating whether the figures are imported streaming the file.
+  size_t window;       ///< The size in bytes of the window used to read the file.
+  size_t memory_limit; ///< The maximum bytes the import can allocate, window, final buffers and levels of detail included.
+};
+
+/**
+ * @brief Reads a text file line by line through a fixed size window.
+ *
+ * Only the window is kept in memory, a line that doesn't fit in the window is an error.
+ * The line passed to the callback is null terminated and has no line break.
+ *
+ * @param path The file to read.
+ * @param window The size of the window in bytes.
+ * @param callback Called with every line of the file.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 File not found.
+ * @return 2 A line is longer than the window.
+ */
+int Stream_Lines(const char *path, size_t window, const std::function<void(char *line)> &callback);
+
+/**
+ * @brief Returns the resident memory of the process.
+ *
+ * @return The resident memory in bytes, 0 if it can't be read in this system.
+ */
+size_t Current_RSS();
+
+/**
+ * @brief Returns the peak resident memory of the process.
+ *
+ * @return The peak resident memory in bytes, 0 if it can't be read in this system.
+ */
+size_t Peak_RSS();
+
+/**
+ * @brief Resets the peak resident memory to the current one, if the system allows it.
+ */
+void Reset_Peak_RSS();
+
+////////////////////////
+#endif /* __OBJ_STREAM_H__ */
+////////////////////////
@@ -7,67 +7,59 @@
 #define __OBJECTS_H__ 1
 ////////////////////////
 
-#include <sphere_3d.h>
-#include <cube_3d.h>
-#include <figures_3d.h>
+#include <registry.h>
 
 /**
-* @struct Objects.
-*
-* @brief For grouping entities childs.
-*/
-struct Objects
-{
-  int type; ///< Used to select the object type, it is define in enum ObjectsType.
-  class Sphere sphere; ///< Object Sphere.
-  class Cube cube; ///< Object Cube.
-  class Figure figure; ///< Object Figure.
-  // class ...
-};
-
-#define MAX_OBJECTS_TYPE 4
-
-/**
-* @enum The objectstype for.
-*
-* @brief Enums the types that an object can be.
-*/
-enum ObjectsType
-{
-  notSet = 0,
-  typeSphere,
-  typeCube,
-  typeFigure,
-  // ...
-};
-
-/**
- * @brief Adds an empty object to the list.
+ * @brief Sets up a new object and adds it to the registry.
+ *
+ * @param registry The registry where the object is added.
  *
- * @param objects Passes an object in the last position.
+ * @return The handle of the new object, -1 while it is not created.
  */
-void Not_Set_Controls(Objects &objects);
+int Not_Set_Controls(Registry &registry);
 
 /**
  * @brief Modifies the Sphere created.
  *
  * @param sphere Sphere to be modified.
+ * @param orbit The orbit of the sphere in the registry.
+ * @param material The material of the sphere in the registry.
  */
-void Spheres_Controls(Sphere &sphere);
+void Spheres_Controls(Sphere &sphere, Entity_Orbit &orbit, Entity_Material &material);
 
 /**
  * @brief Modifies the Cube created.
  *
  * @param cube Cube to be modified.
+ * @param orbit The orbit of the cube in the registry.
+ * @param material The material of the cube in the registry.
  */
-void Cubes_Controls(Cube &cube);
+void Cubes_Controls(Cube &cube, Entity_Orbit &orbit, Entity_Material &material);
 
 /**
  * @brief Modifies the Figure created.
  *
  * @param figure Figure to be modified.
+ * @param orbit The orbit of the figure in the registry.
+ * @param material The material of the figure in the registry.
+ */
+void Figures_Controls(Figure &figure, Entity_Orbit &orbit, Entity_Material &material);
+
+/**
+ * @brief Modifies the Keplerian orbit of an object, or puts its orbit on rails.
+ *
+ * @param registry The registry of the objects.
+ * @param handle The handle of the object.
+ */
+void Rails_Controls(Registry &registry, int handle);
+
+/**
+ * @brief Shows the parent of an object and attaches it to another one.
+ *
+ * @param registry The registry of the objects.
+ * @param handle The handle of the object.
  */
-void Figures_Controls(Figure &figure);
+void Parent_Controls(Registry &registry, int handle);
 
 ////////////////////////
 #endif /* __OBJECTS_H__ */
@@ -0,0 +1,184 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file Particles.h
+
+////////////////////////
+#ifndef __PARTICLES_H__
+#define __PARTICLES_H__ 1
+////////////////////////
+
+#include <SDL2/SDL.h>
+#include <vector_3.h>
+#include <render.h>
+#include <thread_pool.h>
+#include <cstdint>
+#include <vector>
+
+#define PARTICLES_LANES 4    ///< Particles integrated at once by the SIMD kernel, the capacity is padded to it.
+#define PARTICLES_CHUNK 1024 ///< Particles emitted with the same random generator, the chunks are split between threads.
+
+/**
+ * @struct Particle_Settings.
+ *
+ * @brief Configuration of the debris of the destroyed entities.
+ */
+struct Particle_Settings
+{
+  bool enabled;     ///< A flag indicating whether the destroyed entities emit debris.
+  int capacity;     ///< The maximum number of particles, the pool doesn't grow once allocated.
+  int per_face;     ///< The particles emitted by every face of a mesh.
+  float speed;      ///< The speed of the particles from the center of the mesh.
+  float life;       ///< The mean life of a particle, in seconds.
+  float drag;       ///< The fraction of the speed lost every second.
+  float size;       ///< The size of a shard in world units.
+  int min_parallel; ///< The number of particles from which they are updated with threads.
+};
+
+/**
+ * @class Particles
+ *
+ * @brief A fixed pool of debris particles, integrated and drawn in batch.
+ *
+ * The particles are stored as structure of arrays, one array per coordinate, so the integration
+ * moves PARTICLES_LANES particles per instruction. The dead particles are replaced by the last
+ * ones, the live ones are always the first count().
+ *
+ * Every chunk of PARTICLES_CHUNK emitted particles draws from its own xorshift generator seeded by
+ * the chunk, so the threads share no state and the debris is the same with any number of threads.
+ * The visible particles are projected to triangles, shards of the mesh, and drawn with a single
+ * SDL_RenderGeometry call.
+ */
+class Particles
+{
+public:
+  static Particle_Settings settings_; ///< The configuration used by every pool.
+
+  /**
+   * @brief Constructs an empty pool, the particles are allocated by the first emission.
+   */
+  Particles();
+
+  Particles(const Particles &) = delete; ///< The pool owns its arrays, it can't be copied.
+  void operator=(const Particles &) = delete;
+
+  /**
+   * @brief Allocates the pool, the particles alive are lost.
+   *
+   * @param capacity The maximum number of particles.
+   */
+  void reserve(int capacity);
+
+  /**
+   * @brief Emits the debris of a mesh, settings_.per_face particles from the center of every face.
+   *
+   * If the pool can't fit them all the faces are sampled evenly.
+   *
+   * @param centers The center of each face.
+   * @param colors The color of each face, can be nullptr.
+   * @param count The number of faces.
+   * @param origin The center of the mesh, the particles fly away from it.
+   * @param velocity The velocity of the mesh, added to every particle.
+   * @param color The color of the faces without colors, its alpha is used by every particle.
+   *
+   * @return The number of particles emitted.
+   */
+  int emit(const Vec3 *centers, const SDL_Color *colors, int count, Vec3 origin, Vec3 velocity, SDL_Color color);
+
+  /**
+   * @brief Moves the particles and removes the dead ones.
+   *
+   * @param elapsed The time of the frame, in seconds.
+   */
+  void update(float elapsed);
+
+  /**
+   * @brief Projects the visible particles to the vertices of their shards.
+   *
+   * @param drawRender The camera.
+   *
+   * @return The number of visible particles, the first ones of vertices().
+   */
+  int project(Render &drawRender);
+
+#ifndef HEADLESS
+  /**
+   * @brief Draws the particles in a single batch.
+   *
+   * @param render The SDL renderer.
+   * @param drawRender The camera.
+   */
+  void draw(SDL_Renderer *render, Render &drawRender);
+#endif
+
+  /**
+   * @brief Returns the vertices of the last projection, 3 per particle.
+   *
+   * @return The vertices.
+   */
+  const SDL_Vertex *vertices();
+
+  /**
+   * @brief Removes every particle.
+   */
+  void clear();
+
+  /**
+   * @brief Returns the number of live particles.
+   *
+   * @return The number of particles.
+   */
+  int count();
+
+  /**
+   * @brief Returns the maximum number of particles.
+   *
+   * @return The capacity of the pool, 0 until it is allocated.
+   */
+  int capacity();
+
+  /**
+   * @brief Destroys the Particles and its arrays.
+   */
+  ~Particles();
+
+private:
+  float *x_, *y_, *z_;    ///< The positions.
+  float *vx_, *vy_, *vz_; ///< The velocities.
+  float *life_;           ///< The remaining life, in seconds.
+  float *fade_;           ///< The inverse of the life at the emission, the alpha fades with it.
+  SDL_Color *colors_;     ///< The color of each particle.
+  int count_;             ///< The number of live particles.
+  int capacity_;          ///< The number of particles of the arrays, a multiple of PARTICLES_LANES.
+  uint32_t seed_;         ///< The seed of the next emission.
+
+  SDL_Vertex *vertices_;     ///< The shards of the visible particles.
+  std::vector<int> visible_; ///< The visible particles of each range of the projection.
+  Thread_Pool threads_;      ///< The threads of the ranges, kept between frames.
+
+  /**
+   * @brief Integrates a range of particles.
+   *
+   * @param start The first particle, a multiple of PARTICLES_LANES.
+   * @param end The particle after the last one.
+   * @param elapsed The time of the frame.
+   * @param damping The velocity kept after the frame.
+   */
+  void integrate(int start, int end, float elapsed, float damping);
+};
+
+/**
+ * @brief Measures the particles, printing the results on the console.
+ *
+ * The pool is filled with the debris of a sphere of faces, then updated and projected every
+ * frame. No particle can die before the shortest life nor live after the longest one.
+ *
+ * @param particles The number of particles, 0 runs 10000, 100000 and 1000000 particles.
+ * @param frames The number of frames of every run.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A particle died early, lived too long or has an invalid position.
+ */
+int Particles_Benchmark(int particles, int frames);
+
+////////////////////////
+#endif /* __PARTICLES_H__ */
+////////////////////////
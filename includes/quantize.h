@@ -0,0 +1,248 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file quantize.h
+
+////////////////////////
+#ifndef __QUANTIZE_H__
+#define __QUANTIZE_H__
+////////////////////////
+
+#include <cstdint>
+#include <vector>
+#include <vector_3.h>
+#include <vector_4.h>
+
+#define QUANT_AXIS_BITS 24 ///< The most bits of a fixed-point axis, a float keeps no more.
+#define QUANT_QUAT_BITS 10 ///< The bits of each of the three smallest components of a quaternion, 32 with the largest one.
+
+/**
+ * @brief The bounded range of the fixed-point positions of a snapshot.
+ *
+ * The positions are steps from the origin, the lowest corner of the box around them, so every
+ * axis only takes the bits of its extent: a flat scene has an axis of 0 bits.
+ */
+struct Quant_Range
+{
+  Vec3 origin; ///< The lowest corner of the positions.
+  float step;  ///< The units of a step, a position is at most half of it off.
+  int bits[3]; ///< The bits of every axis.
+};
+
+/**
+ * @brief Fits a range around some positions.
+ *
+ * @param positions The positions.
+ * @param count The number of positions.
+ * @param step The units of a step.
+ * @param range The range.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 An axis needs more than QUANT_AXIS_BITS bits at that step, the positions past it are clamped.
+ */
+int Quant_Fit(const Vec3 *positions, int count, float step, Quant_Range &range);
+
+/**
+ * @brief Quantizes a position, the reference of Quant_Encode_Positions.
+ *
+ * @param range The range.
+ * @param position The position, clamped to the range.
+ * @param values The steps of every axis.
+ */
+void Quant_Encode_Position(const Quant_Range &range, Vec3 position, uint32_t values[3]);
+
+/**
+ * @brief Restores a quantized position, the reference of Quant_Decode_Positions.
+ *
+ * @param range The range.
+ * @param values The steps of every axis.
+ *
+ * @return The position.
+ */
+Vec3 Quant_Decode_Position(const Quant_Range &range, const uint32_t values[3]);
+
+/**
+ * @brief Quantizes positions, four at once with SSE2; the values are the ones of Quant_Encode_Position.
+ *
+ * @param range The range.
+ * @param positions The positions.
+ * @param count The number of positions.
+ * @param values The steps, 3 per position.
+ */
+void Quant_Encode_Positions(const Quant_Range &range, const Vec3 *positions, int count, uint32_t *values);
+
+/**
+ * @brief Restores quantized positions, four at once with SSE2; the positions are the ones of Quant_Decode_Position.
+ *
+ * @param range The range.
+ * @param values The steps, 3 per position.
+ * @param count The number of positions.
+ * @param positions The positions.
+ */
+void Quant_Decode_Positions(const Quant_Range &range, const uint32_t *values, int count, Vec3 *positions);
+
+/**
+ * @brief Returns the quaternion of a rotation of the entities.
+ *
+ * @param degrees The angles around x, y and z, applied as MathUtils::Rotate_Point_3D does.
+ *
+ * @return The unit quaternion, w is the real part.
+ */
+Vec4 Quant_Euler(Vec3 degrees);
+
+/**
+ * @brief Rotates a point by a quaternion.
+ *
+ * @param rotation The unit quaternion.
+ * @param point The point.
+ *
+ * @return The point rotated.
+ */
+Vec3 Quant_Rotate(Vec4 rotation, Vec3 point);
+
+/**
+ * @brief Packs a unit quaternion as its smallest three components, the reference of Quant_Encode_Quats.
+ *
+ * The largest component is dropped, its index takes the top 2 bits and it is made positive, the
+ * quaternion and its opposite being the same rotation. The other three are within +-1/sqrt(2) and
+ * take QUANT_QUAT_BITS bits each, in order.
+ *
+ * @param rotation The unit quaternion.
+ *
+ * @return The 32 bits.
+ */
+uint32_t Quant_Pack_Quat(Vec4 rotation);
+
+/**
+ * @brief Restores a packed quaternion, the reference of Quant_Decode_Quats.
+ *
+ * @param packed The 32 bits.
+ *
+ * @return The unit quaternion, its largest component positive.
+ */
+Vec4 Quant_Unpack_Quat(uint32_t packed);
+
+/**
+ * @brief Packs quaternions, four at once with SSE2; the bits are the ones of Quant_Pack_Quat.
+ *
+ * @param rotations The unit quaternions.
+ * @param count The number of quaternions.
+ * @param packed The 32 bits of every one.
+ */
+void Quant_Encode_Quats(const Vec4 *rotations, int count, uint32_t *packed);
+
+/**
+ * @brief Restores packed quaternions, four at once with SSE2; the quaternions are the ones of Quant_Unpack_Quat.
+ *
+ * @param packed The 32 bits of every one.
+ * @param count The number of quaternions.
+ * @param rotations The unit quaternions.
+ */
+void Quant_Decode_Quats(const uint32_t *packed, int count, Vec4 *rotations);
+
+/**
+ * @class Quant_Bits_Writer
+ *
+ * @brief Appends values of any number of bits, the first bits go to the low bits of the first byte.
+ */
+class Quant_Bits_Writer
+{
+public:
+  /**
+   * @brief Constructs a writer with an empty buffer.
+   */
+  Quant_Bits_Writer();
+
+  /**
+   * @brief Appends a value.
+   *
+   * @param value The value, the bits over bits are ignored.
+   * @param bits The number of bits, up to 32.
+   */
+  void write(uint32_t value, int bits);
+
+  void f32(float value); ///< Appends a float as its 32 bits.
+
+  /**
+   * @brief Appends the bits pending, the last byte completed with zeros.
+   */
+  void flush();
+
+  /**
+   * @brief Returns the bytes written, the bits not flushed are not there yet.
+   *
+   * @return The bytes.
+   */
+  const std::vector<uint8_t> &bytes();
+
+  /**
+   * @brief Empties the buffer.
+   */
+  void clear();
+
+private:
+  std::vector<uint8_t> m_bytes; ///< The bytes written.
+  uint64_t m_pending;           ///< The bits not written yet, from the low ones.
+  int m_count;                  ///< The number of bits pending, less than 32.
+};
+
+/**
+ * @brief Reads the values of a Quant_Bits_Writer, in place.
+ *
+ * A read past the end returns 0 and clears ok, as the one of Net_Reader.
+ */
+struct Quant_Bits_Reader
+{
+  const uint8_t *data; ///< The bytes.
+  uint32_t size;       ///< The number of bytes.
+  uint32_t offset;     ///< The next byte not loaded.
+  uint64_t pending;    ///< The bits loaded and not read, from the low ones.
+  int count;           ///< The number of bits loaded.
+  bool ok;             ///< False once a read went past the end.
+
+  uint32_t read(int bits); ///< Reads a value of up to 32 bits.
+  float f32();             ///< Reads a float.
+};
+
+/**
+ * @brief Writes the transforms of a snapshot: its range, then the position and the rotation of every entity.
+ *
+ * @param writer The writer, flushed at the end.
+ * @param positions The positions.
+ * @param rotations The unit quaternions.
+ * @param count The number of entities.
+ * @param step The units of a step of the positions.
+ *
+ * @return The bits per entity, without the range.
+ */
+int Quant_Write_Transforms(Quant_Bits_Writer &writer, const Vec3 *positions, const Vec4 *rotations, int count, float step);
+
+/**
+ * @brief Reads the transforms written by Quant_Write_Transforms.
+ *
+ * @param reader The reader.
+ * @param positions The positions.
+ * @param rotations The unit quaternions.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The bytes end before the transforms, or the range is not valid.
+ */
+int Quant_Read_Transforms(Quant_Bits_Reader &reader, std::vector<Vec3> &positions, std::vector<Vec4> &rotations);
+
+/**
+ * @brief Measures the quantization of transforms, printing the results on the console.
+ *
+ * Random positions in a box thousands of units wide and random rotations of the entities are
+ * encoded and decoded by the reference functions and by the SSE2 ones, then written and read
+ * by the bit packing. The errors are checked against their bounds: half a step per axis for the
+ * positions, the angle of the error of the components for the rotations.
+ *
+ * @param entities The number of entities, 0 runs 10000, 100000 and 1000000 entities.
+ * @param rounds The encodings and decodings measured of every run.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 An error is over its bound, or the SSE2 functions or the bit packing don't give the reference values.
+ */
+int Quantize_Benchmark(int entities, int rounds);
+
+////////////////////////
+#endif /* __QUANTIZE_H__ */
+////////////////////////
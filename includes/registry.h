@@ -0,0 +1,654 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file Registry.h
+
+////////////////////////
+#ifndef __REGISTRY_H__
+#define __REGISTRY_H__ 1
+////////////////////////
+
+#include <sphere_3d.h>
+#include <cube_3d.h>
+#include <figures_3d.h>
+#include <physics.h>
+#include <kepler.h>
+#include <sim_clock.h>
+#include <bvh.h>
+#include <collision.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#define MAX_OBJECTS_TYPE 4
+
+/**
+* @enum The objectstype for.
+*
+* @brief Enums the types that an object can be.
+*/
+enum ObjectsType
+{
+  notSet = 0,
+  typeSphere,
+  typeCube,
+  typeFigure,
+  // ...
+};
+
+#define REGISTRY_SLOT_BITS 20                               ///< Bits of a handle used by the slot, up to 1M entities.
+#define REGISTRY_SLOT_MASK ((1 << REGISTRY_SLOT_BITS) - 1)   ///< The slot of a handle.
+#define REGISTRY_GENERATION_MASK ((1 << (31 - REGISTRY_SLOT_BITS)) - 1) ///< The generation of a handle, after the shift.
+#define ENTITY_POOL_BLOCK 256                               ///< The number of entities of a pool block.
+
+/**
+ * @class Entity_Pool
+ *
+ * @brief Memory for the entities, in blocks of slots that never move.
+ *
+ * Every slot fits any entity type. The released slots go to a free list and are reused before
+ * allocating a new block, so creating and destroying entities doesn't call the allocator once
+ * the pool is warm.
+ */
+class Entity_Pool
+{
+public:
+  /**
+   * @brief Constructs an empty Entity_Pool.
+   */
+  Entity_Pool();
+
+  Entity_Pool(const Entity_Pool &) = delete; ///< The pool owns its blocks, it can't be copied.
+  void operator=(const Entity_Pool &) = delete;
+
+  /**
+   * @brief Returns a free slot, the entity must be constructed on it.
+   *
+   * @return The memory of the slot.
+   */
+  void *allocate();
+
+  /**
+   * @brief Returns a slot to the free list, its entity must be already destructed.
+   *
+   * @param slot The memory of the slot.
+   */
+  void release(void *slot);
+
+  /**
+   * @brief Returns the number of slots of the pool.
+   *
+   * @return The number of slots, used or free.
+   */
+  int capacity();
+
+  /**
+   * @brief Frees the blocks of the pool.
+   */
+  ~Entity_Pool();
+
+private:
+  char **blocks_; ///< The blocks of ENTITY_POOL_BLOCK slots.
+  int nBlocks_;   ///< The number of blocks.
+  void **free_;   ///< The free slots.
+  int nFree_;     ///< The number of free slots.
+};
+
+/**
+ * @struct Registry_State.
+ *
+ * @brief The positions of the entities produced by the simulation steps.
+ */
+struct Registry_State
+{
+  Vec3 *previous; ///< The positions one step before the current ones.
+  Vec3 *current;  ///< The positions after the last step.
+  double time;    ///< The simulated time of the current positions.
+  float alpha;    ///< The fraction of a step from the current positions to the real time.
+  float step;     ///< The step of the simulation, in seconds.
+  int steps;      ///< The steps from the state presented before, their spin is applied once.
+};
+
+/**
+ * @struct Registry_Merge.
+ *
+ * @brief A collision of the simulation, applied to the meshes when its state is presented.
+ */
+struct Registry_Merge
+{
+  int survivor; ///< The handle of the entity that absorbs the other one.
+  int absorbed; ///< The handle of the entity destroyed.
+  float scale;  ///< The growth of the survivor, its volume is the sum of both.
+};
+
+/**
+ * @class Registry
+ *
+ * @brief Stores the entities of the scene in dense component arrays.
+ *
+ * Every component is a packed array indexed by the dense index of the entity, so the update,
+ * the ordering and the draw are linear passes without holes. The entities are referenced with
+ * handles that don't change when other entities are removed; removing swaps the last entity
+ * into the hole, so adding and removing are O(1).
+ *
+ * The orbit and the material of an entity live in the registry from the moment it is added.
+ *
+ * A handle is a slot and the generation of the slot. Removing an entity increments the generation
+ * of its slot, so the old handles of a reused slot are detected as not valid.
+ * The entities are moved into an Entity_Pool, their points and faces are never copied.
+ *
+ * The entities on rails follow their Keplerian orbit, their position is evaluated from the time
+ * of the registry instead of rotated every frame, so it doesn't accumulate error.
+ *
+ * When Physics::settings_.enabled is set the entities are moved by a gravitational simulation
+ * instead of by their orbits. The bodies of the simulation have the dense indices of the entities.
+ *
+ * The entities move in fixed steps of a Sim_Clock, independent of the frame rate. The steps write
+ * the back Registry_State reading the front one, and the meshes are drawn interpolated between the
+ * last two steps; the gravity integrates one step of the clock per step. With Sim_Clock::settings_.threaded
+ * the steps of a frame run in a thread of the registry while the frame is drawn, the same thread for
+ * every frame; every function that reads or modifies the simulated components waits for it.
+ *
+ * The bounding spheres of the entities are kept in a Bvh, updated with the presented positions.
+ * It answers the picks and proximity queries with handles, and culls the entities out of the camera.
+ *
+ * With Collider::settings_.enabled the steps merge the entities that touch, in the order of their
+ * indices: the lighter one is destroyed and the heavier one takes its mass, its momentum and its
+ * volume. The merges are part of the steps, so they are the same for the same scene and clock
+ * settings whatever the frame rate or the threads.
+ *
+ * An entity that starts its destruction emits its debris once, in a Particles pool updated every
+ * frame and drawn over the entities.
+ *
+ * An entity can have a parent, its position is then kept relative to it and its orbit and its rails
+ * turn around the parent, so a moon follows a planet that orbits. The world positions are computed
+ * in one linear pass over the entities sorted with every parent before its children; only the
+ * entities that moved and the children of the ones that moved are recomputed. The order is sorted
+ * again when the hierarchy changes.
+ */
+class Registry
+{
+public:
+  /**
+   * @brief Constructs an empty Registry.
+   */
+  Registry();
+
+  Registry(const Registry &) = delete; ///< The registry owns its entities, it can't be copied.
+  void operator=(const Registry &) = delete;
+
+  /**
+   * @brief Reserves the storage of the components.
+   *
+   * @param capacity The number of entities to store without growing.
+   */
+  void reserve(int capacity);
+
+  /**
+   * @brief Adds an entity moving it into the registry, it is left empty.
+   *
+   * @param type The type of the entity, it is define in enum ObjectsType.
+   * @param entity The entity, of the given type. Its orbit and material are copied in the components.
+   *
+   * @return The handle of the entity.
+   */
+  int add(int type, Entity &&entity);
+
+  /**
+   * @brief Removes and destroys an entity.
+   *
+   * @param handle The handle of the entity.
+   */
+  void remove(int handle);
+
+  /**
+   * @brief Removes and destroys every entity, the handles given before are not valid anymore.
+   */
+  void clear();
+
+  /**
+   * @brief Returns if a handle references an entity of the registry.
+   *
+   * @param handle The handle to check.
+   *
+   * @return True if the handle is valid.
+   */
+  bool valid(int handle);
+
+  /**
+   * @brief Returns the number of entities.
+   *
+   * @return The number of entities.
+   */
+  int count();
+
+  /**
+   * @brief Returns the handle of the entity stored at a dense index.
+   *
+   * @param index The dense index, between 0 and count() - 1.
+   *
+   * @return The handle of the entity.
+   */
+  int handle(int index);
+
+  /**
+   * @brief Returns the dense index of an entity.
+   *
+   * @param handle The handle of the entity.
+   *
+   * @return The dense index, -1 if the handle is not valid.
+   */
+  int index(int handle);
+
+  /**
+   * @brief Returns the type of an entity.
+   *
+   * @param handle The handle of the entity.
+   *
+   * @return The type, it is define in enum ObjectsType.
+   */
+  int type(int handle);
+
+  /**
+   * @brief Returns the mesh of an entity.
+   *
+   * @param handle The handle of the entity.
+   *
+   * @return The entity, nullptr if the handle is not valid.
+   */
+  Entity *entity(int handle);
+
+  /**
+   * @brief Returns the orbit component of an entity.
+   *
+   * @param handle A valid handle.
+   *
+   * @return The orbit of the entity.
+   */
+  Entity_Orbit &orbit(int handle);
+
+  /**
+   * @brief Returns the material component of an entity.
+   *
+   * @param handle A valid handle.
+   *
+   * @return The material of the entity.
+   */
+  Entity_Material &material(int handle);
+
+  /**
+   * @brief Puts an entity on rails, it follows a Keplerian orbit instead of its incremental one.
+   *
+   * @param handle A valid handle.
+   * @param elements The orbit.
+   */
+  void setRails(int handle, const Orbital_Elements &elements);
+
+  /**
+   * @brief Takes an entity off rails, it follows its incremental orbit again.
+   *
+   * @param handle A valid handle.
+   */
+  void clearRails(int handle);
+
+  /**
+   * @brief Returns if an entity is on rails.
+   *
+   * @param handle A valid handle.
+   *
+   * @return True if the entity follows a Keplerian orbit.
+   */
+  bool onRails(int handle);
+
+  /**
+   * @brief Attaches an entity to a parent, the entity follows it from then on.
+   *
+   * The entity keeps its world position; its orbit center and the center of its rails become
+   * relative to the parent.
+   *
+   * @param handle A valid handle.
+   * @param parent The handle of the parent, -1 detaches the entity.
+   *
+   * @return 0 Everything went OK.
+   * @return 1 The parent is not valid, or it is the entity or one of its descendants.
+   */
+  int setParent(int handle, int parent);
+
+  /**
+   * @brief Returns the parent of an entity.
+   *
+   * @param handle A valid handle.
+   *
+   * @return The handle of the parent, -1 if the entity has no parent.
+   */
+  int parent(int handle);
+
+  /**
+   * @brief Returns the position of an entity relative to its parent.
+   *
+   * @param handle A valid handle.
+   *
+   * @return The position in the frame of the parent, the world position if it has no parent.
+   */
+  Vec3 local(int handle);
+
+  /**
+   * @brief Returns the Keplerian orbit of an entity.
+   *
+   * @param handle A valid handle.
+   *
+   * @return The orbit, only used while the entity is on rails.
+   */
+  Orbital_Elements &elements(int handle);
+
+  /**
+   * @brief Returns the simulated time of the presented state, the one used to evaluate the orbits on rails.
+   *
+   * @return The time in seconds.
+   */
+  double time();
+
+  /**
+   * @brief Returns the clock of the simulation.
+   *
+   * @return The clock, its steps are the ones of the entities.
+   */
+  Sim_Clock &clock();
+
+  /**
+   * @brief Returns the packed positions of the entities, refreshed by update.
+   *
+   * @return The positions, count() elements.
+   */
+  Vec3 *positions();
+
+  /**
+   * @brief Returns the packed scales of the entities, refreshed by update.
+   *
+   * @return The scales, count() elements.
+   */
+  Vec3 *scales();
+
+  /**
+   * @brief Returns the packed radii of the bounds of the entities, refreshed by update.
+   *
+   * @return The radii, count() elements.
+   */
+  float *radii();
+
+  /**
+   * @brief Returns the gravitational simulation of the entities.
+   *
+   * @return The simulation, a body per entity with the same index.
+   */
+  Physics &physics();
+
+  /**
+   * @brief Sets the simulation to the current positions of the entities.
+   *
+   * The masses are proportional to the volume of the entities. The entities that orbit get the
+   * velocity of a circular orbit around the heaviest one, in the plane of their orbit.
+   */
+  void startPhysics();
+
+  /**
+   * @brief Removes the destroyed entities, moves the others and refreshes their transforms.
+   *
+   * Advances the clock by the real time since the last update. The entities orbit, or follow
+   * the simulation when it is enabled.
+   */
+  void update();
+
+  /**
+   * @brief Removes the destroyed entities, moves the others and refreshes their transforms.
+   *
+   * @param elapsed The real time to advance the clock, in seconds.
+   */
+  void update(float elapsed);
+
+  /**
+   * @brief Waits for the steps running in the thread, the components can be modified after it.
+   */
+  void wait();
+
+  /**
+   * @brief Returns the entity under a point of the window, the nearest one hit by the ray of the camera.
+   *
+   * @param drawRender The render with the camera.
+   * @param screen The point of the window, in pixels.
+   *
+   * @return The handle of the entity, -1 if there is none.
+   */
+  int pick(Render &drawRender, Vec2 screen);
+
+  /**
+   * @brief Returns the entities whose bounding sphere touches a sphere.
+   *
+   * @param center The center of the sphere.
+   * @param radius The radius of the sphere.
+   * @param handles Returns the handles of the entities, up to max.
+   * @param max The size of handles.
+   *
+   * @return The number of entities found, it can be bigger than max.
+   */
+  int query(Vec3 center, float radius, int *handles, int max);
+
+  /**
+   * @brief Returns the entities nearest to a point.
+   *
+   * @param point The point.
+   * @param k The number of entities.
+   * @param handles Returns the handles of the entities, nearest first.
+   * @param distances Returns the distance to the position of each entity, can be nullptr.
+   *
+   * @return The number of entities found, k unless there are fewer entities.
+   */
+  int nearest(Vec3 point, int k, int *handles, float *distances);
+
+  /**
+   * @brief Returns the hierarchy of the bounding spheres of the entities.
+   *
+   * @return The hierarchy, its items are the handles of the entities.
+   */
+  Bvh &bvh();
+
+  /**
+   * @brief Returns the collision detection of the steps.
+   *
+   * @return The collider, with the pairs of the last step.
+   */
+  Collider &collider();
+
+  /**
+   * @brief Returns the number of merges since the registry was created.
+   *
+   * @return The number of entities destroyed by collisions.
+   */
+  int merges();
+
+  /**
+   * @brief Returns the debris of the destroyed entities.
+   *
+   * @return The particles.
+   */
+  Particles &particles();
+
+  /**
+   * @brief Returns the number of entities drawn in the last draw.
+   *
+   * @return The number of entities inside the camera, count() without culling.
+   */
+  int visible();
+
+#ifndef HEADLESS
+  /**
+   * @brief Draws every entity, back to front.
+   *
+   * With Bvh::settings_.culling only the entities whose bounding sphere touches the camera are drawn.
+   * The debris is drawn after them.
+   *
+   * @param render The SDL renderer to use for drawing.
+   * @param drawRender The render with the camera.
+   * @param light The light point.
+   */
+  void draw(SDL_Renderer *render, Render &drawRender, Vec3 light);
+#endif
+
+  /**
+   * @brief Destroys the Registry and its entities.
+   */
+  ~Registry();
+
+private:
+  int count_;    ///< The number of entities.
+  int capacity_; ///< The number of entities the components can store.
+
+  int *types_;               ///< Mesh component, the type of each entity.
+  Entity **meshes_;          ///< Mesh component, the points and faces of each entity.
+  Vec3 *positions_;          ///< Transform component, the position of each entity.
+  Vec3 *scales_;             ///< Transform component, the scale of each entity.
+  Entity_Orbit *orbits_;     ///< Orbit component.
+  Entity_Material *materials_; ///< Material component.
+  Orbital_Elements *elements_; ///< Keplerian orbit component.
+  bool *rails_;              ///< A flag per entity indicating whether it follows its Keplerian orbit.
+  int *handles_;             ///< The handle of each dense index.
+  int *proxies_;             ///< Bounds component, the proxy of each entity in bvh_.
+  float *radii_;             ///< Bounds component, the radius of the sphere of each entity, it grows when it merges.
+  bool *solid_;              ///< Collision component, a flag per entity indicating whether it collides.
+  bool *shattered_;          ///< Particles component, a flag per entity indicating whether it emitted its debris.
+  int *parents_;             ///< Hierarchy component, the handle of the parent of each entity, -1 for the roots.
+  int *children_;            ///< Hierarchy component, the number of children of each entity.
+  Vec3 *locals_;             ///< Hierarchy component, the position of each entity relative to its parent.
+  int *changed_;             ///< Hierarchy component, the last pass that moved each entity, its children follow it.
+
+  int *sparse_;      ///< The dense index of each slot, -1 if the slot is free.
+  int *generations_; ///< The generation of each slot, incremented when its entity is removed.
+  int nSparse_;      ///< The number of slots ever used.
+  int *free_;        ///< The free slots, reused before using new ones.
+  int nFree_;        ///< The number of free slots.
+
+  Entity_Pool pool_; ///< The memory of the entities.
+
+  Physics physics_;  ///< Gravitational simulation component, the masses and velocities.
+  bool simulating_;  ///< A flag indicating whether the entities follow the simulation.
+
+  Sim_Clock clock_;                  ///< The clock of the steps.
+  Registry_State states_[2];         ///< The double buffered positions, the steps read the front and write the back.
+  int front_;                        ///< The state presented, 0 or 1.
+  std::thread worker_;               ///< The thread running the steps of every frame, started by the first threaded update.
+  std::mutex jobMutex_;              ///< Guards the job handed to the worker.
+  std::condition_variable jobStart_; ///< Wakes the worker when there is a job or it has to stop.
+  std::condition_variable jobDone_;  ///< Wakes the owner when the job ends.
+  float jobElapsed_;                 ///< The real time of the frame of the job, in seconds.
+  bool busy_;                        ///< A flag indicating whether the worker has a job not finished yet.
+  bool stopping_;                    ///< A flag asking the worker to end, set by the destructor.
+  bool pending_;                     ///< A flag indicating whether the thread wrote a back state not presented yet.
+
+  Bvh bvh_;                 ///< The bounding spheres of the entities.
+  int *visible_;            ///< The dense indices of the entities inside the camera in the last draw.
+  Vec3 *visiblePositions_;  ///< The positions of the visible entities, ordered by the render.
+  Vec3 *visibleScales_;     ///< The scales of the visible entities.
+  int nVisible_;            ///< The number of visible entities.
+#ifndef HEADLESS
+  Entity_Draw_Buffers drawBuffers_; ///< The scratch of the draw of the meshes.
+#endif
+
+  Collider collider_;                  ///< The collision detection of the steps.
+  std::vector<Registry_Merge> merges_; ///< The merges of the steps not presented yet.
+  int nMerges_;                        ///< The number of merges.
+
+  Particles particles_; ///< The debris of the destroyed entities.
+
+  int *order_;        ///< The dense indices of the entities, every parent before its children.
+  int *orderParents_; ///< The dense index of the parent of each entity of order_, -1 for the roots.
+  bool ordered_;      ///< A flag indicating whether order_ follows the current hierarchy.
+  int pass_;          ///< The number of hierarchy passes.
+
+  /**
+   * @brief Returns the velocity of a circular orbit for an entity.
+   *
+   * @param index The dense index of the entity.
+   * @param primary The dense index of the entity it orbits.
+   *
+   * @return The velocity, 0 if the entity doesn't orbit.
+   */
+  Vec3 orbitVelocity(int index, int primary);
+
+  /**
+   * @brief Sets the simulation to the positions of the front state.
+   */
+  void seedPhysics();
+
+  /**
+   * @brief Moves an entity to another parent, keeping its world position.
+   *
+   * @param index The dense index of the entity.
+   * @param parent The handle of the new parent, -1 for none.
+   */
+  void attach(int index, int parent);
+
+  /**
+   * @brief Sorts the entities with every parent before its children, by their depth.
+   */
+  void sortHierarchy();
+
+  /**
+   * @brief Advances the clock and simulates its steps, from the front state to the back one.
+   *
+   * @param elapsed The real time to advance the clock, in seconds.
+   */
+  void simulate(float elapsed);
+
+  /**
+   * @brief Runs the jobs handed by the threaded updates, one at a time, until the destructor stops it.
+   */
+  void work();
+
+  /**
+   * @brief Merges the entities that touch in a state, the lighter one of each pair is absorbed.
+   *
+   * @param state The state just simulated.
+   */
+  void collide(Registry_State &state);
+
+  /**
+   * @brief Moves the meshes to the front state, interpolated, and applies the spin of its orbits.
+   */
+  void present();
+
+#ifndef HEADLESS
+  /**
+   * @brief Draws the entities, back to front.
+   *
+   * @param render The SDL renderer to use for drawing.
+   * @param drawRender The render with the camera.
+   * @param light The light point.
+   */
+  void drawEntities(SDL_Renderer *render, Render &drawRender, Vec3 light);
+#endif
+
+  /**
+   * @brief Destructs an entity and releases its memory.
+   *
+   * @param index The dense index of the entity.
+   */
+  void destroy(int index);
+};
+
+/**
+ * @brief Creates and removes bodies in a registry, printing the rate and the memory used on the console.
+ *
+ * Every round copies a sphere before the clock starts, moves the copies into the registry and then
+ * removes them in a random order, keeping a few of the handles to check that the removed ones are not
+ * valid anymore. The add must take the buffers of every copy and leave it without faces.
+ *
+ * @param bodies The number of bodies of every round.
+ * @param rounds The number of rounds.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A copy keeps its faces after the add, a removed handle is still valid or the memory grows after the first round.
+ */
+int Registry_Stress(int bodies, int rounds);
+
+////////////////////////
+#endif /* __REGISTRY_H__ */
+////////////////////////
@@ -10,7 +10,9 @@
 #include <iostream>
 #include <common_defs.h>
 #include "math_utils.h"
+#ifndef HEADLESS
 #include "SDL_event_control.h"
+#endif
 
 /**
  * @struct Render_Vert
@@ -36,7 +38,8 @@ struct Render_Figure
 {
   Render_Vert **verts;  ///< A list of pointers to render vertices.
   Vec3 *point;  ///< A list of points.
-  int n_points;  ///< The number of points.
+  int *indices = nullptr;  ///< Optional list of the points to render, all the points are rendered if null.
+  int n_points;  ///< The number of points, or of indices if there are indices.
   Vec3 desp;  ///< A displacement vector.
   Vec3 light;  ///< A light vector.
   SDL_Color color;  ///< The color of the figure.
@@ -94,12 +97,14 @@ public:
    */
   void translation(Vec3 desp);
 
+#ifndef HEADLESS
   /**
    *  @brief Set the input keys for the camera.
    *
    *  @param keys A pointer to the keys object.
    */
   void inputs();
+#endif
 
   /**
    *  @brief Calculate the draw order of the objects.
@@ -118,7 +123,7 @@ public:
    *  @param figure The figure to be rendered.
    *  @param renderLight A flag indicating whether to render the light or not.
    */
-  void renderPoints(Render_Figure &figure, bool renderLight);
+  void renderPoints(Render_Figure &figure, bool renderLight) const;
 
   /**
    * @brief Render the points of a figure using multiple threads.
@@ -126,7 +131,7 @@ public:
    * @param figure The figure to be rendered.
    * @param renderLight A flag indicating whether to render the light or not.
    */
-  void renderThreadedPoints(Render_Figure &figure, bool renderLight);
+  void renderThreadedPoints(Render_Figure &figure, bool renderLight) const;
 
   /**
    *  @brief Render a single point.
@@ -140,9 +145,10 @@ public:
    *  @param forceRender A flag indicating whether to force the point to be rendered or not.
    *  @param renderLight A flag indicating whether to render the light or not.
    */
-  void renderPoint(Render_Vert &ret_vert, Vec3 point, Vec3 desp, Vec3 light, SDL_Color color, Mat3 model, bool forceRender = false, bool renderLight = false );
+  void renderPoint(Render_Vert &ret_vert, Vec3 point, Vec3 desp, Vec3 light, SDL_Color color, Mat3 model, bool forceRender = false, bool renderLight = false ) const;
 
 
+#ifndef HEADLESS
   /**
    * @brief Draws the camera on the screen using the given keys, renderer, and window dimensions.
    *
@@ -151,20 +157,21 @@ public:
    * @param max_win A Vec2 object representing the dimensions of the window in pixels.
    */
   void cameraDraw(SDL_Renderer *render, Vec2 max_win, Vec3 light);
+#endif
 
   /**
    * @brief Returns the current render scale as a Vec2 object.
    *
    * @return The current render scale.
    */
-  Vec2 getRenderScale();
+  Vec2 getRenderScale() const;
 
   /**
    * @brief Returns the current render center as a Vec2 object.
    *
    * @return The current render center.
    */
-  Vec2 getRenderCenter();
+  Vec2 getRenderCenter() const;
 
   /**
    * @brief Returns the current far clipping plane distance.
@@ -180,6 +187,16 @@ public:
    */
   float getNear();
 
+  /**
+   * @brief Returns the approximated radius in pixels of a sphere once projected.
+   *
+   * @param center The center of the sphere.
+   * @param radius The radius of the sphere.
+   *
+   * @return The projected radius in pixels.
+   */
+  float projectedSize(Vec3 center, float radius) const;
+
   /**
    * @brief Returns the current up vector as a Vec3 object.
    *
@@ -187,6 +204,32 @@ public:
    */
   Vec3 getUp();
 
+  /**
+   * @brief Returns the axes of the view, a point is projected dividing its coordinates in x and y by the one in z.
+   *
+   * @param xAxis Returns the horizontal axis, normalized.
+   * @param yAxis Returns the vertical axis, normalized.
+   * @param zAxis Returns the depth axis, normalized.
+   */
+  void getAxes(Vec3 &xAxis, Vec3 &yAxis, Vec3 &zAxis);
+
+  /**
+   * @brief Returns the ray of the camera through a point of the window, the inverse of the projection.
+   *
+   * @param screen The point of the window, in pixels.
+   * @param origin Returns the origin of the ray, the camera.
+   * @param direction Returns the direction of the ray, normalized.
+   */
+  void screenRay(Vec2 screen, Vec3 &origin, Vec3 &direction);
+
+  /**
+   * @brief Returns the 6 planes of the render trapezoid, a point is drawn if it is inside all of them.
+   *
+   * @param points Returns a point of each plane, 6 of them.
+   * @param normals Returns the normal of each plane towards the inside, normalized.
+   */
+  void getFrustum(Vec3 *points, Vec3 *normals);
+
 private:
   int *draw_order_; ///< A pointer to an array of integers representing the draw order of 3D objects.
   Vec3 up_; ///< A Vec3 object representing the up vector of the camera.
@@ -213,7 +256,7 @@ private:
    * @param point The point to check.
    * @return True if the point is inside the render trapezoid, false otherwise.
    */
-  bool active(Vec3 point);
+  bool active(Vec3 point) const;
 };
 
 /////////////////////////
@@ -0,0 +1,167 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file Scene.h
+
+////////////////////////
+#ifndef __SCENE_H__
+#define __SCENE_H__ 1
+////////////////////////
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <objects.h>
+#include <render.h>
+
+/**
+ * @struct Scene_Body.
+ *
+ * @brief Description of a body of the scene.
+ *
+ * The struct has a fixed layout, the binary scene files store the bodies as an array of it
+ * so they are read with a single fread.
+ */
+struct Scene_Body
+{
+  int32_t type;       ///< The object type, it is define in enum ObjectsType.
+  int32_t mesh;       ///< The mesh of a figure, an index of Scene::meshes, -1 for the other types.
+  SDL_Color color;    ///< The fill color.
+  int32_t fill;       ///< Non zero if the body is filled.
+  int32_t res;        ///< The resolution of a sphere.
+  int32_t subdivisions; ///< The subdivision level of an icosphere, -1 for the UV spheres.
+  Vec3 scale;         ///< The initial scale.
+  Vec3 mov;           ///< The initial position.
+  Vec3 rot;           ///< The initial rotation.
+  Vec3 orbit;         ///< The orbit angle per frame.
+  Vec3 orbit_center;  ///< The center of the orbit.
+  float orbit_vel;    ///< The velocity of the orbit.
+  float kepler[6];    ///< Keplerian orbit: semi-major axis, eccentricity, inclination, node, periapsis and mean anomaly.
+  float period;       ///< The period of the Keplerian orbit in seconds, 0 if the body is not on rails.
+  int32_t parent;     ///< The index of the body it follows, a previous one, -1 if it has no parent.
+};
+
+/**
+ * @struct Scene.
+ *
+ * @brief Bodies, meshes, light and camera of a scene.
+ */
+struct Scene
+{
+  Vec3 camera;                     ///< The camera position.
+  float near;                      ///< The near plane distance.
+  float far;                       ///< The far plane distance.
+  Vec3 light;                      ///< The light point.
+  bool has_light;                  ///< False if the light is the position of the first body.
+  std::vector<std::string> meshes; ///< The .obj files used by the figures, each one is loaded once.
+  std::vector<Scene_Body> bodies;  ///< The bodies of the scene.
+};
+
+/**
+ * @brief Loads a scene from a file, text or binary depending on its first bytes.
+ *
+ * Text scenes have one element per line, '#' starts a comment:
+ *
+ *   camera x y z [near far]
+ *   light x y z
+ *   count n                          (optional, reserves the storage of n bodies, at most the ones the file can hold)
+ *   mesh name path.obj
+ *   sphere key=value ...
+ *   cube key=value ...
+ *   figure mesh=name key=value ...
+ *
+ * The body keys are color=r,g,b,a fill=0|1 res=n ico=level scale=x,y,z pos=x,y,z rot=x,y,z
+ * orbit=x,y,z center=x,y,z around=body parent=body vel=v kepler=a,e,i,node,periapsis,anomaly
+ * period=t, parent makes the body follow a previous one, around sets the orbit center to the
+ * position of a previous body and makes it the parent, and ico makes the sphere an icosphere. A body with a period is on rails, it follows the Keplerian orbit around its
+ * center, with the angles in degrees.
+ *
+ * @param path The file to load.
+ * @param scene The loaded scene.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 File not found.
+ * @return 2 Malformed file, the line is printed on the console.
+ */
+int Scene_Load(const char *path, Scene &scene);
+
+/**
+ * @brief Saves a scene in the text format.
+ *
+ * @param path The file to write.
+ * @param scene The scene to save.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The file can't be written.
+ */
+int Scene_Save_Text(const char *path, const Scene &scene);
+
+/**
+ * @brief Saves a scene in the binary format.
+ *
+ * A header with the counts, camera and light, the mesh paths and the array of bodies.
+ * The numbers are stored in the byte order of the machine that writes the file.
+ *
+ * @param path The file to write.
+ * @param scene The scene to save.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The file can't be written.
+ */
+int Scene_Save_Binary(const char *path, const Scene &scene);
+
+/**
+ * @brief Saves a scene, in the binary format if the file extension is .scnb and in the text one otherwise.
+ *
+ * @param path The file to write.
+ * @param scene The scene to save.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The file can't be written.
+ */
+int Scene_Save(const char *path, const Scene &scene);
+
+/**
+ * @brief Fills a scene with a sun and n bodies orbiting it in random rings.
+ *
+ * The same seed always generates the same scene.
+ *
+ * @param scene The generated scene.
+ * @param n_bodies The number of bodies without the sun.
+ * @param seed The seed of the generator.
+ * @param center The position of the sun.
+ */
+void Scene_Generate(Scene &scene, int n_bodies, uint32_t seed, Vec3 center);
+
+/**
+ * @brief Creates the objects of a scene in the registry, replacing the current ones.
+ *
+ * The registry storage is reserved once. Every mesh and sphere tessellation is built
+ * a single time and the bodies that use it are copies placed afterwards, moved into the
+ * registry; the last body of every prototype takes the prototype itself. The bodies with
+ * a period are put on rails.
+ *
+ * @param scene The scene to create.
+ * @param registry The registry of the objects.
+ * @param light The light point of the scene.
+ * @param drawRender The render, set to the camera of the scene.
+ * @param max_win The window size.
+ *
+ * @return The number of objects created, the bodies with a mesh that can't be loaded are skipped.
+ */
+int Scene_Instantiate(const Scene &scene, Registry &registry, Vec3 &light, Render &drawRender, Vec2 max_win);
+
+/**
+ * @brief Loads a scene and updates it without window, printing the times on the console.
+ *
+ * Every frame updates the registry, selects the level of detail of the objects and sorts them, as the main loop does.
+ *
+ * @param path The scene file.
+ * @param frames The number of frames to update.
+ * @param max_win The window size used by the render.
+ *
+ * @return The result of Scene_Load.
+ */
+int Scene_Benchmark(const char *path, int frames, Vec2 max_win);
+
+////////////////////////
+#endif /* __SCENE_H__ */
+////////////////////////
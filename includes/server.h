@@ -0,0 +1,73 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+
+/** @file Server.h
+ * Headless server globals and includes, nothing of the window is linked.
+ */
+
+////////////////////////
+#ifndef __SERVER_H__
+#define __SERVER_H__ 1
+////////////////////////
+
+#include <iostream>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <scene.h>
+#include <net_replication.h>
+
+const Vec2 k_ViewWin = {1200.0f, 840.0f}; ///< The window of the viewers of main.h, the scenes are placed as they see them.
+
+/**
+ * @brief The local viewers of a headless server, to test it without a display.
+ */
+struct Server_Stand_Ins
+{
+  std::vector<std::unique_ptr<Replication_Client>> clients; ///< The connections, nullptr once lost.
+  std::vector<std::unique_ptr<Registry>> registries;        ///< The entities of every client, never simulated.
+};
+
+/**
+ * @brief The counters of the last report, to print what changed since.
+ */
+struct Server_Report
+{
+  double time;                ///< The time of the server, in seconds.
+  Replication_Stats stats;    ///< The counters of the replication.
+  std::vector<long long> tcp; ///< The bytes sent to every TCP client, the index is the client.
+  std::vector<long long> udp; ///< The bytes sent to every UDP client, the index is the connection.
+};
+
+/**
+ * @brief Connects the stand-ins to the server, over the loopback.
+ *
+ * @param stand_ins The stand-ins, every one gets a registry of its own.
+ * @param count The number of stand-ins.
+ * @param port The port of the server.
+ * @param udp True to connect over UDP.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A stand-in can't connect.
+ */
+int Server_Connect(Server_Stand_Ins &stand_ins, int count, int port, bool udp);
+
+/**
+ * @brief Applies what every stand-in received, as the main loop of a viewer does.
+ *
+ * @param stand_ins The stand-ins, the ones that lost the connection are dropped.
+ *
+ * @return The number of stand-ins still connected.
+ */
+int Server_Update(Server_Stand_Ins &stand_ins);
+
+/**
+ * @brief Prints the times of the ticks and the bandwidth of every client since the last report.
+ *
+ * @param server The server.
+ * @param report The counters of the last report, updated to the current ones.
+ */
+void Server_Print(Replication_Server &server, Server_Report &report);
+
+////////////////////////
+#endif /* __SERVER_H__ */
+////////////////////////
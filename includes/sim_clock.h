@@ -0,0 +1,106 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file SimClock.h
+
+////////////////////////
+#ifndef __SIM_CLOCK_H__
+#define __SIM_CLOCK_H__ 1
+////////////////////////
+
+#include <chrono>
+
+#define CLOCK_MAX_ELAPSED 0.25f ///< The longest real time of a frame, a breakpoint or a dragged window isn't simulated.
+
+/**
+ * @struct Clock_Settings.
+ *
+ * @brief Configuration of the simulation clock.
+ */
+struct Clock_Settings
+{
+  float step;       ///< The fixed timestep of the simulation, in seconds.
+  float time_scale; ///< The simulated seconds per real second, the time warp.
+  bool paused;      ///< A flag indicating whether the simulated time is stopped.
+  int max_steps;    ///< The maximum steps of a frame, the remaining time is dropped.
+  bool threaded;    ///< A flag indicating whether the steps run in a thread while the frame is drawn.
+};
+
+/**
+ * @class Sim_Clock
+ *
+ * @brief Converts the real time of the frames in fixed simulation steps.
+ *
+ * The scaled time of every frame is added to an accumulator and consumed in whole steps, so the
+ * simulation is the same at any frame rate. The time left in the accumulator is the fraction of
+ * a step that the render interpolates.
+ */
+class Sim_Clock
+{
+public:
+  static Clock_Settings settings_; ///< The configuration used by every clock.
+
+  /**
+   * @brief Constructs a Sim_Clock at the time 0.
+   */
+  Sim_Clock();
+
+  /**
+   * @brief Returns the real time since the last call, clamped to CLOCK_MAX_ELAPSED.
+   *
+   * @return The time in seconds.
+   */
+  float elapsed();
+
+  /**
+   * @brief Adds the time of a frame and returns the steps to simulate.
+   *
+   * @param elapsed The real time of the frame, in seconds. It is scaled by settings_.time_scale.
+   *
+   * @return The number of steps of settings_.step, at most settings_.max_steps.
+   */
+  int advance(float elapsed);
+
+  /**
+   * @brief Requests a single step, simulated by the next advance even if the clock is paused.
+   */
+  void stepOnce();
+
+  /**
+   * @brief Returns the step of the last advance.
+   *
+   * @return The step in seconds.
+   */
+  float step();
+
+  /**
+   * @brief Returns the fraction of a step accumulated after the last advance.
+   *
+   * @return The interpolation factor, between 0 and 1.
+   */
+  float alpha();
+
+  /**
+   * @brief Returns the simulated time, the sum of the steps.
+   *
+   * @return The time in seconds.
+   */
+  double time();
+
+  /**
+   * @brief Returns the simulated time dropped because a frame needed more than settings_.max_steps.
+   *
+   * @return The time in seconds, since the clock was constructed.
+   */
+  double dropped();
+
+private:
+  std::chrono::steady_clock::time_point last_; ///< The real time of the last call to elapsed.
+  double accumulator_; ///< The simulated time not consumed by steps yet.
+  double time_;        ///< The simulated time.
+  double dropped_;     ///< The simulated time dropped.
+  float step_;         ///< The step of the last advance.
+  int requested_;      ///< The single steps requested.
+};
+
+////////////////////////
+#endif /* __SIM_CLOCK_H__ */
+////////////////////////
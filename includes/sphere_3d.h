@@ -8,21 +8,36 @@
 
 #include <entity_3d.h>
 
+#define MAX_ICO_LEVEL 6
+
 class Sphere : public Entity
 {
 private:
+  int subdivisions_; ///< The subdivision level of an icosphere, -1 for the UV spheres.
 
   /**
    *  @brief Obtains the sphere points.
    */
   void obtainSphere();
 
+  /**
+   *  @brief Obtains the levels of detail, lower resolution grids of the sphere points.
+   */
+  void obtainLods();
+
+  /**
+   *  @brief Obtains the icosphere points and triangles, copied from the shared tessellation tables.
+   *
+   *  The levels of detail are the lower subdivision levels of the same tables.
+   */
+  void obtainIcosphere();
+
 public:
 
   /**
    *  @brief Constructor for the Sphere class.
    */
-  Sphere(){};
+  Sphere() { subdivisions_ = -1; };
 
   /**
    *  @brief Initializes the sphere.
@@ -40,12 +55,44 @@ public:
    */
   int init(SDL_Color color, bool fill = false, int res = 10, Vec3 scale = {1, 1, 1}, Vec3 mov = {0, 0, 0}, Vec3 rot = {0, 0, 0}, Vec3 orbit = {0, 0, 0}, Vec3 orbit_center = {0, 0, 0});
 
-  void print();
+  /**
+   *  @brief Initializes the sphere as an icosphere, a subdivided icosahedron with uniform triangles.
+   *
+   *  @param color An SDL_Color object representing the color of the sphere.
+   *  @param fill A boolean value indicating whether the sphere should be filled or not.
+   *  @param subdivisions The subdivision level, between 0 and MAX_ICO_LEVEL, every level has 4 times the triangles.
+   *  @param scale A Vec3 object representing the scale of the sphere.
+   *  @param mov A Vec3 object representing the movement of the sphere.
+   *  @param rot A Vec3 object representing the rotation of the sphere.
+   *  @param orbit A Vec3 object representing the orbit of the sphere.
+   *  @param orbit_center A Vec3 object representing the center of the sphere's orbit.
+   *
+   *  @return An integer indicating the success or failure of the initialization.
+   */
+  int initIcosphere(SDL_Color color, bool fill = false, int subdivisions = 3, Vec3 scale = {1, 1, 1}, Vec3 mov = {0, 0, 0}, Vec3 rot = {0, 0, 0}, Vec3 orbit = {0, 0, 0}, Vec3 orbit_center = {0, 0, 0});
+
+  /**
+   *  @brief Returns the number of triangles of the sphere, the UV spheres have 2 per face.
+   *
+   *  @return The number of triangles.
+   */
+  int getTriangles();
+
+  /**
+   *  @brief Returns the subdivision level of an icosphere.
+   *
+   *  @return The subdivision level, -1 for the UV spheres.
+   */
+  int getSubdivisions();
 
   /**
-   *  @brief Destructor for the Sphere class.
+   *  @brief Prints on the console the triangles of every icosphere level and of the UV sphere with the same error.
+   *
+   *  The error is the maximum distance between the faces and the unit sphere.
    */
-  ~Sphere(){};
+  static void TessellationReport();
+
+  void print();
 };
 
 ////////////////////////
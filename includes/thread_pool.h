@@ -0,0 +1,70 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+/// @file Thread_Pool.h
+
+////////////////////////
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__ 1
+////////////////////////
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class Thread_Pool
+ *
+ * @brief Threads kept between the jobs of a module, so a job doesn't create nor join any.
+ *
+ * A job is split in ranges by its owner: the workers run all of them but the last one, which
+ * runs on the thread that asked for the job. The workers are started by the first job that
+ * needs them and sleep until the next one; the pool is used by a single thread at a time.
+ */
+class Thread_Pool
+{
+public:
+  /**
+   * @brief Constructs a Thread_Pool without workers.
+   */
+  Thread_Pool();
+
+  /**
+   * @brief Stops and joins the workers.
+   */
+  ~Thread_Pool();
+
+  Thread_Pool(const Thread_Pool &) = delete; ///< The pool owns its threads, it can't be copied.
+  void operator=(const Thread_Pool &) = delete;
+
+  /**
+   * @brief Runs the ranges of a job and waits for all of them.
+   *
+   * @param ranges The number of ranges, one per thread.
+   * @param work The work of a range, every range writes its own results.
+   */
+  void run(int ranges, const std::function<void(int range)> &work);
+
+private:
+  std::vector<std::thread> workers_;          ///< The workers, the thread of the job takes a range too.
+  std::mutex mutex_;                          ///< Guards the job.
+  std::condition_variable start_;             ///< Wakes the workers when there is a job or they have to stop.
+  std::condition_variable done_;              ///< Wakes the thread of the job when the workers end.
+  const std::function<void(int range)> *job_; ///< The work of the job.
+  int ranges_;                                ///< The number of ranges of the job.
+  int pending_;                               ///< The workers that didn't finish the job yet.
+  int generation_;                            ///< Incremented by every job, a worker runs each one once.
+  bool stopping_;                             ///< A flag asking the workers to end, set by the destructor.
+
+  /**
+   * @brief Runs its range of the jobs until the destructor stops it.
+   *
+   * @param index The range of the worker in every job.
+   * @param generation The last job before the worker started.
+   */
+  void worker(int index, int generation);
+};
+
+////////////////////////
+#endif /* __THREAD_POOL_H__ */
+////////////////////////
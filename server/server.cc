@@ -0,0 +1,191 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file server.cc
+
+#include <server.h>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+
+static volatile std::sig_atomic_t g_stop = 0; ///< Set by Ctrl+C or a termination, the loop ends at its next pass.
+
+static void Server_Signal(int)
+{
+  g_stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+  // Command line: --port port (0 takes a free one), --scene file, --generate bodies seed (the scene without --scene,
+  // 1000 bodies of seed 1 by default), --tick rate (ticks per second), --report seconds (0 only at the end),
+  // --clients count (local viewers over the loopback), --udp (the local viewers connect over UDP), --seconds seconds
+  // (0 runs until Ctrl+C), --record file (log of the connections)
+  int port = 7777;
+  const char *scene_path = nullptr;
+  int bodies = 1000;
+  uint32_t seed = 1;
+  float report_seconds = 1.0f;
+  int client_count = 0;
+  bool udp = false;
+  float seconds = 0.0f;
+  const char *record_path = nullptr;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+      port = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+      scene_path = argv[++i];
+    else if (strcmp(argv[i], "--generate") == 0 && i + 2 < argc)
+    {
+      bodies = atoi(argv[++i]);
+      seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--tick") == 0 && i + 1 < argc)
+      Replication_Server::settings_.tick_rate = std::max((float)atof(argv[++i]), 1.0f);
+    else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+      report_seconds = (float)atof(argv[++i]);
+    else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+      client_count = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--udp") == 0)
+      udp = true;
+    else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = (float)atof(argv[++i]);
+    else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      record_path = argv[++i];
+    else
+    {
+      std::cout << "ERROR: Unknown argument " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  // The simulation, the render only places the camera of the scene
+  Registry registry;
+  Vec3 light;
+  Render camera;
+  Scene scene;
+  if (scene_path != nullptr)
+  {
+    if (Scene_Load(scene_path, scene) != 0)
+      return 1;
+  }
+  else
+    Scene_Generate(scene, bodies, seed, {k_ViewWin.x / 2, k_ViewWin.y / 2, 0.0f});
+  Scene_Instantiate(scene, registry, light, camera, k_ViewWin);
+
+  Replication_Server server;
+  if (server.open(port, registry) != 0 || (record_path != nullptr && server.server().startRecording(record_path) != 0))
+    return 1;
+  std::cout << "Hosting " << registry.count() << " objects on port " << server.server().port() << " at "
+            << Replication_Server::settings_.tick_rate << " ticks per second, TCP and UDP" << std::endl;
+
+  Server_Stand_Ins stand_ins;
+  if (Server_Connect(stand_ins, client_count, server.server().port(), udp) != 0)
+    return 1;
+
+  signal(SIGINT, Server_Signal);
+  signal(SIGTERM, Server_Signal);
+
+  // The ticks are timers of the event loop; the stand-ins are read between its passes, as a viewer would
+  Server_Report report = {};
+  double next_report = report_seconds;
+  while (g_stop == 0 && (seconds <= 0.0f || server.server().time() < seconds))
+  {
+    if (server.server().poll(client_count > 0 ? 5 : 100) < 0)
+      break;
+    int connected = client_count > 0 ? Server_Update(stand_ins) : 0;
+    if (connected < client_count)
+    {
+      std::cout << "ERROR: A local client lost its connection" << std::endl;
+      client_count = connected;
+    }
+    if (report_seconds > 0.0f && server.server().time() >= next_report)
+    {
+      Server_Print(server, report);
+      next_report += report_seconds;
+    }
+  }
+  if (server.stats().ticks != report.stats.ticks)
+    Server_Print(server, report);
+
+  long long snapshots = 0;
+  long long bytes = 0;
+  for (const std::unique_ptr<Replication_Client> &client : stand_ins.clients)
+  {
+    if (client)
+    {
+      snapshots += client->stats().snapshots;
+      bytes += client->stats().bytes;
+    }
+  }
+  if (!stand_ins.clients.empty())
+    printf("Local clients: %d of %d connected, %lld snapshots and %.1f KB received\n", client_count,
+           (int)stand_ins.clients.size(), snapshots, bytes / 1024.0);
+
+  server.close();
+  return client_count == (int)stand_ins.clients.size() ? 0 : 1;
+}
+
+int Server_Connect(Server_Stand_Ins &stand_ins, int count, int port, bool udp)
+{
+  // A viewer never simulates, the server decides where the entities are and which ones merge
+  for (int i = 0; i < count; i++)
+  {
+    stand_ins.clients.push_back(std::make_unique<Replication_Client>());
+    stand_ins.registries.push_back(std::make_unique<Registry>());
+    if (stand_ins.clients.back()->connect("127.0.0.1", port, udp) != 0)
+    {
+      std::cout << "ERROR: Local client " << i << " can't connect" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int Server_Update(Server_Stand_Ins &stand_ins)
+{
+  int connected = 0;
+  for (int i = 0; i < (int)stand_ins.clients.size(); i++)
+  {
+    if (!stand_ins.clients[i])
+      continue;
+    if (stand_ins.clients[i]->update(*stand_ins.registries[i]) < 0)
+    {
+      stand_ins.clients[i] = nullptr;
+      continue;
+    }
+    connected++;
+  }
+  return connected;
+}
+
+void Server_Print(Replication_Server &server, Server_Report &report)
+{
+  const Replication_Stats &stats = server.stats();
+  double now = server.server().time();
+  double elapsed = std::max(now - report.time, 0.001);
+  long long ticks = stats.ticks - report.stats.ticks;
+  double tick_ms = ticks > 0 ? (stats.tickTime - report.stats.tickTime) * 1000.0 / ticks : 0.0;
+  double simulation_ms = ticks > 0 ? (stats.simulation - report.stats.simulation) * 1000.0 / ticks : 0.0;
+  printf("%8.1f s | %5.1f ticks/s | Tick %7.3f ms (simulation %7.3f ms) | Peak %7.3f ms | Overruns %lld | Snapshots %lld\n",
+         now, ticks / elapsed, tick_ms, simulation_ms, stats.peakTick, stats.overruns - report.stats.overruns,
+         stats.snapshots - report.stats.snapshots);
+
+  // A slot reused by a new client starts its counters again
+  double total = 0.0;
+  int clients = 0;
+  server.peers([&](bool udp, int client, const Replication_Peer &peer)
+               {
+                 std::vector<long long> &previous = udp ? report.udp : report.tcp;
+                 if (client >= (int)previous.size())
+                   previous.resize(client + 1, 0);
+                 long long sent = peer.bytes >= previous[client] ? peer.bytes - previous[client] : peer.bytes;
+                 previous[client] = peer.bytes;
+                 total += sent / elapsed;
+                 clients++;
+                 printf("           %s %5d | %10.1f KB/s | %10lld snapshots | acked %u%s\n", udp ? "UDP" : "TCP", client,
+                        sent / elapsed / 1024.0, peer.snapshots, peer.acked, peer.viewing ? " | viewing" : ""); });
+  printf("           %d clients | %10.1f KB/s\n", clients, total / 1024.0);
+
+  report.time = now;
+  report.stats = stats;
+}
@@ -0,0 +1,926 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <bvh.h>
+#include <common_defs.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+Bvh_Settings Bvh::settings_ = {0.5f, 4.0f, 2.0f, true};
+
+// Surface of a box, the cost of visiting it
+static float Area(const Bvh_Box &box)
+{
+  float dx = box.max[0] - box.min[0];
+  float dy = box.max[1] - box.min[1];
+  float dz = box.max[2] - box.min[2];
+  return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static Bvh_Box Union(const Bvh_Box &a, const Bvh_Box &b)
+{
+  Bvh_Box box;
+  for (int i = 0; i < 3; i++)
+  {
+    box.min[i] = std::min(a.min[i], b.min[i]);
+    box.max[i] = std::max(a.max[i], b.max[i]);
+  }
+  return box;
+}
+
+// Squared distance from a point to a box, 0 inside
+static float Box_Distance2(const Bvh_Box &box, const float *point)
+{
+  float d2 = 0.0f;
+  for (int i = 0; i < 3; i++)
+  {
+    float d = std::max(std::max(box.min[i] - point[i], point[i] - box.max[i]), 0.0f);
+    d2 += d * d;
+  }
+  return d2;
+}
+
+// Distance along a ray to the entry of a box, -1 if it misses it before max_distance
+static float Ray_Box(const Bvh_Box &box, const float *origin, const float *inverse, float max_distance)
+{
+  float enter = 0.0f;
+  float exit = max_distance;
+  for (int i = 0; i < 3; i++)
+  {
+    float t0 = (box.min[i] - origin[i]) * inverse[i];
+    float t1 = (box.max[i] - origin[i]) * inverse[i];
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+  }
+  return enter <= exit ? enter : -1.0f;
+}
+
+Bvh::Bvh()
+{
+  nodes_ = nullptr;
+  nNodes_ = 0;
+  capNodes_ = 0;
+  freeNode_ = BVH_NULL;
+  proxies_ = nullptr;
+  nProxies_ = 0;
+  capProxies_ = 0;
+  freeProxy_ = BVH_NULL;
+  root_ = BVH_NULL;
+  ordered_ = true;
+  count_ = 0;
+  nEscaped_ = 0;
+  rebuilds_ = 0;
+  cost_ = 0.0f;
+  stack_ = nullptr;
+}
+
+int Bvh::allocate()
+{
+  int node;
+  if (freeNode_ != BVH_NULL)
+  {
+    node = freeNode_;
+    freeNode_ = nodes_[node].parent;
+  }
+  else
+  {
+    // The stack can hold every node, the refit uses it as queue
+    if (nNodes_ == capNodes_)
+    {
+      capNodes_ = std::max(64, capNodes_ * 2);
+      nodes_ = (Bvh_Node *)realloc(nodes_, capNodes_ * sizeof(Bvh_Node));
+      stack_ = (int *)realloc(stack_, capNodes_ * sizeof(int));
+    }
+    node = nNodes_++;
+  }
+
+  nodes_[node].parent = BVH_NULL;
+  nodes_[node].left = BVH_NULL;
+  nodes_[node].right = BVH_NULL;
+  nodes_[node].height = 0;
+
+  return node;
+}
+
+void Bvh::release(int node)
+{
+  nodes_[node].parent = freeNode_;
+  nodes_[node].height = -1;
+  freeNode_ = node;
+}
+
+void Bvh::fatten(int proxy, Vec3 displacement)
+{
+  Bvh_Proxy &p = proxies_[proxy];
+  float margin = p.radius * (1.0f + settings_.margin);
+  float ahead[3] = {displacement.x * settings_.prediction, displacement.y * settings_.prediction, displacement.z * settings_.prediction};
+  for (int i = 0; i < 3; i++)
+  {
+    p.box.min[i] = p.center[i] - margin + std::min(ahead[i], 0.0f);
+    p.box.max[i] = p.center[i] + margin + std::max(ahead[i], 0.0f);
+  }
+  nodes_[p.node].box = p.box;
+}
+
+int Bvh::insert(Vec3 center, float radius, int item)
+{
+  int proxy;
+  if (freeProxy_ != BVH_NULL)
+  {
+    proxy = freeProxy_;
+    freeProxy_ = proxies_[proxy].item;
+  }
+  else
+  {
+    if (nProxies_ == capProxies_)
+    {
+      capProxies_ = std::max(64, capProxies_ * 2);
+      proxies_ = (Bvh_Proxy *)realloc(proxies_, capProxies_ * sizeof(Bvh_Proxy));
+    }
+    proxy = nProxies_++;
+  }
+
+  int leaf = allocate();
+  nodes_[leaf].right = proxy;
+  Bvh_Proxy &p = proxies_[proxy];
+  p.center[0] = center.x;
+  p.center[1] = center.y;
+  p.center[2] = center.z;
+  p.radius = radius;
+  p.item = item;
+  p.node = leaf;
+  p.escaped = false;
+  fatten(proxy, {0.0f, 0.0f, 0.0f});
+  insertLeaf(leaf);
+  count_++;
+
+  return proxy;
+}
+
+void Bvh::remove(int proxy)
+{
+  int leaf = proxies_[proxy].node;
+  removeLeaf(leaf);
+  release(leaf);
+
+  proxies_[proxy].node = BVH_NULL;
+  proxies_[proxy].escaped = false;
+  proxies_[proxy].item = freeProxy_;
+  freeProxy_ = proxy;
+  count_--;
+}
+
+bool Bvh::move(int proxy, Vec3 center, float radius, Vec3 displacement)
+{
+  Bvh_Proxy &p = proxies_[proxy];
+  p.center[0] = center.x;
+  p.center[1] = center.y;
+  p.center[2] = center.z;
+  p.radius = radius;
+
+  // Still inside its box, the tree doesn't change
+  if (center.x - radius >= p.box.min[0] && center.y - radius >= p.box.min[1] && center.z - radius >= p.box.min[2] &&
+      center.x + radius <= p.box.max[0] && center.y + radius <= p.box.max[1] && center.z + radius <= p.box.max[2])
+    return false;
+
+  // The box grows in the direction the item moves, it stays inside for more frames
+  fatten(proxy, displacement);
+  if (!p.escaped)
+  {
+    p.escaped = true;
+    escaped_.push_back(proxy);
+  }
+  nEscaped_++;
+
+  return true;
+}
+
+void Bvh::update()
+{
+  if (escaped_.empty())
+    return;
+
+  // A few leaves are reinserted, many are cheaper to refit all at once
+  if ((int)escaped_.size() * BVH_REFIT_RATIO < count_)
+  {
+    for (int proxy : escaped_)
+    {
+      // Removed after escaping
+      if (!proxies_[proxy].escaped)
+        continue;
+      proxies_[proxy].escaped = false;
+      removeLeaf(proxies_[proxy].node);
+      insertLeaf(proxies_[proxy].node);
+    }
+  }
+  else
+  {
+    for (int proxy : escaped_)
+      proxies_[proxy].escaped = false;
+    if (refitAll() > cost_ * settings_.rebuild)
+      rebuild();
+  }
+  escaped_.clear();
+}
+
+void Bvh::clear()
+{
+  nNodes_ = 0;
+  freeNode_ = BVH_NULL;
+  nProxies_ = 0;
+  freeProxy_ = BVH_NULL;
+  root_ = BVH_NULL;
+  ordered_ = true;
+  count_ = 0;
+  cost_ = 0.0f;
+  escaped_.clear();
+}
+
+void Bvh::insertLeaf(int leaf)
+{
+  ordered_ = false;
+  if (root_ == BVH_NULL)
+  {
+    root_ = leaf;
+    nodes_[leaf].parent = BVH_NULL;
+    return;
+  }
+
+  // Descends to the sibling that makes the tree grow the least
+  Bvh_Box box = nodes_[leaf].box;
+  int index = root_;
+  while (nodes_[index].left != BVH_NULL)
+  {
+    const Bvh_Node &node = nodes_[index];
+    float combined = Area(Union(box, node.box));
+
+    // A new parent here costs the combined box, going down the ancestors grow anyway
+    float cost = 2.0f * combined;
+    float inheritance = 2.0f * (combined - Area(node.box));
+
+    auto descend = [&](int child)
+    {
+      float grown = Area(Union(box, nodes_[child].box));
+      if (nodes_[child].left == BVH_NULL)
+        return grown + inheritance;
+      return grown - Area(nodes_[child].box) + inheritance;
+    };
+    float cost_left = descend(node.left);
+    float cost_right = descend(node.right);
+
+    if (cost < cost_left && cost < cost_right)
+      break;
+    index = cost_left < cost_right ? node.left : node.right;
+  }
+
+  // A new parent for the sibling and the leaf
+  int sibling = index;
+  int old_parent = nodes_[sibling].parent;
+  int parent = allocate();
+  nodes_[parent].parent = old_parent;
+  nodes_[parent].box = Union(box, nodes_[sibling].box);
+  nodes_[parent].height = nodes_[sibling].height + 1;
+  nodes_[parent].left = sibling;
+  nodes_[parent].right = leaf;
+  nodes_[sibling].parent = parent;
+  nodes_[leaf].parent = parent;
+
+  if (old_parent == BVH_NULL)
+    root_ = parent;
+  else if (nodes_[old_parent].left == sibling)
+    nodes_[old_parent].left = parent;
+  else
+    nodes_[old_parent].right = parent;
+
+  refit(nodes_[leaf].parent);
+}
+
+void Bvh::removeLeaf(int leaf)
+{
+  ordered_ = false;
+  if (leaf == root_)
+  {
+    root_ = BVH_NULL;
+    return;
+  }
+
+  // The sibling takes the place of the parent
+  int parent = nodes_[leaf].parent;
+  int grand = nodes_[parent].parent;
+  int sibling = nodes_[parent].left == leaf ? nodes_[parent].right : nodes_[parent].left;
+  release(parent);
+
+  if (grand == BVH_NULL)
+  {
+    root_ = sibling;
+    nodes_[sibling].parent = BVH_NULL;
+    return;
+  }
+
+  if (nodes_[grand].left == parent)
+    nodes_[grand].left = sibling;
+  else
+    nodes_[grand].right = sibling;
+  nodes_[sibling].parent = grand;
+  refit(grand);
+}
+
+void Bvh::refit(int node)
+{
+  while (node != BVH_NULL)
+  {
+    node = balance(node);
+
+    Bvh_Node &n = nodes_[node];
+    n.height = 1 + std::max(nodes_[n.left].height, nodes_[n.right].height);
+    n.box = Union(nodes_[n.left].box, nodes_[n.right].box);
+
+    node = n.parent;
+  }
+}
+
+float Bvh::refitAll()
+{
+  if (root_ == BVH_NULL)
+    return 0.0f;
+
+  float cost = 0.0f;
+
+  // Built in depth first order the children are after their parent, the arena is read backwards
+  if (ordered_)
+  {
+    for (int i = nNodes_ - 1; i >= 0; i--)
+    {
+      Bvh_Node &node = nodes_[i];
+      if (node.height > 0)
+      {
+        node.box = Union(nodes_[node.left].box, nodes_[node.right].box);
+        cost += Area(node.box);
+      }
+    }
+    return cost;
+  }
+
+  // Breadth first the parents come before their children, backwards they are refitted after them
+  int n = 0;
+  stack_[n++] = root_;
+  for (int i = 0; i < n; i++)
+  {
+    const Bvh_Node &node = nodes_[stack_[i]];
+    if (node.left != BVH_NULL)
+    {
+      stack_[n++] = node.left;
+      stack_[n++] = node.right;
+    }
+  }
+  for (int i = n - 1; i >= 0; i--)
+  {
+    Bvh_Node &node = nodes_[stack_[i]];
+    if (node.left != BVH_NULL)
+    {
+      node.box = Union(nodes_[node.left].box, nodes_[node.right].box);
+      cost += Area(node.box);
+    }
+  }
+
+  return cost;
+}
+
+void Bvh::rebuild()
+{
+  if (root_ == BVH_NULL)
+    return;
+
+  // The arena is written again from the start with the leaves of every proxy
+  Bvh_Build *leaves = (Bvh_Build *)calloc(count_, sizeof(Bvh_Build));
+  int nLeaves = 0;
+  for (int i = 0; i < nProxies_; i++)
+  {
+    const Bvh_Proxy &p = proxies_[i];
+    if (p.node != BVH_NULL)
+      leaves[nLeaves++] = {{p.center[0], p.center[1], p.center[2]}, i};
+  }
+
+  nNodes_ = 0;
+  freeNode_ = BVH_NULL;
+  root_ = build(leaves, nLeaves, BVH_NULL);
+  ordered_ = true;
+  DESTROY(leaves);
+
+  cost_ = 0.0f;
+  for (int i = 0; i < nNodes_; i++)
+  {
+    if (nodes_[i].height > 0)
+      cost_ += Area(nodes_[i].box);
+  }
+  rebuilds_++;
+}
+
+int Bvh::build(Bvh_Build *leaves, int count, int parent)
+{
+  // The parent is allocated before its children
+  int node = allocate();
+  nodes_[node].parent = parent;
+  if (count == 1)
+  {
+    Bvh_Proxy &p = proxies_[leaves[0].proxy];
+    nodes_[node].right = leaves[0].proxy;
+    nodes_[node].box = p.box;
+    p.node = node;
+    return node;
+  }
+
+  // Split at the median of the longest axis of the centers
+  float low[3] = {leaves[0].center[0], leaves[0].center[1], leaves[0].center[2]};
+  float high[3] = {low[0], low[1], low[2]};
+  for (int i = 1; i < count; i++)
+  {
+    for (int a = 0; a < 3; a++)
+    {
+      low[a] = std::min(low[a], leaves[i].center[a]);
+      high[a] = std::max(high[a], leaves[i].center[a]);
+    }
+  }
+  int axis = 0;
+  for (int a = 1; a < 3; a++)
+  {
+    if (high[a] - low[a] > high[axis] - low[axis])
+      axis = a;
+  }
+  int half = count / 2;
+  std::nth_element(leaves, leaves + half, leaves + count, [axis](const Bvh_Build &a, const Bvh_Build &b)
+                   { return a.center[axis] < b.center[axis]; });
+
+  int left = build(leaves, half, node);
+  int right = build(leaves + half, count - half, node);
+  Bvh_Node &n = nodes_[node];
+  n.left = left;
+  n.right = right;
+  n.box = Union(nodes_[left].box, nodes_[right].box);
+  n.height = 1 + std::max(nodes_[left].height, nodes_[right].height);
+
+  return node;
+}
+
+int Bvh::balance(int a)
+{
+  Bvh_Node &A = nodes_[a];
+  if (A.left == BVH_NULL || A.height < 2)
+    return a;
+
+  int b = A.left;
+  int c = A.right;
+  int difference = nodes_[c].height - nodes_[b].height;
+  if (difference <= 1 && difference >= -1)
+    return a;
+
+  // The taller child goes up and A takes the shorter of its children
+  int up = difference > 1 ? c : b;
+  int other = difference > 1 ? b : c;
+  Bvh_Node &U = nodes_[up];
+  Bvh_Node &O = nodes_[other];
+  int f = U.left;
+  int g = U.right;
+  int keep = nodes_[f].height > nodes_[g].height ? f : g;
+  int give = keep == f ? g : f;
+
+  U.left = a;
+  U.parent = A.parent;
+  A.parent = up;
+  if (U.parent == BVH_NULL)
+    root_ = up;
+  else if (nodes_[U.parent].left == a)
+    nodes_[U.parent].left = up;
+  else
+    nodes_[U.parent].right = up;
+
+  U.right = keep;
+  if (up == c)
+    A.right = give;
+  else
+    A.left = give;
+  nodes_[give].parent = a;
+
+  A.box = Union(O.box, nodes_[give].box);
+  A.height = 1 + std::max(O.height, nodes_[give].height);
+  U.box = Union(A.box, nodes_[keep].box);
+  U.height = 1 + std::max(A.height, nodes_[keep].height);
+
+  return up;
+}
+
+int Bvh::raycast(Vec3 origin, Vec3 direction, float &distance)
+{
+  if (root_ == BVH_NULL)
+    return BVH_NULL;
+
+  // Divisions by 0 give infinities, the slabs parallel to the ray are handled by the comparisons
+  float from[3] = {origin.x, origin.y, origin.z};
+  float dir[3] = {direction.x, direction.y, direction.z};
+  float inverse[3] = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+  int hit = BVH_NULL;
+  float best = distance;
+
+  int top = 0;
+  stack_[top++] = root_;
+  while (top > 0)
+  {
+    const Bvh_Node &node = nodes_[stack_[--top]];
+    if (Ray_Box(node.box, from, inverse, best) < 0.0f)
+      continue;
+
+    if (node.left == BVH_NULL)
+    {
+      // The first intersection with the sphere, or the exit if the ray starts inside
+      const Bvh_Proxy &p = proxies_[node.right];
+      float to_center[3] = {p.center[0] - from[0], p.center[1] - from[1], p.center[2] - from[2]};
+      float along = to_center[0] * dir[0] + to_center[1] * dir[1] + to_center[2] * dir[2];
+      float off2 = to_center[0] * to_center[0] + to_center[1] * to_center[1] + to_center[2] * to_center[2] - along * along;
+      float r2 = p.radius * p.radius;
+      if (off2 > r2)
+        continue;
+      float half = sqrtf(r2 - off2);
+      float t = along - half >= 0.0f ? along - half : along + half;
+      if (t >= 0.0f && t < best)
+      {
+        best = t;
+        hit = p.item;
+      }
+      continue;
+    }
+
+    // The nearest child is visited first, it shortens the ray for the other one
+    float t_left = Ray_Box(nodes_[node.left].box, from, inverse, best);
+    float t_right = Ray_Box(nodes_[node.right].box, from, inverse, best);
+    if (t_left >= 0.0f && t_right >= 0.0f)
+    {
+      stack_[top++] = t_left < t_right ? node.right : node.left;
+      stack_[top++] = t_left < t_right ? node.left : node.right;
+    }
+    else if (t_left >= 0.0f)
+      stack_[top++] = node.left;
+    else if (t_right >= 0.0f)
+      stack_[top++] = node.right;
+  }
+
+  distance = best;
+  return hit;
+}
+
+int Bvh::overlap(Vec3 center, float radius, int *items, int max)
+{
+  if (root_ == BVH_NULL)
+    return 0;
+
+  float point[3] = {center.x, center.y, center.z};
+  int found = 0;
+  int top = 0;
+  stack_[top++] = root_;
+  while (top > 0)
+  {
+    const Bvh_Node &node = nodes_[stack_[--top]];
+    if (Box_Distance2(node.box, point) > radius * radius)
+      continue;
+
+    if (node.left == BVH_NULL)
+    {
+      const Bvh_Proxy &p = proxies_[node.right];
+      float dx = p.center[0] - point[0], dy = p.center[1] - point[1], dz = p.center[2] - point[2];
+      float reach = radius + p.radius;
+      if (dx * dx + dy * dy + dz * dz <= reach * reach)
+      {
+        if (found < max)
+          items[found] = p.item;
+        found++;
+      }
+      continue;
+    }
+    stack_[top++] = node.left;
+    stack_[top++] = node.right;
+  }
+
+  return found;
+}
+
+int Bvh::nearest(Vec3 point, int k, int *items, float *distances)
+{
+  if (root_ == BVH_NULL || k <= 0)
+    return 0;
+
+  // The best k are kept sorted in items, with their squared distances
+  float from[3] = {point.x, point.y, point.z};
+  best_.resize(k);
+  int found = 0;
+
+  auto closer = [](const std::pair<float, int> &a, const std::pair<float, int> &b)
+  {
+    return a.first > b.first;
+  };
+  heap_.clear();
+  heap_.push_back({Box_Distance2(nodes_[root_].box, from), root_});
+  while (!heap_.empty())
+  {
+    std::pop_heap(heap_.begin(), heap_.end(), closer);
+    std::pair<float, int> next = heap_.back();
+    heap_.pop_back();
+
+    // Every node left is farther than the kth item
+    if (found == k && next.first >= best_[k - 1])
+      break;
+
+    const Bvh_Node &node = nodes_[next.second];
+    if (node.left == BVH_NULL)
+    {
+      const Bvh_Proxy &p = proxies_[node.right];
+      float dx = p.center[0] - from[0], dy = p.center[1] - from[1], dz = p.center[2] - from[2];
+      float d2 = dx * dx + dy * dy + dz * dz;
+      if (found == k && d2 >= best_[k - 1])
+        continue;
+
+      int i = found < k ? found++ : k - 1;
+      while (i > 0 && best_[i - 1] > d2)
+      {
+        best_[i] = best_[i - 1];
+        items[i] = items[i - 1];
+        i--;
+      }
+      best_[i] = d2;
+      items[i] = p.item;
+      continue;
+    }
+
+    heap_.push_back({Box_Distance2(nodes_[node.left].box, from), node.left});
+    std::push_heap(heap_.begin(), heap_.end(), closer);
+    heap_.push_back({Box_Distance2(nodes_[node.right].box, from), node.right});
+    std::push_heap(heap_.begin(), heap_.end(), closer);
+  }
+
+  if (distances != nullptr)
+  {
+    for (int i = 0; i < found; i++)
+      distances[i] = sqrtf(best_[i]);
+  }
+
+  return found;
+}
+
+int Bvh::frustum(const Vec3 *points, const Vec3 *normals, int planes, int *items)
+{
+  if (root_ == BVH_NULL)
+    return 0;
+
+  int found = 0;
+  int top = 0;
+  stack_[top++] = root_;
+  while (top > 0)
+  {
+    int index = stack_[--top];
+    const Bvh_Node &node = nodes_[index];
+
+    if (node.left == BVH_NULL)
+    {
+      const Bvh_Proxy &p = proxies_[node.right];
+      bool inside = true;
+      for (int i = 0; i < planes && inside; i++)
+      {
+        const Vec3 &c = points[i];
+        const Vec3 &n = normals[i];
+        inside = (p.center[0] - c.x) * n.x + (p.center[1] - c.y) * n.y + (p.center[2] - c.z) * n.z >= -p.radius;
+      }
+      if (inside)
+        items[found++] = p.item;
+      continue;
+    }
+
+    // The corner of the box farthest inside each plane decides if it is out, the nearest if it is all in
+    const Bvh_Box &b = node.box;
+    bool out = false;
+    bool all_in = true;
+    for (int i = 0; i < planes && !out; i++)
+    {
+      const Vec3 &c = points[i];
+      const Vec3 &n = normals[i];
+      float far_side = ((n.x >= 0.0f ? b.max[0] : b.min[0]) - c.x) * n.x + ((n.y >= 0.0f ? b.max[1] : b.min[1]) - c.y) * n.y +
+                       ((n.z >= 0.0f ? b.max[2] : b.min[2]) - c.z) * n.z;
+      float near_side = ((n.x >= 0.0f ? b.min[0] : b.max[0]) - c.x) * n.x + ((n.y >= 0.0f ? b.min[1] : b.max[1]) - c.y) * n.y +
+                        ((n.z >= 0.0f ? b.min[2] : b.max[2]) - c.z) * n.z;
+      out = far_side < 0.0f;
+      all_in = all_in && near_side >= 0.0f;
+    }
+    if (out)
+      continue;
+
+    if (!all_in)
+    {
+      stack_[top++] = node.left;
+      stack_[top++] = node.right;
+      continue;
+    }
+
+    // Every leaf of the subtree, without testing them
+    int bottom = top;
+    stack_[top++] = index;
+    while (top > bottom)
+    {
+      const Bvh_Node &inner = nodes_[stack_[--top]];
+      if (inner.left == BVH_NULL)
+        items[found++] = proxies_[inner.right].item;
+      else
+      {
+        stack_[top++] = inner.left;
+        stack_[top++] = inner.right;
+      }
+    }
+  }
+
+  return found;
+}
+
+int Bvh::count()
+{
+  return count_;
+}
+
+int Bvh::height()
+{
+  return root_ != BVH_NULL ? nodes_[root_].height : 0;
+}
+
+int Bvh::escaped()
+{
+  int ret = nEscaped_;
+  nEscaped_ = 0;
+  return ret;
+}
+
+int Bvh::rebuilds()
+{
+  return rebuilds_;
+}
+
+Bvh::~Bvh()
+{
+  DESTROY(nodes_);
+  DESTROY(proxies_);
+  DESTROY(stack_);
+}
+
+int Bvh_Benchmark(int items, int frames)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  const int sizes[] = {1000, 10000, 100000};
+  const int nSizes = items > 0 ? 1 : 3;
+  const int queries = 100;
+  int ret = 0;
+
+  printf("Items   Insert ms  Move ms   Escaped  Rebuilds  Height  Ray us   Radius us  kNN us   Frustum ms  Visible\n");
+  for (int s = 0; s < nSizes && ret == 0; s++)
+  {
+    int n = items > 0 ? items : sizes[s];
+
+    uint32_t state = 0x2545F491u;
+    auto random = [&state]()
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return (state & 0xFFFFFF) / (float)0x1000000;
+    };
+
+    // Items in a disc orbiting its center, like the ones of Scene_Generate
+    Vec3 *centers = (Vec3 *)calloc(n, sizeof(Vec3));
+    float *radii = (float *)calloc(n, sizeof(float));
+    float *cosines = (float *)calloc(n, sizeof(float));
+    float *sines = (float *)calloc(n, sizeof(float));
+    int *proxies = (int *)calloc(n, sizeof(int));
+    int *found = (int *)calloc(n, sizeof(int));
+    float max_distance = 50.0f + 3.0f * sqrtf((float)n);
+    for (int i = 0; i < n; i++)
+    {
+      float distance = 40.0f + (max_distance - 40.0f) * random();
+      float angle = 6.2831853f * random();
+      centers[i] = {distance * cosf(angle), distance * sinf(angle), 0.4f * distance * (random() - 0.5f)};
+      radii[i] = 1.0f + 4.0f * random();
+      float speed = 0.0035f + 0.007f * random();
+      cosines[i] = cosf(speed);
+      sines[i] = sinf(speed);
+    }
+
+    Bvh bvh;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+      proxies[i] = bvh.insert(centers[i], radii[i], i);
+    double build_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+    double move_ms = 0.0;
+    int escaped = 0;
+    bvh.escaped();
+    for (int f = 0; f < frames; f++)
+    {
+      start = std::chrono::steady_clock::now();
+      for (int i = 0; i < n; i++)
+      {
+        Vec3 old = centers[i];
+        centers[i] = {old.x * cosines[i] - old.y * sines[i], old.x * sines[i] + old.y * cosines[i], old.z};
+        bvh.move(proxies[i], centers[i], radii[i], centers[i] - old);
+      }
+      bvh.update();
+      move_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+      escaped += bvh.escaped();
+    }
+
+    // Queries compared with brute force
+    double ray_us = 0.0, radius_us = 0.0, knn_us = 0.0;
+    for (int q = 0; q < queries && ret == 0; q++)
+    {
+      Vec3 target = centers[(int)(random() * (n - 1))];
+      Vec3 origin = {target.x + 10.0f * (random() - 0.5f), target.y + 10.0f * (random() - 0.5f), 500.0f};
+      Vec3 direction = target - origin;
+      direction = direction / direction.Magnitude();
+
+      float distance = 10000.0f;
+      start = std::chrono::steady_clock::now();
+      int hit = bvh.raycast(origin, direction, distance);
+      ray_us += Milliseconds(std::chrono::steady_clock::now() - start).count() * 1000.0;
+
+      float brute_distance = 10000.0f;
+      for (int i = 0; i < n; i++)
+      {
+        Vec3 to_center = centers[i] - origin;
+        float along = Vec3::DotProduct(to_center, direction);
+        float off2 = Vec3::DotProduct(to_center, to_center) - along * along;
+        if (off2 <= radii[i] * radii[i] && along - sqrtf(radii[i] * radii[i] - off2) >= 0.0f)
+          brute_distance = std::min(brute_distance, along - sqrtf(radii[i] * radii[i] - off2));
+      }
+      if ((hit == BVH_NULL) != (brute_distance == 10000.0f) || fabsf(distance - brute_distance) > 1e-2f)
+      {
+        printf("ERROR: Ray hits %d at %f, brute force at %f\n", hit, distance, brute_distance);
+        ret = 1;
+      }
+
+      float radius = 20.0f;
+      start = std::chrono::steady_clock::now();
+      int inside = bvh.overlap(target, radius, found, n);
+      radius_us += Milliseconds(std::chrono::steady_clock::now() - start).count() * 1000.0;
+      int brute_inside = 0;
+      for (int i = 0; i < n; i++)
+        brute_inside += (centers[i] - target).Magnitude() <= radius + radii[i];
+      if (inside != brute_inside)
+      {
+        printf("ERROR: Radius query finds %d items, brute force %d\n", inside, brute_inside);
+        ret = 1;
+      }
+
+      const int k = 8;
+      float distances[k];
+      start = std::chrono::steady_clock::now();
+      int near = bvh.nearest(origin, k, found, distances);
+      knn_us += Milliseconds(std::chrono::steady_clock::now() - start).count() * 1000.0;
+      int closer = 0;
+      for (int i = 0; i < n; i++)
+        closer += (centers[i] - origin).Magnitude() < distances[near - 1] - 1e-3f;
+      if (near != std::min(k, n) || closer > near - 1)
+      {
+        printf("ERROR: kNN finds %d items, %d are closer than the last one\n", near, closer);
+        ret = 1;
+      }
+    }
+
+    // A box of planes around a quarter of the disc
+    Vec3 points[6] = {{0, 0, 0}, {max_distance, 0, 0}, {0, 0, 0}, {0, max_distance, 0}, {0, 0, -100}, {0, 0, 100}};
+    Vec3 normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    start = std::chrono::steady_clock::now();
+    int visible = bvh.frustum(points, normals, 6, found);
+    double frustum_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    int brute_visible = 0;
+    for (int i = 0; i < n; i++)
+    {
+      bool in = true;
+      for (int p = 0; p < 6; p++)
+        in = in && Vec3::DotProduct(centers[i] - points[p], normals[p]) >= -radii[i];
+      brute_visible += in;
+    }
+    if (visible != brute_visible)
+    {
+      printf("ERROR: Frustum finds %d items, brute force %d\n", visible, brute_visible);
+      ret = 1;
+    }
+
+    frames = std::max(frames, 1);
+    printf("%-7d %-10.3f %-9.3f %-8d %-9d %-7d %-8.2f %-10.2f %-8.2f %-11.3f %d\n", n, build_ms, move_ms / frames, escaped / frames,
+           bvh.rebuilds(), bvh.height(), ray_us / queries, radius_us / queries, knn_us / queries, frustum_ms, visible);
+
+    DESTROY(centers);
+    DESTROY(radii);
+    DESTROY(cosines);
+    DESTROY(sines);
+    DESTROY(proxies);
+    DESTROY(found);
+  }
+
+  return ret;
+}
@@ -0,0 +1,357 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <collision.h>
+#include <common_defs.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+Collision_Settings Collider::settings_ = {true, 4.0f, 4096};
+
+// The cell of a coordinate, rounded down without calling floorf
+static int Cell(float value, float size)
+{
+  float cell = value / size;
+  int truncated = (int)cell;
+  return truncated - (cell < truncated);
+}
+
+// The bucket of a cell, the hash of its row plus x, so the cells of a row are consecutive in memory
+static int Bucket(int x, int y, int z, int buckets)
+{
+  return (int)(((uint32_t)y * 0x9E3779B1u + (uint32_t)z * 0x85EBCA77u + (uint32_t)x) & (uint32_t)(buckets - 1));
+}
+
+Collider::Collider()
+{
+  buckets_ = nullptr;
+  sorted_ = nullptr;
+  starts_ = nullptr;
+  nBuckets_ = 0;
+  capacity_ = 0;
+  nSorted_ = 0;
+  nBig_ = 0;
+  size_ = 1.0f;
+  checks_ = 0;
+}
+
+int Collider::detect(const Vec3 *positions, const float *radii, const bool *solid, int count)
+{
+  pairs_.clear();
+  checks_ = 0;
+  if (count < 2)
+    return 0;
+
+  if (count > capacity_)
+  {
+    capacity_ = std::max(count, capacity_ * 2);
+    nBuckets_ = 1;
+    while (nBuckets_ < 2 * capacity_)
+      nBuckets_ *= 2;
+    buckets_ = (int *)realloc(buckets_, capacity_ * sizeof(int));
+    sorted_ = (int *)realloc(sorted_, capacity_ * sizeof(int));
+    starts_ = (int *)realloc(starts_, (nBuckets_ + 1) * sizeof(int));
+  }
+
+  // The cells follow the mean radius, the bodies with a diameter bigger than a cell are tested apart
+  double sum = 0.0;
+  int nSolid = 0;
+  for (int i = 0; i < count; i++)
+  {
+    if (solid[i])
+    {
+      sum += radii[i];
+      nSolid++;
+    }
+  }
+  if (nSolid < 2)
+    return 0;
+  size_ = std::max((float)(sum / nSolid) * settings_.cell, 0.001f);
+
+  // Counting sort of the bodies by bucket
+  memset(starts_, 0, (nBuckets_ + 1) * sizeof(int));
+  for (int i = 0; i < count; i++)
+  {
+    if (!solid[i] || 2.0f * radii[i] > size_)
+    {
+      buckets_[i] = -1;
+      continue;
+    }
+    buckets_[i] = Bucket(Cell(positions[i].x, size_), Cell(positions[i].y, size_), Cell(positions[i].z, size_), nBuckets_);
+    starts_[buckets_[i] + 1]++;
+  }
+  for (int b = 0; b < nBuckets_; b++)
+    starts_[b + 1] += starts_[b];
+  int *next = (int *)calloc(nBuckets_, sizeof(int));
+  memcpy(next, starts_, nBuckets_ * sizeof(int));
+  nSorted_ = starts_[nBuckets_];
+  nBig_ = nSorted_;
+  for (int i = 0; i < count; i++)
+  {
+    if (buckets_[i] >= 0)
+      sorted_[next[buckets_[i]]++] = i;
+    else if (solid[i])
+      sorted_[nBig_++] = i;
+  }
+  DESTROY(next);
+  int nBig = nBig_;
+
+  // The big bodies by the start of their sphere in x, they sweep the ones that start before they end
+  std::sort(sorted_ + nSorted_, sorted_ + nBig, [positions, radii](int i, int j)
+            {
+              float si = positions[i].x - radii[i];
+              float sj = positions[j].x - radii[j];
+              return si < sj || (si == sj && i < j);
+            });
+
+  // Splits the bodies in a range per thread of the pool, every thread writes its own range
+  int numThreads = std::min((int)std::thread::hardware_concurrency(), nBig / std::max(settings_.min_parallel / 4, 1));
+  if (nBig < settings_.min_parallel)
+    numThreads = 1;
+  numThreads = std::max(numThreads, 1);
+  if ((int)ranges_.size() < numThreads)
+  {
+    ranges_.resize(numThreads);
+    rangeChecks_.resize(numThreads);
+  }
+
+  int perThread = nBig / numThreads;
+  pool_.run(numThreads, [&](int i)
+            {
+              int first = i * perThread;
+              int last = i == numThreads - 1 ? nBig : first + perThread;
+              search(first, last, positions, radii, i);
+            });
+
+  for (int i = 0; i < numThreads; i++)
+  {
+    pairs_.insert(pairs_.end(), ranges_[i].begin(), ranges_[i].end());
+    checks_ += rangeChecks_[i];
+  }
+  std::sort(pairs_.begin(), pairs_.end(), [](const Collision_Pair &p, const Collision_Pair &q)
+            { return p.a < q.a || (p.a == q.a && p.b < q.b); });
+
+  // Two rows can share buckets, their pairs are found twice
+  pairs_.erase(std::unique(pairs_.begin(), pairs_.end(), [](const Collision_Pair &p, const Collision_Pair &q)
+                           { return p.a == q.a && p.b == q.b; }),
+               pairs_.end());
+
+  return (int)pairs_.size();
+}
+
+void Collider::search(int first, int last, const Vec3 *positions, const float *radii, int range)
+{
+  std::vector<Collision_Pair> &found = ranges_[range];
+  found.clear();
+  int checks = 0;
+
+  auto test = [&](int i, int j)
+  {
+    checks++;
+    float dx = positions[j].x - positions[i].x;
+    float dy = positions[j].y - positions[i].y;
+    float dz = positions[j].z - positions[i].z;
+    float reach = radii[i] + radii[j];
+    if (dx * dx + dy * dy + dz * dz <= reach * reach)
+      found.push_back({std::min(i, j), std::max(i, j)});
+  };
+
+  // By bucket, the bodies of near cells are visited together
+  for (int k = first; k < last; k++)
+  {
+    int i = sorted_[k];
+    bool big = buckets_[i] < 0;
+
+    // The grid bodies are at most half a cell, the cells around that the sphere reaches
+    int reach = 1;
+    if (big)
+    {
+      reach = (int)std::min(ceilf((radii[i] + 0.5f * size_) / size_), 1024.0f);
+
+      float end = positions[i].x + radii[i];
+      for (int b = k + 1; b < nBig_ && positions[sorted_[b]].x - radii[sorted_[b]] <= end; b++)
+        test(i, sorted_[b]);
+
+      // Wider than the bodies of the grid, every one is tested
+      int side = 2 * reach + 1;
+      if ((int64_t)side * side * side >= nSorted_)
+      {
+        for (int b = 0; b < nSorted_; b++)
+          test(i, sorted_[b]);
+        continue;
+      }
+    }
+
+    // The rows of cells around, the cells of a row are consecutive buckets
+    int cx = Cell(positions[i].x, size_);
+    int cy = Cell(positions[i].y, size_);
+    int cz = Cell(positions[i].z, size_);
+    int cells = 2 * reach + 1;
+    auto scan = [&](int from, int to)
+    {
+      for (int s = starts_[from]; s < starts_[to]; s++)
+      {
+        // The big bodies find their pairs in the grid, the grid ones by the lower index
+        if (big || sorted_[s] > i)
+          test(i, sorted_[s]);
+      }
+    };
+    for (int z = cz - reach; z <= cz + reach; z++)
+    {
+      for (int y = cy - reach; y <= cy + reach; y++)
+      {
+        int bucket = Bucket(cx - reach, y, z, nBuckets_);
+        if (bucket + cells <= nBuckets_)
+          scan(bucket, bucket + cells);
+        else
+        {
+          scan(bucket, nBuckets_);
+          scan(0, bucket + cells - nBuckets_);
+        }
+      }
+    }
+  }
+
+  rangeChecks_[range] = checks;
+}
+
+const Collision_Pair *Collider::pairs()
+{
+  return pairs_.data();
+}
+
+int Collider::count()
+{
+  return (int)pairs_.size();
+}
+
+int Collider::checks()
+{
+  return checks_;
+}
+
+Collider::~Collider()
+{
+  DESTROY(buckets_);
+  DESTROY(sorted_);
+  DESTROY(starts_);
+}
+
+int Collision_Benchmark(int bodies, int steps)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  const int sizes[] = {1000, 10000, 100000};
+  const int nSizes = bodies > 0 ? 1 : 3;
+  const Collision_Settings saved = Collider::settings_;
+  int ret = 0;
+
+  printf("Bodies  Threads  ms/step   Checks    Pairs\n");
+  for (int s = 0; s < nSizes && ret == 0; s++)
+  {
+    int n = bodies > 0 ? bodies : sizes[s];
+
+    uint32_t state = 0x2545F491u;
+    auto random = [&state]()
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return (state & 0xFFFFFF) / (float)0x1000000;
+    };
+
+    // A disc as dense as the ones of Scene_Generate, with some big bodies, turning at different speeds
+    Vec3 *positions = (Vec3 *)calloc(n, sizeof(Vec3));
+    float *radii = (float *)calloc(n, sizeof(float));
+    float *cosines = (float *)calloc(n, sizeof(float));
+    float *sines = (float *)calloc(n, sizeof(float));
+    bool *solid = (bool *)calloc(n, sizeof(bool));
+    float max_distance = 50.0f + 3.0f * sqrtf((float)n);
+    for (int i = 0; i < n; i++)
+    {
+      float distance = 40.0f + (max_distance - 40.0f) * random();
+      float angle = 6.2831853f * random();
+      positions[i] = {distance * cosf(angle), distance * sinf(angle), 0.4f * distance * (random() - 0.5f)};
+      radii[i] = i % 50 == 0 ? 3.0f + 5.0f * random() : 0.5f + 1.5f * random();
+      float speed = 0.0035f + 0.007f * random();
+      cosines[i] = cosf(speed);
+      sines[i] = sinf(speed);
+      solid[i] = true;
+    }
+
+    // The threaded detection against one thread, the same pairs in the same order
+    for (int threaded = 0; threaded < 2 && ret == 0; threaded++)
+    {
+      Collider::settings_.min_parallel = threaded ? 2 : n + 1;
+      Collider collider;
+      Collider reference;
+      double ms = 0.0;
+      int64_t checks = 0, pairs = 0;
+      for (int step = 0; step < steps && ret == 0; step++)
+      {
+        for (int i = 0; i < n; i++)
+        {
+          Vec3 p = positions[i];
+          positions[i] = {p.x * cosines[i] - p.y * sines[i], p.x * sines[i] + p.y * cosines[i], p.z};
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int found = collider.detect(positions, radii, solid, n);
+        ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+        checks += collider.checks();
+        pairs += found;
+
+        if (threaded)
+        {
+          Collision_Settings parallel = Collider::settings_;
+          Collider::settings_.min_parallel = n + 1;
+          int expected = reference.detect(positions, radii, solid, n);
+          Collider::settings_ = parallel;
+          bool same = expected == found;
+          for (int i = 0; i < found && same; i++)
+            same = collider.pairs()[i].a == reference.pairs()[i].a && collider.pairs()[i].b == reference.pairs()[i].b;
+          if (!same)
+          {
+            printf("ERROR: %d pairs with threads, %d with one thread\n", found, expected);
+            ret = 1;
+          }
+        }
+        else if (step == steps - 1 && n <= 10000)
+        {
+          int brute = 0;
+          for (int i = 0; i < n; i++)
+          {
+            for (int j = i + 1; j < n; j++)
+            {
+              Vec3 d = positions[j] - positions[i];
+              brute += Vec3::DotProduct(d, d) <= (radii[i] + radii[j]) * (radii[i] + radii[j]);
+            }
+          }
+          if (brute != found)
+          {
+            printf("ERROR: %d pairs, brute force %d\n", found, brute);
+            ret = 1;
+          }
+        }
+      }
+
+      steps = std::max(steps, 1);
+      int threads = threaded ? std::max(std::min((int)std::thread::hardware_concurrency(), n / std::max(Collider::settings_.min_parallel / 4, 1)), 1) : 1;
+      printf("%-7d %-8d %-9.3f %-9lld %lld\n", n, threads, ms / steps, (long long)(checks / steps), (long long)(pairs / steps));
+    }
+
+    DESTROY(positions);
+    DESTROY(radii);
+    DESTROY(cosines);
+    DESTROY(sines);
+    DESTROY(solid);
+  }
+  Collider::settings_ = saved;
+
+  return ret;
+}
@@ -4,6 +4,9 @@
 
 void Cube::obtainCube()
 {
+  // An initialized cube releases its previous buffers
+  release();
+
   vertex_ = 8;
 
   points_ = (Vec3 *)calloc(vertex_, sizeof(Vec3));
@@ -13,10 +16,11 @@ void Cube::obtainCube()
   nFaces_ = 6;
   faces_ = (Faces *)calloc(nFaces_, sizeof(Faces));
 
+  faceStorage_ = (int *)calloc(nFaces_ * 4, sizeof(int));
   for (int i = 0; i < nFaces_; ++i)
   {
     faces_[i].n_points = 4;
-    faces_[i].points = (int *)calloc(faces_[i].n_points, sizeof(int));
+    faces_[i].points = faceStorage_ + i * 4;
   }
 
   centers_ = (Vec3 *)calloc(nFaces_, sizeof(Vec3));
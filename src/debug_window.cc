@@ -86,132 +86,183 @@ void Camera_Control(Render &render, My_Window &win, Vec2 max_win, Vec3 &light)
     ImGui::Text("Light point");
     ImGui::DragFloat3((const char *)"Light", &light.x, 1.0f, 0, max_win.x);
 
+    // Level of detail thresholds, projected radius in pixels
+    ImGui::Separator();
+    ImGui::Checkbox("LOD enabled?", &Entity::lod_settings_.enabled);
+    for (int i = 0; i < MAX_LOD_LEVELS - 1; i++)
+    {
+      char label[20];
+      snprintf(label, 20, "LOD %d under (px)", i + 1);
+      float max = i > 0 ? Entity::lod_settings_.thresholds[i - 1] : 1000.0f;
+      ImGui::DragFloat(label, &Entity::lod_settings_.thresholds[i], 0.5f, 0.0f, max);
+    }
+
     ImGui::End();
   }
   else
     ImGui::End();
 }
 
-void Destroy_Object(std::vector<Objects> &objects, Vec3 **objects_mov, Vec3 **objects_scale, Vec2 max_win, int nObject)
-{
-  *objects_mov = (Vec3 *)realloc(*objects_mov, (objects.size() - 1) * sizeof(Vec3));
-  *objects_scale = (Vec3 *)realloc(*objects_scale, (objects.size() - 1) * sizeof(Vec3));
-  std::vector<Objects> copyObjects(objects.size());
-  for (int i = 0; i < (int)objects.size(); i++)
-  {
-    copyObjects.at(i) = objects.at(i);
-  }
-  objects.resize(objects.size() - 1);
-  for (int i = 0; i < (int)objects.size(); i++)
-  {
-    if (i < nObject)
-      objects.at(i) = copyObjects.at(i);
-    else
-      objects.at(i) = copyObjects.at(i + 1);
-  }
-}
-
-void Objects_Control(std::vector<Objects> &objects, Vec3 **objects_mov, Vec3 **objects_scale, Vec2 max_win)
+void Objects_Control(Registry &registry, Render &drawRender, Vec2 max_win)
 {
 
   static int nObject = 0;
+  static bool creating = false;
+  static bool picking = true;
 
-  for (int i = 0; i < (int)objects.size(); i++)
-  {
-    switch (objects.at(i).type)
-    {
-    case typeSphere:
-      if (objects.at(i).sphere.isDestroyed())
-      {
-        Destroy_Object(objects, &*objects_mov, &*objects_scale, max_win, i);
-      }
-      break;
-    case typeCube:
-      if (objects.at(i).cube.isDestroyed())
-      {
-        Destroy_Object(objects, &*objects_mov, &*objects_scale, max_win, i);
-      }
-      break;
-    case typeFigure:
-      if (objects.at(i).figure.isDestroyed())
-      {
-        Destroy_Object(objects, &*objects_mov, &*objects_scale, max_win, i);
-      }
-      break;
-    }
-  }
+  // The controls modify the components, the steps running in the thread finish first
+  registry.wait();
 
   if (ImGui::Begin("Objects controls"))
   {
 
-    if (objects.size() < 100)
+    if (!creating)
     {
       if (ImGui::Button("Create Object"))
-      {
-        nObject = objects.size();
-        *objects_mov = (Vec3 *)realloc(*objects_mov, (objects.size() + 1) * sizeof(Vec3));
-        *objects_scale = (Vec3 *)realloc(*objects_scale, (objects.size() + 1) * sizeof(Vec3));
-        std::vector<Objects> copyObjects(objects.size());
-        for (int i = 0; i < (int)objects.size(); i++)
-        {
-          copyObjects.at(i) = objects.at(i);
-        }
-        objects.resize(objects.size() + 1);
-        objects.at(objects.size() - 1).type = notSet;
-        for (int i = 0; i < (int)objects.size() - 1; i++)
-        {
-          objects.at(i) = copyObjects.at(i);
-        }
-      }
+        creating = true;
     }
-    else
-      ImGui::Button("You can't create more objects, Max = 100");
+    else if (ImGui::Button("Cancel creation"))
+      creating = false;
 
-    if (objects.size() > 0)
+    if (registry.count() > 0)
     {
       if (ImGui::Button("Destroy Object"))
-      {
-        switch (objects.at(nObject).type)
-        {
-        case typeSphere:
-          objects.at(nObject).sphere.startDestroy();
-          break;
-        case typeCube:
-          objects.at(nObject).cube.startDestroy();
-          break;
-        case typeFigure:
-          objects.at(nObject).figure.startDestroy();
-          break;
-        }
-      }
+        registry.entity(registry.handle(nObject))->startDestroy();
     }
     else
       ImGui::Button("You can't destroy objects");
 
-    ImGui::Text("Total objects: %d", (int)objects.size());
+    ImGui::Text("Total objects: %d", registry.count());
+
+    // Gravitational simulation, replaces the orbits while enabled
+    ImGui::Checkbox("Gravity simulation?", &Physics::settings_.enabled);
+    if (Physics::settings_.enabled)
+    {
+      ImGui::DragFloat("Gravity", &Physics::settings_.gravity, 0.05f, 0.0f, 100.0f);
+      ImGui::DragFloat("Softening", &Physics::settings_.softening, 0.05f, 0.01f, 50.0f);
+      ImGui::DragInt("Octree from bodies", &Physics::settings_.min_tree, 10.0f, 0, 1000000);
+      ImGui::DragFloat("Octree theta", &Physics::settings_.theta, 0.01f, 0.0f, 1.5f);
+      ImGui::Text("Octree nodes: %d", registry.physics().treeNodes());
+      if (ImGui::Button("Restart orbits"))
+        registry.startPhysics();
+      if (registry.count() <= 2000 && ImGui::Button("Print energy (console)"))
+        printf("Physics energy: %.6e\n", registry.physics().energy());
+    }
+
+    // Simulation clock, fixed steps of scaled time
+    Sim_Clock &clock = registry.clock();
+    ImGui::Separator();
+    ImGui::Text("Simulated time: %.2f s, dropped %.2f s", registry.time(), clock.dropped());
+    ImGui::DragFloat("Time scale", &Sim_Clock::settings_.time_scale, 0.05f, 0.0f, 1000.0f, "%.2fx");
+    if (ImGui::Button("1x"))
+      Sim_Clock::settings_.time_scale = 1.0f;
+    ImGui::SameLine();
+    if (ImGui::Button("10x"))
+      Sim_Clock::settings_.time_scale = 10.0f;
+    ImGui::SameLine();
+    if (ImGui::Button("100x"))
+      Sim_Clock::settings_.time_scale = 100.0f;
+    ImGui::Checkbox("Paused?", &Sim_Clock::settings_.paused);
+    if (Sim_Clock::settings_.paused)
+    {
+      ImGui::SameLine();
+      if (ImGui::Button("Step"))
+        clock.stepOnce();
+    }
+    ImGui::DragFloat("Sim step (s)", &Sim_Clock::settings_.step, 0.0005f, 0.001f, 0.1f, "%.4f");
+    ImGui::DragInt("Max steps per frame", &Sim_Clock::settings_.max_steps, 1.0f, 1, 10000);
+    ImGui::Checkbox("Simulation thread?", &Sim_Clock::settings_.threaded);
+
+    // Bounding volume hierarchy, picking and culling
+    Bvh &bvh = registry.bvh();
+    ImGui::Separator();
+    ImGui::Checkbox("Camera culling?", &Bvh::settings_.culling);
+    ImGui::Text("Drawn objects: %d of %d", registry.visible(), registry.count());
+    ImGui::Text("BVH height: %d, rebuilds: %d", bvh.height(), bvh.rebuilds());
+    ImGui::DragFloat("BVH margin", &Bvh::settings_.margin, 0.01f, 0.0f, 4.0f);
+    ImGui::Checkbox("Pick with the mouse?", &picking);
+
+    // Collisions of the steps, the lighter body of each pair is absorbed
+    ImGui::Checkbox("Collisions?", &Collider::settings_.enabled);
+    if (Collider::settings_.enabled)
+    {
+      Collider &collider = registry.collider();
+      ImGui::DragFloat("Grid cell (radii)", &Collider::settings_.cell, 0.05f, 2.0f, 32.0f);
+      ImGui::Text("Step pairs: %d, checks: %d", collider.count(), collider.checks());
+      ImGui::Text("Merged objects: %d", registry.merges());
+    }
+
+    // Debris of the destroyed objects
+    ImGui::Checkbox("Debris?", &Particles::settings_.enabled);
+    if (Particles::settings_.enabled)
+    {
+      Particles &particles = registry.particles();
+      ImGui::Text("Particles: %d of %d", particles.count(), particles.capacity());
+      ImGui::DragInt("Particles per face", &Particles::settings_.per_face, 0.1f, 1, 64);
+      ImGui::DragFloat("Debris speed", &Particles::settings_.speed, 0.5f, 0.0f, 500.0f);
+      ImGui::DragFloat("Debris life (s)", &Particles::settings_.life, 0.05f, 0.1f, 20.0f);
+    }
+
+    // A click out of the ImGui windows selects the object under the mouse
+    ImGuiIO &io = ImGui::GetIO();
+    if (picking && !io.WantCaptureMouse && ImGui::IsMouseClicked(0))
+    {
+      int picked = registry.pick(drawRender, {io.MousePos.x, io.MousePos.y});
+      if (picked >= 0)
+      {
+        nObject = registry.index(picked);
+        creating = false;
+      }
+    }
+    ImGui::Separator();
 
-    ImGui::DragInt("Select object", &nObject, 0.25f, 0, objects.size() - 1);
+    ImGui::DragInt("Select object", &nObject, 0.25f, 0, registry.count() - 1);
 
-    if (nObject >= (int)objects.size())
+    if (nObject >= registry.count() || nObject < 0)
       nObject = 0;
     ImGui::Separator();
-    ImGui::Text("Object: %d", nObject);
 
-    if (objects.size() > 0)
+    if (creating)
     {
-      switch (objects.at(nObject).type)
+      ImGui::Text("Object: new");
+      int handle = Not_Set_Controls(registry);
+      if (handle >= 0)
+      {
+        nObject = registry.index(handle);
+        creating = false;
+      }
+    }
+    else if (registry.count() > 0)
+    {
+      int handle = registry.handle(nObject);
+      ImGui::Text("Object: %d (handle %d)", nObject, handle);
+
+      Entity_Orbit &orbit = registry.orbit(handle);
+      Entity_Material &material = registry.material(handle);
+      switch (registry.type(handle))
       {
-      case notSet:
-        Not_Set_Controls(objects.at(nObject));
-        break;
       case typeSphere:
-        Spheres_Controls(objects.at(nObject).sphere);
+        Spheres_Controls(*(Sphere *)registry.entity(handle), orbit, material);
         break;
       case typeCube:
-        Cubes_Controls(objects.at(nObject).cube);
+        Cubes_Controls(*(Cube *)registry.entity(handle), orbit, material);
         break;
       case typeFigure:
-        Figures_Controls(objects.at(nObject).figure);
+        Figures_Controls(*(Figure *)registry.entity(handle), orbit, material);
+      }
+      Rails_Controls(registry, handle);
+      Parent_Controls(registry, handle);
+
+      // The nearest objects, the first one is the selected itself
+      const int k = 6;
+      int near[k];
+      float distances[k];
+      int found = registry.nearest(registry.positions()[nObject], k, near, distances);
+      ImGui::Text("Nearest objects:");
+      for (int i = 0; i < found; i++)
+      {
+        if (near[i] != handle && registry.valid(near[i]))
+          ImGui::BulletText("%d (handle %d) at %.2f", registry.index(near[i]), near[i], distances[i]);
       }
     }
     ImGui::End();
@@ -219,3 +270,48 @@ void Objects_Control(std::vector<Objects> &objects, Vec3 **objects_mov, Vec3 **o
   else
     ImGui::End();
 }
+
+void Network_Control(Replication_Client &client)
+{
+  // The depth of the buffer over the last frames
+  static float depths[120] = {};
+  static int frame = 0;
+
+  const Replication_Stats &stats = client.stats();
+  const Replication_Playback &playback = client.playback();
+  depths[frame] = (float)playback.depth;
+  frame = (frame + 1) % 120;
+
+  if (ImGui::Begin("Network controls"))
+  {
+    ImGui::Text("Snapshots: %lld, full: %lld", stats.snapshots, stats.full);
+    ImGui::Text("Entities: %d", stats.entities);
+    ImGui::Text("Last snapshot: %d bytes, mean: %.0f bytes", stats.lastBytes, stats.snapshots > 0 ? (double)stats.bytes / stats.snapshots : 0.0);
+
+    ImGui::Separator();
+    ImGui::Text("Buffer depth: %d", playback.depth);
+    ImGui::PlotLines("Depth", depths, 120, frame, nullptr, 0.0f, 10.0f, ImVec2(0, 40));
+    ImGui::Text("Delay: %.1f ms, jitter: %.1f ms", playback.delay * 1000.0f, playback.jitter * 1000.0f);
+    ImGui::Text("Tick: %.1f ms", playback.interval * 1000.0f);
+    ImGui::Text("Late packets: %lld", playback.late);
+    ImGui::Text("Extrapolated frames: %lld, held: %lld", playback.extrapolated, playback.held);
+
+    // The delay is fixed by hand or follows the jitter
+    ImGui::Separator();
+    ImGui::Checkbox("Adaptive delay?", &Replication_Server::settings_.adaptive);
+    float delay = Replication_Server::settings_.delay * 1000.0f;
+    if (ImGui::DragFloat("Delay (ms)", &delay, 1.0f, 0.0f, 1000.0f))
+      Replication_Server::settings_.delay = delay / 1000.0f;
+    float max_delay = Replication_Server::settings_.max_delay * 1000.0f;
+    if (ImGui::DragFloat("Max delay (ms)", &max_delay, 1.0f, 0.0f, 2000.0f))
+      Replication_Server::settings_.max_delay = max_delay / 1000.0f;
+    ImGui::DragFloat("Jitter margin", &Replication_Server::settings_.jitter_margin, 0.1f, 0.0f, 10.0f);
+    float extrapolation = Replication_Server::settings_.extrapolation * 1000.0f;
+    if (ImGui::DragFloat("Extrapolation (ms)", &extrapolation, 1.0f, 0.0f, 1000.0f))
+      Replication_Server::settings_.extrapolation = extrapolation / 1000.0f;
+
+    ImGui::End();
+  }
+  else
+    ImGui::End();
+}
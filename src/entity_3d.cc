@@ -3,10 +3,49 @@
 #include <entity_3d.h>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <utility>
 
 typedef std::ratio<1l, 1000l> milli;
 typedef std::chrono::duration<long long, milli> Milliseconds;
 
+Lod_Settings Entity::lod_settings_ = {true, {60.0f, 30.0f, 12.0f}};
+
+// Stable order of the faces sorted by material
+static void Material_Order(const int *materials, int nFaces, std::vector<int> &perm)
+{
+  perm.resize(nFaces);
+  for (int i = 0; i < nFaces; i++)
+    perm[i] = i;
+  std::stable_sort(perm.begin(), perm.end(), [materials](int a, int b)
+                   { return materials[a] < materials[b]; });
+}
+
+// Groups of consecutive faces with the same material, the materials must be sorted
+static int Build_Groups(const int *materials, int nFaces, Material_Group **groups)
+{
+  int nGroups = 0;
+  for (int i = 0; i < nFaces; i++)
+  {
+    if (i == 0 || materials[i] != materials[i - 1])
+      nGroups++;
+  }
+
+  *groups = (Material_Group *)realloc(*groups, nGroups * sizeof(Material_Group));
+  int group = -1;
+  for (int i = 0; i < nFaces; i++)
+  {
+    if (i == 0 || materials[i] != materials[i - 1])
+    {
+      group++;
+      (*groups)[group] = Material_Group{materials[i], i, 0};
+    }
+    (*groups)[group].count++;
+  }
+
+  return nGroups;
+}
+
 // Init entity
 Entity::Entity()
 {
@@ -21,9 +60,21 @@ Entity::Entity()
   renderLight_ = true;
 
   faces_ = nullptr;
+  faceStorage_ = nullptr;
 
   order_ = nullptr;
 
+  faceMaterials_ = nullptr;
+  faceColors_ = nullptr;
+  groups_ = nullptr;
+  nGroups_ = 0;
+  materials_ = false;
+
+  memset(lods_, 0, sizeof(lods_));
+  nLods_ = 1;
+  lod_ = 0;
+  batches_ = 0;
+
   dim_ = 0;
   vertex_ = 0;
   nFaces_ = 0;
@@ -66,7 +117,17 @@ Entity::Entity()
   bytesSize += sizeof(bool);
 };
 
-void Entity::operator=(const Entity &other)
+Entity::Entity(const Entity &other) : Entity()
+{
+  *this = other;
+}
+
+Entity::Entity(Entity &&other) : Entity()
+{
+  *this = std::move(other);
+}
+
+void Entity::copyState(const Entity &other)
 {
   dim_ = other.dim_;
   mov_ = other.mov_;
@@ -75,18 +136,49 @@ void Entity::operator=(const Entity &other)
   renderLight_ = other.renderLight_;
   fillColor_ = other.fillColor_;
   linesColor_ = other.linesColor_;
-  fill_ = other.fill_; 
+  fill_ = other.fill_;
   lines_ = other.lines_;
+  materials_ = other.materials_;
   orbit_vel_ = other.orbit_vel_;
   bytesSize = other.bytesSize;
   destroying_ = other.destroying_;
   destroyed_ = other.destroyed_;
+  destroying_time_ = other.destroying_time_;
+  check_time_ = other.check_time_;
   nFaces_ = other.nFaces_;
-  scale_ = other.scale_; 
+  scale_ = other.scale_;
   rotate_ = other.rotate_;
 
   res_ = other.res_;
   vertex_ = other.vertex_;
+  nGroups_ = other.nGroups_;
+}
+
+void Entity::release()
+{
+  DESTROY(points_);
+  DESTROY(draw_sdl_);
+  DESTROY(faces_);
+  DESTROY(faceStorage_);
+  DESTROY(centers_);
+  DESTROY(order_);
+  DESTROY(faceMaterials_);
+  DESTROY(faceColors_);
+  DESTROY(groups_);
+  clearLods();
+  vertex_ = 0;
+  nFaces_ = 0;
+  nGroups_ = 0;
+}
+
+void Entity::operator=(const Entity &other)
+{
+  if (this == &other)
+    return;
+
+  // The buffers of this entity are released before copying the other ones
+  release();
+  copyState(other);
 
   points_ = (Vec3 *)calloc(vertex_, sizeof(Vec3));
 
@@ -109,6 +201,234 @@ void Entity::operator=(const Entity &other)
     faces_[i] = other.faces_[i];
     order_[i] = other.order_[i];
   }
+
+  // Faces in flat storage point to the storage of the copy
+  if (other.faceStorage_ != nullptr)
+  {
+    int total = 0;
+    for (int i = 0; i < nFaces_; i++)
+      total += faces_[i].n_points;
+    faceStorage_ = (int *)calloc(total, sizeof(int));
+    memcpy(faceStorage_, other.faceStorage_, total * sizeof(int));
+    for (int i = 0; i < nFaces_; i++)
+      faces_[i].points = faceStorage_ + (other.faces_[i].points - other.faceStorage_);
+  }
+
+  if (other.faceMaterials_ != nullptr)
+  {
+    faceMaterials_ = (int *)calloc(nFaces_, sizeof(int));
+    faceColors_ = (SDL_Color *)calloc(nFaces_, sizeof(SDL_Color));
+    groups_ = (Material_Group *)calloc(nGroups_, sizeof(Material_Group));
+    memcpy(faceMaterials_, other.faceMaterials_, nFaces_ * sizeof(int));
+    memcpy(faceColors_, other.faceColors_, nFaces_ * sizeof(SDL_Color));
+    memcpy(groups_, other.groups_, nGroups_ * sizeof(Material_Group));
+  }
+
+  for (int i = 1; i < other.nLods_; i++)
+  {
+    const Lod_Level &lod = other.lods_[i - 1];
+    setLod(i, lod.nFaces > 0 ? lod.faces[0].n_points : 3, lod.storage, lod.nFaces, lod.materials, lod.colors);
+  }
+  lod_ = other.lod_;
+}
+
+void Entity::operator=(Entity &&other)
+{
+  if (this == &other)
+    return;
+
+  release();
+  copyState(other);
+
+  // The buffers change of owner, nothing is copied
+  points_ = other.points_;
+  draw_sdl_ = other.draw_sdl_;
+  centers_ = other.centers_;
+  faces_ = other.faces_;
+  faceStorage_ = other.faceStorage_;
+  order_ = other.order_;
+  faceMaterials_ = other.faceMaterials_;
+  faceColors_ = other.faceColors_;
+  groups_ = other.groups_;
+  memcpy(lods_, other.lods_, sizeof(lods_));
+  nLods_ = other.nLods_;
+  lod_ = other.lod_;
+
+  other.points_ = nullptr;
+  other.draw_sdl_ = nullptr;
+  other.centers_ = nullptr;
+  other.faces_ = nullptr;
+  other.faceStorage_ = nullptr;
+  other.order_ = nullptr;
+  other.faceMaterials_ = nullptr;
+  other.faceColors_ = nullptr;
+  other.groups_ = nullptr;
+  memset(other.lods_, 0, sizeof(other.lods_));
+  other.nLods_ = 1;
+  other.lod_ = 0;
+  other.vertex_ = 0;
+  other.nFaces_ = 0;
+  other.nGroups_ = 0;
+}
+
+void Entity::place(SDL_Color color, bool fill, Vec3 p_scale, Vec3 mov, Vec3 rot, Vec3 orbit, Vec3 orbit_center)
+{
+  fillColor_ = color;
+  linesColor_ = color;
+  fill_ = fill;
+  lines_ = false;
+  orbit_ = orbit;
+  orbit_center_ = orbit_center;
+  orbit_vel_ = 0.0f;
+  destroying_ = false;
+  destroyed_ = false;
+
+  if ((p_scale.x + p_scale.y + p_scale.z) != 3)
+    scale(p_scale);
+
+  if ((mov.x + mov.y + mov.z) != 0)
+    translation(mov);
+
+  if ((rot.x + rot.y + rot.z) != 0)
+    rotation(rot);
+}
+
+void Entity::setLod(int level, int n_points, const int *points, int nFaces, const int *materials, const SDL_Color *colors)
+{
+  if (level < 1 || level >= MAX_LOD_LEVELS)
+    return;
+
+  Lod_Level &lod = lods_[level - 1];
+  DESTROY(lod.faces);
+  DESTROY(lod.storage);
+  DESTROY(lod.vertices);
+  DESTROY(lod.centers);
+  DESTROY(lod.materials);
+  DESTROY(lod.colors);
+  DESTROY(lod.groups);
+  lod.nGroups = 0;
+
+  // The faces are stored sorted by material so each material is a single range
+  std::vector<int> perm;
+  if (materials != nullptr)
+    Material_Order(materials, nFaces, perm);
+
+  lod.nFaces = nFaces;
+  lod.storage = (int *)calloc(nFaces * n_points, sizeof(int));
+  if (materials != nullptr)
+  {
+    lod.materials = (int *)calloc(nFaces, sizeof(int));
+    lod.colors = (SDL_Color *)calloc(nFaces, sizeof(SDL_Color));
+    for (int i = 0; i < nFaces; i++)
+    {
+      memcpy(lod.storage + i * n_points, points + perm[i] * n_points, n_points * sizeof(int));
+      lod.materials[i] = materials[perm[i]];
+      lod.colors[i] = colors[perm[i]];
+    }
+    lod.nGroups = Build_Groups(lod.materials, nFaces, &lod.groups);
+  }
+  else
+    memcpy(lod.storage, points, nFaces * n_points * sizeof(int));
+
+  lod.faces = (Faces *)calloc(nFaces, sizeof(Faces));
+  for (int i = 0; i < nFaces; i++)
+  {
+    lod.faces[i].n_points = n_points;
+    lod.faces[i].points = lod.storage + i * n_points;
+  }
+
+  lod.centers = (Vec3 *)calloc(nFaces, sizeof(Vec3));
+
+  // Only the points used by the level are projected when it is drawn
+  bool *used = (bool *)calloc(vertex_, sizeof(bool));
+  lod.nVertex = 0;
+  for (int i = 0; i < nFaces * n_points; i++)
+  {
+    if (!used[points[i]])
+    {
+      used[points[i]] = true;
+      lod.nVertex++;
+    }
+  }
+  lod.vertices = (int *)calloc(lod.nVertex, sizeof(int));
+  int cont = 0;
+  for (int i = 0; i < vertex_; i++)
+  {
+    if (used[i])
+      lod.vertices[cont++] = i;
+  }
+  free(used);
+
+  nLods_ = std::max(nLods_, level + 1);
+}
+
+void Entity::clearLods()
+{
+  for (int i = 0; i < MAX_LOD_LEVELS - 1; i++)
+  {
+    DESTROY(lods_[i].faces);
+    DESTROY(lods_[i].storage);
+    DESTROY(lods_[i].vertices);
+    DESTROY(lods_[i].centers);
+    DESTROY(lods_[i].materials);
+    DESTROY(lods_[i].colors);
+    DESTROY(lods_[i].groups);
+    lods_[i].nFaces = 0;
+    lods_[i].nVertex = 0;
+    lods_[i].nGroups = 0;
+  }
+  nLods_ = 1;
+  lod_ = 0;
+}
+
+int Entity::lodSize()
+{
+  int size = 0;
+  for (int i = 1; i < nLods_; i++)
+  {
+    const Lod_Level &lod = lods_[i - 1];
+    size += sizeof(Lod_Level);
+    size += sizeof(Faces) * lod.nFaces;
+    size += sizeof(Vec3) * lod.nFaces;
+    size += sizeof(int) * lod.nVertex;
+    if (lod.nFaces > 0)
+      size += sizeof(int) * lod.nFaces * lod.faces[0].n_points;
+    if (lod.materials != nullptr)
+      size += (sizeof(int) + sizeof(SDL_Color)) * lod.nFaces + sizeof(Material_Group) * lod.nGroups;
+  }
+  return size;
+}
+
+void Entity::groupFaces()
+{
+  std::vector<int> perm;
+  Material_Order(faceMaterials_, nFaces_, perm);
+
+  Faces *faces = (Faces *)calloc(nFaces_, sizeof(Faces));
+  int *materials = (int *)calloc(nFaces_, sizeof(int));
+  SDL_Color *colors = (SDL_Color *)calloc(nFaces_, sizeof(SDL_Color));
+  for (int i = 0; i < nFaces_; i++)
+  {
+    faces[i] = faces_[perm[i]];
+    materials[i] = faceMaterials_[perm[i]];
+    colors[i] = faceColors_[perm[i]];
+  }
+  memcpy(faces_, faces, nFaces_ * sizeof(Faces));
+  memcpy(faceMaterials_, materials, nFaces_ * sizeof(int));
+  memcpy(faceColors_, colors, nFaces_ * sizeof(SDL_Color));
+  free(faces);
+  free(materials);
+  free(colors);
+
+  // The centers follow the new order of the faces
+  for (int i = 0; centers_ != nullptr && i < nFaces_; i++)
+  {
+    centers_[i] = points_[faces_[i].points[0]] - points_[faces_[i].points[2]];
+    centers_[i] *= 0.5f;
+    centers_[i] += points_[faces_[i].points[2]];
+  }
+
+  nGroups_ = Build_Groups(faceMaterials_, nFaces_, &groups_);
 }
 
 void Entity::proportion()
@@ -156,11 +476,75 @@ Vec3 Entity::getScale()
   return scale_;
 }
 
+Vec3 Entity::getRotation()
+{
+  return rotate_;
+}
+
+int Entity::getRes()
+{
+  return res_;
+}
+
+float Entity::getRadius()
+{
+  float radius2 = 0.0f;
+  for (int i = 0; i < vertex_; i++)
+  {
+    Vec3 d = points_[i] - mov_;
+    radius2 = std::max(radius2, Vec3::DotProduct(d, d));
+  }
+  return sqrtf(radius2);
+}
+
 int Entity::getFaces()
 {
   return nFaces_;
 }
 
+int Entity::getMaterials()
+{
+  return nGroups_;
+}
+
+int Entity::getBatches()
+{
+  return batches_;
+}
+
+int Entity::getLod()
+{
+  return lod_;
+}
+
+int Entity::getLodLevels()
+{
+  return nLods_;
+}
+
+int Entity::getLodFaces(int level)
+{
+  if (level <= 0 || level >= nLods_)
+    return nFaces_;
+  return lods_[level - 1].nFaces;
+}
+
+int Entity::selectLod(const Render &drawRender)
+{
+  lod_ = 0;
+  if (!lod_settings_.enabled || nLods_ <= 1)
+    return lod_;
+
+  float size = drawRender.projectedSize(mov_, dim_);
+  for (int i = 1; i < nLods_; i++)
+  {
+    if (size < lod_settings_.thresholds[i - 1])
+      lod_ = i;
+  }
+
+  return lod_;
+}
+
 int Entity::getSize()
 {
   return bytesSize;
@@ -212,9 +596,14 @@ void Entity::rotation(Vec3 p_rot)
 
 void Entity::orbit()
 {
-  if ((orbit_center_.x + orbit_center_.y + orbit_center_.z) != 0)
+  orbit(getOrbit());
+}
+
+void Entity::orbit(const Entity_Orbit &p_orbit)
+{
+  if ((p_orbit.center.x + p_orbit.center.y + p_orbit.center.z) != 0)
   {
-    Vec3 p_orbit_ = orbit_ * orbit_vel_;
+    Vec3 p_orbit_ = p_orbit.angle * p_orbit.vel;
 
     Mat4 rot_x;
     Mat4 rot_y;
@@ -235,7 +624,7 @@ void Entity::orbit()
     if (p_orbit_.z != 0)
       model *= rot_z;
 
-    translation(Vec3{-orbit_center_.x, -orbit_center_.y, -orbit_center_.z});
+    translation(Vec3{-p_orbit.center.x, -p_orbit.center.y, -p_orbit.center.z});
     mov_ = MathUtils::Mat4TransformVec3(model, mov_);
     for (int i = 0; i < vertex_; i++)
     {
@@ -245,10 +634,30 @@ void Entity::orbit()
     {
       *(centers_ + i) = MathUtils::Mat4TransformVec3(model, *(centers_ + i));
     }
-    translation(orbit_center_);
+    translation(p_orbit.center);
   }
 }
 
+Entity_Orbit Entity::getOrbit()
+{
+  return Entity_Orbit{orbit_, orbit_center_, orbit_vel_};
+}
+
+Entity_Material Entity::getMaterial()
+{
+  return Entity_Material{fillColor_, linesColor_, fill_, lines_, renderLight_, materials_};
+}
+
+void Entity::setMaterial(const Entity_Material &material)
+{
+  fillColor_ = material.fillColor;
+  linesColor_ = material.linesColor;
+  fill_ = material.fill;
+  lines_ = material.lines;
+  renderLight_ = material.renderLight;
+  materials_ = material.materials;
+}
+
 void Entity::translation(Vec3 p_mov_)
 {
   mov_ += p_mov_;
@@ -287,6 +696,7 @@ void Entity::scale(Vec3 p_scale_)
   translation(mov);
 }
 
+#ifndef HEADLESS
 void Entity::inputs()
 {
   if (EVENT_DOWN(DOWN))
@@ -320,6 +730,7 @@ void Entity::inputs()
   if (EVENT_DOWN(SPACE))
     scale({1.1f, 1.1f, 1.1f});
 }
+#endif
 
 void Entity::startDestroy()
 {
@@ -332,50 +743,81 @@ bool Entity::isDestroyed()
   return destroyed_;
 }
 
-void Entity::destroying()
+bool Entity::isDestroying()
+{
+  return destroying_;
+}
+
+int Entity::debris(Particles &particles, Vec3 velocity, const Entity_Material &material)
+{
+  const SDL_Color *colors = material.materials ? faceColors_ : nullptr;
+  return particles.emit(centers_, colors, nFaces_, mov_, velocity, material.fillColor);
+}
+
+void Entity::destroying(Entity_Material &material)
 {
   check_time_ = std::chrono::steady_clock::now();
 
   auto elapsed_milli = std::chrono::duration_cast<Milliseconds>(check_time_ - destroying_time_);
 
-  fill_ = false;
-  lines_ = true;
-  renderLight_ = false;
+  material.fill = false;
+  material.lines = true;
+  material.renderLight = false;
 
   if (elapsed_milli.count() > 200.0f)
   {
-    lines_ = false;
+    material.lines = false;
   }
 
   if (elapsed_milli.count() >= 750.0f)
   {
-    if (fillColor_.a > (Uint8)5.0f)
-      fillColor_.a -= (Uint8)5.0f;
+    if (material.fillColor.a > (Uint8)5.0f)
+      material.fillColor.a -= (Uint8)5.0f;
     else
     {
-      fillColor_.a = 0;
+      material.fillColor.a = 0;
       destroyed_ = true;
       destroying_ = false;
     }
   }
+}
 
-  Vec3 mov = mov_;
-  translation({-mov_.x, -mov_.y, -mov_.z});
-  for (int i = 0; i < vertex_; i++)
+#ifndef HEADLESS
+void Entity::draw(SDL_Renderer *render, const Render &drawRender, Vec3 light)
+{
+  Entity_Material material = getMaterial();
+  Entity_Draw_Buffers buffers;
+  draw(render, drawRender, light, material, buffers);
+  setMaterial(material);
+}
+
+void Entity::draw(SDL_Renderer *render, const Render &drawRender, Vec3 light, Entity_Material &material, Entity_Draw_Buffers &buffers)
+{
+  if (destroying_)
+    destroying(material);
+
+  // Faces of the selected level of detail
+  selectLod(drawRender);
+  Faces *faces = faces_;
+  Vec3 *centers = centers_;
+  int nFaces = nFaces_;
+  Lod_Level *lod = nullptr;
+  if (lod_ > 0)
   {
-    if (rand() < FLT_MAX / 1000)
+    lod = &lods_[lod_ - 1];
+    faces = lod->faces;
+    centers = lod->centers;
+    nFaces = lod->nFaces;
+    for (int i = 0; i < nFaces; i++)
     {
-      Mat4 model = Mat4::Scale(MathUtils::fRand(1.075f, 0.99f));
-      *(points_ + i) = MathUtils::Mat4TransformVec3(model, *(points_ + i));
+      centers[i] = points_[faces[i].points[0]] - points_[faces[i].points[2]];
+      centers[i] *= 0.5f;
+      centers[i] += points_[faces[i].points[2]];
     }
   }
-  translation(mov);
-}
 
-void Entity::draw(SDL_Renderer *render, Render drawRender, Vec3 light, int id)
-{
-  if (destroying_)
-    destroying();
+  // Material colors multiply the light computed for each point
+  bool use_colors = material.materials && faceColors_ != nullptr;
 
   // Transform of 2D points
   Mat3 model = Mat3::Identity();
@@ -388,121 +830,109 @@ void Entity::draw(SDL_Renderer *render, Render drawRender, Vec3 light, int id)
   Render_Figure figure;
   figure.verts = &draw_sdl_;
   figure.point = points_;
-  figure.n_points = vertex_;
+  figure.indices = lod != nullptr ? lod->vertices : nullptr;
+  figure.n_points = lod != nullptr ? lod->nVertex : vertex_;
   figure.desp = mov_;
   figure.light = light;
-  figure.color = fillColor_;
+  figure.color = use_colors ? SDL_Color{255, 255, 255, material.fillColor.a} : material.fillColor;
   figure.model = model;
   figure.forceRender = false;
 
-  drawRender.renderThreadedPoints(figure, renderLight_);
-  // drawRender.renderPoints(figure, renderLight_);
+  drawRender.renderThreadedPoints(figure, material.renderLight);
+  // drawRender.renderPoints(figure, material.renderLight);
 
-  if (lines_)
+  if (material.lines)
   {
-    SDL_SetRenderDrawColor(render, RGBA(linesColor_));
+    SDL_SetRenderDrawColor(render, RGBA(material.linesColor));
   }
 
   // This is to draw with texture | light
-  if (fill_ || lines_)
+  batches_ = 0;
+  if (material.fill || material.lines)
   {
-    // Points Ordered
-    for (int i = 0; i < nFaces_; i++)
+    // The material colors are baked in the vertices, so every face goes in a single batch
+    const SDL_Color *colors = lod != nullptr ? lod->colors : faceColors_;
+    use_colors = use_colors && colors != nullptr;
+
+    // Faces ordered back to front
+    std::vector<float> &distances = buffers.distances;
+    distances.resize(nFaces);
+    for (int i = 0; i < nFaces; i++)
     {
       order_[i] = i;
+      distances[i] = Vec3::Substract(centers[i], drawRender.camera_).Magnitude();
     }
+    std::sort(order_, order_ + nFaces, [&distances](int a, int b)
+              { return distances[a] > distances[b]; });
 
-    std::sort(order_, order_ + nFaces_, [this, &drawRender](int a, int b)
-              { return Vec3::Substract(centers_[a], drawRender.camera_).Magnitude() > Vec3::Substract(centers_[b], drawRender.camera_).Magnitude(); });
-
-    // Draw Triangles
-    for (int i = 0; i < nFaces_; i++)
+    std::vector<SDL_Vertex> &batch = buffers.batch;
+    auto add_triangle = [this, &batch](int a, int b, int c, const SDL_Color *color)
     {
+      if (!draw_sdl_[a].active || !draw_sdl_[b].active || !draw_sdl_[c].active)
+        return;
 
-      bool draw = true;
+      int points[3] = {a, b, c};
       for (int j = 0; j < 3; j++)
       {
-        draw = (draw && draw_sdl_[faces_[order_[i]].points[j]].active);
-        if (!draw)
-          break;
-      }
-
-      if (draw)
-      {
-        static SDL_Vertex triangle[3];
-        triangle[0] = draw_sdl_[faces_[order_[i]].points[0]].point;
-        triangle[1] = draw_sdl_[faces_[order_[i]].points[1]].point;
-        triangle[2] = draw_sdl_[faces_[order_[i]].points[2]].point;
-
-        if (fill_)
-        {
-          SDL_RenderGeometry(render, NULL, triangle, 3, NULL, 0);
-        }
-
-        if (lines_)
+        SDL_Vertex vertex = draw_sdl_[points[j]].point;
+        if (color != nullptr)
         {
-          SDL_RenderDrawLine(render, triangle[0].position.x, triangle[0].position.y,
-                             triangle[1].position.x, triangle[1].position.y);
-          SDL_RenderDrawLine(render, triangle[1].position.x, triangle[1].position.y,
-                             triangle[2].position.x, triangle[2].position.y);
-          SDL_RenderDrawLine(render, triangle[2].position.x, triangle[2].position.y,
-                             triangle[0].position.x, triangle[0].position.y);
+          vertex.color.r = (Uint8)((color->r * vertex.color.r) / 255);
+          vertex.color.g = (Uint8)((color->g * vertex.color.g) / 255);
+          vertex.color.b = (Uint8)((color->b * vertex.color.b) / 255);
         }
+        batch.push_back(vertex);
       }
+    };
 
-      draw = true;
-      if (faces_[order_[i]].n_points == 4)
-      {
-        draw = (draw && draw_sdl_[faces_[order_[i]].points[0]].active);
-        draw = (draw && draw_sdl_[faces_[order_[i]].points[2]].active);
-        draw = (draw && draw_sdl_[faces_[order_[i]].points[3]].active);
-      }
-      if (faces_[order_[i]].n_points == 4 && draw)
-      {
-        static SDL_Vertex triangle1[3];
-        triangle1[0] = draw_sdl_[faces_[order_[i]].points[3]].point;
-        triangle1[1] = draw_sdl_[faces_[order_[i]].points[2]].point;
-        triangle1[2] = draw_sdl_[faces_[order_[i]].points[0]].point;
+    // Draw Triangles
+    batch.clear();
+    for (int i = 0; i < nFaces; i++)
+    {
+      int index = order_[i];
+      const Faces &face = faces[index];
+      const SDL_Color *color = use_colors ? &colors[index] : nullptr;
 
-        if (fill_)
-        {
-          SDL_RenderGeometry(render, NULL, triangle1, 3, NULL, 0);
-        }
+      add_triangle(face.points[0], face.points[1], face.points[2], color);
+      if (face.n_points == 4)
+        add_triangle(face.points[3], face.points[2], face.points[0], color);
+    }
 
-        if (lines_)
-        {
-          SDL_RenderDrawLine(render, triangle1[0].position.x, triangle1[0].position.y,
-                             triangle1[1].position.x, triangle1[1].position.y);
-          SDL_RenderDrawLine(render, triangle1[1].position.x, triangle1[1].position.y,
-                             triangle1[2].position.x, triangle1[2].position.y);
-          SDL_RenderDrawLine(render, triangle1[2].position.x, triangle1[2].position.y,
-                             triangle1[0].position.x, triangle1[0].position.y);
-        }
+    if (material.fill && !batch.empty())
+    {
+      SDL_RenderGeometry(render, NULL, batch.data(), (int)batch.size(), NULL, 0);
+      batches_++;
+    }
+
+    if (material.lines)
+    {
+      for (int i = 0; i + 2 < (int)batch.size(); i += 3)
+      {
+        SDL_RenderDrawLine(render, batch[i].position.x, batch[i].position.y,
+                           batch[i + 1].position.x, batch[i + 1].position.y);
+        SDL_RenderDrawLine(render, batch[i + 1].position.x, batch[i + 1].position.y,
+                           batch[i + 2].position.x, batch[i + 2].position.y);
+        SDL_RenderDrawLine(render, batch[i + 2].position.x, batch[i + 2].position.y,
+                           batch[i].position.x, batch[i].position.y);
       }
     }
   }
   else
   {
     // That is for points_
-    for (int i = 0; i < vertex_; i++)
+    for (int j = 0; j < figure.n_points; j++)
     {
+      int i = figure.indices != nullptr ? figure.indices[j] : j;
       SDL_SetRenderDrawColor(render, RGBA(draw_sdl_[i].point.color));
       SDL_RenderDrawPoint(render, draw_sdl_[i].point.position.x, draw_sdl_[i].point.position.y);
     }
   }
 }
+#endif
 
 void Entity::print() {}
 
 Entity::~Entity()
 {
-  DESTROY(points_);
-
-  DESTROY(draw_sdl_);
-
-  DESTROY(faces_);
-
-  DESTROY(centers_);
-
-  DESTROY(order_);
+  release();
 }
@@ -1,7 +1,13 @@
 /// @author Marcos Jiménez Saz <jimenezsa@esat-alumni.com>
 
 #include "figures_3d.h"
+#include <mesh_simplify.h>
 #include <string>
+#include <map>
+#include <fstream>
+#include <cstring>
+
+Stream_Settings Figure::stream_settings_ = {false, 64 * 1024, 512 * 1024 * 1024};
 
 void Figure::count_faces(const tinyobj::shape_t &shape)
 {
@@ -22,10 +28,97 @@ void Figure::load_triangles(const tinyobj::shape_t &shape, int &cont)
     faces_[cont].points[0] = indices[face_ind].vertex_index;
     faces_[cont].points[1] = indices[face_ind + 1].vertex_index;
     faces_[cont].points[2] = indices[face_ind + 2].vertex_index;
+    if (faceMaterials_ != nullptr && face_ind / 3 < (int)shape.mesh.material_ids.size())
+      faceMaterials_[cont] = shape.mesh.material_ids[face_ind / 3];
     cont++;
   }
 }
 
+void Figure::bakeColors(const float *vertex_colors, const std::vector<tinyobj::material_t> &materials)
+{
+  for (int i = 0; i < nFaces_; i++)
+  {
+    float color[3] = {1.0f, 1.0f, 1.0f};
+
+    int material = faceMaterials_[i];
+    if (material >= 0 && material < (int)materials.size())
+    {
+      for (int c = 0; c < 3; c++)
+        color[c] = materials[material].diffuse[c];
+    }
+
+    if (vertex_colors != nullptr)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        float mean = 0.0f;
+        for (int j = 0; j < 3; j++)
+          mean += vertex_colors[faces_[i].points[j] * 3 + c];
+        color[c] *= mean / 3.0f;
+      }
+    }
+
+    faceColors_[i].r = (Uint8)(MathUtils::Clamp(color[0], 0.0f, 1.0f) * 255);
+    faceColors_[i].g = (Uint8)(MathUtils::Clamp(color[1], 0.0f, 1.0f) * 255);
+    faceColors_[i].b = (Uint8)(MathUtils::Clamp(color[2], 0.0f, 1.0f) * 255);
+    faceColors_[i].a = 255;
+  }
+}
+
+void Figure::obtainLods()
+{
+  clearLods();
+
+  std::vector<int> tris(nFaces_ * 3);
+  for (int i = 0; i < nFaces_; i++)
+  {
+    tris[i * 3] = faces_[i].points[0];
+    tris[i * 3 + 1] = faces_[i].points[1];
+    tris[i * 3 + 2] = faces_[i].points[2];
+  }
+
+  // Each level keeps about half of the faces of the previous one
+  const int kLevels = MAX_LOD_LEVELS - 1;
+  int targets[kLevels];
+  int *lod_tris[kLevels];
+  int *lod_ids[kLevels];
+  int lod_n_tris[kLevels];
+  for (int i = 0; i < kLevels; i++)
+  {
+    targets[i] = nFaces_ >> (i + 1);
+    lod_tris[i] = (int *)calloc(nFaces_ * 3, sizeof(int));
+    lod_ids[i] = (int *)calloc(nFaces_, sizeof(int));
+  }
+
+  int levels = Simplify_Triangles(points_, vertex_, tris.data(), nFaces_, targets, kLevels, lod_tris, lod_n_tris, lod_ids);
+
+  // The faces of each level keep the material of the face they come from
+  std::vector<int> materials;
+  std::vector<SDL_Color> colors;
+  for (int i = 0; i < levels; i++)
+  {
+    if (faceMaterials_ != nullptr)
+    {
+      materials.resize(lod_n_tris[i]);
+      colors.resize(lod_n_tris[i]);
+      for (int j = 0; j < lod_n_tris[i]; j++)
+      {
+        materials[j] = faceMaterials_[lod_ids[i][j]];
+        colors[j] = faceColors_[lod_ids[i][j]];
+      }
+      setLod(i + 1, 3, lod_tris[i], lod_n_tris[i], materials.data(), colors.data());
+    }
+    else
+      setLod(i + 1, 3, lod_tris[i], lod_n_tris[i]);
+  }
+
+  for (int i = 0; i < kLevels; i++)
+  {
+    DESTROY(lod_tris[i]);
+    DESTROY(lod_ids[i]);
+  }
+}
+
 int Figure::charger(const char *path)
 {
   tinyobj::attrib_t attrib;
@@ -34,6 +127,10 @@ int Figure::charger(const char *path)
   std::string warn;
   std::string err;
 
+  // The .mtl files are searched next to the model
+  std::string base_dir = path;
+  base_dir = base_dir.substr(0, base_dir.find_last_of("/\\") + 1);
+
   // load all data in Obj file
   //'triangulate'
   bool success = tinyobj::LoadObj(&attrib,
@@ -41,7 +138,8 @@ int Figure::charger(const char *path)
                                   &objmaterials,
                                   &warn,
                                   &err,
-                                  path); // model to load
+                                  path, // model to load
+                                  base_dir.c_str());
 
   // boilerplate error handling
   if (!err.empty())
@@ -72,7 +170,7 @@ int Figure::charger(const char *path)
 
   // Convert the face_inds into our format
   // Face_inds should all be triangles due to triangulate=true
-  nFaces_ = 1;
+  nFaces_ = 0;
   for (auto shape = shapes.begin(); shape < shapes.end(); shape++)
   {
     count_faces(*shape);
@@ -81,10 +179,30 @@ int Figure::charger(const char *path)
   faces_ = (Faces *)calloc(nFaces_, sizeof(Faces));
   std::cout << "nFaces_: " << nFaces_ << std::endl;
 
+  faceStorage_ = (int *)calloc(nFaces_ * 3, sizeof(int));
   for (int i = 0; i < nFaces_; ++i)
   {
     faces_[i].n_points = 3;
-    faces_[i].points = (int *)calloc(faces_[i].n_points, sizeof(int));
+    faces_[i].points = faceStorage_ + i * 3;
+  }
+
+  // Materials and vertex colors, only kept if the model has any of them
+  bool vertex_colors = false;
+  if (attrib.colors.size() == attrib.vertices.size())
+  {
+    for (int i = 0; i < (int)attrib.colors.size() && !vertex_colors; i++)
+    {
+      vertex_colors = attrib.colors[i] != 1.0f;
+    }
+  }
+  if (!objmaterials.empty() || vertex_colors)
+  {
+    faceMaterials_ = (int *)calloc(nFaces_, sizeof(int));
+    faceColors_ = (SDL_Color *)calloc(nFaces_, sizeof(SDL_Color));
+    for (int i = 0; i < nFaces_; i++)
+    {
+      faceMaterials_[i] = -1;
+    }
   }
 
   cont = 0;
@@ -93,6 +211,12 @@ int Figure::charger(const char *path)
     load_triangles(*shape, cont);
   }
 
+  if (faceMaterials_ != nullptr)
+  {
+    bakeColors(vertex_colors ? attrib.colors.data() : nullptr, objmaterials);
+    groupFaces();
+  }
+
   centers_ = (Vec3 *)calloc(nFaces_, sizeof(Vec3));
 
   for (int i = 0; i < nFaces_; i++)
@@ -104,9 +228,305 @@ int Figure::charger(const char *path)
 
   order_ = (int *)calloc(nFaces_, sizeof(int));
 
+  obtainLods();
+
   return 0;
 }
 
+// Index of a face corner, "v", "v/vt", "v//vn" or "v/vt/vn", negative indices are relative to the last point
+static int Parse_Corner(char *token, char **end, int n_points)
+{
+  long index = strtol(token, end, 10);
+  while (**end != '\0' && **end != ' ' && **end != '\t')
+    (*end)++;
+
+  if (index < 0)
+    return n_points + (int)index;
+  return (int)index - 1;
+}
+
+// Trims the spaces at the start and end of a line
+static std::string Trim(const char *line)
+{
+  std::string text = line;
+  size_t first = text.find_first_not_of(" \t");
+  size_t last = text.find_last_not_of(" \t");
+  if (first == std::string::npos)
+    return "";
+  return text.substr(first, last - first + 1);
+}
+
+// Peak memory of obtainLods: its buffers, the simplification, then the levels kept
+static size_t Lod_Memory(int n_points, int n_tris, bool colors)
+{
+  const int kLevels = MAX_LOD_LEVELS - 1;
+  size_t tris = (size_t)n_tris;
+
+  // The triangles, and the triangles and origin of every level
+  size_t bytes = tris * 3 * sizeof(int);
+  bytes += kLevels * tris * (3 * sizeof(int) + sizeof(int));
+  bytes += Simplify_Memory(n_points, n_tris);
+
+  // The levels keep about half of the faces of the previous one, all of them less than the faces
+  bytes += tris * (sizeof(Faces) + 3 * sizeof(int) + sizeof(Vec3));
+  bytes += kLevels * (size_t)n_points * (sizeof(int) + sizeof(bool));
+  if (colors)
+    bytes += tris * 2 * (sizeof(int) + sizeof(SDL_Color) + sizeof(Material_Group) + sizeof(int));
+  return bytes;
+}
+
+int Figure::chargerStreamed(const char *path)
+{
+  const size_t window = stream_settings_.window;
+
+  // First pass, only counts
+  int n_vertex = 0;
+  int n_tris = 0;
+  bool vertex_colors = false;
+  bool has_materials = false;
+  std::string mtllib;
+  int ret = Stream_Lines(path, window, [&](char *line)
+  {
+    if (line[0] == 'v' && line[1] == ' ')
+    {
+      n_vertex++;
+
+      // x y z r g b
+      char *cursor = line + 1;
+      char *end = cursor;
+      int values = 0;
+      while (values < 6)
+      {
+        strtof(cursor, &end);
+        if (end == cursor)
+          break;
+        cursor = end;
+        values++;
+      }
+      vertex_colors = vertex_colors || values == 6;
+    }
+    else if (line[0] == 'f' && line[1] == ' ')
+    {
+      char *cursor = line + 1;
+      char *end = cursor;
+      int corners = 0;
+      while (true)
+      {
+        Parse_Corner(cursor, &end, n_vertex);
+        if (end == cursor)
+          break;
+        cursor = end;
+        corners++;
+      }
+      if (corners >= 3)
+        n_tris += corners - 2;
+    }
+    else if (strncmp(line, "usemtl", 6) == 0)
+      has_materials = true;
+    else if (strncmp(line, "mtllib ", 7) == 0)
+      mtllib = Trim(line + 7);
+  });
+
+  if (ret != 0)
+  {
+    if (ret == 2)
+      std::cout << "ERROR: A line doesn't fit in the " << window << " bytes window" << std::endl;
+    return ret;
+  }
+
+  bool colors = has_materials || vertex_colors;
+
+  // Everything the Figure needs is allocated once, so the limit is checked before; the file has a buffer of its own
+  size_t bytes = window + BUFSIZ;
+  bytes += (size_t)n_vertex * (sizeof(Vec3) + sizeof(Render_Vert));
+  bytes += (size_t)n_tris * (sizeof(Faces) + 3 * sizeof(int) + sizeof(Vec3) + sizeof(int));
+  if (colors)
+    bytes += (size_t)n_tris * (sizeof(int) + sizeof(SDL_Color));
+
+  // Then the largest of the copies of groupFaces with the vertex colors, or the levels of detail
+  size_t grouping = colors ? (size_t)n_tris * (sizeof(Faces) + 2 * sizeof(int) + sizeof(SDL_Color) + sizeof(Material_Group)) : 0;
+  if (vertex_colors)
+    grouping += (size_t)n_vertex * 3 * sizeof(float);
+  bytes += std::max(grouping, Lod_Memory(n_vertex, n_tris, colors));
+  std::cout << "Vertex: " << n_vertex << ", nFaces_: " << n_tris << ", import memory: " << bytes / 1024 << " KB" << std::endl;
+  if (bytes > stream_settings_.memory_limit)
+  {
+    std::cout << "ERROR: The figure needs more than " << stream_settings_.memory_limit / 1024 << " KB" << std::endl;
+    return 3;
+  }
+
+  vertex_ = n_vertex;
+  points_ = (Vec3 *)calloc(vertex_, sizeof(Vec3));
+  draw_sdl_ = (Render_Vert *)calloc(vertex_, sizeof(Render_Vert));
+
+  nFaces_ = n_tris;
+  faces_ = (Faces *)calloc(nFaces_, sizeof(Faces));
+  faceStorage_ = (int *)calloc(nFaces_ * 3, sizeof(int));
+  for (int i = 0; i < nFaces_; i++)
+  {
+    faces_[i].n_points = 3;
+    faces_[i].points = faceStorage_ + i * 3;
+  }
+  centers_ = (Vec3 *)calloc(nFaces_, sizeof(Vec3));
+  order_ = (int *)calloc(nFaces_, sizeof(int));
+
+  if (colors)
+  {
+    faceMaterials_ = (int *)calloc(nFaces_, sizeof(int));
+    faceColors_ = (SDL_Color *)calloc(nFaces_, sizeof(SDL_Color));
+  }
+  float *point_colors = vertex_colors ? (float *)calloc(vertex_ * 3, sizeof(float)) : nullptr;
+
+  // The .mtl files are small, they are read whole next to the model
+  std::vector<tinyobj::material_t> materials;
+  std::map<std::string, int> material_map;
+  if (!mtllib.empty())
+  {
+    std::string base_dir = path;
+    base_dir = base_dir.substr(0, base_dir.find_last_of("/\\") + 1);
+    std::ifstream mtl_file(base_dir + mtllib);
+    if (mtl_file)
+    {
+      std::string warn;
+      std::string err;
+      tinyobj::LoadMtl(&material_map, &materials, &mtl_file, &warn, &err);
+      if (!err.empty())
+        std::cerr << err << std::endl;
+    }
+  }
+
+  // Second pass, writes the final buffers
+  int v = 0;
+  int t = 0;
+  int material = -1;
+  std::vector<int> corners;
+  ret = Stream_Lines(path, window, [&](char *line)
+  {
+    if (line[0] == 'v' && line[1] == ' ' && v < vertex_)
+    {
+      char *cursor = line + 1;
+      float values[6] = {0, 0, 0, 1, 1, 1};
+      for (int i = 0; i < 6; i++)
+      {
+        char *end = cursor;
+        float value = strtof(cursor, &end);
+        if (end == cursor)
+          break;
+        values[i] = value;
+        cursor = end;
+      }
+      points_[v] = {values[0], values[1], values[2]};
+      if (point_colors != nullptr)
+      {
+        point_colors[v * 3] = values[3];
+        point_colors[v * 3 + 1] = values[4];
+        point_colors[v * 3 + 2] = values[5];
+      }
+      v++;
+    }
+    else if (line[0] == 'f' && line[1] == ' ')
+    {
+      corners.clear();
+      char *cursor = line + 1;
+      char *end = cursor;
+      while (true)
+      {
+        int index = Parse_Corner(cursor, &end, v);
+        if (end == cursor)
+          break;
+        cursor = end;
+        corners.push_back(std::max(0, std::min(index, vertex_ - 1)));
+      }
+
+      // Polygons are triangulated as a fan
+      for (int i = 1; i + 1 < (int)corners.size() && t < nFaces_; i++)
+      {
+        faces_[t].points[0] = corners[0];
+        faces_[t].points[1] = corners[i];
+        faces_[t].points[2] = corners[i + 1];
+        if (faceMaterials_ != nullptr)
+          faceMaterials_[t] = material;
+        t++;
+      }
+    }
+    else if (strncmp(line, "usemtl", 6) == 0)
+    {
+      auto found = material_map.find(Trim(line + 6));
+      material = found != material_map.end() ? found->second : -1;
+    }
+  });
+
+  if (faceMaterials_ != nullptr)
+  {
+    bakeColors(point_colors, materials);
+    groupFaces();
+  }
+  DESTROY(point_colors);
+
+  for (int i = 0; i < nFaces_; i++)
+  {
+    centers_[i] = points_[faces_[i].points[0]] - points_[faces_[i].points[2]];
+    centers_[i] *= 0.5f;
+    centers_[i] += points_[faces_[i].points[2]];
+  }
+
+  obtainLods();
+
+  return ret;
+}
+
+void Figure::LoadReport()
+{
+  static const char *kModels[] = {
+      "../data/3d_obj/aether.obj",
+      "../data/3d_obj/cornell_box.obj",
+      "../data/3d_obj/cube-vertexcol.obj",
+      "../data/3d_obj/guy.obj",
+      "../data/3d_obj/hand.obj",
+      "../data/3d_obj/keqing.obj",
+      "../data/3d_obj/male.obj",
+      "../data/3d_obj/monkey.obj",
+      "../data/3d_obj/paimon.obj",
+      "../data/3d_obj/suzanne.obj",
+      "../data/3d_obj/tie_UV.obj",
+  };
+
+  bool streaming = stream_settings_.enabled;
+
+  char report[sizeof(kModels) / sizeof(kModels[0])][2][200];
+  for (int i = 0; i < (int)(sizeof(kModels) / sizeof(kModels[0])); i++)
+  {
+    for (int mode = 0; mode < 2; mode++)
+    {
+      stream_settings_.enabled = mode == 1;
+
+      size_t rss = Current_RSS();
+      Reset_Peak_RSS();
+      int size = 0;
+      int ret = 0;
+      {
+        Figure figure;
+        ret = figure.init(kModels[i], SDL_Color{255, 255, 255, 255});
+        size = figure.getSize();
+      }
+      size_t peak = Peak_RSS();
+
+      snprintf(report[i][mode], 200, "%-36s %-9s mesh %8d KB, peak RSS %8zu KB (+%zu KB)%s",
+               kModels[i], mode == 1 ? "streamed" : "tinyobj", size / 1024, peak / 1024,
+               (peak > rss ? peak - rss : 0) / 1024, ret != 0 ? " ERROR" : "");
+    }
+  }
+
+  stream_settings_.enabled = streaming;
+
+  std::cout << "Load memory report" << std::endl;
+  for (int i = 0; i < (int)(sizeof(kModels) / sizeof(kModels[0])); i++)
+  {
+    std::cout << report[i][0] << std::endl;
+    std::cout << report[i][1] << std::endl;
+  }
+}
+
 int Figure::init(const char *path, SDL_Color color, bool fill, Vec3 p_scale, Vec3 mov, Vec3 rot, Vec3 orbit, Vec3 orbit_center)
 {
   std::cout << "Creating figure..." << std::endl;
@@ -123,7 +543,17 @@ int Figure::init(const char *path, SDL_Color color, bool fill, Vec3 p_scale, Vec
   dim_ = 1;
   mov_ = {0, 0, 0};
 
-  int ret = charger(path);
+  // Peak memory of the import, over the memory the process had before it
+  size_t rss = Current_RSS();
+  Reset_Peak_RSS();
+
+  // An initialized figure releases its previous buffers
+  release();
+  int ret = stream_settings_.enabled ? chargerStreamed(path) : charger(path);
+  materials_ = faceColors_ != nullptr;
+
+  size_t peak = Peak_RSS();
+  std::cout << "Load peak RSS: " << peak / 1024 << " KB (+" << (peak > rss ? peak - rss : 0) / 1024 << " KB)" << std::endl;
 
   if (ret != 0)
   {
@@ -169,6 +599,9 @@ int Figure::init(const char *path, SDL_Color color, bool fill, Vec3 p_scale, Vec
   bytesSize += sizeof(float);
   bytesSize += sizeof(bool);
   bytesSize += sizeof(bool);
+  bytesSize += lodSize();
+  if (faceMaterials_ != nullptr)
+    bytesSize += (sizeof(int) + sizeof(SDL_Color)) * nFaces_ + sizeof(Material_Group) * nGroups_;
 
   std::cout << "Bytes size: " << bytesSize << std::endl;
   std::cout << "Real size " << sizeof(this) << std::endl;
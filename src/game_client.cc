@@ -2,30 +2,30 @@
 /// @file game_client.cc
 
 #include <game_client.h>
+#include <cstring>
+#include <thread>
+
+#define CLIENT_INPUT 65536 ///< The initial bytes of the input ring.
 
 GameClient::GameClient()
 {
-#ifdef _WIN32
-  WSADATA wsaData;
-  WSAStartup(MAKEWORD(2, 2), &wsaData);
-#endif
+  Net_Startup();
 
   m_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  m_input.reserve(CLIENT_INPUT);
 }
 
 GameClient::~GameClient()
 {
-#ifdef _WIN32
-  closesocket(m_socket);
-  WSACleanup();
-#elif __linux__
-  close(m_socket);
-#endif
+  if (m_socket != NET_INVALID_SOCKET)
+    Net_Close(m_socket);
+  Net_Cleanup();
 }
 
-void GameClient::connectToServer(const std::string &ipAddress, int port)
+int GameClient::connectToServer(const std::string &ipAddress, int port)
 {
   sockaddr_in serverAddr;
+  memset(&serverAddr, 0, sizeof(serverAddr));
   serverAddr.sin_family = AF_INET;
   serverAddr.sin_port = htons(port);
 #ifdef _WIN32
@@ -34,22 +34,73 @@ void GameClient::connectToServer(const std::string &ipAddress, int port)
   inet_aton(ipAddress.c_str(), &serverAddr.sin_addr);
 #endif
 
-  connect(m_socket, (sockaddr *)&serverAddr, sizeof(serverAddr));
+  // The connection waits, the messages don't
+  if (m_socket == NET_INVALID_SOCKET || connect(m_socket, (sockaddr *)&serverAddr, sizeof(serverAddr)) != 0 ||
+      Net_Set_Non_Blocking(m_socket) != 0)
+  {
+    std::cout << "ERROR: Can't connect to " << ipAddress << ":" << port << std::endl;
+    return 1;
+  }
+
+  Net_Write_Hello(m_writer);
+  return send(m_writer);
+}
+
+int GameClient::send(Net_Writer &writer)
+{
+  const std::vector<uint8_t> &bytes = writer.bytes();
+  size_t sent = 0;
+  while (sent < bytes.size())
+  {
+    int bytesSent = ::send(m_socket, (const char *)bytes.data() + sent, (int)(bytes.size() - sent), MSG_NOSIGNAL);
+    if (bytesSent < 0 && Net_Would_Block())
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    if (bytesSent <= 0)
+      return 1;
+    sent += bytesSent;
+  }
+  writer.clear();
+  return 0;
 }
 
-void GameClient::sendReceive()
+int GameClient::receive(const std::function<void(const Net_Message &message)> &handler)
 {
+  int frames = 0;
   while (true)
   {
-    char buffer[1024];
-    int bytesReceived = recv(m_socket, buffer, 1024, 0);
-    if (bytesReceived > 0)
+    // Every complete frame is handled before reading more
+    Net_Message message;
+    int parsed;
+    while ((parsed = Net_Parse(m_input, message, m_scratch)) == 1)
     {
-      std::cout << "Buffer: " << buffer << std::endl;
+      handler(message);
+      m_input.consume(NET_HEADER + message.header.length);
+      frames++;
     }
+    if (parsed < 0)
+      return -1;
 
-    // Enviar un mensaje al servidor
-    std::string message = "Hello from client!";
-    send(m_socket, message.c_str(), message.size() + 1, 0);
+    int contiguous;
+    uint8_t *tail = m_input.back(contiguous);
+    if (contiguous == 0)
+    {
+      m_input.reserve(m_input.capacity() * 2);
+      continue;
+    }
+
+    int bytesReceived = recv(m_socket, (char *)tail, contiguous, 0);
+    if (bytesReceived < 0 && Net_Would_Block())
+      return frames;
+    if (bytesReceived <= 0)
+      return -1;
+    m_input.produce(bytesReceived);
   }
 }
+
+Net_Writer &GameClient::writer()
+{
+  return m_writer;
+}
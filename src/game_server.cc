@@ -2,70 +2,712 @@
 /// @file game_server.cc
 
 #include <game_server.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <cerrno>
+#include <fcntl.h>
+#endif
+
+#define SERVER_ID 0        ///< The poller id of the server socket, the clients are their slot plus one.
+#define SERVER_EVENTS 1024 ///< The events handled per wait.
+#define SERVER_INPUT 4096  ///< The initial bytes of the input ring of a client.
+
+GameServer_Settings GameServer::settings_ = {12345, 10000, NET_HEADER + NET_MAX_PAYLOAD, 1 << 25, 60.0f};
 
 GameServer::GameServer()
 {
-#ifdef _WIN32
-  WSADATA wsaData;
-  WSAStartup(MAKEWORD(2, 2), &wsaData);
-#elif __linux__
+  Net_Startup();
 
+  m_socket = NET_INVALID_SOCKET;
+#ifdef __linux__
+  m_spare = -1;
 #endif
+  m_idleTimer = -1;
+  m_running = false;
+  m_start = std::chrono::steady_clock::now();
+  memset(&m_stats, 0, sizeof(m_stats));
+}
+
+GameServer::~GameServer()
+{
+  close();
+  Net_Cleanup();
+}
+
+int GameServer::open(int port, bool shared)
+{
+  close();
 
   m_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (m_socket == NET_INVALID_SOCKET)
+  {
+    std::cout << "ERROR: Server socket can't be created" << std::endl;
+    return 1;
+  }
+
+  // A restarted server takes the port again at once
+  int on = 1;
+  setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+  if (shared && Net_Share_Port(m_socket) != 0)
+  {
+    std::cout << "ERROR: Server can't share port " << port << std::endl;
+    close();
+    return 1;
+  }
 
   sockaddr_in serverAddr;
+  memset(&serverAddr, 0, sizeof(serverAddr));
   serverAddr.sin_family = AF_INET;
-  serverAddr.sin_port = htons(12345);
+  serverAddr.sin_port = htons((unsigned short)port);
   serverAddr.sin_addr.s_addr = INADDR_ANY;
 
-  bind(m_socket, (sockaddr *)&serverAddr, sizeof(serverAddr));
-  listen(m_socket, SOMAXCONN);
+  if (bind(m_socket, (sockaddr *)&serverAddr, sizeof(serverAddr)) != 0 || listen(m_socket, SOMAXCONN) != 0 ||
+      Net_Set_Non_Blocking(m_socket) != 0 || m_poller.open() != 0 || m_poller.add(m_socket, SERVER_ID) != 0)
+  {
+    std::cout << "ERROR: Server can't listen to port " << port << std::endl;
+    close();
+    return 1;
+  }
+
+#ifdef __linux__
+  m_spare = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+#endif
+  m_ready.resize(SERVER_EVENTS);
+  m_start = std::chrono::steady_clock::now();
+  memset(&m_stats, 0, sizeof(m_stats));
+  if (settings_.idle_timeout > 0.0f)
+    m_idleTimer = addTimer(1.0f, true, [](GameServer &server) { server.closeIdle(); });
+  return 0;
 }
 
-GameServer::~GameServer()
+void GameServer::close()
 {
-#ifdef _WIN32
-  closesocket(m_socket);
-  WSACleanup();
-#elif __linux__
-  close(m_socket);
+  for (int i = 0; i < (int)m_clients.size(); i++)
+    disconnect(i);
+  m_clients.clear();
+  m_free.clear();
+  m_timers.clear();
+  m_recorder.close();
+  m_idleTimer = -1;
+
+  m_poller.close();
+  if (m_socket != NET_INVALID_SOCKET)
+    Net_Close(m_socket);
+  m_socket = NET_INVALID_SOCKET;
+#ifdef __linux__
+  if (m_spare >= 0)
+    ::close(m_spare);
+  m_spare = -1;
 #endif
 }
 
-void GameServer::listenForConnections()
+int GameServer::port()
+{
+  if (m_socket == NET_INVALID_SOCKET)
+    return 0;
+
+  sockaddr_in address;
+  Net_Length length = sizeof(address);
+  if (getsockname(m_socket, (sockaddr *)&address, &length) != 0)
+    return 0;
+  return ntohs(address.sin_port);
+}
+
+void GameServer::setEvents(const GameServer_Events &events)
+{
+  m_events = events;
+}
+
+int GameServer::poll(int timeout)
+{
+  if (m_socket == NET_INVALID_SOCKET)
+    return -1;
+
+  // The wait ends in time for the next timer
+  int next = fireTimers();
+  if (next >= 0 && (timeout < 0 || next < timeout))
+    timeout = next;
+
+  int count = m_poller.wait(m_ready.data(), (int)m_ready.size(), timeout);
+  for (int i = 0; i < count; i++)
+  {
+    const Net_Event &event = m_ready[i];
+    if (event.id == SERVER_ID)
+    {
+      accept();
+      continue;
+    }
+
+    // A client closed by an earlier event can still have events in this wait
+    int client = (int)event.id - 1;
+    if (!connected(client))
+      continue;
+    if (event.read || event.error)
+      receive(client);
+    if (event.write && connected(client))
+      flush(client);
+  }
+  if (count > 0)
+    m_stats.events += count;
+
+  fireTimers();
+  return count;
+}
+
+void GameServer::run()
+{
+  m_running = true;
+  while (m_running && poll(100) >= 0)
+    ;
+  m_running = false;
+}
+
+void GameServer::stop()
+{
+  m_running = false;
+}
+
+void GameServer::accept()
 {
   while (true)
   {
     sockaddr_in clientAddr;
-#ifdef _WIN32
-    int clientAddrSize = sizeof(clientAddr);
-    SOCKET clientSocket = accept(m_socket, (sockaddr *)&clientAddr, &clientAddrSize);
-#elif __linux__
-    socklen_t clientAddrSize = sizeof(clientAddr);
-    int clientSocket = accept(m_socket, (sockaddr *)&clientAddr, &clientAddrSize);
+    Net_Length clientAddrSize = sizeof(clientAddr);
+    Net_Socket clientSocket = ::accept(m_socket, (sockaddr *)&clientAddr, &clientAddrSize);
+    if (clientSocket == NET_INVALID_SOCKET)
+    {
+      if (Net_Would_Block())
+        return;
+#ifdef __linux__
+      // A connection reset while queued is skipped; out of descriptors the spare one takes the next connection
+      // to close it, the others would wait for an edge that doesn't come
+      if (errno == ECONNABORTED || errno == EINTR)
+        continue;
+      if ((errno == EMFILE || errno == ENFILE) && m_spare >= 0)
+      {
+        ::close(m_spare);
+        Net_Socket rejected = ::accept(m_socket, nullptr, nullptr);
+        if (rejected != NET_INVALID_SOCKET)
+          Net_Close(rejected);
+        m_spare = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (rejected == NET_INVALID_SOCKET)
+          return;
+        std::cout << "ERROR: Server out of descriptors, a connection was closed" << std::endl;
+        continue;
+      }
 #endif
+      // WSAPoll reports the server socket again while connections wait
+      std::cout << "ERROR: Server can't accept more connections" << std::endl;
+      return;
+    }
 
-    Client client;
+    if (m_stats.clients >= settings_.max_clients || Net_Set_Non_Blocking(clientSocket) != 0)
+    {
+      Net_Close(clientSocket);
+      continue;
+    }
+
+    // The small messages of the game go out at once
+    int on = 1;
+    setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+
+    int slot;
+    if (!m_free.empty())
+    {
+      slot = m_free.back();
+      m_free.pop_back();
+    }
+    else
+    {
+      slot = (int)m_clients.size();
+      m_clients.push_back(Client());
+    }
+
+    Client &client = m_clients[slot];
     client.socket = clientSocket;
     client.address = clientAddr;
-    m_clients.push_back(client);
+    client.input.reserve(SERVER_INPUT);
+    client.sent = 0;
+    client.lastReceive = time();
+    if (m_poller.add(clientSocket, (uint64_t)slot + 1) != 0)
+    {
+      Net_Close(clientSocket);
+      client.socket = NET_INVALID_SOCKET;
+      m_free.push_back(slot);
+      continue;
+    }
+
+    m_stats.accepted++;
+    m_stats.clients++;
+    if (m_recorder.recording())
+      m_recorder.record(NET_RECORD_CONNECTED, slot, time(), nullptr, 0);
+    m_stats.peak = std::max(m_stats.peak, m_stats.clients);
+    if (m_events.connected)
+      m_events.connected(*this, slot);
   }
 }
 
-void GameServer::sendReceive()
+void GameServer::receive(int client)
 {
-  while (true)
+  while (connected(client))
+  {
+    // The ring grows while a message doesn't fit, up to the largest one
+    Net_Ring &input = m_clients[client].input;
+    int contiguous;
+    uint8_t *tail = input.back(contiguous);
+    if (contiguous == 0)
+    {
+      if (input.capacity() >= settings_.max_input)
+      {
+        std::cout << "ERROR: Client " << client << " sent a message too long, disconnected" << std::endl;
+        disconnect(client);
+        return;
+      }
+      input.reserve(input.capacity() * 2);
+      continue;
+    }
+
+    int bytesReceived = recv(m_clients[client].socket, (char *)tail, contiguous, 0);
+    if (bytesReceived < 0 && Net_Would_Block())
+      return;
+    if (bytesReceived <= 0)
+    {
+      disconnect(client);
+      return;
+    }
+    input.produce(bytesReceived);
+    m_stats.bytesIn += bytesReceived;
+    if (m_recorder.recording())
+      m_recorder.record(NET_RECORD_IN, client, time(), tail, bytesReceived);
+    m_clients[client].lastReceive = time();
+
+    if (m_events.received)
+    {
+      m_events.received(*this, client, input);
+      continue;
+    }
+
+    // Without a handler every byte goes back
+    while (input.size() > 0 && connected(client))
+    {
+      const uint8_t *data = input.front(contiguous);
+      if (send(client, data, contiguous) != 0)
+        return;
+      input.consume(contiguous);
+    }
+  }
+}
+
+int GameServer::send(int client, const void *data, int size)
+{
+  if (!connected(client))
+    return 1;
+
+  Client &target = m_clients[client];
+  const char *bytes = (const char *)data;
+  if (m_recorder.recording())
+    m_recorder.record(NET_RECORD_OUT, client, time(), data, size);
+
+  // Nothing waiting, the socket takes what it can now
+  if (target.sent == (int)target.output.size())
+  {
+    target.output.clear();
+    target.sent = 0;
+    while (size > 0)
+    {
+      int bytesSent = ::send(target.socket, bytes, size, MSG_NOSIGNAL);
+      if (bytesSent < 0 && Net_Would_Block())
+        break;
+      if (bytesSent <= 0)
+      {
+        disconnect(client);
+        return 1;
+      }
+      m_stats.bytesOut += bytesSent;
+      bytes += bytesSent;
+      size -= bytesSent;
+    }
+    if (size == 0)
+      return 0;
+  }
+
+  if ((int)target.output.size() - target.sent + size > settings_.max_output)
+  {
+    std::cout << "ERROR: Client " << client << " doesn't read, disconnected" << std::endl;
+    disconnect(client);
+    return 1;
+  }
+
+  // Only the first bytes waiting start the watch, the next ones are sent with them
+  bool waiting = target.sent < (int)target.output.size();
+  target.output.insert(target.output.end(), bytes, bytes + size);
+  if (!waiting)
+    m_poller.watchWrite(target.socket, (uint64_t)client + 1, true);
+  return 0;
+}
+
+void GameServer::flush(int client)
+{
+  Client &target = m_clients[client];
+  while (target.sent < (int)target.output.size())
+  {
+    int bytesSent = ::send(target.socket, target.output.data() + target.sent, (int)target.output.size() - target.sent, MSG_NOSIGNAL);
+    if (bytesSent < 0 && Net_Would_Block())
+      return;
+    if (bytesSent <= 0)
+    {
+      disconnect(client);
+      return;
+    }
+    m_stats.bytesOut += bytesSent;
+    target.sent += bytesSent;
+  }
+
+  target.output.clear();
+  target.sent = 0;
+  m_poller.watchWrite(target.socket, (uint64_t)client + 1, false);
+}
+
+void GameServer::disconnect(int client)
+{
+  if (!connected(client))
+    return;
+
+  // The slot is free before the event, the event can't reach the closed socket
+  Client &target = m_clients[client];
+  m_poller.remove(target.socket);
+  Net_Close(target.socket);
+  target.socket = NET_INVALID_SOCKET;
+  target.input.release();
+  std::vector<char>().swap(target.output);
+  target.sent = 0;
+  m_free.push_back(client);
+
+  m_stats.closed++;
+  m_stats.clients--;
+  if (m_recorder.recording())
+    m_recorder.record(NET_RECORD_DISCONNECTED, client, time(), nullptr, 0);
+  if (m_events.disconnected)
+    m_events.disconnected(*this, client);
+}
+
+bool GameServer::connected(int client)
+{
+  return client >= 0 && client < (int)m_clients.size() && m_clients[client].socket != NET_INVALID_SOCKET;
+}
+
+int GameServer::addTimer(float seconds, bool repeat, std::function<void(GameServer &)> callback)
+{
+  int timer = 0;
+  while (timer < (int)m_timers.size() && m_timers[timer].active)
+    timer++;
+  if (timer == (int)m_timers.size())
+    m_timers.push_back(GameServer_Timer());
+
+  GameServer_Timer &added = m_timers[timer];
+  added.due = time() + seconds;
+  added.interval = seconds;
+  added.repeat = repeat;
+  added.active = true;
+  added.callback = callback;
+  return timer;
+}
+
+void GameServer::removeTimer(int timer)
+{
+  if (timer >= 0 && timer < (int)m_timers.size())
+    m_timers[timer].active = false;
+}
+
+int GameServer::fireTimers()
+{
+  // The timers are few, a scan costs less than keeping them sorted
+  double now = time();
+  double next = -1.0;
+  for (int i = 0; i < (int)m_timers.size(); i++)
+  {
+    if (!m_timers[i].active)
+      continue;
+
+    if (m_timers[i].due <= now)
+    {
+      if (m_timers[i].repeat)
+        m_timers[i].due = std::max(m_timers[i].due + m_timers[i].interval, now);
+      else
+        m_timers[i].active = false;
+
+      // The callback can add timers, the vector can move
+      std::function<void(GameServer &)> callback = m_timers[i].callback;
+      callback(*this);
+      if (i >= (int)m_timers.size() || !m_timers[i].active)
+        continue;
+    }
+
+    if (next < 0.0 || m_timers[i].due < next)
+      next = m_timers[i].due;
+  }
+
+  if (next < 0.0)
+    return -1;
+  return (int)std::ceil(std::max(next - time(), 0.0) * 1000.0);
+}
+
+void GameServer::closeIdle()
+{
+  double now = time();
+  for (int i = 0; i < (int)m_clients.size(); i++)
+  {
+    if (connected(i) && now - m_clients[i].lastReceive > settings_.idle_timeout)
+      disconnect(i);
+  }
+}
+
+double GameServer::time()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+const GameServer_Stats &GameServer::stats()
+{
+  return m_stats;
+}
+
+int GameServer::startRecording(const std::string &path)
+{
+  return m_recorder.open(path);
+}
+
+void GameServer::stopRecording()
+{
+  m_recorder.close();
+}
+
+Net_Recorder &GameServer::recorder()
+{
+  return m_recorder;
+}
+
+#define LOAD_MESSAGE 64 ///< The bytes of the messages of the load generator.
+
+/**
+ * @brief A client of the load generator.
+ */
+struct Load_Client
+{
+  Net_Socket socket;                            ///< The connection to the server.
+  bool connected;                               ///< A flag indicating whether the connection is established.
+  int round;                                    ///< The round trips completed.
+  int sent;                                     ///< The bytes of the message sent.
+  int received;                                 ///< The bytes of the echo received.
+  char message[LOAD_MESSAGE];                   ///< The message of the current round.
+  std::chrono::steady_clock::time_point start; ///< The time the message was sent.
+};
+
+// Sends what is left of the message of the round
+static bool Load_Send(Load_Client &load)
+{
+  while (load.sent < LOAD_MESSAGE)
   {
-    for (int i = 0; i < (int)m_clients.size(); i++)
+    int bytesSent = ::send(load.socket, load.message + load.sent, LOAD_MESSAGE - load.sent, MSG_NOSIGNAL);
+    if (bytesSent < 0 && Net_Would_Block())
+      return true;
+    if (bytesSent <= 0)
+      return false;
+    load.sent += bytesSent;
+  }
+  return true;
+}
+
+// A new message, every byte depends on the client and the round
+static void Load_Start(Load_Client &load, int id)
+{
+  for (int i = 0; i < LOAD_MESSAGE; i++)
+    load.message[i] = (char)(id * 31 + load.round * 7 + i);
+  load.sent = 0;
+  load.received = 0;
+  load.start = std::chrono::steady_clock::now();
+}
+
+static int Load_Run(int clients, int rounds)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  GameServer server;
+  if (server.open(0) != 0)
+    return 1;
+  int port = server.port();
+  std::thread loop(&GameServer::run, &server);
+
+  Net_Poller poller;
+  poller.open();
+  std::vector<Load_Client> loads(clients);
+  std::vector<float> latencies;
+  latencies.reserve((size_t)clients * rounds);
+
+  sockaddr_in serverAddr;
+  memset(&serverAddr, 0, sizeof(serverAddr));
+  serverAddr.sin_family = AF_INET;
+  serverAddr.sin_port = htons((unsigned short)port);
+  serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  // Every client connects at once, without waiting for the others
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int errors = 0;
+  for (int i = 0; i < clients; i++)
+  {
+    Load_Client &load = loads[i];
+    load.socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    load.connected = false;
+    load.round = 0;
+    if (load.socket == NET_INVALID_SOCKET || Net_Set_Non_Blocking(load.socket) != 0 ||
+        (connect(load.socket, (sockaddr *)&serverAddr, sizeof(serverAddr)) != 0 && !Net_Would_Block()) ||
+        poller.add(load.socket, (uint64_t)i) != 0)
+    {
+      errors++;
+      continue;
+    }
+    int on = 1;
+    setsockopt(load.socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+    poller.watchWrite(load.socket, (uint64_t)i, true);
+  }
+
+  int connected = 0;
+  int finished = 0;
+  double connect_ms = 0.0;
+  std::vector<Net_Event> events(SERVER_EVENTS);
+  char buffer[LOAD_MESSAGE];
+  while (finished + errors < clients && Milliseconds(std::chrono::steady_clock::now() - start).count() < 60000.0)
+  {
+    int count = poller.wait(events.data(), SERVER_EVENTS, 100);
+    for (int e = 0; e < count; e++)
     {
-      Client &client = m_clients[i];
-      char buffer[1024];
-      int bytesReceived = recv(client.socket, buffer, 1024, 0);
-      if (bytesReceived > 0)
+      int id = (int)events[e].id;
+      Load_Client &load = loads[id];
+      if (load.socket == NET_INVALID_SOCKET || load.round == rounds)
+        continue;
+
+      bool ok = !events[e].error;
+      if (ok && events[e].write && !load.connected)
+      {
+        int error = 0;
+        Net_Length length = sizeof(error);
+        ok = getsockopt(load.socket, SOL_SOCKET, SO_ERROR, (char *)&error, &length) == 0 && error == 0;
+        if (ok)
+        {
+          load.connected = true;
+          if (++connected == clients)
+            connect_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+          Load_Start(load, id);
+        }
+      }
+      if (ok && load.connected)
+        ok = Load_Send(load);
+      if (ok && load.sent == LOAD_MESSAGE)
+        poller.watchWrite(load.socket, (uint64_t)id, false);
+
+      // The echo is read as it arrives, then the next round starts
+      while (ok && load.connected && events[e].read && load.round < rounds)
       {
-        std::cout << "Buffer: " << buffer << std::endl;
+        int bytesReceived = recv(load.socket, buffer, LOAD_MESSAGE - load.received, 0);
+        if (bytesReceived < 0 && Net_Would_Block())
+          break;
+        ok = bytesReceived > 0 && memcmp(buffer, load.message + load.received, bytesReceived) == 0;
+        if (!ok)
+          break;
+        load.received += bytesReceived;
+        if (load.received < LOAD_MESSAGE)
+          continue;
+
+        latencies.push_back((float)std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - load.start).count());
+        if (++load.round == rounds)
+        {
+          finished++;
+          break;
+        }
+        Load_Start(load, id);
+        ok = Load_Send(load);
+        if (ok && load.sent < LOAD_MESSAGE)
+          poller.watchWrite(load.socket, (uint64_t)id, true);
+      }
+
+      if (!ok)
+      {
+        poller.remove(load.socket);
+        Net_Close(load.socket);
+        load.socket = NET_INVALID_SOCKET;
+        errors++;
       }
     }
   }
+  double total_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+  // The clients leave together, the server saw all of them at once
+  for (Load_Client &load : loads)
+  {
+    if (load.socket != NET_INVALID_SOCKET)
+      Net_Close(load.socket);
+  }
+  server.stop();
+  loop.join();
+  GameServer_Stats stats = server.stats();
+
+  double mean = 0.0;
+  float p99 = 0.0f;
+  if (!latencies.empty())
+  {
+    for (float latency : latencies)
+      mean += latency;
+    mean /= latencies.size();
+    size_t index = latencies.size() * 99 / 100;
+    std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+    p99 = latencies[index];
+  }
+
+  printf("%-8d %-11.2f %-10.2f %-14.0f %-10.1f %-10.1f %-7d %d\n", clients, connect_ms, total_ms,
+         latencies.size() / (total_ms / 1000.0), mean, p99, stats.peak, errors);
+
+  if (finished < clients || stats.peak < clients)
+  {
+    printf("ERROR: %d of %d clients finished, %d served at once\n", finished, clients, stats.peak);
+    return 1;
+  }
+  return 0;
+}
+
+int GameServer_Benchmark(int clients, int rounds)
+{
+  std::vector<int> sizes;
+  if (clients > 0)
+    sizes.push_back(clients);
+  else
+    sizes = {100, 1000, 5000};
+  rounds = std::max(rounds, 1);
+
+#ifdef __linux__
+  // Every client takes two descriptors, its socket and the one accepted by the server
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+#endif
+
+  int max_clients = GameServer::settings_.max_clients;
+  GameServer::settings_.max_clients = std::max(max_clients, *std::max_element(sizes.begin(), sizes.end()));
+
+  int ret = 0;
+  printf("Clients  Connect ms  Total ms   Round trips/s  Mean us    P99 us     Peak    Errors\n");
+  for (int n : sizes)
+    ret |= Load_Run(n, rounds);
+
+  GameServer::settings_.max_clients = max_clients;
+  return ret;
 }
@@ -0,0 +1,103 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <kepler.h>
+#include <cmath>
+
+#define DEG_TO_RAD (PI / 180.0f)
+
+Orbital_Elements Kepler_Elements(float semi_major, float eccentricity, float inclination, float ascending_node,
+                                 float periapsis, float mean_anomaly, float period, Vec3 center)
+{
+  Orbital_Elements orbit;
+  orbit.semi_major = semi_major;
+  orbit.eccentricity = std::fmin(std::fmax(eccentricity, 0.0f), 0.99f);
+  orbit.inclination = inclination * DEG_TO_RAD;
+  orbit.ascending_node = ascending_node * DEG_TO_RAD;
+  orbit.periapsis = periapsis * DEG_TO_RAD;
+  orbit.mean_anomaly = mean_anomaly * DEG_TO_RAD;
+  orbit.mean_motion = period != 0.0f ? 2.0f * PI / period : 0.0f;
+  orbit.center = center;
+  Kepler_Init(orbit);
+
+  return orbit;
+}
+
+void Kepler_Init(Orbital_Elements &orbit)
+{
+  float cos_node = cosf(orbit.ascending_node);
+  float sin_node = sinf(orbit.ascending_node);
+  float cos_peri = cosf(orbit.periapsis);
+  float sin_peri = sinf(orbit.periapsis);
+  float cos_incl = cosf(orbit.inclination);
+  float sin_incl = sinf(orbit.inclination);
+
+  orbit.p = {cos_node * cos_peri - sin_node * sin_peri * cos_incl,
+             sin_node * cos_peri + cos_node * sin_peri * cos_incl,
+             sin_peri * sin_incl};
+  orbit.q = {-cos_node * sin_peri - sin_node * cos_peri * cos_incl,
+             -sin_node * sin_peri + cos_node * cos_peri * cos_incl,
+             cos_peri * sin_incl};
+}
+
+float Kepler_Solve(float mean_anomaly, float eccentricity)
+{
+  // Between -PI and PI, where the first guess is good
+  float m = fmodf(mean_anomaly, 2.0f * PI);
+  if (m > PI)
+    m -= 2.0f * PI;
+  else if (m < -PI)
+    m += 2.0f * PI;
+
+  float e = eccentricity;
+  float anomaly = e < 0.8f ? m + e * sinf(m) : (m < 0.0f ? -PI : PI);
+  for (int i = 0; i < KEPLER_ITERATIONS; i++)
+  {
+    float delta = (anomaly - e * sinf(anomaly) - m) / (1.0f - e * cosf(anomaly));
+    anomaly -= delta;
+    if (fabsf(delta) < KEPLER_TOLERANCE)
+      break;
+  }
+
+  return anomaly;
+}
+
+Vec3 Kepler_Position(const Orbital_Elements &orbit, double time)
+{
+  // The mean anomaly is wrapped in double, a float time loses the position after some hours
+  double mean = fmod((double)orbit.mean_anomaly + (double)orbit.mean_motion * time, 2.0 * PI);
+  float anomaly = Kepler_Solve((float)mean, orbit.eccentricity);
+
+  float e = orbit.eccentricity;
+  float x = orbit.semi_major * (cosf(anomaly) - e);
+  float y = orbit.semi_major * sqrtf(1.0f - e * e) * sinf(anomaly);
+
+  return orbit.center + orbit.p * x + orbit.q * y;
+}
+
+Orbital_Elements Kepler_From_Orbit(Vec3 position, const Entity_Orbit &orbit, float frame_rate, double time)
+{
+  Vec3 radius = position - orbit.center;
+  Vec3 axis = orbit.angle * orbit.vel;
+  float degrees = axis.Magnitude();
+  if (degrees == 0.0f || radius.Magnitude() == 0.0f || frame_rate <= 0.0f)
+    return Kepler_Elements(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, orbit.center);
+
+  // The normal of the orbit plane gives the inclination and the node
+  Vec3 normal = axis / degrees;
+  float inclination = acosf(std::fmin(std::fmax(normal.z, -1.0f), 1.0f));
+  float node = fabsf(normal.x) + fabsf(normal.y) > 1e-6f ? atan2f(normal.x, -normal.y) : 0.0f;
+
+  // Only the part of the radius in the plane is kept, the distance is the one of the body
+  Vec3 in_plane = radius - normal * Vec3::DotProduct(radius, normal);
+  if (in_plane.Magnitude() < 1e-6f)
+    return Kepler_Elements(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, orbit.center);
+
+  Orbital_Elements elements = Kepler_Elements(radius.Magnitude(), 0.0f, inclination / DEG_TO_RAD, node / DEG_TO_RAD,
+                                              0.0f, 0.0f, 360.0f / (degrees * frame_rate), orbit.center);
+
+  // The anomaly that puts the body at its position at the given time
+  float anomaly = atan2f(Vec3::DotProduct(in_plane, elements.q), Vec3::DotProduct(in_plane, elements.p));
+  elements.mean_anomaly = (float)fmod((double)anomaly - (double)elements.mean_motion * time, 2.0 * PI);
+
+  return elements;
+}
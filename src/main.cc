@@ -8,6 +8,120 @@ int main(int argc, char **argv)
   system("title Solar System");
   srand(time(nullptr));
 
+  // Command line: --scene file [--bench frames], --generate bodies seed file, --convert file file, --stress bodies rounds,
+  // --nbody bodies steps [--energy] (the energy drift too), --bvh items frames, --collide bodies steps (0 bodies or
+  // items runs 1k, 10k and 100k), --particles count frames (0 runs 10k, 100k and 1M), --server-bench clients rounds
+  // (0 runs 100, 1k and 5k), --net-fuzz iterations, --host port (headless server of the scene), --connect ip port
+  // (viewer of a server), --connect-udp ip port (viewer over UDP), --replication entities ticks (0 entities runs 1k and 100k),
+  // --udp-bench loss latency (loss in %, -1 runs 0, 5 and 20; latency in ms), --interest entities ticks (0 entities
+  // runs 1k, 10k and 100k), --shards count (threads of --host, 0 one per core), --shards-bench shards clients (0 shards
+  // runs 1, 2, 4... up to the cores; 0 clients runs 256), --record file (log of the connections of --host),
+  // --replay file client (plays a log back at full speed, -1 for its first client), --quantize entities rounds (0 entities
+  // runs 10k, 100k and 1M)
+  const char *scene_path = nullptr;
+  int bench_frames = 0;
+  int host_port = -1;
+  int host_shards = -1;
+  const char *record_path = nullptr;
+  const char *connect_ip = nullptr;
+  int connect_port = 0;
+  bool connect_udp = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+      scene_path = argv[++i];
+    else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+      bench_frames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--generate") == 0 && i + 3 < argc)
+    {
+      Scene scene;
+      Scene_Generate(scene, atoi(argv[i + 1]), (uint32_t)strtoul(argv[i + 2], nullptr, 10), {g_middle_win.x, g_middle_win.y, 0.0f});
+      return Scene_Save(argv[i + 3], scene);
+    }
+    else if (strcmp(argv[i], "--convert") == 0 && i + 2 < argc)
+    {
+      Scene scene;
+      int ret = Scene_Load(argv[i + 1], scene);
+      return ret != 0 ? ret : Scene_Save(argv[i + 2], scene);
+    }
+    else if (strcmp(argv[i], "--stress") == 0 && i + 2 < argc)
+      return Registry_Stress(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--nbody") == 0 && i + 2 < argc)
+      return Physics_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]), i + 3 < argc && strcmp(argv[i + 3], "--energy") == 0);
+    else if (strcmp(argv[i], "--bvh") == 0 && i + 2 < argc)
+      return Bvh_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--collide") == 0 && i + 2 < argc)
+      return Collision_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--particles") == 0 && i + 2 < argc)
+      return Particles_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--server-bench") == 0 && i + 2 < argc)
+      return GameServer_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--net-fuzz") == 0 && i + 1 < argc)
+      return Net_Fuzz(atoi(argv[i + 1]));
+    else if (strcmp(argv[i], "--replication") == 0 && i + 2 < argc)
+      return Replication_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--interest") == 0 && i + 2 < argc)
+      return Replication_Interest_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--udp-bench") == 0 && i + 2 < argc)
+      return Udp_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--shards-bench") == 0 && i + 2 < argc)
+      return Replication_Shards_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc)
+      host_port = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+      host_shards = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      record_path = argv[++i];
+    else if (strcmp(argv[i], "--replay") == 0 && i + 2 < argc)
+      return Replication_Replay(argv[i + 1], atoi(argv[i + 2]));
+    else if (strcmp(argv[i], "--quantize") == 0 && i + 2 < argc)
+      return Quantize_Benchmark(atoi(argv[i + 1]), atoi(argv[i + 2]));
+    else if ((strcmp(argv[i], "--connect") == 0 || strcmp(argv[i], "--connect-udp") == 0) && i + 2 < argc)
+    {
+      connect_udp = strcmp(argv[i], "--connect-udp") == 0;
+      connect_ip = argv[++i];
+      connect_port = atoi(argv[++i]);
+    }
+  }
+
+  // Scene update without window
+  if (bench_frames > 0 && scene_path != nullptr)
+    return Scene_Benchmark(scene_path, bench_frames, g_max_win);
+
+  // Simulation without window, the viewers connect to it
+  if (host_port >= 0)
+  {
+    Registry registry;
+    Vec3 light;
+    Render drawRender;
+    Scene scene;
+    if (scene_path != nullptr && Scene_Load(scene_path, scene) == 0)
+      Scene_Instantiate(scene, registry, light, drawRender, g_max_win);
+    else
+      Basic_Objects_Init(registry, light, drawRender);
+
+    // The shards simulate in this thread and send from one thread each
+    if (host_shards >= 0)
+    {
+      if (record_path != nullptr)
+        std::cout << "ERROR: The shards can't record, --record needs a single server" << std::endl;
+      Replication_Shards shards;
+      if (shards.open(host_port, registry, host_shards) != 0)
+        return 1;
+      std::cout << "Hosting " << registry.count() << " objects on port " << shards.port() << " with " << shards.shards()
+                << " shards, TCP and UDP" << std::endl;
+      shards.run();
+      return 0;
+    }
+
+    Replication_Server server;
+    if (server.open(host_port, registry) != 0 || (record_path != nullptr && server.server().startRecording(record_path) != 0))
+      return 1;
+    std::cout << "Hosting " << registry.count() << " objects on port " << server.server().port() << ", TCP and UDP" << std::endl;
+    server.server().run();
+    return 0;
+  }
+
   // Inputs init
   InitKeyboard();
 
@@ -32,12 +146,25 @@ int main(int argc, char **argv)
   Debug_Window::Init(win.window, win.render);
 
   // Variables init
-  std::vector<struct Objects> objects(5);
+  Registry registry;
   Vec3 light;
   Render drawRender;
-  Vec3 *objects_mov = nullptr;
-  Vec3 *objects_scale = nullptr;
-  Basic_Objects_Init(objects, light, drawRender, &objects_mov, &objects_scale);
+  Scene scene;
+  Replication_Client client;
+  bool replicated = false;
+  if (connect_ip != nullptr)
+  {
+    // The server simulates and merges, the viewer only shows its snapshots
+    Collider::settings_.enabled = false;
+    Physics::settings_.enabled = false;
+    replicated = client.connect(connect_ip, connect_port, connect_udp) == 0;
+    light = {g_middle_win.x, g_middle_win.y, 0.0f};
+    drawRender.init(g_max_win, {g_middle_win.x, g_middle_win.y, 100});
+  }
+  else if (scene_path != nullptr && Scene_Load(scene_path, scene) == 0)
+    Scene_Instantiate(scene, registry, light, drawRender, g_max_win);
+  else
+    Basic_Objects_Init(registry, light, drawRender);
 
   // Print window data on console
   std::cout << "Window Information" << std::endl;
@@ -55,59 +182,30 @@ int main(int argc, char **argv)
     // Limits camera draw & light
     drawRender.cameraDraw(win.render, {win.win_x, win.win_y}, light);
 
-    // Objects orbit
-    // Get the positioning variables on the screen
-    for (int i = 0; i < (int)objects.size(); i++)
+    // Objects follow the server, or orbit; destroyed objects are removed. The server sends what the camera sees
+    if (replicated)
+      client.view(drawRender);
+    if (replicated && client.update(registry) < 0)
     {
-      switch (objects.at(i).type)
-      {
-      case typeSphere:
-        objects.at(i).sphere.orbit();
-        objects_mov[i] = objects.at(i).sphere.mov_;
-        objects_scale[i] = objects.at(i).sphere.getScale();
-        break;
-      case typeCube:
-        objects.at(i).cube.orbit();
-        objects_mov[i] = objects.at(i).cube.mov_;
-        objects_scale[i] = objects.at(i).cube.getScale();
-        break;
-      case typeFigure:
-        objects.at(i).figure.orbit();
-        objects_mov[i] = objects.at(i).figure.mov_;
-        objects_scale[i] = objects.at(i).figure.getScale();
-        break;
-      }
+      std::cout << "ERROR: Connection with the server lost" << std::endl;
+      replicated = false;
     }
+    registry.update();
 
-    // Drawing order on screen
-    int *order = drawRender.getOrder(objects_mov, objects_scale, objects.size());
-
-    // Objects draw
-    for (int i = 0; i < (int)objects.size(); i++)
-    {
-      switch (objects.at(order[i]).type)
-      {
-      case typeSphere:
-        objects.at(order[i]).sphere.draw(win.render, drawRender, light, order[i]);
-        break;
-      case typeCube:
-        objects.at(order[i]).cube.draw(win.render, drawRender, light, order[i]);
-        break;
-      case typeFigure:
-        objects.at(order[i]).figure.draw(win.render, drawRender, light, order[i]);
-        break;
-      }
-    }
+    // Objects draw, back to front
+    registry.draw(win.render, drawRender, light);
 
     // ImGui window for objects control
-    if (EVENT_DOWN(F11))
-      objects.at(1).sphere.startDestroy();
+    if (EVENT_DOWN(F11) && registry.count() > 1)
+      registry.entity(registry.handle(1))->startDestroy();
     if (EVENT_DOWN(F12))
       showImgui = !showImgui;
     if (showImgui)
     {
       Camera_Control(drawRender, win, {win.win_x, win.win_y}, light);
-      Objects_Control(objects, &objects_mov, &objects_scale, g_max_win);
+      Objects_Control(registry, drawRender, g_max_win);
+      if (connect_ip != nullptr)
+        Network_Control(client);
     }
 
     // End of grafic window
@@ -124,28 +222,35 @@ int main(int argc, char **argv)
   return 0;
 }
 
-void Basic_Objects_Init(std::vector<struct Objects> &objects, Vec3 &light, Render &drawRender, Vec3 **objects_mov, Vec3 **objects_scale)
+void Basic_Objects_Init(Registry &registry, Vec3 &light, Render &drawRender)
 {
   std::cout << "Sizeof Entity: " << sizeof(class Entity) << std::endl;
 
   std::cout << "Generating objects..." << std::endl;
 
-  for (int i = 0; i < 5; i++)
-    objects.at(i).type = typeSphere;
-  objects.at(0).sphere.init(SDL_Color{255, 255, 255, 100}, true, 20, {30, 30, 30}, {g_middle_win.x, g_middle_win.y, 0.0f});
-  objects.at(1).sphere.init(g_colors[RED], true, 10, {5, 5, 5}, {objects.at(0).sphere.mov_.x - 40, objects.at(0).sphere.mov_.y + 40, 0.0f}, {0, 0, 0}, {0.01f, 0.01f, 0.0f}, objects.at(0).sphere.mov_);
-  objects.at(2).sphere.init(g_colors[GREEN], true, 10, {5, 5, 5}, {objects.at(0).sphere.mov_.x, objects.at(0).sphere.mov_.y + 40, 0.0f}, {0, 0, 0}, {0.01f, 0.0f, 0.0f}, objects.at(0).sphere.mov_);
-  objects.at(3).sphere.init(g_colors[BLUE], true, 10, {5, 5, 5}, {objects.at(0).sphere.mov_.x - 60, objects.at(0).sphere.mov_.y, 0.0f}, {0, 0, 0}, {0.0f, 0.01f, 0.0f}, objects.at(0).sphere.mov_);
-  objects.at(4).sphere.init(g_colors[CYAN], true, 10, {5, 5, 5}, {objects.at(0).sphere.mov_.x + 60, objects.at(0).sphere.mov_.y + 60, 0.0f}, {0, 0, 0}, {0.01f, -0.01f, 0.0f}, objects.at(0).sphere.mov_);
+  Sphere spheres[6];
+  spheres[0].init(SDL_Color{255, 255, 255, 100}, true, 20, {30, 30, 30}, {g_middle_win.x, g_middle_win.y, 0.0f});
+  spheres[1].init(g_colors[RED], true, 10, {5, 5, 5}, {spheres[0].mov_.x - 40, spheres[0].mov_.y + 40, 0.0f}, {0, 0, 0}, {0.01f, 0.01f, 0.0f}, spheres[0].mov_);
+  spheres[2].init(g_colors[GREEN], true, 10, {5, 5, 5}, {spheres[0].mov_.x, spheres[0].mov_.y + 40, 0.0f}, {0, 0, 0}, {0.01f, 0.0f, 0.0f}, spheres[0].mov_);
+  spheres[3].init(g_colors[BLUE], true, 10, {5, 5, 5}, {spheres[0].mov_.x - 60, spheres[0].mov_.y, 0.0f}, {0, 0, 0}, {0.0f, 0.01f, 0.0f}, spheres[0].mov_);
+  spheres[4].init(g_colors[CYAN], true, 10, {5, 5, 5}, {spheres[0].mov_.x + 60, spheres[0].mov_.y + 60, 0.0f}, {0, 0, 0}, {0.01f, -0.01f, 0.0f}, spheres[0].mov_);
+  spheres[5].init(SDL_Color{200, 200, 200, 255}, true, 10, {2, 2, 2}, {spheres[2].mov_.x, spheres[2].mov_.y + 12, 0.0f}, {0, 0, 0}, {0.0f, 0.0f, 0.02f}, spheres[2].mov_);
   for (int i = 1; i < 5; i++)
-    objects.at(i).sphere.orbit_vel_ = 45.0f;
+    spheres[i].orbit_vel_ = 45.0f;
+  spheres[5].orbit_vel_ = 90.0f;
 
-  std::cout << "Objects generated" << std::endl;
+  light = spheres[0].mov_;
 
-  light = objects.at(0).sphere.mov_;
+  // The planets follow the sun and the moon follows the green planet
+  int handles[6];
+  registry.reserve(6);
+  for (int i = 0; i < 6; i++)
+    handles[i] = registry.add(typeSphere, std::move(spheres[i]));
+  for (int i = 1; i < 5; i++)
+    registry.setParent(handles[i], handles[0]);
+  registry.setParent(handles[5], handles[2]);
 
-  *objects_mov = (Vec3 *)realloc(*objects_mov, objects.size() * sizeof(Vec3));
-  *objects_scale = (Vec3 *)realloc(*objects_scale, objects.size() * sizeof(Vec3));
+  std::cout << "Objects generated" << std::endl;
 
   drawRender.init(g_max_win, {g_middle_win.x, g_middle_win.y, 100});
 }
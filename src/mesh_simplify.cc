@@ -0,0 +1,281 @@
+/// @author Marcos Jiménez Saz <jimenezsa@esat-alumni.com>
+
+#include <mesh_simplify.h>
+#include <vector>
+#include <queue>
+#include <algorithm>
+
+/**
+ * @struct Quadric.
+ *
+ * @brief Symmetric 4x4 error matrix, only the upper triangle is stored.
+ */
+struct Quadric
+{
+  double q[10]; ///< a², ab, ac, ad, b², bc, bd, c², cd, d².
+};
+
+/**
+ * @struct Collapse.
+ *
+ * @brief A candidate edge collapse in the priority queue.
+ */
+struct Collapse
+{
+  double cost; ///< Quadric error of the collapse.
+  int from;    ///< The vertex that disappears.
+  int to;      ///< The vertex that survives.
+  int stamp_from; ///< Stamp of from when the collapse was evaluated.
+  int stamp_to;   ///< Stamp of to when the collapse was evaluated.
+
+  bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+static void Quadric_Add_Plane(Quadric &quadric, double a, double b, double c, double d, double w)
+{
+  quadric.q[0] += w * a * a;
+  quadric.q[1] += w * a * b;
+  quadric.q[2] += w * a * c;
+  quadric.q[3] += w * a * d;
+  quadric.q[4] += w * b * b;
+  quadric.q[5] += w * b * c;
+  quadric.q[6] += w * b * d;
+  quadric.q[7] += w * c * c;
+  quadric.q[8] += w * c * d;
+  quadric.q[9] += w * d * d;
+}
+
+static double Quadric_Error(const Quadric &a, const Quadric &b, const Vec3 &p)
+{
+  double q[10];
+  for (int i = 0; i < 10; i++)
+    q[i] = a.q[i] + b.q[i];
+
+  double x = p.x, y = p.y, z = p.z;
+  return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+         q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+         q[7] * z * z + 2 * q[8] * z +
+         q[9];
+}
+
+static Vec3 Triangle_Normal(const Vec3 &a, const Vec3 &b, const Vec3 &c)
+{
+  return Vec3::CrossProduct(b - a, c - a);
+}
+
+size_t Simplify_Memory(int n_points, int n_tris)
+{
+  size_t points = (size_t)std::max(n_points, 0);
+  size_t tris = (size_t)std::max(n_tris, 0);
+
+  // The triangles and their flags, the flags, stamps, quadrics and triangle lists of the points
+  size_t bytes = tris * 3 * sizeof(int) + tris / 8 + points / 8;
+  bytes += points * (sizeof(int) + sizeof(Quadric) + sizeof(std::vector<int>));
+
+  // Every triangle is in the lists of its 3 points, a list takes up to twice its triangles
+  bytes += tris * 3 * sizeof(int) * 2;
+
+  // The edges, and the queue of collapses: every edge once plus the reevaluated neighbours of
+  // every collapse, about 6 per point, at twice its entries
+  bytes += tris * 3 * sizeof(long long);
+  bytes += (tris * 3 + points * 6) * sizeof(Collapse) * 2;
+  return bytes;
+}
+
+int Simplify_Triangles(const Vec3 *points, int n_points, const int *tris, int n_tris,
+                       const int *targets, int n_targets, int **out_tris, int *out_n_tris,
+                       int **out_ids)
+{
+  if (n_points <= 0 || n_tris <= 0 || n_targets <= 0)
+    return 0;
+
+  std::vector<int> tri(tris, tris + n_tris * 3);
+  std::vector<bool> tri_alive(n_tris, true);
+  std::vector<bool> vert_alive(n_points, true);
+  std::vector<int> stamp(n_points, 0);
+  std::vector<Quadric> quadrics(n_points, Quadric{{0}});
+  std::vector<std::vector<int>> vert_tris(n_points);
+
+  int live = 0;
+  for (int t = 0; t < n_tris; t++)
+  {
+    int i0 = tri[t * 3], i1 = tri[t * 3 + 1], i2 = tri[t * 3 + 2];
+    if (i0 == i1 || i1 == i2 || i2 == i0 ||
+        i0 < 0 || i1 < 0 || i2 < 0 || i0 >= n_points || i1 >= n_points || i2 >= n_points)
+    {
+      tri_alive[t] = false;
+      continue;
+    }
+    live++;
+
+    vert_tris[i0].push_back(t);
+    vert_tris[i1].push_back(t);
+    vert_tris[i2].push_back(t);
+
+    // Plane of the triangle weighted by its area
+    Vec3 normal = Triangle_Normal(points[i0], points[i1], points[i2]);
+    float length = normal.Magnitude();
+    if (length <= 0.0f)
+      continue;
+    normal /= length;
+    double d = -Vec3::DotProduct(normal, points[i0]);
+    for (int j = 0; j < 3; j++)
+      Quadric_Add_Plane(quadrics[tri[t * 3 + j]], normal.x, normal.y, normal.z, d, length * 0.5);
+  }
+
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+  auto push_edge = [&](int u, int v)
+  {
+    double cost_uv = Quadric_Error(quadrics[u], quadrics[v], points[v]);
+    double cost_vu = Quadric_Error(quadrics[u], quadrics[v], points[u]);
+    if (cost_uv <= cost_vu)
+      heap.push(Collapse{cost_uv, u, v, stamp[u], stamp[v]});
+    else
+      heap.push(Collapse{cost_vu, v, u, stamp[v], stamp[u]});
+  };
+
+  // Unique edges of the mesh
+  std::vector<long long> edges;
+  edges.reserve(live * 3);
+  for (int t = 0; t < n_tris; t++)
+  {
+    if (!tri_alive[t])
+      continue;
+    for (int j = 0; j < 3; j++)
+    {
+      long long a = tri[t * 3 + j], b = tri[t * 3 + (j + 1) % 3];
+      edges.push_back(std::min(a, b) * n_points + std::max(a, b));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  for (long long edge : edges)
+    push_edge((int)(edge / n_points), (int)(edge % n_points));
+
+  auto snapshot = [&](int level)
+  {
+    int cont = 0;
+    for (int t = 0; t < n_tris; t++)
+    {
+      if (!tri_alive[t])
+        continue;
+      out_tris[level][cont * 3] = tri[t * 3];
+      out_tris[level][cont * 3 + 1] = tri[t * 3 + 1];
+      out_tris[level][cont * 3 + 2] = tri[t * 3 + 2];
+      if (out_ids != nullptr)
+        out_ids[level][cont] = t;
+      cont++;
+    }
+    out_n_tris[level] = cont;
+  };
+
+  int level = 0;
+  std::vector<int> neighbours;
+  while (level < n_targets)
+  {
+    if (live <= targets[level])
+    {
+      snapshot(level);
+      level++;
+      continue;
+    }
+
+    if (heap.empty())
+      break;
+
+    Collapse collapse = heap.top();
+    heap.pop();
+
+    int from = collapse.from;
+    int to = collapse.to;
+    if (!vert_alive[from] || !vert_alive[to] ||
+        stamp[from] != collapse.stamp_from || stamp[to] != collapse.stamp_to)
+      continue;
+
+    // Reject collapses that flip a triangle around the removed vertex
+    bool flips = false;
+    for (int t : vert_tris[from])
+    {
+      if (!tri_alive[t])
+        continue;
+      int *face = &tri[t * 3];
+      if (face[0] == to || face[1] == to || face[2] == to)
+        continue;
+
+      Vec3 before = Triangle_Normal(points[face[0]], points[face[1]], points[face[2]]);
+      Vec3 moved[3];
+      for (int j = 0; j < 3; j++)
+        moved[j] = points[face[j] == from ? to : face[j]];
+      Vec3 after = Triangle_Normal(moved[0], moved[1], moved[2]);
+      if (Vec3::DotProduct(before, after) <= 0.0f)
+      {
+        flips = true;
+        break;
+      }
+    }
+    if (flips)
+      continue;
+
+    // Move every triangle of from onto to
+    for (int t : vert_tris[from])
+    {
+      if (!tri_alive[t])
+        continue;
+      int *face = &tri[t * 3];
+      if (face[0] == to || face[1] == to || face[2] == to)
+      {
+        tri_alive[t] = false;
+        live--;
+        continue;
+      }
+      for (int j = 0; j < 3; j++)
+      {
+        if (face[j] == from)
+          face[j] = to;
+      }
+      vert_tris[to].push_back(t);
+    }
+    vert_tris[from].clear();
+    vert_tris[from].shrink_to_fit();
+
+    vert_alive[from] = false;
+    for (int i = 0; i < 10; i++)
+      quadrics[to].q[i] += quadrics[from].q[i];
+    stamp[from]++;
+    stamp[to]++;
+
+    // Compact the triangle list of to and reevaluate its edges
+    std::vector<int> &to_tris = vert_tris[to];
+    to_tris.erase(std::remove_if(to_tris.begin(), to_tris.end(), [&](int t)
+                                 { return !tri_alive[t]; }),
+                  to_tris.end());
+
+    neighbours.clear();
+    for (int t : to_tris)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        if (tri[t * 3 + j] != to)
+          neighbours.push_back(tri[t * 3 + j]);
+      }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    for (int neighbour : neighbours)
+      push_edge(to, neighbour);
+  }
+
+  // The mesh can't be reduced more, keep what was reached if it is still a reduction
+  if (level < n_targets)
+  {
+    int previous = level > 0 ? out_n_tris[level - 1] : n_tris;
+    if (live < previous)
+    {
+      snapshot(level);
+      level++;
+    }
+  }
+
+  return level;
+}
@@ -0,0 +1,128 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_interest.cc
+
+#include <net_interest.h>
+#include <algorithm>
+#include <cstdint>
+
+Interest_Settings Interest_Grid::settings_ = {true, 32.0f, 8192, 16384};
+
+// The cell of a coordinate, rounded down without calling floorf
+static int Cell(float value, float size)
+{
+  float cell = value / size;
+  int truncated = (int)cell;
+  return truncated - (cell < truncated);
+}
+
+// The bucket of a cell, the hash of the Collider
+static int Bucket(int x, int y, int z, int buckets)
+{
+  return (int)(((uint32_t)y * 0x9E3779B1u + (uint32_t)z * 0x85EBCA77u + (uint32_t)x) & (uint32_t)(buckets - 1));
+}
+
+Interest_Grid::Interest_Grid()
+{
+  m_positions = nullptr;
+  m_radii = nullptr;
+  m_count = 0;
+}
+
+void Interest_Grid::build(const Vec3 *positions, const float *radii, int count)
+{
+  m_positions = positions;
+  m_radii = radii;
+  m_count = count;
+  m_used.clear();
+  if (count == 0)
+    return;
+
+  int n_buckets = 1;
+  while (n_buckets < count)
+    n_buckets *= 2;
+  float size = std::max(settings_.cell, 0.001f);
+
+  // Counting sort of the bodies by bucket, the buckets of the bodies are kept in m_sorted meanwhile
+  m_starts.assign(n_buckets + 1, 0);
+  m_sorted.resize(count);
+  for (int i = 0; i < count; i++)
+  {
+    m_sorted[i] = Bucket(Cell(positions[i].x, size), Cell(positions[i].y, size), Cell(positions[i].z, size), n_buckets);
+    m_starts[m_sorted[i] + 1]++;
+  }
+  for (int b = 0; b < n_buckets; b++)
+  {
+    if (m_starts[b + 1] > 0)
+      m_used.push_back(b);
+    m_starts[b + 1] += m_starts[b];
+  }
+  std::vector<int> buckets(m_sorted);
+  std::vector<int> next(m_starts.begin(), m_starts.end() - 1);
+  for (int i = 0; i < count; i++)
+    m_sorted[next[buckets[i]]++] = i;
+
+  // The box of every bucket holds the spheres of its bodies
+  m_boxes.resize(n_buckets);
+  for (int b : m_used)
+  {
+    Interest_Box &box = m_boxes[b];
+    int first = m_sorted[m_starts[b]];
+    box.min = positions[first] - Vec3{radii[first], radii[first], radii[first]};
+    box.max = positions[first] + Vec3{radii[first], radii[first], radii[first]};
+    for (int k = m_starts[b] + 1; k < m_starts[b + 1]; k++)
+    {
+      int i = m_sorted[k];
+      const Vec3 &p = positions[i];
+      float r = radii[i];
+      box.min = {std::min(box.min.x, p.x - r), std::min(box.min.y, p.y - r), std::min(box.min.z, p.z - r)};
+      box.max = {std::max(box.max.x, p.x + r), std::max(box.max.y, p.y + r), std::max(box.max.z, p.z + r)};
+    }
+  }
+}
+
+int Interest_Grid::query(const Vec3 *points, const Vec3 *normals, int planes, std::vector<int> &indices) const
+{
+  indices.clear();
+  for (int b : m_used)
+  {
+    // The corner of the box farthest inside each plane decides if it is out, the nearest if it is all in
+    const Interest_Box &box = m_boxes[b];
+    bool out = false;
+    bool all_in = true;
+    for (int p = 0; p < planes && !out; p++)
+    {
+      const Vec3 &c = points[p];
+      const Vec3 &n = normals[p];
+      float far_side = ((n.x >= 0.0f ? box.max.x : box.min.x) - c.x) * n.x + ((n.y >= 0.0f ? box.max.y : box.min.y) - c.y) * n.y +
+                       ((n.z >= 0.0f ? box.max.z : box.min.z) - c.z) * n.z;
+      float near_side = ((n.x >= 0.0f ? box.min.x : box.max.x) - c.x) * n.x + ((n.y >= 0.0f ? box.min.y : box.max.y) - c.y) * n.y +
+                        ((n.z >= 0.0f ? box.min.z : box.max.z) - c.z) * n.z;
+      out = far_side < 0.0f;
+      all_in = all_in && near_side >= 0.0f;
+    }
+    if (out)
+      continue;
+
+    if (all_in)
+    {
+      indices.insert(indices.end(), m_sorted.begin() + m_starts[b], m_sorted.begin() + m_starts[b + 1]);
+      continue;
+    }
+
+    for (int k = m_starts[b]; k < m_starts[b + 1]; k++)
+    {
+      int i = m_sorted[k];
+      bool inside = true;
+      for (int p = 0; p < planes && inside; p++)
+        inside = Vec3::DotProduct(m_positions[i] - points[p], normals[p]) >= -m_radii[i];
+      if (inside)
+        indices.push_back(i);
+    }
+  }
+  return (int)indices.size();
+}
+
+int Interest_Grid::cells()
+{
+  return (int)m_used.size();
+}
@@ -0,0 +1,203 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_poller.cc
+
+#include <net_poller.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+Net_Poller::Net_Poller()
+{
+#ifdef __linux__
+  m_epoll = -1;
+#endif
+}
+
+Net_Poller::~Net_Poller()
+{
+  close();
+}
+
+int Net_Poller::open()
+{
+  close();
+#ifdef _WIN32
+  return 0;
+#elif __linux__
+  m_epoll = epoll_create1(0);
+  return m_epoll < 0 ? 1 : 0;
+#endif
+}
+
+void Net_Poller::close()
+{
+#ifdef _WIN32
+  m_fds.clear();
+  m_ids.clear();
+  m_positions.clear();
+#elif __linux__
+  if (m_epoll >= 0)
+    ::close(m_epoll);
+  m_epoll = -1;
+#endif
+}
+
+int Net_Poller::add(Net_Socket socket, uint64_t id)
+{
+#ifdef _WIN32
+  WSAPOLLFD fd;
+  fd.fd = socket;
+  fd.events = POLLRDNORM;
+  fd.revents = 0;
+  m_positions[socket] = (int)m_fds.size();
+  m_fds.push_back(fd);
+  m_ids.push_back(id);
+  return 0;
+#elif __linux__
+  struct epoll_event event;
+  event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+  event.data.u64 = id;
+  return epoll_ctl(m_epoll, EPOLL_CTL_ADD, socket, &event) == 0 ? 0 : 1;
+#endif
+}
+
+void Net_Poller::remove(Net_Socket socket)
+{
+#ifdef _WIN32
+  std::unordered_map<SOCKET, int>::iterator found = m_positions.find(socket);
+  if (found == m_positions.end())
+    return;
+
+  // The last socket takes the place of the removed one
+  int position = found->second;
+  m_positions.erase(found);
+  if (position != (int)m_fds.size() - 1)
+  {
+    m_fds[position] = m_fds.back();
+    m_ids[position] = m_ids.back();
+    m_positions[m_fds[position].fd] = position;
+  }
+  m_fds.pop_back();
+  m_ids.pop_back();
+#elif __linux__
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, socket, nullptr);
+#endif
+}
+
+void Net_Poller::watchWrite(Net_Socket socket, uint64_t id, bool write)
+{
+#ifdef _WIN32
+  (void)id;
+  std::unordered_map<SOCKET, int>::iterator found = m_positions.find(socket);
+  if (found != m_positions.end())
+    m_fds[found->second].events = write ? POLLRDNORM | POLLWRNORM : POLLRDNORM;
+#elif __linux__
+  // The modification rearms the socket, a ready one is reported at the next wait
+  struct epoll_event event;
+  event.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (write ? (uint32_t)EPOLLOUT : 0u);
+  event.data.u64 = id;
+  epoll_ctl(m_epoll, EPOLL_CTL_MOD, socket, &event);
+#endif
+}
+
+int Net_Poller::wait(Net_Event *events, int max, int timeout)
+{
+#ifdef _WIN32
+  if (m_fds.empty())
+  {
+    Sleep(timeout < 0 ? 0 : timeout);
+    return 0;
+  }
+  int ready = WSAPoll(m_fds.data(), (ULONG)m_fds.size(), timeout);
+  if (ready < 0)
+    return -1;
+
+  int count = 0;
+  for (int i = 0; i < (int)m_fds.size() && count < max; i++)
+  {
+    SHORT revents = m_fds[i].revents;
+    if (revents == 0)
+      continue;
+    events[count].id = m_ids[i];
+    events[count].read = (revents & POLLRDNORM) != 0;
+    events[count].write = (revents & POLLWRNORM) != 0;
+    events[count].error = (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+    count++;
+  }
+  return count;
+#elif __linux__
+  if ((int)m_events.size() < max)
+    m_events.resize(max);
+  int ready = epoll_wait(m_epoll, m_events.data(), max, timeout);
+  if (ready < 0)
+    return errno == EINTR ? 0 : -1;
+
+  for (int i = 0; i < ready; i++)
+  {
+    uint32_t flags = m_events[i].events;
+    events[i].id = m_events[i].data.u64;
+    events[i].read = (flags & EPOLLIN) != 0;
+    events[i].write = (flags & EPOLLOUT) != 0;
+    events[i].error = (flags & (EPOLLERR | EPOLLHUP)) != 0;
+  }
+  return ready;
+#endif
+}
+
+void Net_Startup()
+{
+#ifdef _WIN32
+  WSADATA wsaData;
+  WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+}
+
+void Net_Cleanup()
+{
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+int Net_Set_Non_Blocking(Net_Socket socket)
+{
+#ifdef _WIN32
+  u_long on = 1;
+  return ioctlsocket(socket, FIONBIO, &on) == 0 ? 0 : 1;
+#elif __linux__
+  int flags = fcntl(socket, F_GETFL, 0);
+  return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0 ? 0 : 1;
+#endif
+}
+
+int Net_Share_Port(Net_Socket socket)
+{
+#ifdef SO_REUSEPORT
+  int on = 1;
+  return setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, (const char *)&on, sizeof(on)) == 0 ? 0 : 1;
+#else
+  (void)socket;
+  return 1;
+#endif
+}
+
+void Net_Close(Net_Socket socket)
+{
+#ifdef _WIN32
+  closesocket(socket);
+#elif __linux__
+  ::close(socket);
+#endif
+}
+
+bool Net_Would_Block()
+{
+#ifdef _WIN32
+  int error = WSAGetLastError();
+  return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#elif __linux__
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+#endif
+}
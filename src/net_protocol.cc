@@ -0,0 +1,789 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_protocol.cc
+
+#include <net_protocol.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#define NET_CAMERA_BYTES 44    ///< The bytes of a Net_Camera on the wire.
+
+Net_Ring::Net_Ring()
+{
+  m_data = nullptr;
+  m_capacity = 0;
+  m_head = 0;
+  m_size = 0;
+}
+
+Net_Ring::Net_Ring(Net_Ring &&other)
+{
+  m_data = other.m_data;
+  m_capacity = other.m_capacity;
+  m_head = other.m_head;
+  m_size = other.m_size;
+  other.m_data = nullptr;
+  other.m_capacity = 0;
+  other.m_head = 0;
+  other.m_size = 0;
+}
+
+Net_Ring &Net_Ring::operator=(Net_Ring &&other)
+{
+  if (this != &other)
+  {
+    std::swap(m_data, other.m_data);
+    std::swap(m_capacity, other.m_capacity);
+    std::swap(m_head, other.m_head);
+    std::swap(m_size, other.m_size);
+  }
+  return *this;
+}
+
+void Net_Ring::reserve(int capacity)
+{
+  if (capacity <= m_capacity)
+    return;
+
+  int size = m_capacity > 0 ? m_capacity : 256;
+  while (size < capacity)
+    size *= 2;
+
+  // The queued bytes move to the start of the new buffer
+  uint8_t *data = (uint8_t *)malloc(size);
+  int first = std::min(m_size, m_capacity - m_head);
+  if (m_size > 0)
+  {
+    memcpy(data, m_data + m_head, first);
+    memcpy(data + first, m_data, m_size - first);
+  }
+  free(m_data);
+  m_data = data;
+  m_capacity = size;
+  m_head = 0;
+}
+
+void Net_Ring::release()
+{
+  free(m_data);
+  m_data = nullptr;
+  m_capacity = 0;
+  m_head = 0;
+  m_size = 0;
+}
+
+uint8_t *Net_Ring::back(int &contiguous)
+{
+  // Up to the end of the buffer, or up to the front when the bytes wrap
+  int tail = (m_head + m_size) & (m_capacity - 1);
+  if (m_size == m_capacity)
+    contiguous = 0;
+  else
+    contiguous = tail >= m_head ? m_capacity - tail : m_head - tail;
+  return m_data + tail;
+}
+
+void Net_Ring::produce(int bytes)
+{
+  m_size += bytes;
+}
+
+void Net_Ring::write(const void *data, int size)
+{
+  reserve(m_size + size);
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (size > 0)
+  {
+    int contiguous;
+    uint8_t *tail = back(contiguous);
+    int part = std::min(contiguous, size);
+    memcpy(tail, bytes, part);
+    produce(part);
+    bytes += part;
+    size -= part;
+  }
+}
+
+const uint8_t *Net_Ring::peek(int offset, int size, std::vector<uint8_t> &scratch)
+{
+  if (offset < 0 || size < 0 || offset + size > m_size)
+    return nullptr;
+
+  int start = (m_head + offset) & (m_capacity - 1);
+  if (start + size <= m_capacity)
+    return m_data + start;
+
+  // The bytes wrap around the end, only then they are copied
+  int first = m_capacity - start;
+  scratch.resize(size);
+  memcpy(scratch.data(), m_data + start, first);
+  memcpy(scratch.data() + first, m_data, size - first);
+  return scratch.data();
+}
+
+const uint8_t *Net_Ring::front(int &contiguous)
+{
+  contiguous = std::min(m_size, m_capacity - m_head);
+  return m_data + m_head;
+}
+
+void Net_Ring::consume(int bytes)
+{
+  m_size -= bytes;
+  m_head = m_size == 0 ? 0 : (m_head + bytes) & (m_capacity - 1);
+}
+
+int Net_Ring::size()
+{
+  return m_size;
+}
+
+int Net_Ring::capacity()
+{
+  return m_capacity;
+}
+
+Net_Ring::~Net_Ring()
+{
+  free(m_data);
+}
+
+Net_Writer::Net_Writer()
+{
+  m_start = 0;
+  m_sequence = 0;
+}
+
+void Net_Writer::begin(Net_Type type)
+{
+  m_start = m_bytes.size();
+  u32(0);
+  u8(NET_VERSION);
+  u8((uint8_t)type);
+  u16(0);
+  u32(m_sequence++);
+}
+
+void Net_Writer::end()
+{
+  uint32_t length = (uint32_t)(m_bytes.size() - m_start - NET_HEADER);
+  for (int i = 0; i < 4; i++)
+    m_bytes[m_start + i] = (uint8_t)(length >> (8 * i));
+}
+
+void Net_Writer::u8(uint8_t value)
+{
+  m_bytes.push_back(value);
+}
+
+void Net_Writer::u16(uint16_t value)
+{
+  m_bytes.push_back((uint8_t)value);
+  m_bytes.push_back((uint8_t)(value >> 8));
+}
+
+void Net_Writer::u32(uint32_t value)
+{
+  uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  m_bytes.insert(m_bytes.end(), bytes, bytes + 4);
+}
+
+void Net_Writer::f32(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  u32(bits);
+}
+
+void Net_Writer::vec3(Vec3 value)
+{
+  f32(value.x);
+  f32(value.y);
+  f32(value.z);
+}
+
+void Net_Writer::varint(uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    m_bytes.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  m_bytes.push_back((uint8_t)value);
+}
+
+const std::vector<uint8_t> &Net_Writer::bytes()
+{
+  return m_bytes;
+}
+
+void Net_Writer::raw(const void *data, int size)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+}
+
+void Net_Writer::clear()
+{
+  m_bytes.clear();
+  m_start = 0;
+}
+
+uint32_t Net_Writer::sequence()
+{
+  return m_sequence;
+}
+
+uint8_t Net_Reader::u8()
+{
+  if (offset + 1 > size)
+  {
+    ok = false;
+    return 0;
+  }
+  return data[offset++];
+}
+
+uint16_t Net_Reader::u16()
+{
+  if (offset + 2 > size)
+  {
+    ok = false;
+    return 0;
+  }
+  uint16_t value = (uint16_t)(data[offset] | (data[offset + 1] << 8));
+  offset += 2;
+  return value;
+}
+
+uint32_t Net_Reader::u32()
+{
+  if (offset + 4 > size)
+  {
+    ok = false;
+    return 0;
+  }
+  const uint8_t *bytes = data + offset;
+  offset += 4;
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+float Net_Reader::f32()
+{
+  uint32_t bits = u32();
+  float value;
+  memcpy(&value, &bits, 4);
+  return value;
+}
+
+Vec3 Net_Reader::vec3()
+{
+  float x = f32();
+  float y = f32();
+  float z = f32();
+  return {x, y, z};
+}
+
+uint32_t Net_Reader::varint()
+{
+  // 5 bytes at most, a longer one is corrupted
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t byte = u8();
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  ok = false;
+  return 0;
+}
+
+Net_Reader Net_Read(const Net_Message &message)
+{
+  return {message.payload, message.header.length, 0, true};
+}
+
+/**
+ * @brief Reads the header of a frame and checks it.
+ *
+ * @param header The NET_HEADER bytes.
+ * @param message The message of the header.
+ *
+ * @return 0 The header is valid.
+ * @return -1 The frame has another version, an unknown type or a length over NET_MAX_PAYLOAD.
+ */
+static int Net_Parse_Header(const uint8_t *header, Net_Message &message)
+{
+  Net_Reader reader = {header, NET_HEADER, 0, true};
+  message.header.length = reader.u32();
+  message.header.version = reader.u8();
+  message.header.type = reader.u8();
+  reader.u16();
+  message.header.sequence = reader.u32();
+  if (message.header.version != NET_VERSION || message.header.type < NET_HELLO ||
+      message.header.type >= NET_MAX_TYPE || message.header.length > NET_MAX_PAYLOAD)
+    return -1;
+  return 0;
+}
+
+int Net_Parse(Net_Ring &ring, Net_Message &message, std::vector<uint8_t> &scratch)
+{
+  const uint8_t *header = ring.peek(0, NET_HEADER, scratch);
+  if (header == nullptr)
+    return 0;
+  if (Net_Parse_Header(header, message) != 0)
+    return -1;
+
+  // The payload is in place unless it wraps, an empty one still points to the ring
+  const uint8_t *payload = ring.peek(NET_HEADER, (int)message.header.length, scratch);
+  if (payload == nullptr)
+    return 0;
+  message.payload = payload;
+  return 1;
+}
+
+int Net_Parse(const uint8_t *data, int size, Net_Message &message)
+{
+  if (size <= 0)
+    return 0;
+  if (size < NET_HEADER || Net_Parse_Header(data, message) != 0 || message.header.length > (uint32_t)(size - NET_HEADER))
+    return -1;
+  message.payload = data + NET_HEADER;
+  return 1;
+}
+
+void Net_Write_Hello(Net_Writer &writer)
+{
+  writer.begin(NET_HELLO);
+  writer.end();
+}
+
+void Net_Write_Create(Net_Writer &writer, const Net_Create *entities, int count)
+{
+  writer.begin(NET_CREATE);
+  writer.u32((uint32_t)count);
+  for (int i = 0; i < count; i++)
+  {
+    const Net_Create &entity = entities[i];
+    writer.u32(entity.entity);
+    writer.u8(entity.type);
+    writer.u8(entity.fill);
+    writer.u8(entity.res);
+    writer.u8((uint8_t)entity.subdivisions);
+    writer.u32((uint32_t)entity.mesh);
+    writer.u8(entity.color.r);
+    writer.u8(entity.color.g);
+    writer.u8(entity.color.b);
+    writer.u8(entity.color.a);
+    writer.vec3(entity.position);
+    writer.vec3(entity.rotation);
+    writer.vec3(entity.scale);
+    writer.vec3(entity.spin);
+  }
+  writer.end();
+}
+
+void Net_Write_Destroy(Net_Writer &writer, const uint32_t *entities, int count)
+{
+  writer.begin(NET_DESTROY);
+  writer.u32((uint32_t)count);
+  for (int i = 0; i < count; i++)
+    writer.u32(entities[i]);
+  writer.end();
+}
+
+void Net_Write_Transform(Net_Writer &writer, const Net_Transform *transforms, int count)
+{
+  writer.begin(NET_TRANSFORM);
+  writer.u32((uint32_t)count);
+  for (int i = 0; i < count; i++)
+  {
+    writer.u32(transforms[i].entity);
+    writer.vec3(transforms[i].position);
+    writer.vec3(transforms[i].rotation);
+    writer.vec3(transforms[i].scale);
+  }
+  writer.end();
+}
+
+void Net_Write_Camera(Net_Writer &writer, const Net_Camera &camera)
+{
+  writer.begin(NET_CAMERA);
+  writer.vec3(camera.position);
+  writer.vec3(camera.front);
+  writer.vec3(camera.up);
+  writer.f32(camera.near);
+  writer.f32(camera.far);
+  writer.end();
+}
+
+void Net_Write_View(Net_Writer &writer, const Net_View &view)
+{
+  writer.begin(NET_VIEW);
+  writer.vec3(view.position);
+  for (int i = 0; i < NET_VIEW_PLANES; i++)
+  {
+    writer.vec3(view.points[i]);
+    writer.vec3(view.normals[i]);
+  }
+  writer.end();
+}
+
+void Net_Write_Ack(Net_Writer &writer, uint32_t snapshot)
+{
+  writer.begin(NET_ACK);
+  writer.u32(snapshot);
+  writer.end();
+}
+
+uint32_t Net_Zigzag(int32_t value)
+{
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t Net_Unzigzag(uint32_t value)
+{
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+int Net_Count(const Net_Message &message)
+{
+  int entry;
+  switch (message.header.type)
+  {
+  case NET_CREATE:
+    entry = NET_CREATE_BYTES;
+    break;
+  case NET_DESTROY:
+    entry = 4;
+    break;
+  case NET_TRANSFORM:
+    entry = NET_TRANSFORM_BYTES;
+    break;
+  default:
+    return -1;
+  }
+
+  // The count must fill the payload exactly, a corrupted one can't point past it
+  Net_Reader reader = Net_Read(message);
+  uint32_t count = reader.u32();
+  if (!reader.ok || (message.header.length - 4) / entry != count || (message.header.length - 4) % entry != 0)
+    return -1;
+  return (int)count;
+}
+
+void Net_Read_Create(const Net_Message &message, int index, Net_Create &entity)
+{
+  Net_Reader reader = Net_Read(message);
+  reader.offset = 4 + index * NET_CREATE_BYTES;
+  entity.entity = reader.u32();
+  entity.type = reader.u8();
+  entity.fill = reader.u8();
+  entity.res = reader.u8();
+  entity.subdivisions = (int8_t)reader.u8();
+  entity.mesh = (int32_t)reader.u32();
+  entity.color.r = reader.u8();
+  entity.color.g = reader.u8();
+  entity.color.b = reader.u8();
+  entity.color.a = reader.u8();
+  entity.position = reader.vec3();
+  entity.rotation = reader.vec3();
+  entity.scale = reader.vec3();
+  entity.spin = reader.vec3();
+}
+
+uint32_t Net_Read_Destroy(const Net_Message &message, int index)
+{
+  Net_Reader reader = Net_Read(message);
+  reader.offset = 4 + index * 4;
+  return reader.u32();
+}
+
+void Net_Read_Transform(const Net_Message &message, int index, Net_Transform &transform)
+{
+  Net_Reader reader = Net_Read(message);
+  reader.offset = 4 + index * NET_TRANSFORM_BYTES;
+  transform.entity = reader.u32();
+  transform.position = reader.vec3();
+  transform.rotation = reader.vec3();
+  transform.scale = reader.vec3();
+}
+
+int Net_Read_Camera(const Net_Message &message, Net_Camera &camera)
+{
+  Net_Reader reader = Net_Read(message);
+  camera.position = reader.vec3();
+  camera.front = reader.vec3();
+  camera.up = reader.vec3();
+  camera.near = reader.f32();
+  camera.far = reader.f32();
+  return reader.ok ? 0 : 1;
+}
+
+int Net_Read_View(const Net_Message &message, Net_View &view)
+{
+  Net_Reader reader = Net_Read(message);
+  view.position = reader.vec3();
+  for (int i = 0; i < NET_VIEW_PLANES; i++)
+  {
+    view.points[i] = reader.vec3();
+    view.normals[i] = reader.vec3();
+  }
+  return reader.ok ? 0 : 1;
+}
+
+// Xorshift, the fuzzing is the same in every run
+static uint32_t Fuzz_Random(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static float Fuzz_Float(uint32_t &state)
+{
+  return (float)(int)(Fuzz_Random(state) % 2000001) / 1000.0f - 1000.0f;
+}
+
+static Vec3 Fuzz_Vec3(uint32_t &state)
+{
+  float x = Fuzz_Float(state);
+  float y = Fuzz_Float(state);
+  float z = Fuzz_Float(state);
+  return {x, y, z};
+}
+
+static bool Same(Vec3 a, Vec3 b)
+{
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+int Net_Fuzz(int iterations)
+{
+  uint32_t state = 0x2545F491;
+  long long frames = 0;
+  long long bytes = 0;
+  long long rejected = 0;
+  int errors = 0;
+
+  for (int iteration = 0; iteration < iterations && errors == 0; iteration++)
+  {
+    // A stream of random frames, remembered to compare what is parsed
+    Net_Writer writer;
+    std::vector<int> types;
+    std::vector<Net_Create> creates;
+    std::vector<uint32_t> destroys;
+    std::vector<Net_Transform> transforms;
+    std::vector<Net_Camera> cameras;
+    std::vector<Net_View> views;
+    std::vector<int> counts;
+    int n_frames = 1 + Fuzz_Random(state) % 32;
+    for (int f = 0; f < n_frames; f++)
+    {
+      static const int kinds[] = {NET_HELLO, NET_CREATE, NET_DESTROY, NET_TRANSFORM, NET_CAMERA, NET_VIEW};
+      int type = kinds[Fuzz_Random(state) % (sizeof(kinds) / sizeof(kinds[0]))];
+      int count = Fuzz_Random(state) % 4 == 0 ? 0 : 1 + Fuzz_Random(state) % 200;
+      types.push_back(type);
+      counts.push_back(count);
+      if (type == NET_HELLO)
+        Net_Write_Hello(writer);
+      else if (type == NET_CREATE)
+      {
+        size_t first = creates.size();
+        for (int i = 0; i < count; i++)
+        {
+          Net_Create entity;
+          entity.entity = Fuzz_Random(state);
+          entity.type = (uint8_t)Fuzz_Random(state);
+          entity.fill = (uint8_t)Fuzz_Random(state);
+          entity.res = (uint8_t)Fuzz_Random(state);
+          entity.subdivisions = (int8_t)Fuzz_Random(state);
+          entity.mesh = (int32_t)Fuzz_Random(state);
+          uint32_t color = Fuzz_Random(state);
+          entity.color = {(Uint8)color, (Uint8)(color >> 8), (Uint8)(color >> 16), (Uint8)(color >> 24)};
+          entity.position = Fuzz_Vec3(state);
+          entity.rotation = Fuzz_Vec3(state);
+          entity.scale = Fuzz_Vec3(state);
+          entity.spin = Fuzz_Vec3(state);
+          creates.push_back(entity);
+        }
+        Net_Write_Create(writer, creates.data() + first, count);
+      }
+      else if (type == NET_DESTROY)
+      {
+        size_t first = destroys.size();
+        for (int i = 0; i < count; i++)
+          destroys.push_back(Fuzz_Random(state));
+        Net_Write_Destroy(writer, destroys.data() + first, count);
+      }
+      else if (type == NET_TRANSFORM)
+      {
+        size_t first = transforms.size();
+        for (int i = 0; i < count; i++)
+          transforms.push_back({Fuzz_Random(state), Fuzz_Vec3(state), Fuzz_Vec3(state), Fuzz_Vec3(state)});
+        Net_Write_Transform(writer, transforms.data() + first, count);
+      }
+      else if (type == NET_CAMERA)
+      {
+        Net_Camera camera = {Fuzz_Vec3(state), Fuzz_Vec3(state), Fuzz_Vec3(state), Fuzz_Float(state), Fuzz_Float(state)};
+        cameras.push_back(camera);
+        Net_Write_Camera(writer, camera);
+      }
+      else
+      {
+        Net_View view;
+        view.position = Fuzz_Vec3(state);
+        for (int i = 0; i < NET_VIEW_PLANES; i++)
+        {
+          view.points[i] = Fuzz_Vec3(state);
+          view.normals[i] = Fuzz_Vec3(state);
+        }
+        views.push_back(view);
+        Net_Write_View(writer, view);
+      }
+    }
+    const std::vector<uint8_t> &stream = writer.bytes();
+    bytes += stream.size();
+
+    // The stream arrives in random pieces to a small ring, as a socket would fill it
+    Net_Ring ring;
+    ring.reserve(256 << (Fuzz_Random(state) % 4));
+    std::vector<uint8_t> scratch;
+    size_t fed = 0;
+    int parsed = 0;
+    size_t create = 0, destroy = 0, transform = 0, camera = 0, view = 0;
+    while (parsed < n_frames && errors == 0)
+    {
+      if (fed < stream.size())
+      {
+        int contiguous;
+        uint8_t *tail = ring.back(contiguous);
+        int piece = std::min((int)(stream.size() - fed), 1 + (int)(Fuzz_Random(state) % 700));
+        if (contiguous == 0)
+          ring.reserve(ring.capacity() * 2);
+        else
+        {
+          piece = std::min(piece, contiguous);
+          memcpy(tail, stream.data() + fed, piece);
+          ring.produce(piece);
+          fed += piece;
+        }
+      }
+
+      Net_Message message;
+      int ret;
+      while (errors == 0 && (ret = Net_Parse(ring, message, scratch)) == 1)
+      {
+        bool ok = message.header.sequence == (uint32_t)parsed && message.header.type == types[parsed];
+        int count = Net_Count(message);
+        switch (message.header.type)
+        {
+        case NET_HELLO:
+          ok = ok && message.header.length == 0;
+          break;
+        case NET_CREATE:
+          ok = ok && count == counts[parsed];
+          for (int i = 0; ok && i < count; i++)
+          {
+            Net_Create entity;
+            Net_Read_Create(message, i, entity);
+            const Net_Create &expected = creates[create++];
+            ok = entity.entity == expected.entity && entity.type == expected.type && entity.fill == expected.fill &&
+                 entity.res == expected.res && entity.subdivisions == expected.subdivisions && entity.mesh == expected.mesh &&
+                 memcmp(&entity.color, &expected.color, sizeof(SDL_Color)) == 0 && Same(entity.position, expected.position) &&
+                 Same(entity.rotation, expected.rotation) && Same(entity.scale, expected.scale) && Same(entity.spin, expected.spin);
+          }
+          break;
+        case NET_DESTROY:
+          ok = ok && count == counts[parsed];
+          for (int i = 0; ok && i < count; i++)
+            ok = Net_Read_Destroy(message, i) == destroys[destroy++];
+          break;
+        case NET_TRANSFORM:
+          ok = ok && count == counts[parsed];
+          for (int i = 0; ok && i < count; i++)
+          {
+            Net_Transform read;
+            Net_Read_Transform(message, i, read);
+            const Net_Transform &expected = transforms[transform++];
+            ok = read.entity == expected.entity && Same(read.position, expected.position) &&
+                 Same(read.rotation, expected.rotation) && Same(read.scale, expected.scale);
+          }
+          break;
+        case NET_CAMERA:
+        {
+          Net_Camera read;
+          const Net_Camera &expected = cameras[camera++];
+          ok = ok && Net_Read_Camera(message, read) == 0 && Same(read.position, expected.position) && Same(read.front, expected.front) &&
+               Same(read.up, expected.up) && read.near == expected.near && read.far == expected.far;
+          break;
+        }
+        case NET_VIEW:
+        {
+          Net_View read;
+          const Net_View &expected = views[view++];
+          ok = ok && Net_Read_View(message, read) == 0 && Same(read.position, expected.position);
+          for (int i = 0; ok && i < NET_VIEW_PLANES; i++)
+            ok = Same(read.points[i], expected.points[i]) && Same(read.normals[i], expected.normals[i]);
+          break;
+        }
+        }
+
+        if (!ok)
+        {
+          printf("ERROR: Iteration %d frame %d (type %d) doesn't match\n", iteration, parsed, types[parsed]);
+          errors++;
+        }
+        ring.consume(NET_HEADER + message.header.length);
+        parsed++;
+      }
+      if (ret < 0 || (ret == 0 && fed == stream.size() && parsed < n_frames))
+      {
+        printf("ERROR: Iteration %d frame %d %s\n", iteration, parsed, ret < 0 ? "rejected" : "incomplete");
+        errors++;
+      }
+    }
+    frames += parsed;
+
+    // Corrupted bytes, every frame is rejected or read within its payload
+    std::vector<uint8_t> corrupted = stream;
+    int flips = 1 + Fuzz_Random(state) % 8;
+    for (int i = 0; i < flips; i++)
+      corrupted[Fuzz_Random(state) % corrupted.size()] ^= (uint8_t)(1 + Fuzz_Random(state) % 255);
+    Net_Ring bad;
+    bad.write(corrupted.data(), (int)corrupted.size());
+    Net_Message message;
+    int ret;
+    while ((ret = Net_Parse(bad, message, scratch)) == 1)
+    {
+      int count = Net_Count(message);
+      for (int i = 0; i < count; i++)
+      {
+        Net_Transform read;
+        Net_Create entity;
+        if (message.header.type == NET_TRANSFORM)
+          Net_Read_Transform(message, i, read);
+        else if (message.header.type == NET_CREATE)
+          Net_Read_Create(message, i, entity);
+        else
+          Net_Read_Destroy(message, i);
+      }
+      Net_Camera read;
+      if (message.header.type == NET_CAMERA)
+        Net_Read_Camera(message, read);
+      Net_View view;
+      if (message.header.type == NET_VIEW)
+        Net_Read_View(message, view);
+      bad.consume(NET_HEADER + message.header.length);
+    }
+    rejected += ret < 0;
+  }
+
+  printf("Iterations  Frames     Bytes       Corrupted rejected  Errors\n");
+  printf("%-11d %-10lld %-11lld %-19lld %d\n", iterations, frames, bytes, rejected, errors);
+  return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_record.cc
+
+#include <net_record.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#define NET_RECORD_HEADER 8          ///< The bytes of the magic and the version.
+#define NET_RECORD_BUFFER (1 << 16)  ///< The bytes the file buffers before writing.
+
+Net_Recorder::Net_Recorder()
+{
+  m_file = nullptr;
+  m_time = 0;
+  m_bytes = 0;
+}
+
+Net_Recorder::~Net_Recorder()
+{
+  close();
+}
+
+int Net_Recorder::open(const std::string &path)
+{
+  close();
+
+  m_file = fopen(path.c_str(), "wb");
+  if (m_file == NULL)
+  {
+    std::cout << "ERROR: Log " << path << " can't be created" << std::endl;
+    return 1;
+  }
+  setvbuf(m_file, nullptr, _IOFBF, NET_RECORD_BUFFER);
+
+  m_entry.clear();
+  m_entry.raw(NET_RECORD_MAGIC, 4);
+  m_entry.u32(NET_RECORD_VERSION);
+  fwrite(m_entry.bytes().data(), 1, m_entry.bytes().size(), m_file);
+  m_bytes = (long long)m_entry.bytes().size();
+  m_time = 0;
+  return 0;
+}
+
+void Net_Recorder::close()
+{
+  if (m_file != nullptr)
+    fclose(m_file);
+  m_file = nullptr;
+}
+
+bool Net_Recorder::recording()
+{
+  return m_file != nullptr;
+}
+
+void Net_Recorder::record(Net_Record_Kind kind, int client, double time, const void *data, int size)
+{
+  if (m_file == nullptr)
+    return;
+
+  // The times are differences, most records are microseconds apart and take a byte or two
+  long long now = std::max((long long)llround(time * 1000000.0), m_time);
+  m_entry.clear();
+  m_entry.u8((uint8_t)kind);
+  m_entry.varint((uint32_t)client);
+  m_entry.varint((uint32_t)std::min(now - m_time, (long long)UINT32_MAX));
+  m_entry.varint((uint32_t)size);
+  m_time = now;
+
+  fwrite(m_entry.bytes().data(), 1, m_entry.bytes().size(), m_file);
+  if (size > 0)
+    fwrite(data, 1, size, m_file);
+  m_bytes += (long long)m_entry.bytes().size() + size;
+}
+
+void Net_Recorder::recordWorld(double time, const Vec3 *positions, const Vec4 *rotations, int count, float step)
+{
+  if (m_file == nullptr)
+    return;
+
+  m_world.clear();
+  Quant_Write_Transforms(m_world, positions, rotations, count, step);
+  record(NET_RECORD_WORLD, -1, time, m_world.bytes().data(), (int)m_world.bytes().size());
+}
+
+long long Net_Recorder::bytes()
+{
+  return m_bytes;
+}
+
+Net_Log::Net_Log()
+{
+  m_offset = 0;
+  m_time = 0;
+}
+
+int Net_Log::open(const std::string &path)
+{
+  m_data.clear();
+  rewind();
+
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+  {
+    std::cout << "ERROR: Log " << path << " can't be read" << std::endl;
+    return 1;
+  }
+  uint8_t buffer[NET_RECORD_BUFFER];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    m_data.insert(m_data.end(), buffer, buffer + read);
+  fclose(file);
+
+  Net_Reader reader = {m_data.data(), (uint32_t)m_data.size(), 4, true};
+  if (m_data.size() < NET_RECORD_HEADER || memcmp(m_data.data(), NET_RECORD_MAGIC, 4) != 0 || reader.u32() != NET_RECORD_VERSION)
+  {
+    std::cout << "ERROR: " << path << " is not a log of version " << NET_RECORD_VERSION << std::endl;
+    m_data.clear();
+    return 2;
+  }
+  return 0;
+}
+
+int Net_Log::next(Net_Record &record)
+{
+  if (m_offset >= m_data.size())
+    return 0;
+
+  Net_Reader reader = {m_data.data(), (uint32_t)m_data.size(), m_offset, true};
+  record.kind = reader.u8();
+  record.client = (int)reader.varint();
+  m_time += reader.varint();
+  record.size = (int)reader.varint();
+  record.time = m_time / 1000000.0;
+
+  // A record cut by a crash of the server ends the log as corrupted
+  if (!reader.ok || record.kind < NET_RECORD_CONNECTED || record.kind >= NET_RECORD_MAX_KIND || record.size < 0 ||
+      (uint32_t)record.size > reader.size - reader.offset)
+  {
+    m_offset = (uint32_t)m_data.size();
+    return -1;
+  }
+  record.data = m_data.data() + reader.offset;
+  m_offset = reader.offset + (uint32_t)record.size;
+  return 1;
+}
+
+void Net_Log::rewind()
+{
+  m_offset = NET_RECORD_HEADER;
+  m_time = 0;
+}
+
+int Net_Log::size()
+{
+  return (int)m_data.size();
+}
@@ -0,0 +1,1847 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_replication.cc
+
+#include <net_replication.h>
+#include <scene.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#define REPLICATION_CREATES 4096   ///< The entities of a create frame, the first snapshot of a big scene takes many.
+#define REPLICATION_DRIFT 0.0001   ///< The seconds per snapshot the smallest transit is let go.
+#define REPLICATION_PACE 0.05f     ///< The change of the pace of the playback while the delay adapts, 5% faster or slower.
+#define REPLICATION_DEADBAND 0.25f ///< The ticks the delay can be off its target before it adapts.
+#define REPLICATION_RECOVERY 0.01f ///< The seconds per second a delay grown by late snapshots shrinks back.
+#define REPLICATION_EPSILON 0.001f ///< The smallest turn applied, in degrees.
+#define REPLICATION_UDP 0.005f     ///< The seconds between the updates of the UDP endpoint of the server.
+#define REPLICATION_FOLLOW 0.001f  ///< The seconds between the checks of the feed of a server without simulation.
+#define REPLICATION_VIEW 0.25      ///< The seconds a view that doesn't change is sent again, it could be lost over UDP.
+#define REPLICATION_HEADER 12      ///< The bytes of the id, the base and the time of a snapshot, after the frame header.
+
+Replication_Settings Replication_Server::settings_ = {20.0f, 1.0f / 64.0f, 1.0f / 256.0f, 32, 0.1f, true, 0.5f, 4.0f, 0.25f, 1.0f};
+
+static int Slot(uint32_t handle)
+{
+  return (int)(handle & REGISTRY_SLOT_MASK);
+}
+
+// The slot after the previous one by a distance read from a frame, -1 if it is past the last slot
+static int Next_Slot(int previous, uint32_t distance)
+{
+  if (previous >= REGISTRY_SLOT_MASK || distance > (uint32_t)(REGISTRY_SLOT_MASK - previous - 1))
+    return -1;
+  return previous + 1 + (int)distance;
+}
+
+static int32_t Quantize(float value, float step)
+{
+  return (int32_t)lroundf(value / step);
+}
+
+// The rotations are angles of a turn, their differences take the short way around
+static int32_t Wrap_Turn(int32_t value)
+{
+  return value & (REPLICATION_TURN - 1);
+}
+
+static int32_t Delta(int value, int32_t current, int32_t base)
+{
+  int32_t delta = current - base;
+  if (value >= 3 && value < 6)
+    delta = (int32_t)(int16_t)(uint16_t)delta;
+  return delta;
+}
+
+static int32_t Undelta(int value, int32_t base, int32_t delta)
+{
+  int32_t current = base + delta;
+  if (value >= 3 && value < 6)
+    current = Wrap_Turn(current);
+  return current;
+}
+
+static int Varint_Bytes(uint32_t value)
+{
+  int bytes = 1;
+  for (; value >= 0x80; value >>= 7)
+    bytes++;
+  return bytes;
+}
+
+// The bytes of an entry of a snapshot against its base, 0 if it didn't change. At most: the distance to the
+// previous slot is taken as the slot itself
+static int Entry_Bytes(uint32_t handle, const int32_t *values, const int32_t *base)
+{
+  int bytes = 0;
+  uint32_t mask = 0;
+  for (int v = 0; v < REPLICATION_VALUES; v++)
+  {
+    if (values[v] != base[v])
+    {
+      bytes += Varint_Bytes(Net_Zigzag(Delta(v, values[v], base[v])));
+      mask |= 1u << v;
+    }
+  }
+  if (bytes == 0)
+    return 0;
+  return bytes + Varint_Bytes((uint32_t)Slot(handle)) + Varint_Bytes(handle >> REGISTRY_SLOT_BITS) + Varint_Bytes(mask);
+}
+
+static float Wrap_Degrees(float degrees)
+{
+  degrees = fmodf(degrees + 180.0f, 360.0f);
+  return degrees < 0.0f ? degrees + 180.0f : degrees - 180.0f;
+}
+
+void Replication_Capture(Registry &registry, uint32_t id, uint32_t time, Replication_Snapshot &snapshot)
+{
+  int count = registry.count();
+  snapshot.id = id;
+  snapshot.time = time;
+  snapshot.handles.resize(count);
+  snapshot.values.resize((size_t)count * REPLICATION_VALUES);
+
+  // The dense order changes with every removal, the slots don't: a counting sort by slot
+  int max_slot = -1;
+  for (int i = 0; i < count; i++)
+    max_slot = std::max(max_slot, Slot(registry.handle(i)));
+  std::vector<int> indices(max_slot + 1, -1);
+  for (int i = 0; i < count; i++)
+    indices[Slot(registry.handle(i))] = i;
+
+  const Vec3 *positions = registry.positions();
+  const Vec3 *scales = registry.scales();
+  float position_step = Replication_Server::settings_.position_step;
+  float scale_step = Replication_Server::settings_.scale_step;
+  int n = 0;
+  for (int index : indices)
+  {
+    if (index < 0)
+      continue;
+
+    int handle = registry.handle(index);
+    Vec3 rotation = registry.entity(handle)->getRotation();
+    int32_t *values = &snapshot.values[(size_t)n * REPLICATION_VALUES];
+    values[0] = Quantize(positions[index].x, position_step);
+    values[1] = Quantize(positions[index].y, position_step);
+    values[2] = Quantize(positions[index].z, position_step);
+    values[3] = Wrap_Turn(Quantize(rotation.x, 360.0f / REPLICATION_TURN));
+    values[4] = Wrap_Turn(Quantize(rotation.y, 360.0f / REPLICATION_TURN));
+    values[5] = Wrap_Turn(Quantize(rotation.z, 360.0f / REPLICATION_TURN));
+    values[6] = Quantize(scales[index].x, scale_step);
+    values[7] = Quantize(scales[index].y, scale_step);
+    values[8] = Quantize(scales[index].z, scale_step);
+    snapshot.handles[n++] = (uint32_t)handle;
+  }
+}
+
+/**
+ * @brief Describes an entity as a client builds it.
+ *
+ * @param registry The registry.
+ * @param handle The handle of the entity.
+ * @param create The description.
+ */
+static void Replication_Describe(Registry &registry, int handle, Net_Create &create)
+{
+  Entity *entity = registry.entity(handle);
+  const Entity_Material &material = registry.material(handle);
+  const Entity_Orbit &orbit = registry.orbit(handle);
+  int type = registry.type(handle);
+
+  // The spin is the one Registry::present applies, only to the orbits it simulates
+  bool spins = !Physics::settings_.enabled && !registry.onRails(handle) && orbit.vel != 0.0f &&
+               (registry.parent(handle) >= 0 || (orbit.center.x + orbit.center.y + orbit.center.z) != 0);
+
+  create.entity = (uint32_t)handle;
+  create.type = (uint8_t)type;
+  create.fill = material.fill ? 1 : 0;
+  create.res = (uint8_t)entity->getRes();
+  create.subdivisions = type == typeSphere ? (int8_t)static_cast<Sphere *>(entity)->getSubdivisions() : -1;
+  create.mesh = -1;
+  create.color = material.fillColor;
+  create.position = entity->mov_;
+  create.rotation = entity->getRotation();
+  create.scale = entity->getScale();
+  create.spin = spins ? orbit.angle * (orbit.vel * ORBIT_RATE) : Vec3{0.0f, 0.0f, 0.0f};
+}
+
+void Replication_Build(Registry &registry, uint32_t id, uint32_t time, bool grid, const Replication_Tick *previous, Replication_Tick &tick)
+{
+  std::shared_ptr<Replication_Snapshot> snapshot = std::make_shared<Replication_Snapshot>();
+  Replication_Capture(registry, id, time, *snapshot);
+  tick.snapshot = snapshot;
+
+  int count = (int)snapshot->handles.size();
+  const Vec3 *positions = registry.positions();
+  const float *radii = registry.radii();
+  tick.creates.resize(count);
+  tick.positions.resize(count);
+  tick.radii.resize(count);
+
+  // Only the entities new since the previous tick are described, the others move to their snapshot
+  const std::vector<uint32_t> *known = previous ? &previous->snapshot->handles : nullptr;
+  size_t p = 0;
+  float position_step = Replication_Server::settings_.position_step;
+  float scale_step = Replication_Server::settings_.scale_step;
+  float turn_step = 360.0f / REPLICATION_TURN;
+  for (int j = 0; j < count; j++)
+  {
+    int handle = (int)snapshot->handles[j];
+    int index = registry.index(handle);
+    tick.positions[j] = positions[index];
+    tick.radii[j] = radii[index];
+
+    while (known && p < known->size() && Slot((*known)[p]) < Slot(handle))
+      p++;
+    Net_Create &create = tick.creates[j];
+    if (!known || p == known->size() || (*known)[p] != (uint32_t)handle)
+    {
+      Replication_Describe(registry, handle, create);
+      continue;
+    }
+    const int32_t *values = &snapshot->values[(size_t)j * REPLICATION_VALUES];
+    create = previous->creates[p];
+    create.position = {values[0] * position_step, values[1] * position_step, values[2] * position_step};
+    create.rotation = {values[3] * turn_step, values[4] * turn_step, values[5] * turn_step};
+    create.scale = {values[6] * scale_step, values[7] * scale_step, values[8] * scale_step};
+  }
+
+  tick.gridded = grid;
+  if (grid)
+    tick.grid.build(tick.positions.data(), tick.radii.data(), count);
+}
+
+/**
+ * @brief The entities of a snapshot that are not in a base, walking both by slot.
+ *
+ * @param snapshot The snapshot.
+ * @param base The base, nullptr for none.
+ * @param created The indices in the snapshot of the entities new since the base.
+ * @param destroyed The indices in the base of the entities gone from the snapshot, nullptr to ignore them.
+ */
+static void Replication_Diff(const Replication_Snapshot &snapshot, const Replication_Snapshot *base, std::vector<int> &created,
+                             std::vector<int> *destroyed)
+{
+  created.clear();
+  if (destroyed)
+    destroyed->clear();
+
+  int n = (int)snapshot.handles.size();
+  int m = base ? (int)base->handles.size() : 0;
+  int i = 0;
+  int j = 0;
+  while (i < m || j < n)
+  {
+    // A reused slot is a destroyed entity and a created one
+    if (j == n || (i < m && Slot(base->handles[i]) < Slot(snapshot.handles[j])))
+    {
+      if (destroyed)
+        destroyed->push_back(i);
+      i++;
+    }
+    else if (i == m || Slot(snapshot.handles[j]) < Slot(base->handles[i]))
+      created.push_back(j++);
+    else
+    {
+      if (base->handles[i] != snapshot.handles[j])
+      {
+        if (destroyed)
+          destroyed->push_back(i);
+        created.push_back(j);
+      }
+      i++;
+      j++;
+    }
+  }
+}
+
+void Replication_Write(Net_Writer &writer, const Replication_Snapshot &snapshot, const Replication_Snapshot *base)
+{
+  std::vector<int> created;
+  std::vector<int> destroyed;
+  Replication_Diff(snapshot, base, created, &destroyed);
+
+  writer.begin(NET_SNAPSHOT);
+  writer.u32(snapshot.id);
+  writer.u32(base ? base->id : 0);
+  writer.u32(snapshot.time);
+
+  // The slots are increasing, every one is written as the distance to the previous one minus one
+  writer.varint((uint32_t)destroyed.size());
+  int previous = -1;
+  for (int i : destroyed)
+  {
+    int slot = Slot(base->handles[i]);
+    writer.varint((uint32_t)(slot - previous - 1));
+    previous = slot;
+  }
+
+  // The entries: the created entities against zeros, the others against the base when they changed
+  static const int32_t zeros[REPLICATION_VALUES] = {};
+  std::vector<int> entries;
+  std::vector<const int32_t *> bases;
+  int n = (int)snapshot.handles.size();
+  int m = base ? (int)base->handles.size() : 0;
+  size_t next = 0;
+  for (int i = 0, j = 0; j < n; j++)
+  {
+    const int32_t *values = &snapshot.values[(size_t)j * REPLICATION_VALUES];
+    if (next < created.size() && created[next] == j)
+    {
+      next++;
+      entries.push_back(j);
+      bases.push_back(zeros);
+      continue;
+    }
+
+    while (i < m && base->handles[i] != snapshot.handles[j])
+      i++;
+    const int32_t *old = &base->values[(size_t)i * REPLICATION_VALUES];
+    if (!std::equal(values, values + REPLICATION_VALUES, old))
+    {
+      entries.push_back(j);
+      bases.push_back(old);
+    }
+  }
+
+  writer.varint((uint32_t)entries.size());
+  previous = -1;
+  for (size_t e = 0; e < entries.size(); e++)
+  {
+    int j = entries[e];
+    uint32_t handle = snapshot.handles[j];
+    int slot = Slot(handle);
+    writer.varint((uint32_t)(slot - previous - 1));
+    writer.varint(handle >> REGISTRY_SLOT_BITS);
+    previous = slot;
+
+    const int32_t *values = &snapshot.values[(size_t)j * REPLICATION_VALUES];
+    uint32_t mask = 0;
+    for (int v = 0; v < REPLICATION_VALUES; v++)
+    {
+      if (values[v] != bases[e][v])
+        mask |= 1u << v;
+    }
+    writer.varint(mask);
+    for (int v = 0; v < REPLICATION_VALUES; v++)
+    {
+      if (mask & (1u << v))
+        writer.varint(Net_Zigzag(Delta(v, values[v], bases[e][v])));
+    }
+  }
+  writer.end();
+}
+
+uint32_t Replication_Base(const Net_Message &message)
+{
+  Net_Reader reader = Net_Read(message);
+  reader.offset = 4;
+  return reader.u32();
+}
+
+int Replication_Read(const Net_Message &message, const Replication_Snapshot *base, Replication_Snapshot &snapshot)
+{
+  Net_Reader reader = Net_Read(message);
+  snapshot.id = reader.u32();
+  uint32_t base_id = reader.u32();
+  snapshot.time = reader.u32();
+  if (!reader.ok || snapshot.id == 0 || (base_id != 0) != (base != nullptr) || (base && base->id != base_id))
+    return 1;
+
+  // Every count is checked against the bytes left before anything is allocated
+  int m = base ? (int)base->handles.size() : 0;
+  uint32_t n_destroyed = reader.varint();
+  if (!reader.ok || n_destroyed > (uint32_t)m)
+    return 1;
+  std::vector<int> destroyed(n_destroyed);
+  int previous = -1;
+  for (int &slot : destroyed)
+  {
+    slot = Next_Slot(previous, reader.varint());
+    if (slot < 0)
+      return 1;
+    previous = slot;
+  }
+
+  uint32_t n_entries = reader.varint();
+  if (!reader.ok || n_entries > (reader.size - reader.offset) / 3)
+    return 1;
+
+  snapshot.handles.clear();
+  snapshot.values.clear();
+  snapshot.handles.reserve(m - n_destroyed + n_entries);
+  snapshot.values.reserve((size_t)(m - n_destroyed + n_entries) * REPLICATION_VALUES);
+
+  static const int32_t zeros[REPLICATION_VALUES] = {};
+  int i = 0;
+  size_t d = 0;
+  uint32_t read = 0;
+  bool pending = false;
+  int slot = 0;
+  uint32_t handle = 0;
+  uint32_t mask = 0;
+  previous = -1;
+  while (reader.ok)
+  {
+    if (!pending && read < n_entries)
+    {
+      slot = Next_Slot(previous, reader.varint());
+      uint32_t generation = reader.varint();
+      mask = reader.varint();
+      if (slot < 0 || generation > REGISTRY_GENERATION_MASK || mask >= (1u << REPLICATION_VALUES))
+        return 1;
+      handle = (uint32_t)slot | generation << REGISTRY_SLOT_BITS;
+      previous = slot;
+      pending = true;
+      read++;
+    }
+
+    // The destroyed entities of the base are skipped
+    while (i < m && d < destroyed.size() && Slot(base->handles[i]) == destroyed[d])
+    {
+      i++;
+      d++;
+    }
+
+    const int32_t *old;
+    if (pending && (i == m || slot < Slot(base->handles[i])))
+      old = zeros;
+    else if (pending && slot == Slot(base->handles[i]))
+    {
+      if (base->handles[i] != handle)
+        return 1;
+      old = &base->values[(size_t)i++ * REPLICATION_VALUES];
+    }
+    else if (i < m)
+    {
+      // Unchanged since the base
+      snapshot.handles.push_back(base->handles[i]);
+      snapshot.values.insert(snapshot.values.end(), &base->values[(size_t)i * REPLICATION_VALUES],
+                             &base->values[(size_t)(i + 1) * REPLICATION_VALUES]);
+      i++;
+      continue;
+    }
+    else
+      break;
+
+    snapshot.handles.push_back(handle);
+    for (int v = 0; v < REPLICATION_VALUES; v++)
+      snapshot.values.push_back((mask & (1u << v)) ? Undelta(v, old[v], Net_Unzigzag(reader.varint())) : old[v]);
+    pending = false;
+  }
+
+  return reader.ok && d == destroyed.size() && reader.offset == reader.size ? 0 : 1;
+}
+
+const Replication_Snapshot &Replication_Filter(const Replication_Tick &tick, const Replication_Snapshot *base, Replication_Peer &peer,
+                                               Replication_Stats &stats)
+{
+  const Interest_Settings &settings = Interest_Grid::settings_;
+  const Replication_Snapshot &current = *tick.snapshot;
+  const Net_View &view = peer.view;
+  size_t slots = current.handles.empty() ? 0 : Slot(current.handles.back()) + 1;
+  if (peer.priorities.size() < slots)
+    peer.priorities.resize(slots, 0.0f);
+
+  // The relevance is the size the entity is seen, the most relevant ones are kept
+  std::vector<int> found;
+  tick.grid.query(view.points, view.normals, NET_VIEW_PLANES, found);
+  std::vector<std::pair<float, int>> relevant(found.size());
+  for (size_t k = 0; k < found.size(); k++)
+  {
+    int j = found[k];
+    float distance = std::max((tick.positions[j] - view.position).Magnitude(), 1.0f);
+    relevant[k] = {(tick.radii[j] + 1.0f) / distance, j};
+  }
+  if ((int)relevant.size() > settings.max_entities)
+  {
+    std::nth_element(relevant.begin(), relevant.begin() + settings.max_entities, relevant.end(),
+                     [](const std::pair<float, int> &a, const std::pair<float, int> &b)
+                     { return a.first > b.first; });
+    relevant.resize(settings.max_entities);
+  }
+  std::sort(relevant.begin(), relevant.end(), [](const std::pair<float, int> &a, const std::pair<float, int> &b)
+            { return a.second < b.second; });
+
+  // What the client knows of every entity: the values of the last snapshot sent, or of the base
+  uint32_t last_id = current.id - 1;
+  const Replication_Snapshot &last_sent = peer.history[last_id % peer.history.size()];
+  const Replication_Snapshot *last = last_id != 0 && last_sent.id == last_id ? &last_sent : nullptr;
+  static const int32_t zeros[REPLICATION_VALUES] = {};
+  int n_base = base ? (int)base->handles.size() : 0;
+  int n_last = last ? (int)last->handles.size() : 0;
+  std::vector<const int32_t *> known(relevant.size(), nullptr);
+  std::vector<int> costs(relevant.size(), 0);
+  std::vector<int> waiting;
+  std::vector<bool> kept(n_base, false);
+  int spent = 0;
+  for (size_t k = 0, b = 0, l = 0; k < relevant.size(); k++)
+  {
+    int j = relevant[k].second;
+    uint32_t handle = current.handles[j];
+    int slot = Slot(handle);
+    while ((int)b < n_base && Slot(base->handles[b]) < slot)
+      b++;
+    while ((int)l < n_last && Slot(last->handles[l]) < slot)
+      l++;
+    const int32_t *in_base = (int)b < n_base && base->handles[b] == handle ? &base->values[b * REPLICATION_VALUES] : nullptr;
+    const int32_t *in_last = (int)l < n_last && last->handles[l] == handle ? &last->values[l * REPLICATION_VALUES] : nullptr;
+    known[k] = in_last ? in_last : in_base;
+    if (in_base)
+      kept[b] = true;
+
+    // An entity not in the base goes with its description
+    const int32_t *values = &current.values[(size_t)j * REPLICATION_VALUES];
+    int fresh = in_base ? Entry_Bytes(handle, values, in_base) : NET_CREATE_BYTES + Entry_Bytes(handle, values, zeros);
+    int stale = 0;
+    if (known[k])
+      stale = in_base ? Entry_Bytes(handle, known[k], in_base) : NET_CREATE_BYTES + Entry_Bytes(handle, known[k], zeros);
+    spent += stale;
+
+    peer.priorities[slot] += relevant[k].first;
+    if (known[k] && std::equal(values, values + REPLICATION_VALUES, known[k]))
+      peer.priorities[slot] = 0.0f;
+    else
+    {
+      costs[k] = fresh - stale;
+      waiting.push_back((int)k);
+    }
+  }
+
+  // The headers and the entities of the base out of the view take their bytes first, as Replication_Write writes them
+  int n_destroyed = 0;
+  for (int b = 0, previous = -1; b < n_base; b++)
+  {
+    if (kept[b])
+      continue;
+    int slot = Slot(base->handles[b]);
+    spent += Varint_Bytes((uint32_t)(slot - previous - 1));
+    previous = slot;
+    n_destroyed++;
+  }
+  spent += NET_HEADER + REPLICATION_HEADER + Varint_Bytes((uint32_t)n_destroyed) + Varint_Bytes((uint32_t)relevant.size());
+
+  // The changes by priority while they fit, the ones that don't wait and gain priority
+  std::sort(waiting.begin(), waiting.end(), [&](int a, int b)
+            { return peer.priorities[Slot(current.handles[relevant[a].second])] >
+                     peer.priorities[Slot(current.handles[relevant[b].second])]; });
+  std::vector<bool> chosen(relevant.size(), false);
+  for (int k : waiting)
+  {
+    if (spent + costs[k] > settings.budget)
+    {
+      stats.deferred++;
+      continue;
+    }
+    spent += costs[k];
+    chosen[k] = true;
+    peer.priorities[Slot(current.handles[relevant[k].second])] = 0.0f;
+  }
+
+  Replication_Snapshot &filtered = peer.history[current.id % peer.history.size()];
+  filtered.id = current.id;
+  filtered.time = current.time;
+  filtered.handles.clear();
+  filtered.values.clear();
+  for (size_t k = 0; k < relevant.size(); k++)
+  {
+    if (!chosen[k] && !known[k])
+      continue;
+    int j = relevant[k].second;
+    const int32_t *values = chosen[k] ? &current.values[(size_t)j * REPLICATION_VALUES] : known[k];
+    filtered.handles.push_back(current.handles[j]);
+    filtered.values.insert(filtered.values.end(), values, values + REPLICATION_VALUES);
+  }
+  return filtered;
+}
+
+void Replication_Feed::publish(std::shared_ptr<const Replication_Tick> tick)
+{
+  std::atomic_store(&m_latest, std::move(tick));
+}
+
+std::shared_ptr<const Replication_Tick> Replication_Feed::latest() const
+{
+  return std::atomic_load(&m_latest);
+}
+
+Replication_Server::Replication_Server()
+{
+  m_registry = nullptr;
+  m_feed = nullptr;
+  m_id = 0;
+  m_timer = -1;
+  m_udpTimer = -1;
+  m_stats = {};
+  m_recorded = -1.0;
+}
+
+Replication_Server::~Replication_Server()
+{
+  close();
+}
+
+int Replication_Server::open(int port, Registry &registry)
+{
+  if (listen(port, false) != 0)
+    return 1;
+
+  m_registry = &registry;
+  m_timer = m_server.addTimer(1.0f / settings_.tick_rate, true, [this](GameServer &)
+                              { tick(); });
+  return 0;
+}
+
+int Replication_Server::open(int port, Replication_Feed &feed, bool shared)
+{
+  if (listen(port, shared) != 0)
+    return 1;
+
+  // The feed is checked often, a tick waits at most that long to be sent
+  m_feed = &feed;
+  m_timer = m_server.addTimer(REPLICATION_FOLLOW, true, [this](GameServer &)
+                              { tick(); });
+  return 0;
+}
+
+int Replication_Server::listen(int port, bool shared)
+{
+  close();
+
+  m_registry = nullptr;
+  m_feed = nullptr;
+  m_history.assign(std::max(settings_.history, 2), nullptr);
+  m_tick = nullptr;
+  m_id = 0;
+  m_recorded = -1.0;
+  m_peers.clear();
+  m_udpPeers.clear();
+
+  GameServer_Events events;
+  events.connected = [this](GameServer &, int client)
+  {
+    if (client >= (int)m_peers.size())
+      m_peers.resize(client + 1);
+    m_peers[client] = Replication_Peer();
+  };
+  events.received = [this](GameServer &, int client, Net_Ring &input)
+  { received(client, input); };
+  events.disconnected = [this](GameServer &, int client)
+  { m_peers[client].ready = false; };
+  m_server.setEvents(events);
+
+  // The UDP clients are the same peers, their frames come whole in the messages
+  Udp_Events udp_events;
+  udp_events.connected = [this](Udp_Endpoint &, int connection)
+  {
+    if (connection >= (int)m_udpPeers.size())
+      m_udpPeers.resize(connection + 1);
+    m_udpPeers[connection] = Replication_Peer();
+  };
+  udp_events.received = [this](Udp_Endpoint &endpoint, int connection, int, const uint8_t *data, int size)
+  {
+    Net_Message message;
+    int parsed;
+    while ((parsed = Net_Parse(data, size, message)) == 1)
+    {
+      handle(m_udpPeers[connection], message);
+      data += NET_HEADER + message.header.length;
+      size -= NET_HEADER + message.header.length;
+    }
+    if (parsed < 0)
+    {
+      std::cout << "ERROR: UDP client " << connection << " sent a corrupted frame, disconnected" << std::endl;
+      endpoint.disconnect(connection);
+    }
+  };
+  udp_events.disconnected = [this](Udp_Endpoint &, int connection)
+  { m_udpPeers[connection].ready = false; };
+  m_udp.setEvents(udp_events);
+
+  if (m_server.open(port, shared) != 0)
+    return 1;
+  if (m_udp.open(m_server.port(), shared) != 0)
+  {
+    m_server.close();
+    return 1;
+  }
+
+  m_udpTimer = m_server.addTimer(REPLICATION_UDP, true, [this](GameServer &)
+                                 { m_udp.update(); });
+  return 0;
+}
+
+void Replication_Server::close()
+{
+  if (m_timer >= 0)
+    m_server.removeTimer(m_timer);
+  if (m_udpTimer >= 0)
+    m_server.removeTimer(m_udpTimer);
+  m_timer = -1;
+  m_udpTimer = -1;
+  m_udp.close();
+  m_server.close();
+}
+
+const Replication_Snapshot *Replication_Server::snapshot(uint32_t id)
+{
+  if (id == 0 || id > m_id || m_id - id >= m_history.size())
+    return nullptr;
+
+  // A server that follows a feed can skip ticks, their places keep older snapshots
+  const std::shared_ptr<const Replication_Snapshot> &kept = m_history[id % m_history.size()];
+  return kept && kept->id == id ? kept.get() : nullptr;
+}
+
+void Replication_Server::received(int client, Net_Ring &input)
+{
+  Net_Message message;
+  int parsed;
+  while ((parsed = Net_Parse(input, message, m_scratch)) == 1)
+  {
+    handle(m_peers[client], message);
+    input.consume(NET_HEADER + message.header.length);
+  }
+
+  if (parsed < 0)
+  {
+    std::cout << "ERROR: Client " << client << " sent a corrupted frame, disconnected" << std::endl;
+    m_server.disconnect(client);
+  }
+}
+
+void Replication_Server::handle(Replication_Peer &peer, const Net_Message &message)
+{
+  if (message.header.type == NET_HELLO)
+  {
+    peer.ready = true;
+    peer.acked = 0;
+  }
+  else if (message.header.type == NET_ACK && message.header.length == 4)
+  {
+    // The acks only go forward, a snapshot not sent yet can't be acked
+    uint32_t id = Net_Read(message).u32();
+    if (id > peer.acked && id <= m_id)
+      peer.acked = id;
+  }
+  else if (message.header.type == NET_VIEW)
+  {
+    Net_View view;
+    if (Net_Read_View(message, view) != 0)
+      return;
+    peer.view = view;
+
+    // Its snapshots have their own history from now on, the next one is full
+    if (!peer.viewing && Interest_Grid::settings_.enabled)
+    {
+      peer.viewing = true;
+      peer.acked = 0;
+      peer.history.assign(m_history.size(), Replication_Snapshot());
+    }
+  }
+}
+
+const Replication_Snapshot *Replication_Server::base(Replication_Peer &peer)
+{
+  if (!peer.viewing)
+    return snapshot(peer.acked);
+
+  // An ack of a snapshot sent before the view isn't in the history
+  const Replication_Snapshot *acked = snapshot(peer.acked) ? &peer.history[peer.acked % peer.history.size()] : nullptr;
+  return acked && acked->id == peer.acked ? acked : nullptr;
+}
+
+void Replication_Server::describe(Replication_Peer &peer, const Replication_Tick &tick, const Replication_Snapshot &current,
+                                  const Replication_Snapshot *base)
+{
+  // The snapshot sent is the one of the tick or a part of it, both by slot
+  std::vector<int> created;
+  Replication_Diff(current, base, created, nullptr);
+  const std::vector<uint32_t> &handles = tick.snapshot->handles;
+  size_t j = 0;
+  for (size_t first = 0; first < created.size(); first += REPLICATION_CREATES)
+  {
+    size_t last = std::min(created.size(), first + REPLICATION_CREATES);
+    m_creates.resize(last - first);
+    for (size_t c = first; c < last; c++)
+    {
+      while (handles[j] != current.handles[created[c]])
+        j++;
+      m_creates[c - first] = tick.creates[j];
+    }
+    Net_Write_Create(peer.writer, m_creates.data(), (int)m_creates.size());
+  }
+}
+
+void Replication_Server::write(Replication_Peer &peer, const Replication_Snapshot &current, const Replication_Snapshot *base)
+{
+  size_t start = peer.writer.bytes().size();
+  Replication_Write(peer.writer, current, base);
+  int bytes = (int)(peer.writer.bytes().size() - start);
+  m_stats.snapshots++;
+  m_stats.bytes += bytes;
+  m_stats.full += base ? 0 : 1;
+  m_stats.lastBytes = bytes;
+  peer.snapshots++;
+}
+
+void Replication_Server::tick()
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::shared_ptr<const Replication_Tick> current;
+  if (m_feed)
+  {
+    // Every tick is sent once, the ones published meanwhile are skipped
+    current = m_feed->latest();
+    if (!current || current->snapshot->id == m_id)
+      return;
+  }
+  else
+  {
+    m_registry->update(1.0f / settings_.tick_rate);
+
+    // The grid is built once for every client with a view
+    bool viewing = false;
+    for (const std::vector<Replication_Peer> *peers : {&m_peers, &m_udpPeers})
+    {
+      for (const Replication_Peer &peer : *peers)
+        viewing = viewing || (peer.ready && peer.viewing);
+    }
+    std::shared_ptr<Replication_Tick> built = std::make_shared<Replication_Tick>();
+    Replication_Build(*m_registry, m_id + 1, (uint32_t)(m_server.time() * 1000.0), viewing, m_tick.get(), *built);
+    current = built;
+    m_tick = built;
+  }
+  std::chrono::steady_clock::time_point simulated = std::chrono::steady_clock::now();
+  send(current);
+  record(*current);
+
+  // A tick longer than the interval delays the next one, the timer skips the ticks it can't catch up
+  float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  m_stats.ticks++;
+  m_stats.tickTime += seconds;
+  m_stats.simulation += std::chrono::duration<double>(simulated - start).count();
+  m_stats.lastTick = seconds * 1000.0f;
+  m_stats.peakTick = std::max(m_stats.peakTick, m_stats.lastTick);
+  m_stats.overruns += seconds > 1.0f / settings_.tick_rate ? 1 : 0;
+}
+
+void Replication_Server::send(const std::shared_ptr<const Replication_Tick> &current)
+{
+  const Replication_Tick &tick = *current;
+  const Replication_Snapshot &snapshot = *tick.snapshot;
+  m_id = snapshot.id;
+  m_history[m_id % m_history.size()] = tick.snapshot;
+
+  // A tick without grid goes whole, the client has no base in its history and gets it full
+  auto snapshot_of = [&](Replication_Peer &peer, const Replication_Snapshot *base) -> const Replication_Snapshot &
+  {
+    if (!peer.viewing || !tick.gridded)
+      return snapshot;
+    const Replication_Snapshot &filtered = Replication_Filter(tick, base, peer, m_stats);
+    m_stats.interest = (int)filtered.handles.size();
+    return filtered;
+  };
+
+  for (int client = 0; client < (int)m_peers.size(); client++)
+  {
+    Replication_Peer &peer = m_peers[client];
+    if (!peer.ready || !m_server.connected(client))
+      continue;
+
+    // The entities new since the ack are described before the snapshot moves them
+    const Replication_Snapshot *acked = base(peer);
+    const Replication_Snapshot &sent = snapshot_of(peer, acked);
+    describe(peer, tick, sent, acked);
+    write(peer, sent, acked);
+
+    const std::vector<uint8_t> &frames = peer.writer.bytes();
+    m_server.send(client, frames.data(), (int)frames.size());
+    peer.bytes += (long long)frames.size();
+    peer.writer.clear();
+  }
+
+  // Over UDP the descriptions can't be lost, a snapshot late is better dropped than waited for
+  for (int connection = 0; connection < (int)m_udpPeers.size(); connection++)
+  {
+    Replication_Peer &peer = m_udpPeers[connection];
+    if (!peer.ready || !m_udp.connected(connection))
+      continue;
+
+    const Replication_Snapshot *acked = base(peer);
+    const Replication_Snapshot &sent = snapshot_of(peer, acked);
+    describe(peer, tick, sent, acked);
+    if (!peer.writer.bytes().empty())
+      m_udp.send(connection, UDP_RELIABLE, peer.writer.bytes().data(), (int)peer.writer.bytes().size());
+    peer.bytes += (long long)peer.writer.bytes().size();
+    peer.writer.clear();
+
+    write(peer, sent, acked);
+    m_udp.send(connection, UDP_UNRELIABLE, peer.writer.bytes().data(), (int)peer.writer.bytes().size());
+    peer.bytes += (long long)peer.writer.bytes().size();
+    peer.writer.clear();
+  }
+  m_udp.update();
+  m_stats.entities = (int)snapshot.handles.size();
+}
+
+void Replication_Server::record(const Replication_Tick &tick)
+{
+  double now = m_server.time();
+  if (!m_server.recorder().recording() || settings_.record_world <= 0.0f || (m_recorded >= 0.0 && now - m_recorded < settings_.record_world))
+    return;
+  m_recorded = now;
+
+  // The positions of the tick are the ones of the registry, the rotations come back from the snapshot
+  const Replication_Snapshot &snapshot = *tick.snapshot;
+  int count = (int)snapshot.handles.size();
+  float turn_step = 360.0f / REPLICATION_TURN;
+  m_rotations.resize(count);
+  for (int j = 0; j < count; j++)
+  {
+    const int32_t *values = &snapshot.values[(size_t)j * REPLICATION_VALUES];
+    m_rotations[j] = Quant_Euler({values[3] * turn_step, values[4] * turn_step, values[5] * turn_step});
+  }
+  m_server.recorder().recordWorld(now, tick.positions.data(), m_rotations.data(), count, settings_.position_step);
+}
+
+GameServer &Replication_Server::server()
+{
+  return m_server;
+}
+
+const Replication_Stats &Replication_Server::stats()
+{
+  return m_stats;
+}
+
+void Replication_Server::peers(const std::function<void(bool udp, int client, const Replication_Peer &peer)> &visit)
+{
+  for (int client = 0; client < (int)m_peers.size(); client++)
+  {
+    if (m_peers[client].ready && m_server.connected(client))
+      visit(false, client, m_peers[client]);
+  }
+  for (int connection = 0; connection < (int)m_udpPeers.size(); connection++)
+  {
+    if (m_udpPeers[connection].ready && m_udp.connected(connection))
+      visit(true, connection, m_udpPeers[connection]);
+  }
+}
+
+Replication_Jitter::Replication_Jitter()
+{
+  clear();
+}
+
+void Replication_Jitter::clear()
+{
+  m_frames.clear();
+  m_previous = Replication_Frame();
+  m_previous.snapshot.id = 0;
+  m_previous.time = 0.0;
+  m_offset = 0.0;
+  m_transit = 0.0;
+  m_shown = 0.0;
+  m_sampled = -1.0;
+  m_bump = 0.0f;
+  m_synced = false;
+  m_adapting = false;
+  m_playback = {};
+  m_playback.delay = Replication_Server::settings_.delay;
+  m_playback.interval = 1.0f / Replication_Server::settings_.tick_rate;
+}
+
+void Replication_Jitter::push(const Replication_Snapshot &snapshot, std::vector<int> &&locals, double arrival)
+{
+  double time = snapshot.time / 1000.0;
+  double transit = arrival - time;
+  if (!m_synced)
+  {
+    m_offset = transit;
+    m_transit = transit;
+    m_shown = time - m_playback.delay;
+    m_synced = true;
+  }
+  else
+  {
+    // The jitter of RFC 3550, the mean variation of the transit
+    m_playback.jitter += ((float)fabs(transit - m_transit) - m_playback.jitter) / 16.0f;
+    m_transit = transit;
+
+    // The smallest transit is let go slowly, to follow a drift of the clocks or a new route
+    m_offset = std::min(transit, m_offset + REPLICATION_DRIFT);
+  }
+
+  // The connection keeps the order, an older snapshot is a repeated one
+  if (!m_frames.empty())
+  {
+    if (time <= m_frames.back().time)
+      return;
+    m_playback.interval += ((float)(time - m_frames.back().time) - m_playback.interval) / 8.0f;
+  }
+
+  // Late, its time was already shown: the delay grows at once
+  if (time < m_shown)
+  {
+    m_playback.late++;
+    m_bump = std::min(m_bump + m_playback.interval * 0.5f, Replication_Server::settings_.max_delay);
+  }
+
+  m_frames.push_back({snapshot, std::move(locals), time});
+}
+
+/**
+ * @brief Calls place with the entities between two snapshots.
+ *
+ * @param from The older snapshot.
+ * @param to The newer snapshot.
+ * @param alpha The fraction from the older to the newer, over 1 extrapolates.
+ * @param older True to also place the entities only in the older snapshot.
+ * @param place The function called with every entity.
+ */
+static void Replication_Blend(const Replication_Frame &from, const Replication_Frame &to, float alpha, bool older,
+                              const std::function<void(int local, Vec3 position, Vec3 rotation, Vec3 scale)> &place)
+{
+  float position_step = Replication_Server::settings_.position_step;
+  float scale_step = Replication_Server::settings_.scale_step;
+  float degrees = 360.0f / REPLICATION_TURN;
+  auto blend = [&](int local, const int32_t *a, const int32_t *b)
+  {
+    if (local < 0)
+      return;
+
+    float v[REPLICATION_VALUES];
+    for (int i = 0; i < REPLICATION_VALUES; i++)
+      v[i] = a[i] + Delta(i, b[i], a[i]) * alpha;
+    place(local, Vec3{v[0], v[1], v[2]} * position_step, Vec3{v[3], v[4], v[5]} * degrees, Vec3{v[6], v[7], v[8]} * scale_step);
+  };
+
+  const Replication_Snapshot &a = from.snapshot;
+  const Replication_Snapshot &b = to.snapshot;
+  int m = (int)a.handles.size();
+  int n = (int)b.handles.size();
+  int i = 0;
+  int j = 0;
+  while (i < m || j < n)
+  {
+    if (j == n || (i < m && Slot(a.handles[i]) < Slot(b.handles[j])))
+    {
+      if (older)
+        blend(from.locals[i], &a.values[(size_t)i * REPLICATION_VALUES], &a.values[(size_t)i * REPLICATION_VALUES]);
+      i++;
+    }
+    else if (i == m || Slot(b.handles[j]) < Slot(a.handles[i]) || a.handles[i] != b.handles[j])
+    {
+      blend(to.locals[j], &b.values[(size_t)j * REPLICATION_VALUES], &b.values[(size_t)j * REPLICATION_VALUES]);
+      if (i < m && Slot(a.handles[i]) == Slot(b.handles[j]))
+        i++;
+      j++;
+    }
+    else
+    {
+      blend(to.locals[j], &a.values[(size_t)i * REPLICATION_VALUES], &b.values[(size_t)j * REPLICATION_VALUES]);
+      i++;
+      j++;
+    }
+  }
+}
+
+void Replication_Jitter::sample(double now, const std::function<void(int local, Vec3 position, Vec3 rotation, Vec3 scale)> &place,
+                                const std::function<void(uint32_t entity, int local)> &destroyed)
+{
+  if (!m_synced || m_frames.empty())
+    return;
+
+  // The delay changes the pace of the playback a little, it never jumps
+  const Replication_Settings &settings = Replication_Server::settings_;
+  float elapsed = m_sampled >= 0.0 ? (float)(now - m_sampled) : 0.0f;
+  m_sampled = now;
+  if (settings.adaptive)
+  {
+    m_bump = std::max(m_bump - elapsed * REPLICATION_RECOVERY, 0.0f);
+    float target = m_playback.interval + settings.jitter_margin * m_playback.jitter + m_bump;
+    target = std::min(std::max(target, m_playback.interval), settings.max_delay);
+    // Adapting starts when the delay is far from its target, and goes on until it gets there
+    float error = target - m_playback.delay;
+    float step = elapsed * REPLICATION_PACE;
+    if (fabsf(error) > m_playback.interval * REPLICATION_DEADBAND)
+      m_adapting = true;
+    if (m_adapting)
+    {
+      m_playback.delay += std::min(std::max(error, -step), step);
+      m_adapting = fabsf(error) > step;
+    }
+  }
+  else
+    m_playback.delay = settings.delay;
+  m_shown = std::max(m_shown, now - m_offset - m_playback.delay);
+
+  // The snapshots passed leave, the entities missing from the next one are gone
+  std::vector<int> created;
+  std::vector<int> gone;
+  while (m_frames.size() >= 2 && m_frames[1].time <= m_shown)
+  {
+    Replication_Diff(m_frames[1].snapshot, &m_frames[0].snapshot, created, &gone);
+    for (int i : gone)
+      destroyed(m_frames[0].snapshot.handles[i], m_frames[0].locals[i]);
+    m_previous = std::move(m_frames.front());
+    m_frames.pop_front();
+  }
+
+  m_playback.depth = 0;
+  for (const Replication_Frame &frame : m_frames)
+    m_playback.depth += frame.time > m_shown ? 1 : 0;
+
+  const Replication_Frame &current = m_frames[0];
+  if (m_frames.size() >= 2)
+  {
+    const Replication_Frame &next = m_frames[1];
+    float alpha = (float)std::min(std::max((m_shown - current.time) / (next.time - current.time), 0.0), 1.0);
+    Replication_Blend(current, next, alpha, true, place);
+    return;
+  }
+
+  // Past the last snapshot: on with the last velocity, then stopped
+  double past = m_shown - current.time;
+  if (past <= 0.0 || m_previous.snapshot.id == 0)
+  {
+    Replication_Blend(current, current, 0.0f, true, place);
+    return;
+  }
+  if (past <= settings.extrapolation)
+    m_playback.extrapolated++;
+  else
+  {
+    m_playback.held++;
+    past = settings.extrapolation;
+  }
+  Replication_Blend(m_previous, current, 1.0f + (float)(past / (current.time - m_previous.time)), false, place);
+}
+
+const Replication_Playback &Replication_Jitter::playback()
+{
+  return m_playback;
+}
+
+Replication_Client::Replication_Client()
+{
+  m_history.assign(std::max(Replication_Server::settings_.history, 2), Replication_Snapshot());
+  m_connection = -1;
+  m_closed = false;
+  m_view = Net_View();
+  m_viewed = -1.0;
+  m_hasCube = false;
+  m_start = std::chrono::steady_clock::now();
+  m_last = 0.0;
+  m_stats = {};
+}
+
+int Replication_Client::connect(const std::string &ipAddress, int port, bool udp)
+{
+  m_jitter.clear();
+  m_udp.close();
+  m_connection = -1;
+  m_closed = false;
+  m_received.clear();
+  m_viewed = -1.0;
+  if (!udp)
+    return m_client.connectToServer(ipAddress, port);
+
+  // The server takes the client once it says hello, as over TCP
+  Udp_Events events;
+  events.connected = [this](Udp_Endpoint &endpoint, int connection)
+  {
+    m_writer.begin(NET_HELLO);
+    m_writer.end();
+    endpoint.send(connection, UDP_RELIABLE, m_writer.bytes().data(), (int)m_writer.bytes().size());
+    m_writer.clear();
+  };
+  events.received = [this](Udp_Endpoint &, int, int, const uint8_t *data, int size)
+  { m_received.insert(m_received.end(), data, data + size); };
+  events.disconnected = [this](Udp_Endpoint &, int)
+  { m_closed = true; };
+  m_udp.setEvents(events);
+
+  if (m_udp.open(0) != 0)
+    return 1;
+  m_connection = m_udp.connect(ipAddress, port);
+  return m_connection >= 0 ? 0 : 1;
+}
+
+void Replication_Client::create(Registry &registry, const Net_Create &entity)
+{
+  if (m_entities.find(entity.entity) != m_entities.end())
+    return;
+
+  // The tessellations are built once, as Scene_Instantiate does
+  int handle;
+  if (entity.type == typeSphere)
+  {
+    int key = entity.subdivisions >= 0 ? 100 + std::min((int)entity.subdivisions, MAX_ICO_LEVEL) : std::min(std::max((int)entity.res, 2), 50);
+    if (m_spheres.find(key) == m_spheres.end())
+    {
+      if (entity.subdivisions >= 0)
+        m_spheres[key].initIcosphere({255, 255, 255, 255}, false, entity.subdivisions);
+      else
+        m_spheres[key].init({255, 255, 255, 255}, false, key);
+    }
+    Sphere sphere = m_spheres[key];
+    sphere.place(entity.color, entity.fill != 0, entity.scale, entity.position, entity.rotation * 0.1f, {0, 0, 0}, {0, 0, 0});
+    handle = registry.add(typeSphere, std::move(sphere));
+  }
+  else
+  {
+    if (!m_hasCube)
+      m_cube.init({255, 255, 255, 255});
+    m_hasCube = true;
+    Cube cube = m_cube;
+    cube.place(entity.color, entity.fill != 0, entity.scale, entity.position, entity.rotation * 0.1f, {0, 0, 0}, {0, 0, 0});
+    handle = registry.add(typeCube, std::move(cube));
+  }
+
+  if (handle >= 0)
+    m_entities[entity.entity] = {handle, entity.spin};
+}
+
+void Replication_Client::view(Render &render)
+{
+  Net_View view;
+  view.position = render.camera_;
+  render.getFrustum(view.points, view.normals);
+  double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+  if (m_viewed >= 0.0 && now - m_viewed < REPLICATION_VIEW && memcmp(&view, &m_view, sizeof(Net_View)) == 0)
+    return;
+  m_view = view;
+  m_viewed = now;
+
+  // A lost view is replaced by the next one, it doesn't have to be reliable
+  if (m_connection >= 0)
+  {
+    Net_Write_View(m_writer, view);
+    m_udp.send(m_connection, UDP_UNRELIABLE, m_writer.bytes().data(), (int)m_writer.bytes().size());
+    m_writer.clear();
+  }
+  else
+  {
+    Net_Write_View(m_client.writer(), view);
+    m_client.send(m_client.writer());
+  }
+}
+
+bool Replication_Client::handle(Registry &registry, const Net_Message &message, double now, uint32_t &latest)
+{
+  if (message.header.type == NET_CREATE)
+  {
+    int count = Net_Count(message);
+    for (int i = 0; i < count; i++)
+    {
+      Net_Create entity;
+      Net_Read_Create(message, i, entity);
+      create(registry, entity);
+    }
+  }
+  else if (message.header.type == NET_SNAPSHOT)
+  {
+    // The base is a snapshot received before, the server only uses the ones acked
+    uint32_t base_id = Replication_Base(message);
+    const Replication_Snapshot *base = nullptr;
+    if (base_id != 0)
+    {
+      base = &m_history[base_id % m_history.size()];
+      if (base->id != base_id)
+        return false;
+    }
+    if (Replication_Read(message, base, m_decoded) != 0)
+      return false;
+
+    Replication_Snapshot &stored = m_history[m_decoded.id % m_history.size()];
+    std::swap(stored, m_decoded);
+    latest = stored.id;
+    m_stats.snapshots++;
+    m_stats.bytes += NET_HEADER + message.header.length;
+    m_stats.full += base ? 0 : 1;
+    m_stats.lastBytes = NET_HEADER + message.header.length;
+    m_stats.entities = (int)stored.handles.size();
+
+    // The entities were created before the snapshot, they are looked up once
+    std::vector<int> locals(stored.handles.size());
+    for (size_t i = 0; i < stored.handles.size(); i++)
+    {
+      auto found = m_entities.find(stored.handles[i]);
+      locals[i] = found != m_entities.end() ? found->second.handle : -1;
+    }
+    m_jitter.push(stored, std::move(locals), now);
+  }
+  return true;
+}
+
+int Replication_Client::update(Registry &registry)
+{
+  double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+  long long received = m_stats.snapshots;
+  bool ok = true;
+  uint32_t latest = 0;
+  auto handler = [&](const Net_Message &message)
+  { ok = ok && handle(registry, message, now, latest); };
+
+  // Every UDP message holds whole frames, a cut one is as corrupted as a wrong one
+  int frames = 0;
+  if (m_connection >= 0)
+  {
+    m_udp.update();
+    const uint8_t *data = m_received.data();
+    int size = (int)m_received.size();
+    Net_Message message;
+    int parsed;
+    while ((parsed = Net_Parse(data, size, message)) == 1)
+    {
+      handler(message);
+      data += NET_HEADER + message.header.length;
+      size -= NET_HEADER + message.header.length;
+      frames++;
+    }
+    m_received.clear();
+    if (parsed < 0 || m_closed)
+      frames = -1;
+  }
+  else
+    frames = m_client.receive(handler);
+  if (frames < 0 || !ok)
+    return -1;
+
+  // Only the last snapshot is acked, the server uses it as the base; a lost ack is replaced by the next one
+  if (latest != 0 && m_connection >= 0)
+  {
+    Net_Write_Ack(m_writer, latest);
+    m_udp.send(m_connection, UDP_UNRELIABLE, m_writer.bytes().data(), (int)m_writer.bytes().size());
+    m_writer.clear();
+  }
+  else if (latest != 0)
+  {
+    Net_Write_Ack(m_client.writer(), latest);
+    if (m_client.send(m_client.writer()) != 0)
+      return -1;
+  }
+
+  present(registry, now);
+  return (int)(m_stats.snapshots - received);
+}
+
+int Replication_Client::replay(Registry &registry, Net_Ring &input, double now)
+{
+  long long received = m_stats.snapshots;
+  uint32_t latest = 0;
+  Net_Message message;
+  int parsed;
+  while ((parsed = Net_Parse(input, message, m_scratch)) == 1)
+  {
+    if (!handle(registry, message, now, latest))
+      return -1;
+    input.consume(NET_HEADER + message.header.length);
+  }
+  if (parsed < 0)
+    return -1;
+
+  present(registry, now);
+  return (int)(m_stats.snapshots - received);
+}
+
+void Replication_Client::present(Registry &registry, double now)
+{
+  // The registry sees the translations as moves of the controls, its state follows
+  auto place = [&registry](int local, Vec3 position, Vec3 rotation, Vec3 scale)
+  {
+    if (!registry.valid(local))
+      return;
+    Entity *entity = registry.entity(local);
+
+    Vec3 move = position - entity->mov_;
+    if (move.x != 0.0f || move.y != 0.0f || move.z != 0.0f)
+      entity->translation(move);
+
+    Vec3 turn = rotation - entity->getRotation();
+    turn = {Wrap_Degrees(turn.x), Wrap_Degrees(turn.y), Wrap_Degrees(turn.z)};
+    if (fabsf(turn.x) > REPLICATION_EPSILON || fabsf(turn.y) > REPLICATION_EPSILON || fabsf(turn.z) > REPLICATION_EPSILON)
+      entity->rotation(turn * 0.1f);
+
+    Vec3 current = entity->getScale();
+    if (current.x != 0.0f && current.y != 0.0f && current.z != 0.0f && (scale.x != current.x || scale.y != current.y || scale.z != current.z))
+      entity->scale({scale.x / current.x, scale.y / current.y, scale.z / current.z});
+  };
+
+  // The merged entities break apart here too
+  auto destroyed = [this, &registry](uint32_t entity, int local)
+  {
+    if (registry.valid(local) && !registry.entity(local)->isDestroying())
+      registry.entity(local)->startDestroy();
+    m_entities.erase(entity);
+  };
+  m_jitter.sample(now, place, destroyed);
+
+  // The spin of the orbits doesn't travel, it is a function of the time
+  float elapsed = (float)(now - m_last);
+  m_last = now;
+  for (auto &replicated : m_entities)
+  {
+    const Vec3 &spin = replicated.second.spin;
+    if ((spin.x == 0.0f && spin.y == 0.0f && spin.z == 0.0f) || !registry.valid(replicated.second.handle))
+      continue;
+    Entity *entity = registry.entity(replicated.second.handle);
+    entity->orbit({spin, entity->mov_, elapsed});
+  }
+}
+
+const Replication_Stats &Replication_Client::stats()
+{
+  return m_stats;
+}
+
+const Replication_Playback &Replication_Client::playback()
+{
+  return m_jitter.playback();
+}
+
+/**
+ * @brief Measures the snapshots of a generated scene.
+ *
+ * @param n The number of entities.
+ * @param ticks The snapshots.
+ * @param moving The percentage of the entities that orbit.
+ * @param row The line of the table.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 A snapshot read doesn't match the one written.
+ */
+static int Replication_Run(int n, int ticks, int moving, std::string &row)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  Scene scene;
+  Scene_Generate(scene, n, 1234, {400.0f, 300.0f, 0.0f});
+  for (int i = 0; i < n; i++)
+  {
+    if (i % 100 >= moving)
+      scene.bodies[i].orbit_vel = 0.0f;
+  }
+  Registry registry;
+  Vec3 light;
+  Render drawRender;
+  Scene_Instantiate(scene, registry, light, drawRender, {800.0f, 600.0f});
+
+  // The server keeps the snapshots acked two ticks later, the client the ones it received
+  const int lag = 2;
+  std::vector<Replication_Snapshot> sent(lag + 1);
+  std::vector<Replication_Snapshot> received(lag + 1);
+  Net_Writer writer;
+  Net_Writer full;
+  long long delta_bytes = 0;
+  int full_bytes = 0;
+  double encode_ms = 0.0;
+  double decode_ms = 0.0;
+  int errors = 0;
+  for (int t = 1; t <= ticks; t++)
+  {
+    registry.update(1.0f / Replication_Server::settings_.tick_rate);
+    Replication_Snapshot &current = sent[t % (lag + 1)];
+    Replication_Capture(registry, (uint32_t)t, (uint32_t)(t * 1000 / Replication_Server::settings_.tick_rate), current);
+    const Replication_Snapshot *base = t > lag ? &sent[(t - lag) % (lag + 1)] : nullptr;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    writer.clear();
+    Replication_Write(writer, current, base);
+    encode_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+    if (base)
+      delta_bytes += writer.bytes().size();
+
+    full.clear();
+    Replication_Write(full, current, nullptr);
+    full_bytes = (int)full.bytes().size();
+
+    Net_Message message;
+    Net_Reader header = {writer.bytes().data(), NET_HEADER, 0, true};
+    message.header.length = header.u32();
+    message.header.version = header.u8();
+    message.header.type = header.u8();
+    message.payload = writer.bytes().data() + NET_HEADER;
+
+    start = std::chrono::steady_clock::now();
+    Replication_Snapshot &read = received[t % (lag + 1)];
+    int ret = Replication_Read(message, t > lag ? &received[(t - lag) % (lag + 1)] : nullptr, read);
+    decode_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+    if (ret != 0 || read.handles != current.handles || read.values != current.values)
+      errors++;
+  }
+
+  // Raw is the same registry as float transforms, a Net_Transform per entity
+  char line[160];
+  int count = registry.count();
+  double delta = (double)delta_bytes / (ticks - lag);
+  snprintf(line, sizeof(line), "%-9d %-7d %-11d %-11d %-17.0f %-13.2f %-10.3f %-10.3f %d\n", count, moving, NET_HEADER + 4 + 40 * count,
+           full_bytes, delta, delta / std::max(count, 1), encode_ms / ticks, decode_ms / ticks, errors);
+  row = line;
+  return errors == 0 ? 0 : 1;
+}
+
+int Replication_Benchmark(int entities, int ticks)
+{
+  std::vector<int> sizes;
+  if (entities > 0)
+    sizes.push_back(entities);
+  else
+    sizes = {1000, 100000};
+  ticks = std::max(ticks, 3);
+
+  // The scenes print while they are generated, the table goes after them
+  int ret = 0;
+  std::vector<std::string> rows;
+  for (int n : sizes)
+  {
+    for (int moving : {100, 1})
+    {
+      rows.emplace_back();
+      ret |= Replication_Run(n, ticks, moving, rows.back());
+    }
+  }
+
+  printf("Entities  Moving  Raw bytes   Full bytes  Delta bytes/tick  Bytes/entity  Encode ms  Decode ms  Errors\n");
+  for (const std::string &row : rows)
+    printf("%s", row.c_str());
+  return ret;
+}
+
+/**
+ * @brief Measures the snapshots of a client that sends its view, in a generated scene.
+ *
+ * @param n The number of entities.
+ * @param ticks The snapshots.
+ * @param row The line of the table.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The grid doesn't find what a test of every entity finds, or a snapshot read doesn't match.
+ */
+static int Interest_Run(int n, int ticks, std::string &row)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  Scene scene;
+  Scene_Generate(scene, n, 1234, {400.0f, 300.0f, 0.0f});
+  Registry registry;
+  Vec3 light;
+  Render drawRender;
+  Scene_Instantiate(scene, registry, light, drawRender, {800.0f, 600.0f});
+
+  // The client looks from the camera of the scene and acks two ticks later
+  Replication_Peer peer = Replication_Peer();
+  peer.viewing = true;
+  peer.view.position = drawRender.camera_;
+  drawRender.getFrustum(peer.view.points, peer.view.normals);
+  peer.history.assign(std::max(Replication_Server::settings_.history, 2), Replication_Snapshot());
+  const int lag = 2;
+  std::vector<std::shared_ptr<const Replication_Snapshot>> sent(lag + 1);
+  std::vector<Replication_Snapshot> received(peer.history.size());
+
+  Replication_Tick built[2];
+  std::vector<int> found;
+  std::vector<int> created;
+  Replication_Stats stats = {};
+  Net_Writer writer;
+  long long broadcast_bytes = 0;
+  long long interest_bytes = 0;
+  long long interest = 0;
+  int peak = 0;
+  int visible = 0;
+  double build_ms = 0.0;
+  double filter_ms = 0.0;
+  int errors = 0;
+  for (int t = 1; t <= ticks; t++)
+  {
+    registry.update(1.0f / Replication_Server::settings_.tick_rate);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Replication_Tick &tick = built[t % 2];
+    Replication_Build(registry, (uint32_t)t, (uint32_t)(t * 1000 / Replication_Server::settings_.tick_rate), true,
+                      t > 1 ? &built[(t - 1) % 2] : nullptr, tick);
+    build_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+    sent[t % (lag + 1)] = tick.snapshot;
+    const Replication_Snapshot &current = *tick.snapshot;
+
+    if (t == 1)
+    {
+      visible = tick.grid.query(peer.view.points, peer.view.normals, NET_VIEW_PLANES, found);
+      int brute_visible = 0;
+      for (int i = 0; i < registry.count(); i++)
+      {
+        bool in = true;
+        for (int p = 0; p < NET_VIEW_PLANES; p++)
+          in = in && Vec3::DotProduct(registry.positions()[i] - peer.view.points[p], peer.view.normals[p]) >= -registry.radii()[i];
+        brute_visible += in;
+      }
+      if (visible != brute_visible)
+      {
+        printf("ERROR: The grid finds %d entities, brute force %d\n", visible, brute_visible);
+        errors++;
+      }
+    }
+
+    // Every entity to every client, the descriptions of the new ones included
+    const Replication_Snapshot *base = t > lag ? sent[(t - lag) % (lag + 1)].get() : nullptr;
+    writer.clear();
+    Replication_Write(writer, current, base);
+    Replication_Diff(current, base, created, nullptr);
+    broadcast_bytes += (long long)writer.bytes().size() + (long long)created.size() * NET_CREATE_BYTES;
+
+    // Only what the view sees, within the budget
+    const Replication_Snapshot *acked = nullptr;
+    if (t > lag && peer.history[(t - lag) % peer.history.size()].id == (uint32_t)(t - lag))
+      acked = &peer.history[(t - lag) % peer.history.size()];
+    start = std::chrono::steady_clock::now();
+    const Replication_Snapshot &filtered = Replication_Filter(tick, acked, peer, stats);
+    filter_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+    writer.clear();
+    Replication_Write(writer, filtered, acked);
+    Replication_Diff(filtered, acked, created, nullptr);
+    int bytes = (int)writer.bytes().size() + (int)created.size() * NET_CREATE_BYTES;
+    interest_bytes += bytes;
+    interest += (long long)filtered.handles.size();
+    peak = std::max(peak, bytes);
+
+    Net_Message message;
+    Replication_Snapshot &read = received[t % received.size()];
+    const Replication_Snapshot *read_base = acked ? &received[acked->id % received.size()] : nullptr;
+    if (Net_Parse(writer.bytes().data(), (int)writer.bytes().size(), message) != 1 || Replication_Read(message, read_base, read) != 0 ||
+        read.handles != filtered.handles || read.values != filtered.values)
+    {
+      if (errors++ == 0)
+        printf("ERROR: Snapshot %d of the client doesn't match the one written\n", t);
+    }
+  }
+
+  if (peak > Interest_Grid::settings_.budget)
+  {
+    printf("ERROR: A snapshot of %d bytes is over the budget of %d\n", peak, Interest_Grid::settings_.budget);
+    errors++;
+  }
+
+  char line[160];
+  snprintf(line, sizeof(line), "%-9d %-8d %-9lld %-17lld %-16lld %-7d %-7d %-14.1f %-8.3f %-10.3f %d\n", registry.count(), visible,
+           interest / ticks, broadcast_bytes / ticks, interest_bytes / ticks, peak, Interest_Grid::settings_.budget,
+           (double)stats.deferred / ticks, build_ms / ticks, filter_ms / ticks, errors);
+  row = line;
+  return errors == 0 ? 0 : 1;
+}
+
+int Replication_Interest_Benchmark(int entities, int ticks)
+{
+  std::vector<int> sizes;
+  if (entities > 0)
+    sizes.push_back(entities);
+  else
+    sizes = {1000, 10000, 100000};
+  ticks = std::max(ticks, 3);
+
+  // The scenes print while they are generated, the table goes after them
+  int ret = 0;
+  std::vector<std::string> rows;
+  for (int n : sizes)
+  {
+    rows.emplace_back();
+    ret |= Interest_Run(n, ticks, rows.back());
+  }
+
+  printf("Entities  Visible  Sent/tick Broadcast B/tick  Interest B/tick  Peak B  Budget  Deferred/tick  Build ms Filter ms  Errors\n");
+  for (const std::string &row : rows)
+    printf("%s", row.c_str());
+  return ret;
+}
+
+// FNV-1a, the hashes of the replays
+static uint64_t Replay_Hash(uint64_t hash, const void *data, size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  return hash;
+}
+
+/**
+ * @brief Reads the next event of the session of a client in a log.
+ *
+ * @param log The log.
+ * @param client The client, -1 takes the first one accepted.
+ * @param record The event.
+ * @param started A flag indicating whether the session started, false before the first call.
+ *
+ * @return 1 An event of the session was read.
+ * @return 0 The session or the log ended.
+ * @return -1 The log is corrupted.
+ */
+static int Replay_Next(Net_Log &log, int &client, Net_Record &record, bool &started)
+{
+  int read;
+  while ((read = log.next(record)) == 1)
+  {
+    // The slot of a client is reused by later connections, only the first session is played
+    if (!started && record.kind == NET_RECORD_CONNECTED && (client < 0 || record.client == client))
+    {
+      client = record.client;
+      started = true;
+    }
+    if (!started || record.client != client)
+      continue;
+    return record.kind == NET_RECORD_DISCONNECTED ? 0 : 1;
+  }
+  return read;
+}
+
+int Replication_Replay(const std::string &path, int client)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  Net_Log log;
+  if (log.open(path) != 0)
+    return 1;
+
+  // The protocol alone: every frame parsed, the snapshots read against their bases
+  int chosen = client;
+  bool started = false;
+  Net_Record record;
+  Net_Ring out;
+  Net_Ring in;
+  std::vector<uint8_t> scratch;
+  std::vector<Replication_Snapshot> history(std::max(Replication_Server::settings_.history, 2));
+  Replication_Snapshot decoded;
+  long long frames = 0;
+  long long snapshots = 0;
+  long long creates = 0;
+  long long bytes_out = 0;
+  long long bytes_in = 0;
+  long long types_in[NET_MAX_TYPE] = {};
+  double first = -1.0;
+  double last = 0.0;
+  uint64_t decode_hash = 1469598103934665603ull;
+  int errors = 0;
+  int read;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (errors == 0 && (read = Replay_Next(log, chosen, record, started)) == 1)
+  {
+    first = first < 0.0 ? record.time : first;
+    last = record.time;
+    Net_Message message;
+    int parsed;
+    if (record.kind == NET_RECORD_IN)
+    {
+      bytes_in += record.size;
+      in.write(record.data, record.size);
+      while ((parsed = Net_Parse(in, message, scratch)) == 1)
+      {
+        types_in[message.header.type]++;
+        in.consume(NET_HEADER + message.header.length);
+      }
+      errors += parsed < 0;
+      continue;
+    }
+    if (record.kind != NET_RECORD_OUT)
+      continue;
+
+    bytes_out += record.size;
+    out.write(record.data, record.size);
+    while ((parsed = Net_Parse(out, message, scratch)) == 1)
+    {
+      frames++;
+      if (message.header.type == NET_CREATE)
+        creates += Net_Count(message);
+      else if (message.header.type == NET_SNAPSHOT)
+      {
+        uint32_t base_id = Replication_Base(message);
+        const Replication_Snapshot *base = base_id != 0 ? &history[base_id % history.size()] : nullptr;
+        if ((base && base->id != base_id) || Replication_Read(message, base, decoded) != 0)
+        {
+          errors++;
+          break;
+        }
+        decode_hash = Replay_Hash(decode_hash, &decoded.id, sizeof(decoded.id));
+        decode_hash = Replay_Hash(decode_hash, decoded.handles.data(), decoded.handles.size() * sizeof(uint32_t));
+        decode_hash = Replay_Hash(decode_hash, decoded.values.data(), decoded.values.size() * sizeof(int32_t));
+        std::swap(history[decoded.id % history.size()], decoded);
+        snapshots++;
+      }
+      out.consume(NET_HEADER + message.header.length);
+    }
+    errors += parsed < 0;
+  }
+  double decode_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+  errors += read < 0;
+  if (!started)
+  {
+    std::cout << "ERROR: The log has no client " << client << std::endl;
+    return 1;
+  }
+
+  // The same frames through a client, at the times of the log; the registry doesn't simulate
+  bool collide = Collider::settings_.enabled;
+  Collider::settings_.enabled = false;
+  Registry registry;
+  Replication_Client replica;
+  Net_Ring stream;
+  double previous = first;
+  started = false;
+  log.rewind();
+  start = std::chrono::steady_clock::now();
+  while (errors == 0 && Replay_Next(log, chosen, record, started) == 1)
+  {
+    if (record.kind != NET_RECORD_OUT)
+      continue;
+    stream.write(record.data, record.size);
+    if (replica.replay(registry, stream, record.time) < 0)
+      errors++;
+    registry.update((float)(record.time - previous));
+    previous = record.time;
+  }
+  double apply_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+  Collider::settings_.enabled = collide;
+
+  // The worlds belong to no client, every one is read back
+  long long worlds = 0;
+  long long world_entities = 0;
+  long long world_bytes = 0;
+  std::vector<Vec3> world_positions;
+  std::vector<Vec4> world_rotations;
+  log.rewind();
+  while (errors == 0 && log.next(record) == 1)
+  {
+    if (record.kind != NET_RECORD_WORLD)
+      continue;
+    Quant_Bits_Reader reader = {record.data, (uint32_t)record.size, 0, 0, 0, true};
+    errors += Quant_Read_Transforms(reader, world_positions, world_rotations);
+    worlds++;
+    world_entities += (long long)world_positions.size();
+    world_bytes += record.size;
+  }
+
+  uint64_t apply_hash = 1469598103934665603ull;
+  for (int i = 0; i < registry.count(); i++)
+  {
+    int handle = registry.handle(i);
+    apply_hash = Replay_Hash(apply_hash, &handle, sizeof(handle));
+    apply_hash = Replay_Hash(apply_hash, &registry.positions()[i], sizeof(Vec3));
+    apply_hash = Replay_Hash(apply_hash, &registry.scales()[i], sizeof(Vec3));
+  }
+
+  printf("Log %s: %d bytes, client %d for %.1f s\n", path.c_str(), log.size(), chosen, std::max(last - first, 0.0));
+  printf("Frames    Snapshots  Creates   Bytes out   Bytes in   Acks      Views     Entities\n");
+  printf("%-9lld %-10lld %-9lld %-11lld %-10lld %-9lld %-9lld %d\n", frames, snapshots, creates, bytes_out, bytes_in, types_in[NET_ACK],
+         types_in[NET_VIEW], registry.count());
+  printf("Worlds    Bytes      Entities  Bytes/entity\n");
+  printf("%-9lld %-10lld %-9lld %.2f\n", worlds, world_bytes, world_entities, world_bytes / (double)std::max(world_entities, 1ll));
+  printf("Pass     Ms         MB/s      Snapshots/s  Hash\n");
+  double mb = bytes_out / (1024.0 * 1024.0);
+  printf("Decode   %-10.2f %-9.1f %-12.0f %016llx\n", decode_ms, mb / std::max(decode_ms / 1000.0, 1e-9),
+         snapshots / std::max(decode_ms / 1000.0, 1e-9), (unsigned long long)decode_hash);
+  printf("Apply    %-10.2f %-9.1f %-12.0f %016llx\n", apply_ms, mb / std::max(apply_ms / 1000.0, 1e-9),
+         snapshots / std::max(apply_ms / 1000.0, 1e-9), (unsigned long long)apply_hash);
+  if (errors > 0)
+    printf("ERROR: The log is corrupted, a frame doesn't match its base or a world can't be read\n");
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,388 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_shards.cc
+
+#include <net_shards.h>
+#include <scene.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#endif
+
+#define SHARDS_EVENTS 256        ///< The events a client thread of the benchmark handles per wait.
+#define SHARDS_INPUT (1 << 20)   ///< The bytes of the input ring of a client of the benchmark.
+#define SHARDS_ENTITIES 2000     ///< The entities of the scene of the benchmark.
+#define SHARDS_TICK_RATE 60.0f   ///< The ticks per second of the benchmark.
+#define SHARDS_WARMUP 1.0        ///< The seconds the clients take their first snapshots before the measure.
+#define SHARDS_MEASURE 3.0       ///< The seconds measured.
+
+Replication_Shards::Replication_Shards()
+{
+  m_registry = nullptr;
+  m_running = false;
+  m_simulating = false;
+  m_id = 0;
+}
+
+Replication_Shards::~Replication_Shards()
+{
+  close();
+}
+
+int Replication_Shards::open(int port, Registry &registry, int shards)
+{
+  close();
+
+  int n = shards > 0 ? shards : std::max((int)std::thread::hardware_concurrency(), 1);
+  m_registry = &registry;
+  m_feed.publish(nullptr);
+  m_id = 0;
+  m_shards.clear();
+
+  // The first shard takes the port, the others share it
+  for (int i = 0; i < n; i++)
+  {
+    m_shards.emplace_back(new Replication_Server());
+    if (m_shards[i]->open(i == 0 ? port : m_shards[0]->server().port(), m_feed, n > 1) != 0)
+    {
+      close();
+      return 1;
+    }
+  }
+
+  m_running = true;
+  m_simulating = true;
+  for (int i = 0; i < n; i++)
+    m_threads.emplace_back(&Replication_Shards::loop, this, i);
+  return 0;
+}
+
+void Replication_Shards::loop(int index)
+{
+  GameServer &server = m_shards[index]->server();
+  while (m_running && server.poll(100) >= 0)
+    ;
+}
+
+void Replication_Shards::run()
+{
+  typedef std::chrono::duration<double> Seconds;
+
+  float rate = Replication_Server::settings_.tick_rate;
+  std::chrono::steady_clock::duration interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(Seconds(1.0 / rate));
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point next = start;
+  std::shared_ptr<const Replication_Tick> previous = m_feed.latest();
+  while (m_simulating)
+  {
+    m_registry->update(1.0f / rate);
+    std::shared_ptr<Replication_Tick> tick = std::make_shared<Replication_Tick>();
+    uint32_t time = (uint32_t)(Seconds(std::chrono::steady_clock::now() - start).count() * 1000.0);
+    Replication_Build(*m_registry, ++m_id, time, Interest_Grid::settings_.enabled, previous.get(), *tick);
+    m_feed.publish(tick);
+    previous = tick;
+
+    // A late tick doesn't make the next ones hurry
+    next = std::max(next + interval, std::chrono::steady_clock::now());
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void Replication_Shards::stop()
+{
+  m_simulating = false;
+}
+
+void Replication_Shards::close()
+{
+  m_simulating = false;
+  m_running = false;
+  for (std::thread &thread : m_threads)
+    thread.join();
+  m_threads.clear();
+  for (std::unique_ptr<Replication_Server> &shard : m_shards)
+    shard->close();
+  m_feed.publish(nullptr);
+}
+
+int Replication_Shards::port()
+{
+  return m_shards.empty() ? 0 : m_shards[0]->server().port();
+}
+
+int Replication_Shards::shards()
+{
+  return (int)m_shards.size();
+}
+
+Replication_Server &Replication_Shards::shard(int index)
+{
+  return *m_shards[index];
+}
+
+/**
+ * @brief A client of the benchmark, it acks every snapshot without decoding it.
+ */
+struct Shards_Client
+{
+  Net_Socket socket; ///< The connection to the server, invalid if it was lost.
+  Net_Ring input;    ///< The bytes received and not parsed yet.
+  Net_Writer writer; ///< The acks.
+};
+
+/**
+ * @brief The counters of a thread of clients of the benchmark.
+ */
+struct Shards_Reader
+{
+  long long snapshots; ///< The snapshots received while measuring.
+  long long bytes;     ///< The bytes received while measuring.
+  int lost;            ///< The clients that couldn't connect or lost the connection.
+};
+
+/**
+ * @brief Connects some clients and reads their snapshots until the end of the measure, in its thread.
+ *
+ * @param port The port of the server.
+ * @param clients The number of clients.
+ * @param measure The time the measure starts.
+ * @param end The time the measure ends.
+ * @param reader The counters.
+ */
+static void Shards_Read(int port, int clients, std::chrono::steady_clock::time_point measure, std::chrono::steady_clock::time_point end,
+                        Shards_Reader &reader)
+{
+  reader = {};
+  sockaddr_in serverAddr;
+  memset(&serverAddr, 0, sizeof(serverAddr));
+  serverAddr.sin_family = AF_INET;
+  serverAddr.sin_port = htons((unsigned short)port);
+  serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  // The connections are made waiting, the loopback answers at once
+  Net_Poller poller;
+  poller.open();
+  std::vector<Shards_Client> loads(clients);
+  for (int i = 0; i < clients; i++)
+  {
+    Shards_Client &load = loads[i];
+    load.socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (load.socket == NET_INVALID_SOCKET || connect(load.socket, (sockaddr *)&serverAddr, sizeof(serverAddr)) != 0)
+    {
+      if (load.socket != NET_INVALID_SOCKET)
+        Net_Close(load.socket);
+      load.socket = NET_INVALID_SOCKET;
+      reader.lost++;
+      continue;
+    }
+    int on = 1;
+    setsockopt(load.socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+    load.writer.begin(NET_HELLO);
+    load.writer.end();
+    ::send(load.socket, (const char *)load.writer.bytes().data(), (int)load.writer.bytes().size(), MSG_NOSIGNAL);
+    load.writer.clear();
+    load.input.reserve(SHARDS_INPUT);
+    Net_Set_Non_Blocking(load.socket);
+    poller.add(load.socket, (uint64_t)i);
+  }
+
+  std::vector<Net_Event> events(SHARDS_EVENTS);
+  std::vector<uint8_t> scratch;
+  while (std::chrono::steady_clock::now() < end)
+  {
+    int count = poller.wait(events.data(), SHARDS_EVENTS, 10);
+    bool measuring = std::chrono::steady_clock::now() >= measure;
+    for (int e = 0; e < count; e++)
+    {
+      Shards_Client &load = loads[events[e].id];
+      if (load.socket == NET_INVALID_SOCKET)
+        continue;
+
+      bool ok = !events[e].error;
+      uint32_t acked = 0;
+      while (ok)
+      {
+        int contiguous = 0;
+        uint8_t *back = load.input.back(contiguous);
+        if (contiguous == 0)
+        {
+          load.input.reserve(load.input.capacity() * 2);
+          continue;
+        }
+        int bytesReceived = recv(load.socket, (char *)back, contiguous, 0);
+        if (bytesReceived < 0 && Net_Would_Block())
+          break;
+        ok = bytesReceived > 0;
+        if (!ok)
+          break;
+        load.input.produce(bytesReceived);
+        reader.bytes += measuring ? bytesReceived : 0;
+
+        Net_Message message;
+        int parsed;
+        while ((parsed = Net_Parse(load.input, message, scratch)) == 1)
+        {
+          if (message.header.type == NET_SNAPSHOT)
+          {
+            acked = Net_Read(message).u32();
+            reader.snapshots += measuring ? 1 : 0;
+          }
+          load.input.consume(NET_HEADER + message.header.length);
+        }
+        ok = parsed == 0;
+      }
+
+      // Only the last snapshot of the burst is acked, a full send buffer skips the ack
+      if (ok && acked != 0)
+      {
+        load.writer.begin(NET_ACK);
+        load.writer.u32(acked);
+        load.writer.end();
+        int bytesSent = ::send(load.socket, (const char *)load.writer.bytes().data(), (int)load.writer.bytes().size(), MSG_NOSIGNAL);
+        ok = bytesSent > 0 || Net_Would_Block();
+        load.writer.clear();
+      }
+
+      if (!ok)
+      {
+        poller.remove(load.socket);
+        Net_Close(load.socket);
+        load.socket = NET_INVALID_SOCKET;
+        reader.lost++;
+      }
+    }
+  }
+
+  for (Shards_Client &load : loads)
+  {
+    if (load.socket != NET_INVALID_SOCKET)
+      Net_Close(load.socket);
+  }
+}
+
+/**
+ * @brief Measures a sharded server with some clients.
+ *
+ * @param registry The scene simulated.
+ * @param shards The number of shards, and of threads of clients.
+ * @param clients The number of clients.
+ * @param single The snapshots per second of a single shard, 0 if this is the first run.
+ * @param row The line of the table.
+ * @param rate Returns the snapshots received per second.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The shards can't open, or a client lost its connection.
+ */
+static int Shards_Run(Registry &registry, int shards, int clients, double single, std::string &row, double &rate)
+{
+  typedef std::chrono::duration<double> Seconds;
+
+  Replication_Shards server;
+  if (server.open(0, registry, shards) != 0)
+    return 1;
+  std::thread simulation(&Replication_Shards::run, &server);
+
+  // The clients are split among as many threads as shards
+  std::chrono::steady_clock::time_point measure =
+      std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(Seconds(SHARDS_WARMUP));
+  std::chrono::steady_clock::time_point end =
+      measure + std::chrono::duration_cast<std::chrono::steady_clock::duration>(Seconds(SHARDS_MEASURE));
+  std::vector<Shards_Reader> readers(shards);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < shards; t++)
+  {
+    int count = clients / shards + (t < clients % shards ? 1 : 0);
+    threads.emplace_back(Shards_Read, server.port(), count, measure, end, std::ref(readers[t]));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+
+  server.stop();
+  simulation.join();
+  server.close();
+
+  Shards_Reader total = {};
+  for (const Shards_Reader &reader : readers)
+  {
+    total.snapshots += reader.snapshots;
+    total.bytes += reader.bytes;
+    total.lost += reader.lost;
+  }
+
+  // The clients of every shard show how even the system spread them
+  int fewest = clients;
+  int most = 0;
+  long long full = 0;
+  for (int i = 0; i < server.shards(); i++)
+  {
+    int served = (int)server.shard(i).server().stats().accepted;
+    fewest = std::min(fewest, served);
+    most = std::max(most, served);
+    full += server.shard(i).stats().full;
+  }
+
+  rate = total.snapshots / SHARDS_MEASURE;
+  double expected = (double)clients * Replication_Server::settings_.tick_rate;
+  char line[160];
+  snprintf(line, sizeof(line), "%-7d %-8d %-8d %-14.0f %-10.1f %-9.1f %-8.2f %-9lld %d\n", shards, clients, most - fewest, rate,
+           100.0 * rate / expected, total.bytes / SHARDS_MEASURE / (1024.0 * 1024.0), single > 0.0 ? rate / single : 1.0, full,
+           total.lost);
+  row = line;
+  return total.lost == 0 ? 0 : 1;
+}
+
+int Replication_Shards_Benchmark(int shards, int clients)
+{
+  int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+  std::vector<int> counts;
+  if (shards > 0)
+    counts.push_back(shards);
+  else
+  {
+    for (int n = 1; n < cores; n *= 2)
+      counts.push_back(n);
+    counts.push_back(cores);
+  }
+  clients = clients > 0 ? clients : 256;
+
+#ifdef __linux__
+  // Every client takes two descriptors, its socket and the one accepted by a shard
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+#endif
+
+  // Every entity orbits, every snapshot carries all of them
+  Scene scene;
+  Scene_Generate(scene, SHARDS_ENTITIES, 1234, {400.0f, 300.0f, 0.0f});
+  Registry registry;
+  Vec3 light;
+  Render drawRender;
+  Scene_Instantiate(scene, registry, light, drawRender, {800.0f, 600.0f});
+
+  float tick_rate = Replication_Server::settings_.tick_rate;
+  Replication_Server::settings_.tick_rate = SHARDS_TICK_RATE;
+  int ret = 0;
+  double single = 0.0;
+  std::vector<std::string> rows;
+  for (int n : counts)
+  {
+    double rate = 0.0;
+    rows.emplace_back();
+    ret |= Shards_Run(registry, n, clients, single, rows.back(), rate);
+    single = single > 0.0 ? single : rate;
+  }
+  Replication_Server::settings_.tick_rate = tick_rate;
+
+  printf("%d entities at %.0f ticks per second, %d cores\n", registry.count(), SHARDS_TICK_RATE, cores);
+  printf("Shards  Clients  Uneven   Snapshots/s    Of ticks %%  MB/s      Scaling  Full      Lost\n");
+  for (const std::string &row : rows)
+    printf("%s", row.c_str());
+  return ret;
+}
@@ -0,0 +1,1167 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file net_udp.cc
+
+#include <net_udp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#endif
+
+#define UDP_GOODBYES 3 ///< The times a goodbye is sent, the other side times out if every one is lost.
+
+/**
+ * @brief The states of a connection.
+ */
+enum Udp_State
+{
+  UDP_FREE,       ///< The slot is free.
+  UDP_CONNECTING, ///< The handshake goes on.
+  UDP_CONNECTED,  ///< The data packets flow.
+};
+
+/**
+ * @brief The types of the packets, after UDP_PROTOCOL.
+ */
+enum Udp_Packet
+{
+  UDP_CONNECT = 1, ///< Connecting side: salt, padded.
+  UDP_CHALLENGE,   ///< Listening side: salt and cookie.
+  UDP_RESPONSE,    ///< Connecting side: salt and cookie, padded.
+  UDP_ACCEPT,      ///< Listening side: salt and its own salt.
+  UDP_DENIED,      ///< Listening side: salt, the endpoint is full.
+  UDP_DATA,        ///< Both: token, sequence, ack, ack bits, message count and the messages.
+  UDP_DISCONNECT,  ///< Both: token.
+};
+
+Udp_Settings Udp_Endpoint::settings_ = {64, 10.0f, 0.1f, 0.1f, 0.05f, 256, 0.0f, 0.0f, 0.0f, 0.0f};
+
+// The sequences and ids wrap, the newer one is less than half the range ahead
+static bool Udp_Newer(uint16_t a, uint16_t b)
+{
+  uint16_t ahead = (uint16_t)(a - b);
+  return ahead != 0 && ahead < 32768;
+}
+
+static uint64_t Udp_Key(const sockaddr_in &address)
+{
+  return ((uint64_t)address.sin_addr.s_addr << 16) | address.sin_port;
+}
+
+static float Udp_Chance(std::mt19937 &random)
+{
+  return (float)(random() >> 8) / 16777216.0f;
+}
+
+// The earliest datagram is the front of the heap, a burst due at once goes out in order
+static bool Udp_Later(const Udp_Datagram &a, const Udp_Datagram &b)
+{
+  return a.due > b.due || (a.due == b.due && a.order > b.order);
+}
+
+/**
+ * @brief Sets a slot to a new connection.
+ *
+ * @param connection The slot.
+ * @param address The other endpoint.
+ * @param state The state it starts in.
+ * @param salt The salt of the side that connects.
+ * @param now The time of the endpoint.
+ */
+static void Udp_Start(Udp_Connection &connection, const sockaddr_in &address, int state, uint32_t salt, double now)
+{
+  connection = Udp_Connection();
+  connection.state = state;
+  connection.address = address;
+  connection.salt = salt;
+  connection.started = now;
+  connection.lastReceive = now;
+  connection.lastSend = now;
+
+  // Until a packet arrives the ack names a sequence the other side hasn't sent for a long time
+  connection.remote = 0xFFFF;
+  connection.sent.resize(UDP_PACKETS);
+  connection.outgoing.resize(UDP_WINDOW);
+  connection.incoming.resize(UDP_WINDOW);
+  connection.joins.resize(UDP_JOINS);
+}
+
+/**
+ * @brief Moves the queued reliable fragments into the window, while it has room.
+ *
+ * @param connection The connection.
+ */
+static void Udp_Refill(Udp_Connection &connection)
+{
+  while (!connection.queued.empty() && (uint16_t)(connection.nextId - connection.oldestId) < UDP_WINDOW)
+  {
+    Udp_Fragment &slot = connection.outgoing[connection.nextId % UDP_WINDOW];
+    slot = std::move(connection.queued.front());
+    connection.queued.pop_front();
+    slot.id = connection.nextId++;
+    slot.used = true;
+    slot.acked = false;
+    slot.sent = -1.0;
+  }
+}
+
+Udp_Endpoint::Udp_Endpoint()
+{
+  Net_Startup();
+
+  m_socket = NET_INVALID_SOCKET;
+  m_record = nullptr;
+  m_messages = 0;
+  m_delay = 0.0f;
+  m_queued = 0;
+  m_random.seed(std::random_device{}() ^ (uint32_t)std::chrono::steady_clock::now().time_since_epoch().count());
+  m_secret = ((uint64_t)m_random() << 32) | m_random();
+  m_start = std::chrono::steady_clock::now();
+  m_stats = {};
+}
+
+Udp_Endpoint::~Udp_Endpoint()
+{
+  close();
+  Net_Cleanup();
+}
+
+int Udp_Endpoint::open(int port, bool shared)
+{
+  close();
+
+  m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (m_socket == NET_INVALID_SOCKET)
+  {
+    std::cout << "ERROR: UDP socket can't be created" << std::endl;
+    return 1;
+  }
+
+  // The buffers take the bursts of the batches
+  int buffer = 1 << 21;
+  setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, (const char *)&buffer, sizeof(buffer));
+  setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, (const char *)&buffer, sizeof(buffer));
+  if (shared && Net_Share_Port(m_socket) != 0)
+  {
+    std::cout << "ERROR: UDP socket can't share port " << port << std::endl;
+    close();
+    return 1;
+  }
+
+#ifdef _WIN32
+  // Windows reports a datagram refused by the other side as an error of the next receive
+  BOOL reset = FALSE;
+  DWORD returned = 0;
+  WSAIoctl(m_socket, _WSAIOW(IOC_VENDOR, 12), &reset, sizeof(reset), nullptr, 0, &returned, nullptr, nullptr);
+#endif
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons((unsigned short)port);
+  address.sin_addr.s_addr = INADDR_ANY;
+
+  if (bind(m_socket, (sockaddr *)&address, sizeof(address)) != 0 || Net_Set_Non_Blocking(m_socket) != 0 ||
+      m_poller.open() != 0 || m_poller.add(m_socket, 0) != 0)
+  {
+    std::cout << "ERROR: UDP socket can't bind port " << port << std::endl;
+    close();
+    return 1;
+  }
+
+  m_connections.assign(std::max(settings_.max_connections, 1), Udp_Connection());
+  m_delay = settings_.latency;
+  m_input.resize((size_t)UDP_BATCH * UDP_MTU);
+  m_stats = {};
+  return 0;
+}
+
+void Udp_Endpoint::close()
+{
+  for (int i = 0; i < (int)m_connections.size(); i++)
+    disconnect(i);
+
+  // The goodbyes leave at once, the simulation doesn't delay them
+  flush(HUGE_VAL);
+  m_connections.clear();
+  m_addresses.clear();
+  m_delayed.clear();
+
+  m_poller.close();
+  if (m_socket != NET_INVALID_SOCKET)
+    Net_Close(m_socket);
+  m_socket = NET_INVALID_SOCKET;
+}
+
+int Udp_Endpoint::port()
+{
+  if (m_socket == NET_INVALID_SOCKET)
+    return 0;
+
+  sockaddr_in address;
+  Net_Length length = sizeof(address);
+  if (getsockname(m_socket, (sockaddr *)&address, &length) != 0)
+    return 0;
+  return ntohs(address.sin_port);
+}
+
+void Udp_Endpoint::setEvents(const Udp_Events &events)
+{
+  m_events = events;
+}
+
+int Udp_Endpoint::connect(const std::string &ipAddress, int port)
+{
+  if (m_socket == NET_INVALID_SOCKET)
+    return -1;
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons((unsigned short)port);
+#ifdef _WIN32
+  address.sin_addr.s_addr = inet_addr(ipAddress.c_str());
+#elif __linux__
+  inet_aton(ipAddress.c_str(), &address.sin_addr);
+#endif
+
+  int connection = -1;
+  for (int i = 0; i < (int)m_connections.size() && connection < 0; i++)
+  {
+    if (m_connections[i].state == UDP_FREE)
+      connection = i;
+  }
+  if (connection < 0 || m_addresses.find(Udp_Key(address)) != m_addresses.end())
+  {
+    std::cout << "ERROR: Can't connect to " << ipAddress << ":" << port << " over UDP" << std::endl;
+    return -1;
+  }
+
+  double now = time();
+  Udp_Connection &slot = m_connections[connection];
+  Udp_Start(slot, address, UDP_CONNECTING, m_random() | 1, now);
+  m_addresses[Udp_Key(address)] = connection;
+  handshake(address, UDP_CONNECT, slot.salt, 0, now);
+  return connection;
+}
+
+void Udp_Endpoint::disconnect(int connection)
+{
+  if (connection < 0 || connection >= (int)m_connections.size() || m_connections[connection].state == UDP_FREE)
+    return;
+
+  const Udp_Connection &slot = m_connections[connection];
+  if (slot.state == UDP_CONNECTED)
+  {
+    for (int i = 0; i < UDP_GOODBYES; i++)
+      handshake(slot.address, UDP_DISCONNECT, slot.token, 0, time());
+  }
+  drop(connection);
+}
+
+bool Udp_Endpoint::connected(int connection)
+{
+  return connection >= 0 && connection < (int)m_connections.size() && m_connections[connection].state == UDP_CONNECTED;
+}
+
+int Udp_Endpoint::send(int connection, int channel, const void *data, int size)
+{
+  if (!connected(connection) || channel < 0 || channel >= UDP_CHANNELS || size < 0)
+    return 1;
+
+  int fragments = std::max((size + UDP_FRAGMENT - 1) / UDP_FRAGMENT, 1);
+  if (fragments > 0xFFFF)
+  {
+    std::cout << "ERROR: A message of " << size << " bytes doesn't fit in " << 0xFFFF << " fragments" << std::endl;
+    return 1;
+  }
+
+  Udp_Connection &slot = m_connections[connection];
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (int f = 0; f < fragments; f++)
+  {
+    Udp_Fragment fragment = Udp_Fragment();
+    fragment.fragment = (uint16_t)f;
+    fragment.fragments = (uint16_t)fragments;
+    fragment.used = true;
+    fragment.sent = -1.0;
+    fragment.data.assign(bytes + f * UDP_FRAGMENT, bytes + std::min(size, (f + 1) * UDP_FRAGMENT));
+    if (channel == UDP_RELIABLE)
+      slot.queued.push_back(std::move(fragment));
+    else
+    {
+      fragment.id = slot.unreliableId;
+      slot.unreliable.push_back(std::move(fragment));
+    }
+  }
+
+  if (channel == UDP_RELIABLE)
+    Udp_Refill(slot);
+  else
+    slot.unreliableId++;
+  return 0;
+}
+
+void Udp_Endpoint::update()
+{
+  if (m_socket == NET_INVALID_SOCKET)
+    return;
+  double now = time();
+
+  // The delay wanders between updates as the queues of a network do, the datagrams of a burst share it
+  m_delay += settings_.jitter * (Udp_Chance(m_random) - 0.5f) * 0.25f;
+  m_delay = std::min(std::max(m_delay, settings_.latency), settings_.latency + settings_.jitter);
+
+#ifdef __linux__
+  // A batch of datagrams per call, until the socket is empty
+  mmsghdr headers[UDP_BATCH];
+  iovec vectors[UDP_BATCH];
+  sockaddr_in addresses[UDP_BATCH];
+  while (true)
+  {
+    memset(headers, 0, sizeof(headers));
+    for (int i = 0; i < UDP_BATCH; i++)
+    {
+      vectors[i].iov_base = m_input.data() + (size_t)i * UDP_MTU;
+      vectors[i].iov_len = UDP_MTU;
+      headers[i].msg_hdr.msg_name = &addresses[i];
+      headers[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+      headers[i].msg_hdr.msg_iov = &vectors[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int count = recvmmsg(m_socket, headers, UDP_BATCH, MSG_DONTWAIT, nullptr);
+    if (count <= 0)
+      break;
+    m_stats.calls++;
+    for (int i = 0; i < count; i++)
+    {
+      if (headers[i].msg_hdr.msg_flags & MSG_TRUNC)
+        m_stats.invalid++;
+      else
+        handle(addresses[i], m_input.data() + (size_t)i * UDP_MTU, (int)headers[i].msg_len, now);
+    }
+    if (count < UDP_BATCH)
+      break;
+  }
+#else
+  while (true)
+  {
+    sockaddr_in address;
+    Net_Length length = sizeof(address);
+    int size = recvfrom(m_socket, (char *)m_input.data(), UDP_MTU, 0, (sockaddr *)&address, &length);
+    if (size < 0)
+      break;
+    m_stats.calls++;
+    handle(address, m_input.data(), size, now);
+  }
+#endif
+
+  for (int i = 0; i < (int)m_connections.size(); i++)
+  {
+    Udp_Connection &slot = m_connections[i];
+    if (slot.state == UDP_CONNECTING)
+    {
+      if (now - slot.started > settings_.timeout)
+      {
+        std::cout << "ERROR: UDP handshake with port " << ntohs(slot.address.sin_port) << " timed out" << std::endl;
+        drop(i);
+      }
+      else if (now - slot.lastSend >= settings_.handshake)
+      {
+        handshake(slot.address, slot.cookie != 0 ? UDP_RESPONSE : UDP_CONNECT, slot.salt, slot.cookie, now);
+        slot.lastSend = now;
+      }
+    }
+    else if (slot.state == UDP_CONNECTED)
+    {
+      if (now - slot.lastReceive > settings_.timeout)
+        drop(i);
+      else
+        write(slot, now);
+    }
+  }
+
+  flush(now);
+}
+
+void Udp_Endpoint::wait(int timeout)
+{
+  if (m_socket == NET_INVALID_SOCKET)
+    return;
+
+  // A datagram delayed by the simulation is due before the timeout
+  if (!m_delayed.empty())
+    timeout = std::min(timeout, std::max((int)ceil((m_delayed.front().due - time()) * 1000.0), 0));
+
+  Net_Event event;
+  m_poller.wait(&event, 1, timeout);
+}
+
+float Udp_Endpoint::rtt(int connection)
+{
+  return connected(connection) ? m_connections[connection].rtt : 0.0f;
+}
+
+double Udp_Endpoint::time()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+const Udp_Stats &Udp_Endpoint::stats()
+{
+  return m_stats;
+}
+
+void Udp_Endpoint::handle(const sockaddr_in &address, const uint8_t *data, int size, double now)
+{
+  m_stats.packetsReceived++;
+  m_stats.bytesReceived += size;
+
+  Net_Reader reader = {data, (uint32_t)size, 0, true};
+  uint32_t protocol = reader.u32();
+  uint8_t type = reader.u8();
+  if (!reader.ok || protocol != UDP_PROTOCOL)
+  {
+    m_stats.invalid++;
+    return;
+  }
+
+  auto found = m_addresses.find(Udp_Key(address));
+  int index = found != m_addresses.end() ? found->second : -1;
+  Udp_Connection *connection = index >= 0 ? &m_connections[index] : nullptr;
+
+  if (type == UDP_DATA)
+  {
+    uint32_t token = reader.u32();
+    if (connection == nullptr || connection->state != UDP_CONNECTED || token != connection->token)
+      m_stats.invalid++;
+    else
+      packet(index, reader, now);
+    return;
+  }
+
+  uint32_t first = reader.u32();
+  uint32_t second = reader.u32();
+  bool padded = size >= UDP_HANDSHAKE_BYTES;
+  if (!reader.ok)
+  {
+    m_stats.invalid++;
+    return;
+  }
+
+  switch (type)
+  {
+  case UDP_CONNECT:
+    // Nothing is kept until the address answers the challenge
+    if (padded)
+      handshake(address, UDP_CHALLENGE, first, cookie(address, first), now);
+    else
+      m_stats.invalid++;
+    break;
+
+  case UDP_CHALLENGE:
+    if (connection != nullptr && connection->state == UDP_CONNECTING && connection->salt == first && second != 0)
+    {
+      connection->cookie = second;
+      connection->lastSend = now;
+      handshake(address, UDP_RESPONSE, first, second, now);
+    }
+    break;
+
+  case UDP_RESPONSE:
+  {
+    if (!padded || second != cookie(address, first))
+    {
+      m_stats.invalid++;
+      break;
+    }
+
+    // The accept was lost, or the other side restarted
+    if (connection != nullptr)
+    {
+      if (connection->state == UDP_CONNECTED && connection->salt == first)
+        handshake(address, UDP_ACCEPT, first, connection->token ^ first, now);
+      if (connection->state != UDP_CONNECTED || connection->salt == first)
+        break;
+      drop(index);
+    }
+
+    int free = -1;
+    for (int i = 0; i < (int)m_connections.size() && free < 0; i++)
+    {
+      if (m_connections[i].state == UDP_FREE)
+        free = i;
+    }
+    if (free < 0)
+    {
+      handshake(address, UDP_DENIED, first, 0, now);
+      break;
+    }
+
+    Udp_Connection &slot = m_connections[free];
+    uint32_t salt = m_random() | 1;
+    Udp_Start(slot, address, UDP_CONNECTED, first, now);
+    slot.cookie = second;
+    slot.token = first ^ salt;
+    m_addresses[Udp_Key(address)] = free;
+    m_stats.connections++;
+    handshake(address, UDP_ACCEPT, first, salt, now);
+    if (m_events.connected)
+      m_events.connected(*this, free);
+    break;
+  }
+
+  case UDP_ACCEPT:
+    if (connection != nullptr && connection->state == UDP_CONNECTING && connection->salt == first)
+    {
+      connection->state = UDP_CONNECTED;
+      connection->token = first ^ second;
+      connection->rtt = (float)(now - connection->lastSend);
+      connection->lastReceive = now;
+      m_stats.connections++;
+      if (m_events.connected)
+        m_events.connected(*this, index);
+    }
+    break;
+
+  case UDP_DENIED:
+    if (connection != nullptr && connection->state == UDP_CONNECTING && connection->salt == first)
+    {
+      std::cout << "ERROR: UDP endpoint at port " << ntohs(address.sin_port) << " is full" << std::endl;
+      drop(index);
+    }
+    break;
+
+  case UDP_DISCONNECT:
+    if (connection != nullptr && connection->state == UDP_CONNECTED && connection->token == first)
+      drop(index);
+    break;
+
+  default:
+    m_stats.invalid++;
+    break;
+  }
+}
+
+void Udp_Endpoint::packet(int connection, Net_Reader &reader, double now)
+{
+  Udp_Connection &slot = m_connections[connection];
+  uint16_t sequence = reader.u16();
+  uint16_t ack = reader.u16();
+  uint32_t bits = reader.u32();
+  int count = reader.u8();
+  if (!reader.ok)
+  {
+    m_stats.invalid++;
+    return;
+  }
+  slot.lastReceive = now;
+
+  // Every ack travels in 33 packets, one is enough
+  acknowledge(slot, ack, now);
+  for (int i = 0; i < 32; i++)
+  {
+    if ((bits >> i) & 1)
+      acknowledge(slot, (uint16_t)(ack - 1 - i), now);
+  }
+
+  if (!slot.received)
+  {
+    slot.received = true;
+    slot.remote = sequence;
+    slot.remoteBits = 0;
+  }
+  else if (Udp_Newer(sequence, slot.remote))
+  {
+    int shift = (uint16_t)(sequence - slot.remote);
+    slot.remoteBits = (shift >= 32 ? 0 : slot.remoteBits << shift) | (shift <= 32 ? 1u << (shift - 1) : 0);
+    slot.remote = sequence;
+  }
+  else
+  {
+    // A duplicate is acked again but its messages are not taken twice
+    int back = (uint16_t)(slot.remote - sequence);
+    bool duplicate = back == 0 || (back <= 32 && ((slot.remoteBits >> (back - 1)) & 1));
+    if (duplicate)
+      count = 0;
+    else if (back <= 32)
+      slot.remoteBits |= 1u << (back - 1);
+  }
+
+  // A burst is acked while it arrives, before its first packets leave the bitfield
+  if (++slot.acking >= UDP_ACK_EVERY)
+  {
+    begin(slot, now);
+    finish(slot, now);
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    Udp_Fragment fragment = Udp_Fragment();
+    int channel = reader.u8();
+    fragment.id = reader.u16();
+    fragment.fragment = reader.u16();
+    fragment.fragments = reader.u16();
+    uint32_t size = reader.u16();
+    if (!reader.ok || channel >= UDP_CHANNELS || fragment.fragment >= fragment.fragments || size > reader.size - reader.offset)
+    {
+      m_stats.invalid++;
+      return;
+    }
+
+    const uint8_t *data = reader.data + reader.offset;
+    reader.offset += size;
+    bool open = channel == UDP_RELIABLE ? reliable(connection, fragment, data, (int)size) : unreliable(connection, fragment, data, (int)size);
+    if (!open)
+      return;
+  }
+}
+
+void Udp_Endpoint::acknowledge(Udp_Connection &connection, uint16_t sequence, double now)
+{
+  Udp_Sent &sent = connection.sent[sequence % UDP_PACKETS];
+  if (!sent.used || sent.acked || sent.sequence != sequence)
+    return;
+  sent.acked = true;
+  connection.backoff = 0;
+
+  float sample = (float)(now - sent.time);
+  connection.rtt = connection.rtt == 0.0f ? sample : connection.rtt + (sample - connection.rtt) * 0.1f;
+
+  for (uint16_t id : sent.reliable)
+  {
+    Udp_Fragment &fragment = connection.outgoing[id % UDP_WINDOW];
+    if (fragment.used && fragment.id == id && !fragment.acked)
+    {
+      fragment.acked = true;
+      fragment.data.clear();
+    }
+  }
+
+  // The window slides past the fragments acked, the queued ones take their place
+  while (connection.oldestId != connection.nextId && connection.outgoing[connection.oldestId % UDP_WINDOW].acked)
+  {
+    connection.outgoing[connection.oldestId % UDP_WINDOW].used = false;
+    connection.outgoing[connection.oldestId % UDP_WINDOW].acked = false;
+    connection.oldestId++;
+  }
+  Udp_Refill(connection);
+}
+
+bool Udp_Endpoint::reliable(int connection, const Udp_Fragment &fragment, const uint8_t *data, int size)
+{
+  Udp_Connection &slot = m_connections[connection];
+
+  // The sender never gets a window ahead, an id outside it was taken already and its ack lost
+  if ((uint16_t)(fragment.id - slot.expectedId) >= UDP_WINDOW)
+    return true;
+  Udp_Fragment &stored = slot.incoming[fragment.id % UDP_WINDOW];
+  if (stored.used)
+    return true;
+  stored.id = fragment.id;
+  stored.fragment = fragment.fragment;
+  stored.fragments = fragment.fragments;
+  stored.used = true;
+  stored.data.assign(data, data + size);
+
+  // The fragments are joined in order, a message at a time
+  while (slot.incoming[slot.expectedId % UDP_WINDOW].used)
+  {
+    Udp_Fragment &next = slot.incoming[slot.expectedId % UDP_WINDOW];
+    next.used = false;
+    slot.expectedId++;
+    if (next.fragment == 0)
+      slot.message.clear();
+    slot.message.insert(slot.message.end(), next.data.begin(), next.data.end());
+    if (next.fragment + 1 != next.fragments)
+      continue;
+
+    if (m_events.received)
+      m_events.received(*this, connection, UDP_RELIABLE, slot.message.data(), (int)slot.message.size());
+    if (slot.state != UDP_CONNECTED)
+      return false;
+  }
+  return true;
+}
+
+bool Udp_Endpoint::unreliable(int connection, const Udp_Fragment &fragment, const uint8_t *data, int size)
+{
+  Udp_Connection &slot = m_connections[connection];
+
+  // A message older than the last one is late
+  if (slot.delivered && !Udp_Newer(fragment.id, slot.lastId))
+  {
+    m_stats.stale++;
+    return true;
+  }
+
+  const uint8_t *message = data;
+  int length = size;
+  if (fragment.fragments > 1)
+  {
+    // The fragments of the next messages interleave, a few are joined at once and the oldest gives way
+    Udp_Join *join = nullptr;
+    for (Udp_Join &candidate : slot.joins)
+    {
+      if (candidate.used && candidate.id == fragment.id)
+        join = &candidate;
+    }
+    if (join == nullptr)
+    {
+      for (Udp_Join &candidate : slot.joins)
+      {
+        if (join == nullptr || !candidate.used || (join->used && Udp_Newer(join->id, candidate.id)))
+          join = &candidate;
+      }
+      if (join->used)
+        m_stats.stale++;
+      join->id = fragment.id;
+      join->used = true;
+      join->parts = 0;
+      join->length = 0;
+      join->pieces.assign(fragment.fragments, 0);
+      join->data.resize((size_t)fragment.fragments * UDP_FRAGMENT);
+    }
+
+    // Only the last fragment is shorter, the others have their place in the message
+    bool last = fragment.fragment + 1 == fragment.fragments;
+    if (fragment.fragments != join->pieces.size() || (last ? size > UDP_FRAGMENT : size != UDP_FRAGMENT))
+    {
+      m_stats.invalid++;
+      return true;
+    }
+    if (join->pieces[fragment.fragment])
+      return true;
+    join->pieces[fragment.fragment] = 1;
+    memcpy(join->data.data() + (size_t)fragment.fragment * UDP_FRAGMENT, data, size);
+    if (last)
+      join->length = fragment.fragment * UDP_FRAGMENT + size;
+    if (++join->parts < fragment.fragments)
+      return true;
+
+    join->used = false;
+    message = join->data.data();
+    length = join->length;
+  }
+
+  // The messages older than this one won't be taken any more
+  slot.lastId = fragment.id;
+  slot.delivered = true;
+  for (Udp_Join &join : slot.joins)
+  {
+    if (join.used && !Udp_Newer(join.id, slot.lastId))
+    {
+      join.used = false;
+      m_stats.stale++;
+    }
+  }
+
+  if (m_events.received)
+    m_events.received(*this, connection, UDP_UNRELIABLE, message, length);
+  return slot.state == UDP_CONNECTED;
+}
+
+void Udp_Endpoint::write(Udp_Connection &connection, double now)
+{
+  // Without acks the resends slow down, a congested path gets a chance to drain
+  float rtt = connection.rtt > 0.0f ? connection.rtt : UDP_FIRST_RTT;
+  float resend = std::max(settings_.resend, rtt * 1.5f) * (float)(1 << connection.backoff);
+  bool resent = false;
+  int packets = 0;
+
+  // The reliable fragments due go first, the unreliable ones fill the rest
+  uint16_t id = connection.oldestId;
+  size_t next = 0;
+  while (true)
+  {
+    while (id != connection.nextId)
+    {
+      const Udp_Fragment &fragment = connection.outgoing[id % UDP_WINDOW];
+      if (!fragment.acked && (fragment.sent < 0.0 || now - fragment.sent >= resend))
+        break;
+      id++;
+    }
+
+    Udp_Fragment *fragment = nullptr;
+    int channel = UDP_RELIABLE;
+    if (id != connection.nextId)
+      fragment = &connection.outgoing[id % UDP_WINDOW];
+    else if (next < connection.unreliable.size())
+    {
+      fragment = &connection.unreliable[next];
+      channel = UDP_UNRELIABLE;
+    }
+    if (fragment == nullptr)
+      break;
+
+    size_t bytes = UDP_MESSAGE_HEADER + fragment->data.size();
+    if (m_record != nullptr && (m_packet.bytes().size() + bytes > UDP_MTU || m_messages == 255))
+      finish(connection, now);
+    if (m_record == nullptr)
+    {
+      if (packets == settings_.max_packets)
+        break;
+      begin(connection, now);
+      packets++;
+    }
+
+    m_packet.u8((uint8_t)channel);
+    m_packet.u16(channel == UDP_RELIABLE ? id : fragment->id);
+    m_packet.u16(fragment->fragment);
+    m_packet.u16(fragment->fragments);
+    m_packet.u16((uint16_t)fragment->data.size());
+    m_packet.raw(fragment->data.data(), (int)fragment->data.size());
+    m_messages++;
+
+    if (channel == UDP_RELIABLE)
+    {
+      if (fragment->sent >= 0.0)
+      {
+        m_stats.resent++;
+        resent = true;
+      }
+      fragment->sent = now;
+      m_record->reliable.push_back(id);
+      id++;
+    }
+    else
+      next++;
+  }
+
+  // Without messages an empty packet carries the acks, and keeps the connection alive
+  if (m_record != nullptr)
+    finish(connection, now);
+  else if (packets == 0 && (connection.acking > 0 || now - connection.lastSend >= settings_.keepalive))
+  {
+    begin(connection, now);
+    finish(connection, now);
+  }
+
+  m_stats.stale += connection.unreliable.size() - next;
+  connection.unreliable.clear();
+  if (resent)
+    connection.backoff = std::min(connection.backoff + 1, UDP_BACKOFF);
+}
+
+void Udp_Endpoint::begin(Udp_Connection &connection, double now)
+{
+  Udp_Sent &record = connection.sent[connection.sequence % UDP_PACKETS];
+  if (record.used && !record.acked && !record.reliable.empty())
+    m_stats.lost++;
+  record.sequence = connection.sequence;
+  record.used = true;
+  record.acked = false;
+  record.time = now;
+  record.reliable.clear();
+  m_record = &record;
+  m_messages = 0;
+
+  m_packet.clear();
+  m_packet.u32(UDP_PROTOCOL);
+  m_packet.u8(UDP_DATA);
+  m_packet.u32(connection.token);
+  m_packet.u16(connection.sequence++);
+  m_packet.u16(connection.remote);
+  m_packet.u32(connection.remoteBits);
+  m_packet.u8(0);
+}
+
+void Udp_Endpoint::finish(Udp_Connection &connection, double now)
+{
+  // The count of messages goes last in the header
+  uint8_t datagram[UDP_MTU];
+  const std::vector<uint8_t> &bytes = m_packet.bytes();
+  memcpy(datagram, bytes.data(), bytes.size());
+  datagram[UDP_DATA_HEADER - 1] = (uint8_t)m_messages;
+  emit(connection.address, datagram, (int)bytes.size(), now);
+  connection.lastSend = now;
+  connection.acking = 0;
+  m_record = nullptr;
+}
+
+void Udp_Endpoint::emit(const sockaddr_in &address, const uint8_t *data, int size, double now)
+{
+  m_stats.packetsSent++;
+  m_stats.bytesSent += size;
+
+  // The simulation of the network loses, duplicates and delays the datagrams
+  if (settings_.loss > 0.0f && Udp_Chance(m_random) < settings_.loss)
+  {
+    m_stats.dropped++;
+    return;
+  }
+
+  int copies = settings_.duplicate > 0.0f && Udp_Chance(m_random) < settings_.duplicate ? 2 : 1;
+  for (int i = 0; i < copies; i++)
+  {
+    float delay = i == 0 ? m_delay : m_delay + settings_.jitter * Udp_Chance(m_random);
+    std::vector<Udp_Datagram> &queue = delay > 0.0f ? m_delayed : m_outgoing;
+    queue.emplace_back();
+    Udp_Datagram &datagram = queue.back();
+    datagram.due = now + delay;
+    datagram.order = m_queued++;
+    datagram.address = address;
+    datagram.size = size;
+    memcpy(datagram.bytes, data, size);
+    if (delay > 0.0f)
+      std::push_heap(m_delayed.begin(), m_delayed.end(), Udp_Later);
+  }
+}
+
+void Udp_Endpoint::handshake(const sockaddr_in &address, int type, uint32_t first, uint32_t second, double now)
+{
+  m_packet.clear();
+  m_packet.u32(UDP_PROTOCOL);
+  m_packet.u8((uint8_t)type);
+  m_packet.u32(first);
+  m_packet.u32(second);
+
+  // The requests are as big as the answers, the endpoint can't be used to amplify an attack
+  if (type == UDP_CONNECT || type == UDP_RESPONSE)
+  {
+    while (m_packet.bytes().size() < UDP_HANDSHAKE_BYTES)
+      m_packet.u8(0);
+  }
+  emit(address, m_packet.bytes().data(), (int)m_packet.bytes().size(), now);
+}
+
+void Udp_Endpoint::flush(double now)
+{
+  while (!m_delayed.empty() && m_delayed.front().due <= now)
+  {
+    std::pop_heap(m_delayed.begin(), m_delayed.end(), Udp_Later);
+    m_outgoing.push_back(m_delayed.back());
+    m_delayed.pop_back();
+  }
+  if (m_socket == NET_INVALID_SOCKET)
+  {
+    m_outgoing.clear();
+    return;
+  }
+
+  // A full send buffer loses the rest, as a congested network would
+  size_t sent = 0;
+  while (sent < m_outgoing.size())
+  {
+#ifdef __linux__
+    mmsghdr headers[UDP_BATCH];
+    iovec vectors[UDP_BATCH];
+    int batch = (int)std::min(m_outgoing.size() - sent, (size_t)UDP_BATCH);
+    memset(headers, 0, sizeof(headers));
+    for (int i = 0; i < batch; i++)
+    {
+      Udp_Datagram &datagram = m_outgoing[sent + i];
+      vectors[i].iov_base = datagram.bytes;
+      vectors[i].iov_len = datagram.size;
+      headers[i].msg_hdr.msg_name = &datagram.address;
+      headers[i].msg_hdr.msg_namelen = sizeof(datagram.address);
+      headers[i].msg_hdr.msg_iov = &vectors[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int count = sendmmsg(m_socket, headers, batch, 0);
+    m_stats.calls++;
+    if (count < 0 && Net_Would_Block())
+      break;
+    sent += count > 0 ? count : 1;
+#else
+    Udp_Datagram &datagram = m_outgoing[sent];
+    int bytes = sendto(m_socket, (const char *)datagram.bytes, datagram.size, 0, (const sockaddr *)&datagram.address, sizeof(datagram.address));
+    m_stats.calls++;
+    if (bytes < 0 && Net_Would_Block())
+      break;
+    sent++;
+#endif
+  }
+  m_outgoing.clear();
+}
+
+uint32_t Udp_Endpoint::cookie(const sockaddr_in &address, uint32_t salt)
+{
+  // SplitMix64 of the address and the salt, keyed by the secret
+  uint64_t x = m_secret ^ Udp_Key(address) ^ ((uint64_t)salt * 0x9E3779B97F4A7C15ull);
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBull;
+  x ^= x >> 31;
+  uint32_t value = (uint32_t)x ^ (uint32_t)(x >> 32);
+  return value != 0 ? value : 1;
+}
+
+void Udp_Endpoint::drop(int connection)
+{
+  Udp_Connection &slot = m_connections[connection];
+  if (slot.state == UDP_CONNECTED)
+    m_stats.connections--;
+  m_addresses.erase(Udp_Key(slot.address));
+  slot = Udp_Connection();
+  if (m_events.disconnected)
+    m_events.disconnected(*this, connection);
+}
+
+/**
+ * @brief Sends the frames of the benchmark at a loss and a latency.
+ *
+ * @param loss The percentage of the datagrams lost.
+ * @param latency The milliseconds of latency.
+ * @param row The line of the table.
+ *
+ * @return 0 Everything went OK.
+ * @return 1 The handshake failed, or a frame was lost, corrupted or out of order.
+ */
+static int Udp_Run(int loss, int latency, std::string &row)
+{
+  typedef std::chrono::duration<double> Seconds;
+  const int ticks = 400;
+  const float interval = 0.005f;
+
+  Udp_Settings saved = Udp_Endpoint::settings_;
+  Udp_Endpoint::settings_.loss = loss / 100.0f;
+  Udp_Endpoint::settings_.latency = latency / 1000.0f;
+  Udp_Endpoint::settings_.jitter = latency / 4000.0f;
+
+  Udp_Endpoint server;
+  Udp_Endpoint client;
+  int peer = -1;
+  bool ready = false;
+  uint32_t reliable = 0;
+  int unreliable = 0;
+  uint32_t last = 0;
+  int acks = 0;
+  int errors = 0;
+
+  Udp_Events serverEvents;
+  serverEvents.connected = [&peer](Udp_Endpoint &, int connection)
+  { peer = connection; };
+  serverEvents.received = [&acks](Udp_Endpoint &, int, int, const uint8_t *data, int size)
+  {
+    Net_Message message;
+    if (Net_Parse(data, size, message) == 1 && message.header.type == NET_ACK)
+      acks++;
+  };
+  server.setEvents(serverEvents);
+
+  // The reliable frames come whole and in order, the entities name their frame; the unreliable ones only go forward
+  Udp_Events clientEvents;
+  clientEvents.connected = [&ready](Udp_Endpoint &, int)
+  { ready = true; };
+  clientEvents.received = [&](Udp_Endpoint &, int, int channel, const uint8_t *data, int size)
+  {
+    Net_Message message;
+    if (Net_Parse(data, size, message) != 1 || NET_HEADER + (int)message.header.length != size)
+    {
+      errors++;
+      return;
+    }
+    int count = Net_Count(message);
+    if (channel == UDP_RELIABLE)
+    {
+      Net_Create entity = Net_Create();
+      if (count > 0)
+        Net_Read_Create(message, count - 1, entity);
+      if (message.header.type != NET_CREATE || count <= 0 || message.header.sequence != reliable || entity.entity != reliable * 4096 + count - 1)
+        errors++;
+      reliable++;
+    }
+    else
+    {
+      if (message.header.type != NET_TRANSFORM || count != 100 || (unreliable > 0 && message.header.sequence <= last))
+        errors++;
+      last = message.header.sequence;
+      unreliable++;
+    }
+  };
+  client.setEvents(clientEvents);
+
+  if (server.open(0) != 0 || client.open(0) != 0)
+  {
+    Udp_Endpoint::settings_ = saved;
+    return 1;
+  }
+  int connection = client.connect("127.0.0.1", server.port());
+
+  std::vector<Net_Create> creates(2000, Net_Create());
+  std::vector<Net_Transform> transforms(100, Net_Transform());
+  Net_Writer creating;
+  Net_Writer moving;
+  Net_Writer acking;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  double finished = 0.0;
+  int tick = 0;
+  while (true)
+  {
+    double now = Seconds(std::chrono::steady_clock::now() - start).count();
+    if (now > 30.0 || connection < 0)
+      break;
+
+    // A frame of a few entities every tick, and one of 128 KB every 50 ticks
+    if (ready && peer >= 0 && tick < ticks && now >= tick * interval)
+    {
+      int count = tick % 50 == 49 ? 2000 : 1 + tick % 40;
+      for (int i = 0; i < count; i++)
+        creates[i].entity = (uint32_t)(tick * 4096 + i);
+      creating.clear();
+      Net_Write_Create(creating, creates.data(), count);
+      server.send(peer, UDP_RELIABLE, creating.bytes().data(), (int)creating.bytes().size());
+
+      moving.clear();
+      Net_Write_Transform(moving, transforms.data(), (int)transforms.size());
+      server.send(peer, UDP_UNRELIABLE, moving.bytes().data(), (int)moving.bytes().size());
+
+      acking.clear();
+      Net_Write_Ack(acking, last);
+      client.send(connection, UDP_UNRELIABLE, acking.bytes().data(), (int)acking.bytes().size());
+      tick++;
+    }
+
+    server.update();
+    client.update();
+    if (tick == ticks && reliable == (uint32_t)ticks)
+    {
+      finished = now;
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  const Udp_Stats &stats = server.stats();
+  char line[200];
+  snprintf(line, sizeof(line), "%-5d %-8d %4u/%-6d %4d/%-6d %-7d %-7lld %-9lld %-6lld %-7.1f %-11.1f %-8.2f %d\n", loss, latency,
+           reliable, ticks, unreliable, ticks, acks, stats.resent, stats.lost, client.stats().stale,
+           server.rtt(peer) * 1000.0f, (double)stats.packetsSent / std::max(stats.calls, 1LL), finished, errors);
+  row = line;
+
+  client.close();
+  server.close();
+  Udp_Endpoint::settings_ = saved;
+  return errors == 0 && reliable == (uint32_t)ticks ? 0 : 1;
+}
+
+int Udp_Benchmark(int loss, int latency)
+{
+  std::vector<int> losses;
+  if (loss >= 0)
+    losses.push_back(loss);
+  else
+    losses = {0, 5, 20};
+  latency = std::max(latency, 0);
+
+  int ret = 0;
+  std::vector<std::string> rows;
+  for (int l : losses)
+  {
+    rows.emplace_back();
+    ret |= Udp_Run(l, latency, rows.back());
+  }
+
+  printf("Loss  Latency  Reliable     Unreliable  Acks    Resent  Lost pkts Stale  RTT ms  Packets/call Seconds  Errors\n");
+  for (const std::string &row : rows)
+    printf("%s", row.c_str());
+  return ret;
+}
@@ -0,0 +1,135 @@
+/// @author Marcos Jiménez Saz <jimenezsa@esat-alumni.com>
+
+#include <obj_stream.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#elif __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+int Stream_Lines(const char *path, size_t window, const std::function<void(char *line)> &callback)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return 1;
+
+  char *buffer = (char *)malloc(window + 1);
+  size_t used = 0;
+  int ret = 0;
+
+  while (ret == 0)
+  {
+    size_t read = fread(buffer + used, 1, window - used, file);
+    used += read;
+    bool end = read == 0;
+
+    // Every complete line of the window
+    size_t start = 0;
+    for (size_t i = 0; i < used; i++)
+    {
+      if (buffer[i] != '\n')
+        continue;
+
+      buffer[i] = '\0';
+      if (i > start && buffer[i - 1] == '\r')
+        buffer[i - 1] = '\0';
+      callback(buffer + start);
+      start = i + 1;
+    }
+
+    if (end)
+    {
+      // Last line without line break
+      if (start < used)
+      {
+        buffer[used] = '\0';
+        callback(buffer + start);
+      }
+      break;
+    }
+
+    if (start == 0 && used == window)
+      ret = 2;
+
+    // The incomplete line goes to the start of the window
+    memmove(buffer, buffer + start, used - start);
+    used -= start;
+  }
+
+  free(buffer);
+  fclose(file);
+
+  return ret;
+}
+
+#ifdef __linux__
+static size_t Status_Value(const char *key)
+{
+  FILE *file = fopen("/proc/self/status", "r");
+  if (file == NULL)
+    return 0;
+
+  char line[256];
+  size_t value = 0;
+  size_t length = strlen(key);
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    if (strncmp(line, key, length) == 0)
+    {
+      value = strtoull(line + length, NULL, 10) * 1024;
+      break;
+    }
+  }
+  fclose(file);
+
+  return value;
+}
+#endif
+
+size_t Current_RSS()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.WorkingSetSize;
+  return 0;
+#elif __linux__
+  return Status_Value("VmRSS:");
+#else
+  return 0;
+#endif
+}
+
+size_t Peak_RSS()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize;
+  return 0;
+#elif __linux__
+  return Status_Value("VmHWM:");
+#else
+  return 0;
+#endif
+}
+
+void Reset_Peak_RSS()
+{
+#ifdef __linux__
+  // Writing 5 to clear_refs resets the peak resident memory
+  int file = open("/proc/self/clear_refs", O_WRONLY);
+  if (file >= 0)
+  {
+    if (write(file, "5", 1) < 0)
+      perror("clear_refs");
+    close(file);
+  }
+#endif
+}
@@ -2,10 +2,97 @@
 
 #include <objects.h>
 
-void Not_Set_Controls(Objects &object)
+// Fill, lines and light of any object
+static void Material_Controls(Entity_Material &material)
+{
+  // Render Light
+  ImGui::Checkbox("Render Light?", &material.renderLight);
+
+  // Dots draw change
+  ImGui::Checkbox("Fill?", &material.fill);
+
+  // Color change
+  float newFillColor[4];
+  newFillColor[0] = (float)material.fillColor.r / 255;
+  newFillColor[1] = (float)material.fillColor.g / 255;
+  newFillColor[2] = (float)material.fillColor.b / 255;
+  newFillColor[3] = (float)material.fillColor.a / 255;
+  ImGui::ColorEdit4("Fill/Dots Color", newFillColor);
+  material.fillColor.r = (Uint8)(newFillColor[0] * 255);
+  material.fillColor.g = (Uint8)(newFillColor[1] * 255);
+  material.fillColor.b = (Uint8)(newFillColor[2] * 255);
+  material.fillColor.a = (Uint8)(newFillColor[3] * 255);
+
+  ImGui::Checkbox("Lines Draw?", &material.lines);
+  if (material.lines)
+  {
+    // Color change
+    float newLineColor[4];
+    newLineColor[0] = (float)material.linesColor.r / 255;
+    newLineColor[1] = (float)material.linesColor.g / 255;
+    newLineColor[2] = (float)material.linesColor.b / 255;
+    newLineColor[3] = (float)material.linesColor.a / 255;
+    ImGui::ColorEdit4("Lines Color", newLineColor);
+    material.linesColor.r = (Uint8)(newLineColor[0] * 255);
+    material.linesColor.g = (Uint8)(newLineColor[1] * 255);
+    material.linesColor.b = (Uint8)(newLineColor[2] * 255);
+    material.linesColor.a = (Uint8)(newLineColor[3] * 255);
+  }
+}
+
+// Orbit of any object
+static void Orbit_Controls(Entity_Orbit &orbit)
+{
+  // Orbit center
+  ImGui::DragFloat3("Orbit Center", &orbit.center.x, -10000, 10000);
+
+  // Orbit mov
+  ImGui::DragFloat3("Orbit Angle", &orbit.angle.x, -0.5, 0.5);
+
+  // Orbit vel if have orbit mov
+  ImGui::DragFloat("Orbit Vel", &orbit.vel, -100, 100);
+
+  if (ImGui::Button("Stop planet (orbit vel = 0)"))
+  {
+    orbit.vel = 0.0f;
+  }
+}
+
+// Translation, rotation and scale of any object
+static void Transform_Controls(Entity &entity)
+{
+  // Translate Planets
+  Vec3 mov = {0, 0, 0};
+  ImGui::DragFloat3("Translate", &mov.x, -1, 1);
+  mov.x *= -1;
+  mov.z *= -1;
+  if (mov.x != 0 || mov.y != 0 || mov.z != 0)
+    entity.translation(mov);
+
+  // Rotate Planets
+  Vec3 rot = {0, 0, 0};
+  ImGui::DragFloat3("Rotate", &rot.x, -1, 1);
+  rot.x *= -1;
+  rot.y *= -1;
+  if (rot.x != 0 || rot.y != 0 || rot.z != 0)
+    entity.rotation(rot);
+
+  // Escale Planets
+  Vec3 scale = {1, 1, 1};
+  ImGui::DragFloat3("Scale", &scale.x, 0, 2);
+  if (scale.x != 1 || scale.y != 1 || scale.z != 1)
+    entity.scale(scale);
+
+  // Escale Planets in the 3 axis
+  float eScale = 1;
+  ImGui::DragFloat("Equal scale", &eScale, 0, 2);
+  if (eScale != 1)
+    entity.scale({eScale, eScale, eScale});
+}
+
+int Not_Set_Controls(Registry &registry)
 {
   ImGui::Text("Type: notSet, 0 triangles");
-  ImGui::Text("Size: %d", object.figure.getSize());
 
   char str[200];
   memset(str, 0, sizeof(str));
@@ -20,6 +107,20 @@ void Not_Set_Controls(Objects &object)
   {
     ImGui::Text("Please select the file to charge: ");
     ImGui::InputText(" ", path, 1000);
+
+    // Streaming import, window and memory ceiling in KB
+    ImGui::Checkbox("Streaming load?", &Figure::stream_settings_.enabled);
+    if (Figure::stream_settings_.enabled)
+    {
+      int window = (int)(Figure::stream_settings_.window / 1024);
+      int limit = (int)(Figure::stream_settings_.memory_limit / 1024);
+      ImGui::DragInt("Window (KB)", &window, 1.0f, 1, 64 * 1024);
+      ImGui::DragInt("Memory limit (KB)", &limit, 1024.0f, 1, 4 * 1024 * 1024);
+      Figure::stream_settings_.window = (size_t)std::max(window, 1) * 1024;
+      Figure::stream_settings_.memory_limit = (size_t)std::max(limit, 1) * 1024;
+    }
+    if (ImGui::Button("Report load memory (console)"))
+      Figure::LoadReport();
   }
 
   static SDL_Color color = {0, 0, 0, 255};
@@ -53,31 +154,57 @@ void Not_Set_Controls(Objects &object)
   ImGui::DragFloat3("Orbit Center", &orbit_center.x, -10000, 10000);
 
   static int res = 10;
+  static bool icosphere = false;
+  static int subdivisions = 3;
 
   if (type == typeSphere)
-    ImGui::DragInt("Res", &res, 0.25f, 0, 50);
+  {
+    // Icospheres have uniform triangles, the UV spheres have them tiny at the poles
+    ImGui::Checkbox("Icosphere?", &icosphere);
+    if (icosphere)
+      ImGui::DragInt("Subdivisions", &subdivisions, 0.1f, 0, MAX_ICO_LEVEL);
+    else
+      ImGui::DragInt("Res", &res, 0.25f, 0, 50);
+    if (ImGui::Button("Report sphere triangles (console)"))
+      Sphere::TessellationReport();
+  }
 
+  int handle = -1;
   if (ImGui::Button("Set new values"))
   {
     switch (type)
     {
     case typeSphere:
-      object.type = type;
-      object.sphere.init(color, fill, res, scale, mov, rot, orbit, orbit_center);
+    {
+      Sphere sphere;
+      if (icosphere)
+        sphere.initIcosphere(color, fill, subdivisions, scale, mov, rot, orbit, orbit_center);
+      else
+        sphere.init(color, fill, res, scale, mov, rot, orbit, orbit_center);
+      handle = registry.add(type, std::move(sphere));
       break;
+    }
     case typeCube:
-      object.type = type;
-      object.cube.init(color, fill, scale, mov, rot, orbit, orbit_center);
+    {
+      Cube cube;
+      cube.init(color, fill, scale, mov, rot, orbit, orbit_center);
+      handle = registry.add(type, std::move(cube));
       break;
+    }
     case typeFigure:
+    {
       std::cout << path << std::endl;
-      if (fopen(path, "r") != NULL)
+      FILE *file = fopen(path, "r");
+      if (file != NULL)
       {
-        object.type = type;
-        object.figure.init(path, color, fill, scale, mov, rot, orbit, orbit_center);
+        fclose(file);
+        Figure figure;
+        figure.init(path, color, fill, scale, mov, rot, orbit, orbit_center);
+        handle = registry.add(type, std::move(figure));
       }
       break;
     }
+    }
     type = 0;
     color = {0, 0, 0, 255};
     fill = false;
@@ -88,96 +215,32 @@ void Not_Set_Controls(Objects &object)
     orbit = {0, 0, 0};
     orbit_center = {0, 0, 0};
   }
+
+  return handle;
 }
 
-void Spheres_Controls(Sphere &sphere)
+void Spheres_Controls(Sphere &sphere, Entity_Orbit &orbit, Entity_Material &material)
 {
-  ImGui::Text("Type: sphere, %d triangles", sphere.getFaces()*2);
+  if (sphere.getSubdivisions() >= 0)
+    ImGui::Text("Type: icosphere level %d, %d triangles", sphere.getSubdivisions(), sphere.getTriangles());
+  else
+    ImGui::Text("Type: sphere, %d triangles", sphere.getTriangles());
   ImGui::Text("Size: %d", sphere.getSize());
+  ImGui::Text("LOD: %d of %d, %d faces", sphere.getLod(), sphere.getLodLevels() - 1, sphere.getLodFaces(sphere.getLod()));
 
   char str[50];
   memset(str, 0, sizeof(str));
   snprintf(str, 50, "Translation %f, %f, %f", sphere.mov_.x, sphere.mov_.y, sphere.mov_.z);
   ImGui::Text("%s", str);
 
-  // Render Light
-  ImGui::Checkbox("Render Light?", &sphere.renderLight_);
-
-  // Dots draw change
-  ImGui::Checkbox("Fill?", &sphere.fill_);
-
-  // Color change
-  float newFillColor[4];
-  newFillColor[0] = (float)sphere.fillColor_.r / 255;
-  newFillColor[1] = (float)sphere.fillColor_.g / 255;
-  newFillColor[2] = (float)sphere.fillColor_.b / 255;
-  newFillColor[3] = (float)sphere.fillColor_.a / 255;
-  ImGui::ColorEdit4("Fill/Dots Color", newFillColor);
-  sphere.fillColor_.r = (Uint8)(newFillColor[0] * 255);
-  sphere.fillColor_.g = (Uint8)(newFillColor[1] * 255);
-  sphere.fillColor_.b = (Uint8)(newFillColor[2] * 255);
-  sphere.fillColor_.a = (Uint8)(newFillColor[3] * 255);
-
-  ImGui::Checkbox("Lines Draw?", &sphere.lines_);
-  if (sphere.lines_)
-  {
-    // Color change
-    float newLineColor[4];
-    newLineColor[0] = (float)sphere.linesColor_.r / 255;
-    newLineColor[1] = (float)sphere.linesColor_.g / 255;
-    newLineColor[2] = (float)sphere.linesColor_.b / 255;
-    newLineColor[3] = (float)sphere.linesColor_.a / 255;
-    ImGui::ColorEdit4("Lines Color", newLineColor);
-    sphere.linesColor_.r = (Uint8)(newLineColor[0] * 255);
-    sphere.linesColor_.g = (Uint8)(newLineColor[1] * 255);
-    sphere.linesColor_.b = (Uint8)(newLineColor[2] * 255);
-    sphere.linesColor_.a = (Uint8)(newLineColor[3] * 255);
-  }
-
-  // Orbit center
-  ImGui::DragFloat3("Orbit Center", &sphere.orbit_center_.x, -10000, 10000);
-
-  // Orbit mov
-  ImGui::DragFloat3("Orbit Angle", &sphere.orbit_.x, -0.5, 0.5);
-
-  // Orbit vel if have orbit mov
-  ImGui::DragFloat("Orbit Vel", &sphere.orbit_vel_, -100, 100);
-
-  if (ImGui::Button("Stop planet (orbit vel = 0)"))
-  {
-    sphere.orbit_vel_ = 0.0f;
-  }
-
-  // Translate Planets
-  Vec3 mov = {0, 0, 0};
-  ImGui::DragFloat3("Translate", &mov.x, -1, 1);
-  mov.x *= -1;
-  mov.z *= -1;
-  if (mov.x != 0 || mov.y != 0 || mov.z != 0)
-    sphere.translation(mov);
-
-  // Rotate Planets
-  Vec3 rot = {0, 0, 0};
-  ImGui::DragFloat3("Rotate", &rot.x, -1, 1);
-  rot.x *= -1;
-  rot.y *= -1;
-  if (rot.x != 0 || rot.y != 0 || rot.z != 0)
-    sphere.rotation(rot);
+  Material_Controls(material);
 
-  // Escale Planets
-  Vec3 scale = {1, 1, 1};
-  ImGui::DragFloat3("Scale", &scale.x, 0, 2);
-  if (scale.x != 1 || scale.y != 1 || scale.z != 1)
-    sphere.scale(scale);
+  Orbit_Controls(orbit);
 
-  // Escale Planets in the 3 axis
-  float eScale = 1;
-  ImGui::DragFloat("Equal scale", &eScale, 0, 2);
-  if (eScale != 1)
-    sphere.scale({eScale, eScale, eScale});
+  Transform_Controls(sphere);
 }
 
-void Cubes_Controls(Cube &cube)
+void Cubes_Controls(Cube &cube, Entity_Orbit &orbit, Entity_Material &material)
 {
   ImGui::Text("Type: cube, %d triangles", cube.getFaces()*2);
   ImGui::Text("Size: %d", cube.getSize());
@@ -187,166 +250,90 @@ void Cubes_Controls(Cube &cube)
   snprintf(str, 50, "Translation %f, %f, %f", cube.mov_.x, cube.mov_.y, cube.mov_.z);
   ImGui::Text("%s", str);
 
-  // Render Light
-  ImGui::Checkbox("Render Light?", &cube.renderLight_);
-
-  // Dots draw change
-  ImGui::Checkbox("Fill?", &cube.fill_);
-
-  // Color change
-  float newFillColor[4];
-  newFillColor[0] = (float)cube.fillColor_.r / 255;
-  newFillColor[1] = (float)cube.fillColor_.g / 255;
-  newFillColor[2] = (float)cube.fillColor_.b / 255;
-  newFillColor[3] = (float)cube.fillColor_.a / 255;
-  ImGui::ColorEdit4("Fill/Dots Color", newFillColor);
-  cube.fillColor_.r = (Uint8)(newFillColor[0] * 255);
-  cube.fillColor_.g = (Uint8)(newFillColor[1] * 255);
-  cube.fillColor_.b = (Uint8)(newFillColor[2] * 255);
-  cube.fillColor_.a = (Uint8)(newFillColor[3] * 255);
-
-  ImGui::Checkbox("Lines Draw?", &cube.lines_);
-  if (cube.lines_)
-  {
-    // Color change
-    float newLineColor[4];
-    newLineColor[0] = (float)cube.linesColor_.r / 255;
-    newLineColor[1] = (float)cube.linesColor_.g / 255;
-    newLineColor[2] = (float)cube.linesColor_.b / 255;
-    newLineColor[3] = (float)cube.linesColor_.a / 255;
-    ImGui::ColorEdit4("Lines Color", newLineColor);
-    cube.linesColor_.r = (Uint8)(newLineColor[0] * 255);
-    cube.linesColor_.g = (Uint8)(newLineColor[1] * 255);
-    cube.linesColor_.b = (Uint8)(newLineColor[2] * 255);
-    cube.linesColor_.a = (Uint8)(newLineColor[3] * 255);
-  }
-
-  // Orbit center
-  ImGui::DragFloat3("Orbit Center", &cube.orbit_center_.x, -10000, 10000);
-
-  // Orbit mov
-  ImGui::DragFloat3("Orbit Angle", &cube.orbit_.x, -0.5, 0.5);
+  Material_Controls(material);
 
-  // Orbit vel if have orbit mov
-  ImGui::DragFloat("Orbit Vel", &cube.orbit_vel_, -100, 100);
-
-  if (ImGui::Button("Stop planet (orbit vel = 0)"))
-  {
-    cube.orbit_vel_ = 0.0f;
-  }
-
-  // Translate Planets
-  Vec3 mov = {0, 0, 0};
-  ImGui::DragFloat3("Translate", &mov.x, -1, 1);
-  mov.x *= -1;
-  mov.z *= -1;
-  if (mov.x != 0 || mov.y != 0 || mov.z != 0)
-    cube.translation(mov);
-
-  // Rotate Planets
-  Vec3 rot = {0, 0, 0};
-  ImGui::DragFloat3("Rotate", &rot.x, -1, 1);
-  rot.x *= -1;
-  rot.y *= -1;
-  if (rot.x != 0 || rot.y != 0 || rot.z != 0)
-    cube.rotation(rot);
-
-  // Escale Planets
-  Vec3 scale = {1, 1, 1};
-  ImGui::DragFloat3("Scale", &scale.x, 0, 2);
-  if (scale.x != 1 || scale.y != 1 || scale.z != 1)
-    cube.scale(scale);
+  Orbit_Controls(orbit);
 
-  // Escale Planets in the 3 axis
-  float eScale = 1;
-  ImGui::DragFloat("Equal scale", &eScale, 0, 2);
-  if (eScale != 1)
-    cube.scale({eScale, eScale, eScale});
+  Transform_Controls(cube);
 }
 
-void Figures_Controls(Figure &figure)
+void Figures_Controls(Figure &figure, Entity_Orbit &orbit, Entity_Material &material)
 {
   ImGui::Text("Type: figure, %d triangles", figure.getFaces());
   ImGui::Text("Size: %d", figure.getSize());
+  ImGui::Text("LOD: %d of %d, %d faces", figure.getLod(), figure.getLodLevels() - 1, figure.getLodFaces(figure.getLod()));
 
   char str[50];
   memset(str, 0, sizeof(str));
   snprintf(str, 50, "Translation %f, %f, %f", figure.mov_.x, figure.mov_.y, figure.mov_.z);
   ImGui::Text("%s", str);
 
-  // Render Light
-  ImGui::Checkbox("Render Light?", &figure.renderLight_);
-
-  // Dots draw change
-  ImGui::Checkbox("Fill?", &figure.fill_);
-
-  // Color change
-  float newFillColor[4];
-  newFillColor[0] = (float)figure.fillColor_.r / 255;
-  newFillColor[1] = (float)figure.fillColor_.g / 255;
-  newFillColor[2] = (float)figure.fillColor_.b / 255;
-  newFillColor[3] = (float)figure.fillColor_.a / 255;
-  ImGui::ColorEdit4("Fill/Dots Color", newFillColor);
-  figure.fillColor_.r = (Uint8)(newFillColor[0] * 255);
-  figure.fillColor_.g = (Uint8)(newFillColor[1] * 255);
-  figure.fillColor_.b = (Uint8)(newFillColor[2] * 255);
-  figure.fillColor_.a = (Uint8)(newFillColor[3] * 255);
-
-  ImGui::Checkbox("Lines Draw?", &figure.lines_);
-  if (figure.lines_)
+  // Material colors, the fill color only sets the alpha
+  if (figure.getMaterials() > 0)
   {
-    // Color change
-    float newLineColor[4];
-    newLineColor[0] = (float)figure.linesColor_.r / 255;
-    newLineColor[1] = (float)figure.linesColor_.g / 255;
-    newLineColor[2] = (float)figure.linesColor_.b / 255;
-    newLineColor[3] = (float)figure.linesColor_.a / 255;
-    ImGui::ColorEdit4("Lines Color", newLineColor);
-    figure.linesColor_.r = (Uint8)(newLineColor[0] * 255);
-    figure.linesColor_.g = (Uint8)(newLineColor[1] * 255);
-    figure.linesColor_.b = (Uint8)(newLineColor[2] * 255);
-    figure.linesColor_.a = (Uint8)(newLineColor[3] * 255);
+    ImGui::Checkbox("Materials?", &material.materials);
+    ImGui::SameLine();
+    ImGui::Text("%d materials, %d batches", figure.getMaterials(), figure.getBatches());
   }
 
-  // Orbit center
-  ImGui::DragFloat3("Orbit Center", &figure.orbit_center_.x, -10000, 10000);
+  Material_Controls(material);
 
-  // Orbit mov
-  ImGui::DragFloat3("Orbit Angle", &figure.orbit_.x, -0.5, 0.5);
+  Orbit_Controls(orbit);
 
-  // Orbit vel if have orbit mov
-  ImGui::DragFloat("Orbit Vel", &figure.orbit_vel_, -100, 100);
+  Transform_Controls(figure);
+}
 
-  if (ImGui::Button("Stop planet (orbit vel = 0)"))
+void Rails_Controls(Registry &registry, int handle)
+{
+  ImGui::Separator();
+  if (!registry.onRails(handle))
   {
-    figure.orbit_vel_ = 0.0f;
+    // The incremental orbit becomes the circular orbit it describes
+    if (ImGui::Button("Put orbit on rails"))
+    {
+      Orbital_Elements elements = Kepler_From_Orbit(registry.local(handle), registry.orbit(handle), ORBIT_RATE, registry.time());
+      if (elements.semi_major > 0.0f)
+        registry.setRails(handle, elements);
+    }
+    return;
   }
 
-  // Translate Planets
-  Vec3 mov = {0, 0, 0};
-  ImGui::DragFloat3("Translate", &mov.x, -1, 1);
-  mov.x *= -1;
-  mov.z *= -1;
-  if (mov.x != 0 || mov.y != 0 || mov.z != 0)
-    figure.translation(mov);
-
-  // Rotate Planets
-  Vec3 rot = {0, 0, 0};
-  ImGui::DragFloat3("Rotate", &rot.x, -1, 1);
-  rot.x *= -1;
-  rot.y *= -1;
-  if (rot.x != 0 || rot.y != 0 || rot.z != 0)
-    figure.rotation(rot);
+  Orbital_Elements &elements = registry.elements(handle);
+  ImGui::Text("On rails, time %.2f s", registry.time());
+
+  // The angles are edited in degrees
+  float degrees[4] = {elements.inclination * 180.0f / PI, elements.ascending_node * 180.0f / PI,
+                      elements.periapsis * 180.0f / PI, elements.mean_anomaly * 180.0f / PI};
+  float period = elements.mean_motion != 0.0f ? 2.0f * PI / elements.mean_motion : 0.0f;
+  bool changed = false;
+  changed |= ImGui::DragFloat("Semi-major axis", &elements.semi_major, 0.5f, 0.0f, 10000.0f);
+  changed |= ImGui::DragFloat("Eccentricity", &elements.eccentricity, 0.005f, 0.0f, 0.99f);
+  changed |= ImGui::DragFloat("Inclination", &degrees[0], 0.5f, -180.0f, 180.0f);
+  changed |= ImGui::DragFloat("Ascending node", &degrees[1], 0.5f, -360.0f, 360.0f);
+  changed |= ImGui::DragFloat("Periapsis", &degrees[2], 0.5f, -360.0f, 360.0f);
+  changed |= ImGui::DragFloat("Mean anomaly", &degrees[3], 0.5f, -360.0f, 360.0f);
+  changed |= ImGui::DragFloat("Period (s)", &period, 0.1f, -1000.0f, 1000.0f);
+  if (changed)
+  {
+    elements = Kepler_Elements(elements.semi_major, elements.eccentricity, degrees[0], degrees[1], degrees[2],
+                               degrees[3], period, elements.center);
+  }
 
-  // Escale Planets
-  Vec3 scale = {1, 1, 1};
-  ImGui::DragFloat3("Scale", &scale.x, 0, 2);
-  if (scale.x != 1 || scale.y != 1 || scale.z != 1)
-    figure.scale(scale);
+  if (ImGui::Button("Take off rails"))
+    registry.clearRails(handle);
+}
 
-  // Escale Planets in the 3 axis
-  float eScale = 1;
-  ImGui::DragFloat("Equal scale", &eScale, 0, 2);
-  if (eScale != 1)
-    figure.scale({eScale, eScale, eScale});
+void Parent_Controls(Registry &registry, int handle)
+{
+  ImGui::Separator();
+  int parent = registry.parent(handle);
+  int index = parent >= 0 ? registry.index(parent) : -1;
+  if (parent >= 0)
+    ImGui::Text("Parent: %d (handle %d)", index, parent);
+  else
+    ImGui::Text("Parent: none");
+
+  // -1 detaches the object, an invalid parent leaves it as it was
+  if (ImGui::DragInt("Parent object", &index, 0.1f, -1, registry.count() - 1))
+    registry.setParent(handle, index >= 0 ? registry.handle(index) : -1);
 }
@@ -0,0 +1,421 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <particles.h>
+#include <common_defs.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLES_SSE 1
+#include <emmintrin.h>
+#endif
+
+Particle_Settings Particles::settings_ = {true, 1 << 18, 4, 40.0f, 1.5f, 0.8f, 2.0f, 16384};
+
+// Grows an array, the particles are plain data
+template <typename T>
+static void Resize(T *&array, int size)
+{
+  array = (T *)realloc((void *)array, size * sizeof(T));
+}
+
+// The particles of every range but the last one, a multiple of align
+static int Range_Size(int count, int ranges, int align)
+{
+  return (count / ranges + align - 1) / align * align;
+}
+
+// Splits [0, count) in ranges evaluated by the threads of a pool
+static int Parallel_Ranges(Thread_Pool &pool, int count, int align, const std::function<void(int range, int start, int end)> &work)
+{
+  int numThreads = std::min((int)std::thread::hardware_concurrency(), count / std::max(Particles::settings_.min_parallel / 4, 1));
+  if (count < Particles::settings_.min_parallel || numThreads <= 1)
+  {
+    work(0, 0, count);
+    return 1;
+  }
+
+  // Every thread writes the results of its own range
+  int perThread = Range_Size(count, numThreads, align);
+  pool.run(numThreads, [&](int i)
+           {
+             int start = std::min(i * perThread, count);
+             int end = i == numThreads - 1 ? count : std::min(start + perThread, count);
+             work(i, start, end);
+           });
+
+  return numThreads;
+}
+
+// The seed of a chunk, a finalizer that spreads consecutive values
+static uint32_t Hash(uint32_t value)
+{
+  value ^= value >> 16;
+  value *= 0x85EBCA6Bu;
+  value ^= value >> 13;
+  value *= 0xC2B2AE35u;
+  value ^= value >> 16;
+  return value != 0 ? value : 0x9E3779B9u;
+}
+
+// A value in [0, 1) from a xorshift generator
+static float Random(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (state & 0xFFFFFF) / (float)0x1000000;
+}
+
+Particles::Particles()
+{
+  x_ = y_ = z_ = nullptr;
+  vx_ = vy_ = vz_ = nullptr;
+  life_ = nullptr;
+  fade_ = nullptr;
+  colors_ = nullptr;
+  count_ = 0;
+  capacity_ = 0;
+  seed_ = 0x2545F491u;
+  vertices_ = nullptr;
+}
+
+void Particles::reserve(int capacity)
+{
+  capacity_ = std::max((capacity + PARTICLES_LANES - 1) / PARTICLES_LANES * PARTICLES_LANES, 0);
+  count_ = 0;
+
+  float **arrays[] = {&x_, &y_, &z_, &vx_, &vy_, &vz_, &life_, &fade_};
+  for (float **array : arrays)
+    Resize(*array, capacity_);
+  Resize(colors_, capacity_);
+  Resize(vertices_, capacity_ * 3);
+}
+
+int Particles::emit(const Vec3 *centers, const SDL_Color *colors, int count, Vec3 origin, Vec3 velocity, SDL_Color color)
+{
+  if (capacity_ == 0)
+    reserve(settings_.capacity);
+  if (count <= 0)
+    return 0;
+
+  int n = (int)std::min((int64_t)count * std::max(settings_.per_face, 1), (int64_t)(capacity_ - count_));
+  if (n <= 0)
+    return 0;
+
+  const int first = count_;
+  const uint32_t seed = seed_;
+  const float speed = settings_.speed;
+  const float life = std::max(settings_.life, 0.01f);
+  const float size = settings_.size;
+
+  // The ranges are whole chunks, every chunk has its own generator
+  Parallel_Ranges(threads_, n, PARTICLES_CHUNK, [&](int, int start, int end)
+                  {
+    uint32_t state = 0;
+    for (int k = start; k < end; k++)
+    {
+      if (k % PARTICLES_CHUNK == 0)
+        state = Hash(seed + (uint32_t)(k / PARTICLES_CHUNK));
+
+      // The faces are sampled evenly when they don't fit
+      int face = (int)((int64_t)k * count / n);
+      Vec3 center = centers[face];
+      float rx = Random(state) * 2.0f - 1.0f;
+      float ry = Random(state) * 2.0f - 1.0f;
+      float rz = Random(state) * 2.0f - 1.0f;
+
+      // Away from the center of the mesh, with some spread
+      float ox = center.x - origin.x;
+      float oy = center.y - origin.y;
+      float oz = center.z - origin.z;
+      float length = sqrtf(ox * ox + oy * oy + oz * oz);
+      float out = length > 0.0f ? speed * (0.5f + Random(state)) / length : 0.0f;
+
+      int i = first + k;
+      x_[i] = center.x + rx * size;
+      y_[i] = center.y + ry * size;
+      z_[i] = center.z + rz * size;
+      vx_[i] = velocity.x + ox * out + rx * speed * 0.25f;
+      vy_[i] = velocity.y + oy * out + ry * speed * 0.25f;
+      vz_[i] = velocity.z + oz * out + rz * speed * 0.25f;
+      life_[i] = life * (0.5f + Random(state));
+      fade_[i] = 1.0f / life_[i];
+      colors_[i] = colors != nullptr ? colors[face] : color;
+      colors_[i].a = color.a;
+    } });
+
+  count_ += n;
+  seed_ += (uint32_t)((n + PARTICLES_CHUNK - 1) / PARTICLES_CHUNK);
+
+  return n;
+}
+
+void Particles::integrate(int start, int end, float elapsed, float damping)
+{
+#ifdef PARTICLES_SSE
+  const __m128 dt = _mm_set1_ps(elapsed);
+  const __m128 damp = _mm_set1_ps(damping);
+  for (int i = start; i < end; i += PARTICLES_LANES)
+  {
+    __m128 vx = _mm_mul_ps(_mm_loadu_ps(vx_ + i), damp);
+    __m128 vy = _mm_mul_ps(_mm_loadu_ps(vy_ + i), damp);
+    __m128 vz = _mm_mul_ps(_mm_loadu_ps(vz_ + i), damp);
+    _mm_storeu_ps(x_ + i, _mm_add_ps(_mm_loadu_ps(x_ + i), _mm_mul_ps(vx, dt)));
+    _mm_storeu_ps(y_ + i, _mm_add_ps(_mm_loadu_ps(y_ + i), _mm_mul_ps(vy, dt)));
+    _mm_storeu_ps(z_ + i, _mm_add_ps(_mm_loadu_ps(z_ + i), _mm_mul_ps(vz, dt)));
+    _mm_storeu_ps(vx_ + i, vx);
+    _mm_storeu_ps(vy_ + i, vy);
+    _mm_storeu_ps(vz_ + i, vz);
+    _mm_storeu_ps(life_ + i, _mm_sub_ps(_mm_loadu_ps(life_ + i), dt));
+  }
+#else
+  for (int i = start; i < end; i++)
+  {
+    vx_[i] *= damping;
+    vy_[i] *= damping;
+    vz_[i] *= damping;
+    x_[i] += vx_[i] * elapsed;
+    y_[i] += vy_[i] * elapsed;
+    z_[i] += vz_[i] * elapsed;
+    life_[i] -= elapsed;
+  }
+#endif
+}
+
+void Particles::update(float elapsed)
+{
+  if (count_ == 0 || elapsed <= 0.0f)
+    return;
+
+  // The last lane is completed with particles past count_, the capacity is padded to the lanes
+  const int padded = (count_ + PARTICLES_LANES - 1) / PARTICLES_LANES * PARTICLES_LANES;
+  const float damping = std::max(1.0f - settings_.drag * elapsed, 0.0f);
+  Parallel_Ranges(threads_, padded, PARTICLES_LANES, [&](int, int start, int end)
+                  { integrate(start, end, elapsed, damping); });
+
+  // The last particle takes the place of a dead one
+  for (int i = 0; i < count_;)
+  {
+    if (life_[i] > 0.0f)
+    {
+      i++;
+      continue;
+    }
+
+    int last = --count_;
+    x_[i] = x_[last];
+    y_[i] = y_[last];
+    z_[i] = z_[last];
+    vx_[i] = vx_[last];
+    vy_[i] = vy_[last];
+    vz_[i] = vz_[last];
+    life_[i] = life_[last];
+    fade_[i] = fade_[last];
+    colors_[i] = colors_[last];
+  }
+}
+
+int Particles::project(Render &drawRender)
+{
+  if (count_ == 0)
+    return 0;
+
+  // The same projection of Render::renderPoint, the depth divides x and y
+  Vec3 xAxis, yAxis, zAxis;
+  drawRender.getAxes(xAxis, yAxis, zAxis);
+  Vec3 points[6], normals[6];
+  drawRender.getFrustum(points, normals);
+  float planes[6][4];
+  for (int p = 0; p < 6; p++)
+  {
+    planes[p][0] = normals[p].x;
+    planes[p][1] = normals[p].y;
+    planes[p][2] = normals[p].z;
+    planes[p][3] = Vec3::DotProduct(points[p], normals[p]);
+  }
+  const Vec3 camera = drawRender.camera_;
+  const Vec2 center = drawRender.getRenderCenter();
+  const Vec2 scale = drawRender.getRenderScale();
+  const float size = settings_.size;
+
+  visible_.assign(std::max((int)std::thread::hardware_concurrency(), 1), 0);
+  int ranges = Parallel_Ranges(threads_, count_, PARTICLES_LANES, [&](int range, int start, int end)
+                               {
+    SDL_Vertex *out = vertices_ + start * 3;
+    int visible = 0;
+    for (int i = start; i < end; i++)
+    {
+      // Inside the 6 planes of the render trapezoid
+      bool inside = true;
+      for (int p = 0; p < 6 && inside; p++)
+        inside = x_[i] * planes[p][0] + y_[i] * planes[p][1] + z_[i] * planes[p][2] >= planes[p][3];
+      if (!inside)
+        continue;
+
+      float dx = x_[i] - camera.x;
+      float dy = y_[i] - camera.y;
+      float dz = z_[i] - camera.z;
+      float depth = dx * zAxis.x + dy * zAxis.y + dz * zAxis.z;
+      if (depth == 0.0f)
+        continue;
+      float inv = 1.0f / depth;
+      float sx = center.x + scale.x * (dx * xAxis.x + dy * xAxis.y + dz * xAxis.z) * inv;
+      float sy = center.y + scale.y * (dx * yAxis.x + dy * yAxis.y + dz * yAxis.z) * inv;
+      float h = std::max(size * scale.x * fabsf(inv), 0.75f);
+
+      SDL_Color color = colors_[i];
+      color.a = (Uint8)(color.a * std::min(life_[i] * fade_[i], 1.0f));
+      out[0] = {{sx, sy - h}, color, {0.0f, 0.0f}};
+      out[1] = {{sx + 0.87f * h, sy + 0.5f * h}, color, {0.0f, 0.0f}};
+      out[2] = {{sx - 0.87f * h, sy + 0.5f * h}, color, {0.0f, 0.0f}};
+      out += 3;
+      visible++;
+    }
+    visible_[range] = visible; });
+
+  // The shards of every range after the ones of the previous range
+  int perThread = Range_Size(count_, ranges, PARTICLES_LANES);
+  int total = visible_[0];
+  for (int r = 1; r < ranges; r++)
+  {
+    int start = std::min(r * perThread, count_);
+    memmove(vertices_ + total * 3, vertices_ + start * 3, visible_[r] * 3 * sizeof(SDL_Vertex));
+    total += visible_[r];
+  }
+
+  return total;
+}
+
+#ifndef HEADLESS
+void Particles::draw(SDL_Renderer *render, Render &drawRender)
+{
+  int visible = project(drawRender);
+  if (visible > 0)
+    SDL_RenderGeometry(render, NULL, vertices_, visible * 3, NULL, 0);
+}
+#endif
+
+const SDL_Vertex *Particles::vertices()
+{
+  return vertices_;
+}
+
+void Particles::clear()
+{
+  count_ = 0;
+}
+
+int Particles::count()
+{
+  return count_;
+}
+
+int Particles::capacity()
+{
+  return capacity_;
+}
+
+Particles::~Particles()
+{
+  DESTROY(x_);
+  DESTROY(y_);
+  DESTROY(z_);
+  DESTROY(vx_);
+  DESTROY(vy_);
+  DESTROY(vz_);
+  DESTROY(life_);
+  DESTROY(fade_);
+  DESTROY(colors_);
+  DESTROY(vertices_);
+}
+
+int Particles_Benchmark(int particles, int frames)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  const int sizes[] = {10000, 100000, 1000000};
+  const int nSizes = particles > 0 ? 1 : 3;
+  const Particle_Settings saved = Particles::settings_;
+  const float elapsed = 1.0f / 60.0f;
+  frames = std::max(frames, 1);
+  int ret = 0;
+
+  // The debris lives longer than the run, the shortest life is half the mean
+  Particles::settings_.life = 4.0f * frames * elapsed;
+  Particles::settings_.per_face = 4;
+
+  Render drawRender;
+  drawRender.init({1200.0f, 840.0f}, {600.0f, 420.0f, 100.0f});
+
+  printf("Particles  Update ms  Project ms  Visible   Mparticles/s\n");
+  for (int s = 0; s < nSizes && ret == 0; s++)
+  {
+    int n = particles > 0 ? particles : sizes[s];
+
+    // The faces of a sphere in front of the camera
+    int faces = (n + 3) / 4;
+    Vec3 *centers = (Vec3 *)calloc(faces, sizeof(Vec3));
+    Vec3 origin = {600.0f, 420.0f, 0.0f};
+    for (int i = 0; i < faces; i++)
+    {
+      float theta = 6.2831853f * (i * 0.618034f - floorf(i * 0.618034f));
+      float z = 1.0f - 2.0f * (i + 0.5f) / faces;
+      float r = sqrtf(1.0f - z * z);
+      centers[i] = {origin.x + 60.0f * r * cosf(theta), origin.y + 60.0f * r * sinf(theta), origin.z + 60.0f * z};
+    }
+
+    Particles pool;
+    pool.reserve(n);
+    int emitted = pool.emit(centers, nullptr, faces, origin, {0.0f, 0.0f, 0.0f}, {255, 200, 120, 255});
+
+    double update_ms = 0.0, project_ms = 0.0;
+    int visible = 0;
+    for (int f = 0; f < frames; f++)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      pool.update(elapsed);
+      update_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+      start = std::chrono::steady_clock::now();
+      visible = pool.project(drawRender);
+      project_ms += Milliseconds(std::chrono::steady_clock::now() - start).count();
+    }
+
+    for (int i = 0; i < visible * 3; i++)
+    {
+      SDL_FPoint p = pool.vertices()[i].position;
+      if (!std::isfinite(p.x) || !std::isfinite(p.y))
+      {
+        printf("ERROR: Shard %d at %f, %f\n", i / 3, p.x, p.y);
+        ret = 1;
+        break;
+      }
+    }
+    if (pool.count() != emitted)
+    {
+      printf("ERROR: %d particles alive of %d, none should have died\n", pool.count(), emitted);
+      ret = 1;
+    }
+    pool.update(1.5f * Particles::settings_.life);
+    if (pool.count() != 0)
+    {
+      printf("ERROR: %d particles alive after the longest life\n", pool.count());
+      ret = 1;
+    }
+
+    printf("%-10d %-10.3f %-11.3f %-9d %.1f\n", emitted, update_ms / frames, project_ms / frames, visible,
+           emitted / std::max(update_ms / frames, 0.001) / 1000.0);
+
+    DESTROY(centers);
+  }
+  Particles::settings_ = saved;
+
+  return ret;
+}
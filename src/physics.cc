@@ -0,0 +1,590 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <physics.h>
+#include <common_defs.h>
+#include <sim_clock.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PHYSICS_SSE 1
+#include <emmintrin.h>
+#endif
+
+Physics_Settings Physics::settings_ = {false, 10.0f, 2.0f, 512, PHYSICS_TREE_BODIES, 0.5f};
+
+// Grows an array, the new bodies are zeroed so the padding has no mass
+template <typename T>
+static void Resize(T *&array, int size, int old_size)
+{
+  array = (T *)realloc((void *)array, size * sizeof(T));
+  memset((void *)(array + old_size), 0, (size - old_size) * sizeof(T));
+}
+
+Physics::Physics()
+{
+  count_ = 0;
+  capacity_ = 0;
+  x_ = nullptr;
+  y_ = nullptr;
+  z_ = nullptr;
+  vx_ = nullptr;
+  vy_ = nullptr;
+  vz_ = nullptr;
+  ax_ = nullptr;
+  ay_ = nullptr;
+  az_ = nullptr;
+  m_ = nullptr;
+  current_ = false;
+  nodes_ = nullptr;
+  nNodes_ = 0;
+  capNodes_ = 0;
+  order_ = nullptr;
+  scratch_ = nullptr;
+}
+
+void Physics::reserve(int capacity)
+{
+  capacity = (capacity + PHYSICS_LANES - 1) / PHYSICS_LANES * PHYSICS_LANES;
+  if (capacity <= capacity_)
+    return;
+
+  float **arrays[] = {&x_, &y_, &z_, &vx_, &vy_, &vz_, &ax_, &ay_, &az_, &m_};
+  for (float **array : arrays)
+    Resize(*array, capacity, capacity_);
+  Resize(order_, capacity, capacity_);
+  Resize(scratch_, capacity, capacity_);
+  capacity_ = capacity;
+}
+
+int Physics::add(Vec3 position, Vec3 velocity, float mass)
+{
+  if (count_ == capacity_)
+    reserve(std::max(16, capacity_ * 2));
+
+  int index = count_++;
+  set(index, position, velocity, mass);
+  ax_[index] = 0.0f;
+  ay_[index] = 0.0f;
+  az_[index] = 0.0f;
+
+  return index;
+}
+
+void Physics::remove(int index)
+{
+  if (index < 0 || index >= count_)
+    return;
+
+  // The last body fills the hole and its slot becomes padding
+  int last = --count_;
+  float *arrays[] = {x_, y_, z_, vx_, vy_, vz_, ax_, ay_, az_, m_};
+  for (float *array : arrays)
+  {
+    array[index] = array[last];
+    array[last] = 0.0f;
+  }
+  current_ = false;
+}
+
+void Physics::clear()
+{
+  float *arrays[] = {x_, y_, z_, vx_, vy_, vz_, ax_, ay_, az_, m_};
+  for (float *array : arrays)
+  {
+    if (array != nullptr)
+      memset(array, 0, capacity_ * sizeof(float));
+  }
+  count_ = 0;
+  current_ = false;
+}
+
+int Physics::count()
+{
+  return count_;
+}
+
+Vec3 Physics::position(int index)
+{
+  return {x_[index], y_[index], z_[index]};
+}
+
+Vec3 Physics::velocity(int index)
+{
+  return {vx_[index], vy_[index], vz_[index]};
+}
+
+float Physics::mass(int index)
+{
+  return m_[index];
+}
+
+void Physics::set(int index, Vec3 position, Vec3 velocity, float mass)
+{
+  x_[index] = position.x;
+  y_[index] = position.y;
+  z_[index] = position.z;
+  vx_[index] = velocity.x;
+  vy_[index] = velocity.y;
+  vz_[index] = velocity.z;
+  m_[index] = mass;
+  current_ = false;
+}
+
+void Physics::parallel(int count, const std::function<void(int start, int end)> &work)
+{
+  int numThreads = std::min((int)std::thread::hardware_concurrency(), count / std::max(settings_.min_parallel / 4, 1));
+  if (count < settings_.min_parallel || numThreads <= 1)
+  {
+    work(0, count);
+    return;
+  }
+
+  // The last range takes the remainder
+  int perThread = count / numThreads;
+  pool_.run(numThreads, [&](int range)
+            { work(range * perThread, range == numThreads - 1 ? count : (range + 1) * perThread); });
+}
+
+void Physics::accelerations(int start, int end)
+{
+  const float g = settings_.gravity;
+  const float eps2 = settings_.softening * settings_.softening;
+
+  // The padding bodies have mass 0, so every body is evaluated against whole lanes
+  const int padded = (count_ + PHYSICS_LANES - 1) / PHYSICS_LANES * PHYSICS_LANES;
+
+  for (int i = start; i < end; i++)
+  {
+    float ax = 0.0f;
+    float ay = 0.0f;
+    float az = 0.0f;
+
+#ifdef PHYSICS_SSE
+    const __m128 xi = _mm_set1_ps(x_[i]);
+    const __m128 yi = _mm_set1_ps(y_[i]);
+    const __m128 zi = _mm_set1_ps(z_[i]);
+    const __m128 soft = _mm_set1_ps(eps2);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 sum_x = _mm_setzero_ps();
+    __m128 sum_y = _mm_setzero_ps();
+    __m128 sum_z = _mm_setzero_ps();
+    for (int j = 0; j < padded; j += PHYSICS_LANES)
+    {
+      __m128 dx = _mm_sub_ps(_mm_loadu_ps(x_ + j), xi);
+      __m128 dy = _mm_sub_ps(_mm_loadu_ps(y_ + j), yi);
+      __m128 dz = _mm_sub_ps(_mm_loadu_ps(z_ + j), zi);
+      __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), soft));
+
+      // m / r^3, the body itself has distance 0 and adds nothing
+      __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(r2));
+      __m128 s = _mm_mul_ps(_mm_loadu_ps(m_ + j), _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+      sum_x = _mm_add_ps(sum_x, _mm_mul_ps(dx, s));
+      sum_y = _mm_add_ps(sum_y, _mm_mul_ps(dy, s));
+      sum_z = _mm_add_ps(sum_z, _mm_mul_ps(dz, s));
+    }
+    float lanes[PHYSICS_LANES];
+    _mm_storeu_ps(lanes, sum_x);
+    ax = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm_storeu_ps(lanes, sum_y);
+    ay = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm_storeu_ps(lanes, sum_z);
+    az = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+    for (int j = 0; j < padded; j++)
+    {
+      float dx = x_[j] - x_[i];
+      float dy = y_[j] - y_[i];
+      float dz = z_[j] - z_[i];
+      float inv = 1.0f / sqrtf(dx * dx + dy * dy + dz * dz + eps2);
+      float s = m_[j] * inv * inv * inv;
+      ax += dx * s;
+      ay += dy * s;
+      az += dz * s;
+    }
+#endif
+
+    ax_[i] = ax * g;
+    ay_[i] = ay * g;
+    az_[i] = az * g;
+  }
+}
+
+void Physics::buildTree()
+{
+  nNodes_ = 0;
+  if (count_ == 0)
+    return;
+
+  // The root is the bounding cube of every body
+  float min_x = x_[0], min_y = y_[0], min_z = z_[0];
+  float max_x = x_[0], max_y = y_[0], max_z = z_[0];
+  for (int i = 0; i < count_; i++)
+  {
+    min_x = std::min(min_x, x_[i]);
+    min_y = std::min(min_y, y_[i]);
+    min_z = std::min(min_z, z_[i]);
+    max_x = std::max(max_x, x_[i]);
+    max_y = std::max(max_y, y_[i]);
+    max_z = std::max(max_z, z_[i]);
+    order_[i] = i;
+  }
+
+  if (capNodes_ == 0)
+    Resize(nodes_, capNodes_ = 64, 0);
+
+  Octree_Node &root = nodes_[nNodes_++];
+  root.cx = (min_x + max_x) * 0.5f;
+  root.cy = (min_y + max_y) * 0.5f;
+  root.cz = (min_z + max_z) * 0.5f;
+  root.half = std::max(std::max(max_x - min_x, max_y - min_y), max_z - min_z) * 0.5f * 1.001f + 1e-3f;
+  root.first = 0;
+  root.count = count_;
+
+  splitNode(0, 0);
+}
+
+void Physics::splitNode(int node, int depth)
+{
+  // The arena can grow while splitting, the node is always read by index
+  const int first = nodes_[node].first;
+  const int count = nodes_[node].count;
+
+  if (count <= OCTREE_LEAF_BODIES || depth >= OCTREE_MAX_DEPTH)
+  {
+    float mass = 0.0f, x = 0.0f, y = 0.0f, z = 0.0f;
+    for (int k = first; k < first + count; k++)
+    {
+      int i = order_[k];
+      mass += m_[i];
+      x += x_[i] * m_[i];
+      y += y_[i] * m_[i];
+      z += z_[i] * m_[i];
+    }
+    Octree_Node &leaf = nodes_[node];
+    leaf.mass = mass;
+    leaf.x = mass > 0.0f ? x / mass : leaf.cx;
+    leaf.y = mass > 0.0f ? y / mass : leaf.cy;
+    leaf.z = mass > 0.0f ? z / mass : leaf.cz;
+    leaf.child = -1;
+    leaf.nChildren = 0;
+    return;
+  }
+
+  const float cx = nodes_[node].cx;
+  const float cy = nodes_[node].cy;
+  const float cz = nodes_[node].cz;
+  const float half = nodes_[node].half * 0.5f;
+
+  // Counting sort of the range by octant
+  auto octant = [&](int i)
+  {
+    return (x_[i] >= cx ? 1 : 0) | (y_[i] >= cy ? 2 : 0) | (z_[i] >= cz ? 4 : 0);
+  };
+  int offsets[8] = {0};
+  for (int k = first; k < first + count; k++)
+    offsets[octant(order_[k])]++;
+  int counts[8];
+  int start = first;
+  for (int o = 0; o < 8; o++)
+  {
+    counts[o] = offsets[o];
+    offsets[o] = start;
+    start += counts[o];
+  }
+  for (int k = first; k < first + count; k++)
+  {
+    int i = order_[k];
+    scratch_[offsets[octant(i)]++] = i;
+  }
+  memcpy(order_ + first, scratch_ + first, count * sizeof(int));
+
+  // The children of a node are consecutive in the arena
+  int nChildren = 0;
+  for (int o = 0; o < 8; o++)
+    nChildren += counts[o] > 0 ? 1 : 0;
+  if (nNodes_ + nChildren > capNodes_)
+  {
+    int capacity = std::max(capNodes_ * 2, nNodes_ + nChildren);
+    Resize(nodes_, capacity, capNodes_);
+    capNodes_ = capacity;
+  }
+
+  int child = nNodes_;
+  start = first;
+  for (int o = 0; o < 8; o++)
+  {
+    if (counts[o] == 0)
+      continue;
+    Octree_Node &n = nodes_[nNodes_++];
+    n.cx = cx + ((o & 1) ? half : -half);
+    n.cy = cy + ((o & 2) ? half : -half);
+    n.cz = cz + ((o & 4) ? half : -half);
+    n.half = half;
+    n.first = start;
+    n.count = counts[o];
+    start += counts[o];
+  }
+  nodes_[node].child = child;
+  nodes_[node].nChildren = nChildren;
+
+  for (int c = 0; c < nChildren; c++)
+    splitNode(child + c, depth + 1);
+
+  // Mass and center of mass of the children
+  float mass = 0.0f, x = 0.0f, y = 0.0f, z = 0.0f;
+  for (int c = child; c < child + nChildren; c++)
+  {
+    mass += nodes_[c].mass;
+    x += nodes_[c].x * nodes_[c].mass;
+    y += nodes_[c].y * nodes_[c].mass;
+    z += nodes_[c].z * nodes_[c].mass;
+  }
+  Octree_Node &n = nodes_[node];
+  n.mass = mass;
+  n.x = mass > 0.0f ? x / mass : n.cx;
+  n.y = mass > 0.0f ? y / mass : n.cy;
+  n.z = mass > 0.0f ? z / mass : n.cz;
+}
+
+void Physics::treeAccelerations(int start, int end)
+{
+  const float g = settings_.gravity;
+  const float eps2 = settings_.softening * settings_.softening;
+  const float theta2 = settings_.theta * settings_.theta;
+
+  int stack[OCTREE_MAX_DEPTH * 8];
+
+  // The bodies are walked in octree order, so consecutive bodies visit the same nodes
+  for (int k = start; k < end; k++)
+  {
+    const int i = order_[k];
+    const float px = x_[i];
+    const float py = y_[i];
+    const float pz = z_[i];
+    float ax = 0.0f;
+    float ay = 0.0f;
+    float az = 0.0f;
+
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+      const Octree_Node &n = nodes_[stack[--top]];
+      if (n.child < 0)
+      {
+        for (int b = n.first; b < n.first + n.count; b++)
+        {
+          int j = order_[b];
+          float dx = x_[j] - px;
+          float dy = y_[j] - py;
+          float dz = z_[j] - pz;
+          float inv = 1.0f / sqrtf(dx * dx + dy * dy + dz * dz + eps2);
+          float s = m_[j] * inv * inv * inv;
+          ax += dx * s;
+          ay += dy * s;
+          az += dz * s;
+        }
+        continue;
+      }
+
+      float dx = n.x - px;
+      float dy = n.y - py;
+      float dz = n.z - pz;
+      float d2 = dx * dx + dy * dy + dz * dz;
+      float size = 2.0f * n.half;
+
+      // Far enough, the whole node is one body on its center of mass
+      if (size * size < theta2 * d2)
+      {
+        float inv = 1.0f / sqrtf(d2 + eps2);
+        float s = n.mass * inv * inv * inv;
+        ax += dx * s;
+        ay += dy * s;
+        az += dz * s;
+      }
+      else
+      {
+        for (int c = n.child; c < n.child + n.nChildren; c++)
+          stack[top++] = c;
+      }
+    }
+
+    ax_[i] = ax * g;
+    ay_[i] = ay * g;
+    az_[i] = az * g;
+  }
+}
+
+void Physics::accelerations()
+{
+  if (count_ >= settings_.min_tree && settings_.theta > 0.0f)
+  {
+    buildTree();
+    parallel(count_, [this](int start, int end)
+    {
+      treeAccelerations(start, end);
+    });
+  }
+  else
+  {
+    nNodes_ = 0;
+    parallel(count_, [this](int start, int end)
+    {
+      accelerations(start, end);
+    });
+  }
+  current_ = true;
+}
+
+void Physics::step(float dt)
+{
+  if (!current_)
+    accelerations();
+
+  const float half = 0.5f * dt;
+
+  // Kick and drift
+  for (int i = 0; i < count_; i++)
+  {
+    vx_[i] += ax_[i] * half;
+    vy_[i] += ay_[i] * half;
+    vz_[i] += az_[i] * half;
+    x_[i] += vx_[i] * dt;
+    y_[i] += vy_[i] * dt;
+    z_[i] += vz_[i] * dt;
+  }
+
+  accelerations();
+
+  // Kick with the accelerations of the new positions, reused by the next step
+  for (int i = 0; i < count_; i++)
+  {
+    vx_[i] += ax_[i] * half;
+    vy_[i] += ay_[i] * half;
+    vz_[i] += az_[i] * half;
+  }
+}
+
+double Physics::energy()
+{
+  const double eps2 = (double)settings_.softening * settings_.softening;
+
+  // The row i of the pairs is folded with the row count_ - 1 - i, so every fold tests count_ pairs and the
+  // threads get the same work; the folds are added in order, the result doesn't depend on the threads
+  int numFolds = (count_ + 1) / 2;
+  std::vector<double> kinetic(numFolds, 0.0);
+  std::vector<double> potential(numFolds, 0.0);
+  parallel(numFolds, [&](int first, int last)
+  {
+    for (int f = first; f < last; f++)
+    {
+      int rows[2] = {f, count_ - 1 - f};
+      for (int r = 0; r < (rows[0] == rows[1] ? 1 : 2); r++)
+      {
+        int i = rows[r];
+        kinetic[f] += 0.5 * m_[i] * ((double)vx_[i] * vx_[i] + (double)vy_[i] * vy_[i] + (double)vz_[i] * vz_[i]);
+        for (int j = i + 1; j < count_; j++)
+        {
+          double dx = (double)x_[j] - x_[i];
+          double dy = (double)y_[j] - y_[i];
+          double dz = (double)z_[j] - z_[i];
+          potential[f] -= (double)m_[i] * m_[j] / sqrt(dx * dx + dy * dy + dz * dz + eps2);
+        }
+      }
+    }
+  });
+
+  double total = 0.0;
+  for (int f = 0; f < numFolds; f++)
+    total += kinetic[f] + settings_.gravity * potential[f];
+
+  return total;
+}
+
+int Physics::treeNodes()
+{
+  return nNodes_;
+}
+
+Physics::~Physics()
+{
+  DESTROY(x_);
+  DESTROY(y_);
+  DESTROY(z_);
+  DESTROY(vx_);
+  DESTROY(vy_);
+  DESTROY(vz_);
+  DESTROY(ax_);
+  DESTROY(ay_);
+  DESTROY(az_);
+  DESTROY(m_);
+  DESTROY(nodes_);
+  DESTROY(order_);
+  DESTROY(scratch_);
+}
+
+int Physics_Benchmark(int bodies, int steps, bool energy)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  const int sizes[] = {1000, 10000, 100000};
+  const int nSizes = bodies > 0 ? 1 : 3;
+  const Physics_Settings saved = Physics::settings_;
+
+  printf("Bodies  Solver       ms/step   Nodes     Energy drift\n");
+  for (int s = 0; s < nSizes; s++)
+  {
+    int n = bodies > 0 ? bodies : sizes[s];
+
+    for (int solver = 0; solver < 3; solver++)
+    {
+      // The same disc for both solvers, a heavy body and light ones in circular orbits
+      Physics physics;
+      physics.reserve(n);
+      uint32_t state = 0x2545F491u;
+      auto random = [&state]()
+      {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state & 0xFFFFFF) / (float)0x1000000;
+      };
+      const float center_mass = (float)n;
+      physics.add({0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, center_mass);
+      for (int i = 1; i < n; i++)
+      {
+        float radius = 50.0f + 450.0f * random();
+        float angle = 6.2831853f * random();
+        float speed = sqrtf(Physics::settings_.gravity * center_mass / radius);
+        physics.add({radius * cosf(angle), radius * sinf(angle), 10.0f * (random() - 0.5f)},
+                    {-speed * sinf(angle), speed * cosf(angle), 0.0f}, 0.5f + random());
+      }
+
+      if (solver < 2)
+        Physics::settings_.min_tree = solver == 0 ? n + 1 : 0;
+      double initial = energy ? physics.energy() : 0.0;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (int i = 0; i < steps; i++)
+        physics.step(Sim_Clock::settings_.step);
+      double ms = Milliseconds(std::chrono::steady_clock::now() - start).count() / std::max(steps, 1);
+
+      // The drift is O(N^2) to measure, longer than the run itself with many bodies
+      printf("%-7d %-12s %-9.3f %-9d ", n, solver == 0 ? "direct" : solver == 1 ? "barnes-hut" : "auto", ms, physics.treeNodes());
+      if (energy)
+        printf("%.3e\n", fabs((physics.energy() - initial) / initial));
+      else
+        printf("-\n");
+      Physics::settings_ = saved;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,649 @@
+/// @author Javier guinot Almenar <guinotal@esat-alumni.com>
+/// @file quantize.cc
+
+#include <quantize.h>
+#include <math_utils.h>
+#include <common_defs.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUANT_SSE 1
+#include <emmintrin.h>
+#endif
+
+#define QUANT_QUAT_MAX ((1 << QUANT_QUAT_BITS) - 1) ///< The largest value of a component of a packed quaternion.
+#define QUANT_SQRT1_2 0.70710678f                   ///< The largest of the three smallest components of a unit quaternion.
+
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "The positions are read as a flat array of floats");
+static_assert(sizeof(Vec4) == 4 * sizeof(float), "The quaternions are read as a flat array of floats");
+
+// A component in +-1/sqrt(2) goes to [0, QUANT_QUAT_MAX] as c * scale + offset
+static const float k_QuatScale = QUANT_QUAT_MAX * QUANT_SQRT1_2;
+static const float k_QuatOffset = QUANT_QUAT_MAX * 0.5f;
+static const float k_QuatInverse = 1.0f / k_QuatScale;
+
+static uint32_t Mask(int bits)
+{
+  return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+}
+
+// The largest step of an axis, as a float for the clamps
+static float Axis_Max(int bits)
+{
+  return (float)Mask(bits);
+}
+
+int Quant_Fit(const Vec3 *positions, int count, float step, Quant_Range &range)
+{
+  Vec3 low = count > 0 ? positions[0] : Vec3{0.0f, 0.0f, 0.0f};
+  Vec3 high = low;
+  for (int i = 1; i < count; i++)
+  {
+    low = {std::min(low.x, positions[i].x), std::min(low.y, positions[i].y), std::min(low.z, positions[i].z)};
+    high = {std::max(high.x, positions[i].x), std::max(high.y, positions[i].y), std::max(high.z, positions[i].z)};
+  }
+
+  range.origin = low;
+  range.step = step;
+  int ret = 0;
+  float extent[3] = {high.x - low.x, high.y - low.y, high.z - low.z};
+  for (int axis = 0; axis < 3; axis++)
+  {
+    double steps = std::ceil((double)extent[axis] / step);
+    int bits = 0;
+    while (bits < QUANT_AXIS_BITS && (double)Mask(bits) < steps)
+      bits++;
+    ret |= (double)Mask(bits) < steps ? 1 : 0;
+    range.bits[axis] = bits;
+  }
+  return ret;
+}
+
+void Quant_Encode_Position(const Quant_Range &range, Vec3 position, uint32_t values[3])
+{
+  const float inverse = 1.0f / range.step;
+  const float origin[3] = {range.origin.x, range.origin.y, range.origin.z};
+  const float value[3] = {position.x, position.y, position.z};
+  for (int axis = 0; axis < 3; axis++)
+  {
+    float steps = std::min(std::max((value[axis] - origin[axis]) * inverse, 0.0f), Axis_Max(range.bits[axis]));
+    values[axis] = (uint32_t)lrintf(steps);
+  }
+}
+
+Vec3 Quant_Decode_Position(const Quant_Range &range, const uint32_t values[3])
+{
+  return {range.origin.x + (float)values[0] * range.step, range.origin.y + (float)values[1] * range.step,
+          range.origin.z + (float)values[2] * range.step};
+}
+
+void Quant_Encode_Positions(const Quant_Range &range, const Vec3 *positions, int count, uint32_t *values)
+{
+  int i = 0;
+#ifdef QUANT_SSE
+  // Four positions are three registers of floats, their axes rotate: x y z x, y z x y, z x y z
+  const float *in = &positions[0].x;
+  const float origin[3] = {range.origin.x, range.origin.y, range.origin.z};
+  const float top[3] = {Axis_Max(range.bits[0]), Axis_Max(range.bits[1]), Axis_Max(range.bits[2])};
+  __m128 origins[3];
+  __m128 tops[3];
+  for (int r = 0; r < 3; r++)
+  {
+    origins[r] = _mm_setr_ps(origin[r % 3], origin[(r + 1) % 3], origin[(r + 2) % 3], origin[r % 3]);
+    tops[r] = _mm_setr_ps(top[r % 3], top[(r + 1) % 3], top[(r + 2) % 3], top[r % 3]);
+  }
+  const __m128 inverse = _mm_set1_ps(1.0f / range.step);
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      __m128 steps = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + i * 3 + r * 4), origins[r]), inverse);
+      steps = _mm_min_ps(_mm_max_ps(steps, zero), tops[r]);
+      _mm_storeu_si128((__m128i *)(values + i * 3 + r * 4), _mm_cvtps_epi32(steps));
+    }
+  }
+#endif
+  for (; i < count; i++)
+    Quant_Encode_Position(range, positions[i], values + i * 3);
+}
+
+void Quant_Decode_Positions(const Quant_Range &range, const uint32_t *values, int count, Vec3 *positions)
+{
+  int i = 0;
+#ifdef QUANT_SSE
+  float *out = &positions[0].x;
+  const float origin[3] = {range.origin.x, range.origin.y, range.origin.z};
+  __m128 origins[3];
+  for (int r = 0; r < 3; r++)
+    origins[r] = _mm_setr_ps(origin[r % 3], origin[(r + 1) % 3], origin[(r + 2) % 3], origin[r % 3]);
+  const __m128 step = _mm_set1_ps(range.step);
+  for (; i + 4 <= count; i += 4)
+  {
+    for (int r = 0; r < 3; r++)
+    {
+      __m128 steps = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(values + i * 3 + r * 4)));
+      _mm_storeu_ps(out + i * 3 + r * 4, _mm_add_ps(origins[r], _mm_mul_ps(steps, step)));
+    }
+  }
+#endif
+  for (; i < count; i++)
+    positions[i] = Quant_Decode_Position(range, values + i * 3);
+}
+
+static Vec4 Quat_Multiply(Vec4 a, Vec4 b)
+{
+  return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y, a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w, a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+Vec4 Quant_Euler(Vec3 degrees)
+{
+  // The matrices of x, y and z are multiplied in that order
+  const float half = PI / 360.0f;
+  Vec4 x = {sinf(degrees.x * half), 0.0f, 0.0f, cosf(degrees.x * half)};
+  Vec4 y = {0.0f, sinf(degrees.y * half), 0.0f, cosf(degrees.y * half)};
+  Vec4 z = {0.0f, 0.0f, sinf(degrees.z * half), cosf(degrees.z * half)};
+  return Quat_Multiply(Quat_Multiply(x, y), z);
+}
+
+Vec3 Quant_Rotate(Vec4 rotation, Vec3 point)
+{
+  Vec4 rotated = Quat_Multiply(Quat_Multiply(rotation, {point.x, point.y, point.z, 0.0f}),
+                               {-rotation.x, -rotation.y, -rotation.z, rotation.w});
+  return {rotated.x, rotated.y, rotated.z};
+}
+
+static uint32_t Quat_Component(float value)
+{
+  return (uint32_t)lrintf(std::min(std::max(value * k_QuatScale + k_QuatOffset, 0.0f), (float)QUANT_QUAT_MAX));
+}
+
+static float Quat_Value(uint32_t component)
+{
+  return ((float)component - k_QuatOffset) * k_QuatInverse;
+}
+
+uint32_t Quant_Pack_Quat(Vec4 rotation)
+{
+  const float q[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+  int largest = 0;
+  for (int i = 1; i < 4; i++)
+  {
+    if (fabsf(q[i]) > fabsf(q[largest]))
+      largest = i;
+  }
+
+  uint32_t packed = (uint32_t)largest;
+  for (int i = 0; i < 4; i++)
+  {
+    if (i != largest)
+      packed = (packed << QUANT_QUAT_BITS) | Quat_Component(q[largest] < 0.0f ? -q[i] : q[i]);
+  }
+  return packed;
+}
+
+Vec4 Quant_Unpack_Quat(uint32_t packed)
+{
+  int largest = (int)(packed >> (3 * QUANT_QUAT_BITS));
+  float a = Quat_Value((packed >> (2 * QUANT_QUAT_BITS)) & QUANT_QUAT_MAX);
+  float b = Quat_Value((packed >> QUANT_QUAT_BITS) & QUANT_QUAT_MAX);
+  float c = Quat_Value(packed & QUANT_QUAT_MAX);
+  float d = sqrtf(std::max(1.0f - (a * a + b * b + c * c), 0.0f));
+
+  // The largest one goes back between the other three
+  switch (largest)
+  {
+  case 0:
+    return {d, a, b, c};
+  case 1:
+    return {a, d, b, c};
+  case 2:
+    return {a, b, d, c};
+  default:
+    return {a, b, c, d};
+  }
+}
+
+#ifdef QUANT_SSE
+// Takes a where the mask is set and b elsewhere
+static __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+void Quant_Encode_Quats(const Vec4 *rotations, int count, uint32_t *packed)
+{
+  int i = 0;
+#ifdef QUANT_SSE
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 scale = _mm_set1_ps(k_QuatScale);
+  const __m128 offset = _mm_set1_ps(k_QuatOffset);
+  const __m128 top = _mm_set1_ps((float)QUANT_QUAT_MAX);
+  const __m128 zero = _mm_setzero_ps();
+  const float *in = &rotations[0].x;
+  for (; i + 4 <= count; i += 4)
+  {
+    // Four quaternions become a register per component
+    __m128 x = _mm_loadu_ps(in + i * 4);
+    __m128 y = _mm_loadu_ps(in + i * 4 + 4);
+    __m128 z = _mm_loadu_ps(in + i * 4 + 8);
+    __m128 w = _mm_loadu_ps(in + i * 4 + 12);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    // The first largest one, as Quant_Pack_Quat finds it
+    __m128 best = _mm_andnot_ps(sign, x);
+    __m128 value = x;
+    __m128i largest = _mm_setzero_si128();
+    const __m128 components[3] = {y, z, w};
+    for (int c = 0; c < 3; c++)
+    {
+      __m128 magnitude = _mm_andnot_ps(sign, components[c]);
+      __m128 greater = _mm_cmpgt_ps(magnitude, best);
+      best = Select(greater, magnitude, best);
+      value = Select(greater, components[c], value);
+      largest = Select(_mm_castps_si128(greater), _mm_set1_epi32(c + 1), largest);
+    }
+    __m128 flip = _mm_and_ps(_mm_cmplt_ps(value, zero), sign);
+
+    // The other three in order: y z w, x z w, x y w or x y z
+    __m128 first = Select(_mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128())), y, x);
+    __m128 second = Select(_mm_castsi128_ps(_mm_cmplt_epi32(largest, _mm_set1_epi32(2))), z, y);
+    __m128 third = Select(_mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3))), z, w);
+    __m128i bits = largest;
+    for (__m128 component : {first, second, third})
+    {
+      __m128 steps = _mm_add_ps(_mm_mul_ps(_mm_xor_ps(component, flip), scale), offset);
+      steps = _mm_min_ps(_mm_max_ps(steps, zero), top);
+      bits = _mm_or_si128(_mm_slli_epi32(bits, QUANT_QUAT_BITS), _mm_cvtps_epi32(steps));
+    }
+    _mm_storeu_si128((__m128i *)(packed + i), bits);
+  }
+#endif
+  for (; i < count; i++)
+    packed[i] = Quant_Pack_Quat(rotations[i]);
+}
+
+void Quant_Decode_Quats(const uint32_t *packed, int count, Vec4 *rotations)
+{
+  int i = 0;
+#ifdef QUANT_SSE
+  const __m128i mask = _mm_set1_epi32(QUANT_QUAT_MAX);
+  const __m128 offset = _mm_set1_ps(k_QuatOffset);
+  const __m128 inverse = _mm_set1_ps(k_QuatInverse);
+  const __m128 one = _mm_set1_ps(1.0f);
+  float *out = &rotations[0].x;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128i bits = _mm_loadu_si128((const __m128i *)(packed + i));
+    __m128i largest = _mm_srli_epi32(bits, 3 * QUANT_QUAT_BITS);
+    __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bits, 2 * QUANT_QUAT_BITS), mask)), offset), inverse);
+    __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bits, QUANT_QUAT_BITS), mask)), offset), inverse);
+    __m128 c = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(bits, mask)), offset), inverse);
+    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+    __m128 d = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, sum), _mm_setzero_ps()));
+
+    // The largest one goes back between the other three, as Quant_Unpack_Quat puts it
+    __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+    __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(1)));
+    __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(2)));
+    __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3)));
+    __m128 x = Select(is0, d, a);
+    __m128 y = Select(is0, a, Select(is1, d, b));
+    __m128 z = Select(_mm_or_ps(is0, is1), b, Select(is2, d, c));
+    __m128 w = Select(is3, d, c);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(out + i * 4, x);
+    _mm_storeu_ps(out + i * 4 + 4, y);
+    _mm_storeu_ps(out + i * 4 + 8, z);
+    _mm_storeu_ps(out + i * 4 + 12, w);
+  }
+#endif
+  for (; i < count; i++)
+    rotations[i] = Quant_Unpack_Quat(packed[i]);
+}
+
+Quant_Bits_Writer::Quant_Bits_Writer()
+{
+  m_pending = 0;
+  m_count = 0;
+}
+
+void Quant_Bits_Writer::write(uint32_t value, int bits)
+{
+  // The bits pending are less than 32, the value fits with them in 64
+  m_pending |= (uint64_t)(value & Mask(bits)) << m_count;
+  m_count += bits;
+  if (m_count >= 32)
+  {
+    uint32_t word = (uint32_t)m_pending;
+    uint8_t bytes[4] = {(uint8_t)word, (uint8_t)(word >> 8), (uint8_t)(word >> 16), (uint8_t)(word >> 24)};
+    m_bytes.insert(m_bytes.end(), bytes, bytes + 4);
+    m_pending >>= 32;
+    m_count -= 32;
+  }
+}
+
+void Quant_Bits_Writer::f32(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  write(bits, 32);
+}
+
+void Quant_Bits_Writer::flush()
+{
+  for (; m_count > 0; m_count -= 8)
+  {
+    m_bytes.push_back((uint8_t)m_pending);
+    m_pending >>= 8;
+  }
+  m_pending = 0;
+  m_count = 0;
+}
+
+const std::vector<uint8_t> &Quant_Bits_Writer::bytes()
+{
+  return m_bytes;
+}
+
+void Quant_Bits_Writer::clear()
+{
+  m_bytes.clear();
+  m_pending = 0;
+  m_count = 0;
+}
+
+uint32_t Quant_Bits_Reader::read(int bits)
+{
+  // Whole words while they are there, the bytes of the end one by one
+  if (count < bits && count <= 32 && offset + 4 <= size)
+  {
+    const uint8_t *bytes = data + offset;
+    uint32_t word = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    pending |= (uint64_t)word << count;
+    count += 32;
+    offset += 4;
+  }
+  while (count < bits && offset < size)
+  {
+    pending |= (uint64_t)data[offset++] << count;
+    count += 8;
+  }
+  if (count < bits)
+  {
+    ok = false;
+    return 0;
+  }
+
+  uint32_t value = (uint32_t)pending & Mask(bits);
+  pending >>= bits;
+  count -= bits;
+  return value;
+}
+
+float Quant_Bits_Reader::f32()
+{
+  uint32_t bits = read(32);
+  float value;
+  memcpy(&value, &bits, 4);
+  return value;
+}
+
+int Quant_Write_Transforms(Quant_Bits_Writer &writer, const Vec3 *positions, const Vec4 *rotations, int count, float step)
+{
+  Quant_Range range;
+  Quant_Fit(positions, count, step, range);
+  std::vector<uint32_t> values((size_t)count * 3);
+  std::vector<uint32_t> packed(count);
+  Quant_Encode_Positions(range, positions, count, values.data());
+  Quant_Encode_Quats(rotations, count, packed.data());
+
+  writer.write((uint32_t)count, 32);
+  writer.f32(range.origin.x);
+  writer.f32(range.origin.y);
+  writer.f32(range.origin.z);
+  writer.f32(range.step);
+  for (int axis = 0; axis < 3; axis++)
+    writer.write((uint32_t)range.bits[axis], 5);
+  for (int i = 0; i < count; i++)
+  {
+    for (int axis = 0; axis < 3; axis++)
+      writer.write(values[(size_t)i * 3 + axis], range.bits[axis]);
+    writer.write(packed[i], 32);
+  }
+  writer.flush();
+  return range.bits[0] + range.bits[1] + range.bits[2] + 32;
+}
+
+int Quant_Read_Transforms(Quant_Bits_Reader &reader, std::vector<Vec3> &positions, std::vector<Vec4> &rotations)
+{
+  Quant_Range range;
+  uint32_t count = reader.read(32);
+  range.origin.x = reader.f32();
+  range.origin.y = reader.f32();
+  range.origin.z = reader.f32();
+  range.step = reader.f32();
+  for (int axis = 0; axis < 3; axis++)
+    range.bits[axis] = (int)reader.read(5);
+
+  // A corrupted count can't make the vectors grow past what the bytes hold
+  int entity_bits = range.bits[0] + range.bits[1] + range.bits[2] + 32;
+  uint64_t left = (uint64_t)(reader.size - reader.offset) * 8 + reader.count;
+  if (!reader.ok || range.bits[0] > QUANT_AXIS_BITS || range.bits[1] > QUANT_AXIS_BITS || range.bits[2] > QUANT_AXIS_BITS ||
+      !(range.step > 0.0f) || (uint64_t)count * entity_bits > left)
+    return 1;
+
+  std::vector<uint32_t> values((size_t)count * 3);
+  std::vector<uint32_t> packed(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    for (int axis = 0; axis < 3; axis++)
+      values[(size_t)i * 3 + axis] = reader.read(range.bits[axis]);
+    packed[i] = reader.read(32);
+  }
+  positions.resize(count);
+  rotations.resize(count);
+  Quant_Decode_Positions(range, values.data(), (int)count, positions.data());
+  Quant_Decode_Quats(packed.data(), (int)count, rotations.data());
+  return reader.ok ? 0 : 1;
+}
+
+// The seconds a function takes, the best of rounds
+static double Best_Time(int rounds, const std::function<void()> &work)
+{
+  double best = 1e30;
+  for (int r = 0; r < rounds; r++)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    work();
+    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+static int Quantize_Run(int entities, int rounds, std::string &row)
+{
+  // Positions in a box of the size of a generated scene, rotations as the entities have them
+  const float step = 1.0f / 64.0f;
+  std::mt19937 random(entities);
+  std::uniform_real_distribution<float> coordinate(-4000.0f, 4000.0f);
+  std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+  std::vector<Vec3> positions(entities);
+  std::vector<Vec3> eulers(entities);
+  std::vector<Vec4> rotations(entities);
+  for (int i = 0; i < entities; i++)
+  {
+    positions[i] = {coordinate(random) + 600.0f, coordinate(random) + 420.0f, coordinate(random) * 0.25f};
+    eulers[i] = {angle(random), angle(random), angle(random)};
+    rotations[i] = Quant_Euler(eulers[i]);
+  }
+
+  Quant_Range range;
+  if (Quant_Fit(positions.data(), entities, step, range) != 0)
+  {
+    std::cout << "ERROR: The positions don't fit the range" << std::endl;
+    return 1;
+  }
+
+  // The references, then the SSE2 functions that must give the same values
+  std::vector<uint32_t> values((size_t)entities * 3);
+  std::vector<uint32_t> simd_values((size_t)entities * 3);
+  std::vector<uint32_t> packed(entities);
+  std::vector<uint32_t> simd_packed(entities);
+  std::vector<Vec3> decoded(entities);
+  std::vector<Vec3> simd_decoded(entities);
+  std::vector<Vec4> unpacked(entities);
+  std::vector<Vec4> simd_unpacked(entities);
+  double encode = Best_Time(rounds, [&]()
+                            {
+                              for (int i = 0; i < entities; i++)
+                              {
+                                Quant_Encode_Position(range, positions[i], &values[(size_t)i * 3]);
+                                packed[i] = Quant_Pack_Quat(rotations[i]);
+                              } });
+  double decode = Best_Time(rounds, [&]()
+                            {
+                              for (int i = 0; i < entities; i++)
+                              {
+                                decoded[i] = Quant_Decode_Position(range, &values[(size_t)i * 3]);
+                                unpacked[i] = Quant_Unpack_Quat(packed[i]);
+                              } });
+  double simd_encode = Best_Time(rounds, [&]()
+                                 {
+                                   Quant_Encode_Positions(range, positions.data(), entities, simd_values.data());
+                                   Quant_Encode_Quats(rotations.data(), entities, simd_packed.data()); });
+  double simd_decode = Best_Time(rounds, [&]()
+                                 {
+                                   Quant_Decode_Positions(range, simd_values.data(), entities, simd_decoded.data());
+                                   Quant_Decode_Quats(simd_packed.data(), entities, simd_unpacked.data()); });
+  if (values != simd_values || packed != simd_packed ||
+      memcmp(decoded.data(), simd_decoded.data(), decoded.size() * sizeof(Vec3)) != 0 ||
+      memcmp(unpacked.data(), simd_unpacked.data(), unpacked.size() * sizeof(Vec4)) != 0)
+  {
+    std::cout << "ERROR: The SSE2 quantization doesn't give the reference values" << std::endl;
+    return 1;
+  }
+
+  // The bit packing gives back what it was given
+  Quant_Bits_Writer writer;
+  std::vector<Vec3> read_positions;
+  std::vector<Vec4> read_rotations;
+  int entity_bits = 0;
+  double write = Best_Time(rounds, [&]()
+                           {
+                             writer.clear();
+                             entity_bits = Quant_Write_Transforms(writer, positions.data(), rotations.data(), entities, step); });
+  int read_ret = 0;
+  double read = Best_Time(rounds, [&]()
+                          {
+                            Quant_Bits_Reader reader = {writer.bytes().data(), (uint32_t)writer.bytes().size(), 0, 0, 0, true};
+                            read_ret = Quant_Read_Transforms(reader, read_positions, read_rotations); });
+  if (read_ret != 0 || memcmp(read_positions.data(), decoded.data(), decoded.size() * sizeof(Vec3)) != 0 ||
+      memcmp(read_rotations.data(), unpacked.data(), unpacked.size() * sizeof(Vec4)) != 0)
+  {
+    std::cout << "ERROR: The bit packing doesn't give back the transforms" << std::endl;
+    return 1;
+  }
+
+  // Cut bytes are refused, not read past their end
+  Quant_Bits_Reader cut = {writer.bytes().data(), (uint32_t)writer.bytes().size() - 1, 0, 0, 0, true};
+  if (Quant_Read_Transforms(cut, read_positions, read_rotations) == 0)
+  {
+    std::cout << "ERROR: The bit packing reads transforms cut short" << std::endl;
+    return 1;
+  }
+
+  // Half a step per axis, plus the rounding of a float as far as the positions go
+  double position_error = 0.0;
+  double position_bound = 0.0;
+  for (int i = 0; i < entities; i++)
+  {
+    const float original[3] = {positions[i].x, positions[i].y, positions[i].z};
+    const float restored[3] = {decoded[i].x, decoded[i].y, decoded[i].z};
+    for (int axis = 0; axis < 3; axis++)
+    {
+      position_error = std::max(position_error, fabs((double)restored[axis] - original[axis]));
+      position_bound = std::max(position_bound, step * 0.5 + fabs((double)original[axis]) * 4.0 * FLT_EPSILON);
+    }
+  }
+
+  // Three components off by half a step move the largest one up to 3 times as much: a chord of sqrt(12)
+  // half steps on the unit sphere, a rotation of 4 asin(chord / 2). The entities are checked against their own angles
+  double half_step = 0.5 / k_QuatScale;
+  double angle_bound = 4.0 * asin(std::min(sqrt(12.0) * half_step * 0.5, 1.0)) + 1e-5;
+  double angle_error = 0.0;
+  double point_error = 0.0;
+  const Vec3 probe = {0.48f, -0.6f, 0.64f};
+  for (int i = 0; i < entities; i++)
+  {
+    const Vec4 &q = rotations[i];
+    const Vec4 &r = unpacked[i];
+    double dot = fabs((double)q.x * r.x + (double)q.y * r.y + (double)q.z * r.z + (double)q.w * r.w);
+    angle_error = std::max(angle_error, 2.0 * acos(std::min(dot, 1.0)));
+
+    // The entities of a sample, their own rotation as the reference
+    if (i % 16 == 0)
+    {
+      Vec3 expected = MathUtils::Rotate_Point_3D(eulers[i], probe);
+      Vec3 rotated = Quant_Rotate(r, probe);
+      point_error = std::max(point_error, (double)(rotated - expected).Magnitude());
+    }
+  }
+  if (position_error > position_bound || angle_error > angle_bound || point_error > angle_bound + 1e-4)
+  {
+    printf("ERROR: Quantization error over its bound: position %g of %g, angle %g of %g rad, point %g\n", position_error,
+           position_bound, angle_error, angle_bound, point_error);
+    return 1;
+  }
+
+  char line[256];
+  snprintf(line, sizeof(line), "%9d | %5d | %5.1f | %8.2f | %8.2f | %8.2f | %8.2f | %9.2f | %8.2f | %9.6f | %9.4f\n", entities,
+           entity_bits, (double)writer.bytes().size() / entities, entities / encode / 1e6, entities / simd_encode / 1e6,
+           entities / decode / 1e6, entities / simd_decode / 1e6, entities / write / 1e6, entities / read / 1e6,
+           position_error, angle_error * 180.0 / PI);
+  row = line;
+  return 0;
+}
+
+int Quantize_Benchmark(int entities, int rounds)
+{
+  std::vector<int> runs;
+  if (entities > 0)
+    runs.push_back(entities);
+  else
+    runs = {10000, 100000, 1000000};
+  rounds = std::max(rounds, 1);
+
+#ifdef QUANT_SSE
+  const char *lanes = "SSE2";
+#else
+  const char *lanes = "scalar, no SSE2";
+#endif
+  printf("Quantized transforms, %d rounds (best), %s; raw floats are %d bytes per entity\n", rounds, lanes,
+         (int)(sizeof(Vec3) + sizeof(Vec4)));
+  printf(" Entities |  Bits | Bytes | Enc M/s  | SIMD M/s | Dec M/s  | SIMD M/s | Write M/s | Read M/s | Pos error | Deg error\n");
+  for (int n : runs)
+  {
+    std::string row;
+    if (Quantize_Run(n, rounds, row) != 0)
+      return 1;
+    printf("%s", row.c_str());
+  }
+  return 0;
+}
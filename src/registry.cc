@@ -0,0 +1,1113 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <registry.h>
+#include <obj_stream.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// A slot fits every entity type
+static const size_t k_SlotSize = (std::max(std::max(sizeof(Sphere), sizeof(Cube)), sizeof(Figure)) + 15) & ~(size_t)15;
+
+// Mass of a body, proportional to its volume
+static float Body_Mass(Vec3 scale)
+{
+  return fabsf(scale.x * scale.y * scale.z);
+}
+
+// The biggest axis of a scale, the one that bounds the mesh
+static float Max_Scale(Vec3 scale)
+{
+  return std::max(std::max(fabsf(scale.x), fabsf(scale.y)), fabsf(scale.z));
+}
+
+// A flag indicating whether an orbit moves its entity, the center of a child is relative to its parent and can be 0
+static bool Orbits(const Entity_Orbit &orbit, bool child)
+{
+  return (child || (orbit.center.x + orbit.center.y + orbit.center.z) != 0) && orbit.vel != 0.0f &&
+         (orbit.angle.x != 0.0f || orbit.angle.y != 0.0f || orbit.angle.z != 0.0f);
+}
+
+// Position after an orbit, the same rotation Entity::orbit applies to the points scaled by the steps
+static Vec3 Orbit_Position(Vec3 position, const Entity_Orbit &orbit, float steps)
+{
+  Vec3 degrees = orbit.angle * (orbit.vel * steps);
+  Mat4 model = Mat4::Identity();
+  if (degrees.x != 0)
+    model *= Mat4::RotateX((degrees.x * PI) / 180);
+  if (degrees.y != 0)
+    model *= Mat4::RotateY((degrees.y * PI) / 180);
+  if (degrees.z != 0)
+    model *= Mat4::RotateZ((degrees.z * PI) / 180);
+
+  return MathUtils::Mat4TransformVec3(model, position - orbit.center) + orbit.center;
+}
+
+// Grows a component array, the components are plain data
+template <typename T>
+static void Resize(T *&array, int size)
+{
+  array = (T *)realloc((void *)array, size * sizeof(T));
+}
+
+Entity_Pool::Entity_Pool()
+{
+  blocks_ = nullptr;
+  nBlocks_ = 0;
+  free_ = nullptr;
+  nFree_ = 0;
+}
+
+void *Entity_Pool::allocate()
+{
+  if (nFree_ == 0)
+  {
+    // A new block, its slots go to the free list in reverse so they are used in order
+    Resize(blocks_, nBlocks_ + 1);
+    Resize(free_, (nBlocks_ + 1) * ENTITY_POOL_BLOCK);
+    char *block = (char *)malloc(k_SlotSize * ENTITY_POOL_BLOCK);
+    blocks_[nBlocks_++] = block;
+    for (int i = ENTITY_POOL_BLOCK - 1; i >= 0; i--)
+      free_[nFree_++] = block + i * k_SlotSize;
+  }
+
+  return free_[--nFree_];
+}
+
+void Entity_Pool::release(void *slot)
+{
+  free_[nFree_++] = slot;
+}
+
+int Entity_Pool::capacity()
+{
+  return nBlocks_ * ENTITY_POOL_BLOCK;
+}
+
+Entity_Pool::~Entity_Pool()
+{
+  for (int i = 0; i < nBlocks_; i++)
+    DESTROY(blocks_[i]);
+  DESTROY(blocks_);
+  DESTROY(free_);
+}
+
+Registry::Registry()
+{
+  count_ = 0;
+  capacity_ = 0;
+  types_ = nullptr;
+  meshes_ = nullptr;
+  positions_ = nullptr;
+  scales_ = nullptr;
+  orbits_ = nullptr;
+  materials_ = nullptr;
+  elements_ = nullptr;
+  rails_ = nullptr;
+  handles_ = nullptr;
+  proxies_ = nullptr;
+  radii_ = nullptr;
+  solid_ = nullptr;
+  shattered_ = nullptr;
+  parents_ = nullptr;
+  children_ = nullptr;
+  locals_ = nullptr;
+  changed_ = nullptr;
+  order_ = nullptr;
+  orderParents_ = nullptr;
+  ordered_ = true;
+  pass_ = 0;
+  sparse_ = nullptr;
+  generations_ = nullptr;
+  nSparse_ = 0;
+  free_ = nullptr;
+  nFree_ = 0;
+  simulating_ = false;
+  for (int i = 0; i < 2; i++)
+    states_[i] = {nullptr, nullptr, 0.0, 0.0f, Sim_Clock::settings_.step, 0};
+  front_ = 0;
+  pending_ = false;
+  jobElapsed_ = 0.0f;
+  busy_ = false;
+  stopping_ = false;
+  visible_ = nullptr;
+  visiblePositions_ = nullptr;
+  visibleScales_ = nullptr;
+  nVisible_ = 0;
+  nMerges_ = 0;
+}
+
+void Registry::reserve(int capacity)
+{
+  if (capacity <= capacity_)
+    return;
+
+  wait();
+  capacity_ = std::min(capacity, REGISTRY_SLOT_MASK + 1);
+  Resize(types_, capacity_);
+  Resize(meshes_, capacity_);
+  Resize(positions_, capacity_);
+  Resize(scales_, capacity_);
+  Resize(orbits_, capacity_);
+  Resize(materials_, capacity_);
+  Resize(elements_, capacity_);
+  Resize(rails_, capacity_);
+  Resize(handles_, capacity_);
+  Resize(proxies_, capacity_);
+  Resize(radii_, capacity_);
+  Resize(solid_, capacity_);
+  Resize(shattered_, capacity_);
+  Resize(parents_, capacity_);
+  Resize(children_, capacity_);
+  Resize(locals_, capacity_);
+  Resize(changed_, capacity_);
+  Resize(order_, capacity_);
+  Resize(orderParents_, capacity_);
+  Resize(visible_, capacity_);
+  Resize(visiblePositions_, capacity_);
+  Resize(visibleScales_, capacity_);
+  Resize(sparse_, capacity_);
+  Resize(generations_, capacity_);
+  Resize(free_, capacity_);
+  for (int i = 0; i < 2; i++)
+  {
+    Resize(states_[i].previous, capacity_);
+    Resize(states_[i].current, capacity_);
+  }
+  physics_.reserve(capacity_);
+}
+
+int Registry::add(int type, Entity &&entity)
+{
+  wait();
+  if (count_ == capacity_)
+    reserve(std::max(16, capacity_ * 2));
+  if (count_ == capacity_)
+  {
+    std::cout << "ERROR: Registry full, " << count_ << " entities" << std::endl;
+    return -1;
+  }
+
+  int slot;
+  if (nFree_ > 0)
+  {
+    slot = free_[--nFree_];
+  }
+  else
+  {
+    slot = nSparse_++;
+    generations_[slot] = 0;
+  }
+
+  // The entity is moved to the pool, its buffers change of owner
+  void *memory = pool_.allocate();
+  Entity *moved;
+  switch (type)
+  {
+  case typeSphere:
+    moved = new (memory) Sphere(std::move((Sphere &)entity));
+    break;
+  case typeCube:
+    moved = new (memory) Cube(std::move((Cube &)entity));
+    break;
+  case typeFigure:
+    moved = new (memory) Figure(std::move((Figure &)entity));
+    break;
+  default:
+    moved = new (memory) Entity(std::move(entity));
+    break;
+  }
+
+  int index = count_++;
+  sparse_[slot] = index;
+  handles_[index] = slot | (generations_[slot] << REGISTRY_SLOT_BITS);
+  types_[index] = type;
+  meshes_[index] = moved;
+  positions_[index] = moved->mov_;
+  scales_[index] = moved->getScale();
+  orbits_[index] = moved->getOrbit();
+  materials_[index] = moved->getMaterial();
+  rails_[index] = false;
+  for (int i = 0; i < 2; i++)
+  {
+    states_[i].previous[index] = moved->mov_;
+    states_[i].current[index] = moved->mov_;
+  }
+  physics_.add(moved->mov_, {0.0f, 0.0f, 0.0f}, Body_Mass(moved->getScale()));
+
+  radii_[index] = moved->getRadius();
+  solid_[index] = !moved->isDestroying();
+  shattered_[index] = moved->isDestroying();
+  parents_[index] = -1;
+  children_[index] = 0;
+  locals_[index] = moved->mov_;
+  changed_[index] = -1;
+  ordered_ = false;
+  proxies_[index] = bvh_.insert(moved->mov_, radii_[index], handles_[index]);
+
+  // Added during the simulation, it starts orbiting the heaviest body
+  if (simulating_)
+  {
+    int primary = 0;
+    for (int i = 1; i < count_; i++)
+    {
+      if (physics_.mass(i) > physics_.mass(primary))
+        primary = i;
+    }
+    physics_.set(index, moved->mov_, orbitVelocity(index, primary), physics_.mass(index));
+  }
+
+  return handles_[index];
+}
+
+void Registry::destroy(int index)
+{
+  Entity *entity = meshes_[index];
+  switch (types_[index])
+  {
+  case typeSphere:
+    ((Sphere *)entity)->~Sphere();
+    break;
+  case typeCube:
+    ((Cube *)entity)->~Cube();
+    break;
+  case typeFigure:
+    ((Figure *)entity)->~Figure();
+    break;
+  default:
+    entity->~Entity();
+    break;
+  }
+  pool_.release(entity);
+}
+
+void Registry::remove(int handle)
+{
+  if (!valid(handle))
+    return;
+
+  wait();
+  int slot = handle & REGISTRY_SLOT_MASK;
+  int index = sparse_[slot];
+
+  // The children are adopted by the parent of the entity
+  if (children_[index] > 0)
+  {
+    for (int i = 0; i < count_; i++)
+    {
+      if (parents_[i] == handle)
+        attach(i, parents_[index]);
+    }
+  }
+  attach(index, -1);
+  ordered_ = false;
+
+  destroy(index);
+  bvh_.remove(proxies_[index]);
+
+  // The last entity fills the hole
+  int last = count_ - 1;
+  if (index != last)
+  {
+    types_[index] = types_[last];
+    meshes_[index] = meshes_[last];
+    positions_[index] = positions_[last];
+    scales_[index] = scales_[last];
+    orbits_[index] = orbits_[last];
+    materials_[index] = materials_[last];
+    elements_[index] = elements_[last];
+    rails_[index] = rails_[last];
+    proxies_[index] = proxies_[last];
+    radii_[index] = radii_[last];
+    solid_[index] = solid_[last];
+    shattered_[index] = shattered_[last];
+    parents_[index] = parents_[last];
+    children_[index] = children_[last];
+    locals_[index] = locals_[last];
+    changed_[index] = changed_[last];
+    for (int i = 0; i < 2; i++)
+    {
+      states_[i].previous[index] = states_[i].previous[last];
+      states_[i].current[index] = states_[i].current[last];
+    }
+    handles_[index] = handles_[last];
+    sparse_[handles_[index] & REGISTRY_SLOT_MASK] = index;
+  }
+  count_--;
+  physics_.remove(index);
+
+  // The old handles of the slot stop being valid
+  sparse_[slot] = -1;
+  generations_[slot] = (generations_[slot] + 1) & REGISTRY_GENERATION_MASK;
+  free_[nFree_++] = slot;
+}
+
+void Registry::clear()
+{
+  wait();
+  for (int i = 0; i < count_; i++)
+  {
+    int slot = handles_[i] & REGISTRY_SLOT_MASK;
+    destroy(i);
+    sparse_[slot] = -1;
+    generations_[slot] = (generations_[slot] + 1) & REGISTRY_GENERATION_MASK;
+  }
+  count_ = 0;
+  nVisible_ = 0;
+  ordered_ = true;
+  merges_.clear();
+  particles_.clear();
+  physics_.clear();
+  bvh_.clear();
+
+  // Every slot is free, the generations are kept
+  nFree_ = 0;
+  for (int slot = nSparse_ - 1; slot >= 0; slot--)
+    free_[nFree_++] = slot;
+}
+
+bool Registry::valid(int handle)
+{
+  if (handle < 0)
+    return false;
+
+  int slot = handle & REGISTRY_SLOT_MASK;
+  return slot < nSparse_ && sparse_[slot] >= 0 && generations_[slot] == (handle >> REGISTRY_SLOT_BITS);
+}
+
+int Registry::count()
+{
+  return count_;
+}
+
+int Registry::handle(int index)
+{
+  return handles_[index];
+}
+
+int Registry::index(int handle)
+{
+  return valid(handle) ? sparse_[handle & REGISTRY_SLOT_MASK] : -1;
+}
+
+int Registry::type(int handle)
+{
+  return valid(handle) ? types_[sparse_[handle & REGISTRY_SLOT_MASK]] : notSet;
+}
+
+Entity *Registry::entity(int handle)
+{
+  return valid(handle) ? meshes_[sparse_[handle & REGISTRY_SLOT_MASK]] : nullptr;
+}
+
+Entity_Orbit &Registry::orbit(int handle)
+{
+  wait();
+  return orbits_[sparse_[handle & REGISTRY_SLOT_MASK]];
+}
+
+Entity_Material &Registry::material(int handle)
+{
+  return materials_[sparse_[handle & REGISTRY_SLOT_MASK]];
+}
+
+void Registry::setRails(int handle, const Orbital_Elements &elements)
+{
+  wait();
+  int index = sparse_[handle & REGISTRY_SLOT_MASK];
+  elements_[index] = elements;
+  rails_[index] = true;
+}
+
+void Registry::clearRails(int handle)
+{
+  wait();
+  rails_[sparse_[handle & REGISTRY_SLOT_MASK]] = false;
+}
+
+bool Registry::onRails(int handle)
+{
+  return rails_[sparse_[handle & REGISTRY_SLOT_MASK]];
+}
+
+Orbital_Elements &Registry::elements(int handle)
+{
+  wait();
+  return elements_[sparse_[handle & REGISTRY_SLOT_MASK]];
+}
+
+int Registry::setParent(int handle, int parent)
+{
+  wait();
+  if (!valid(handle) || (parent >= 0 && !valid(parent)))
+    return 1;
+
+  // An entity can't descend from itself
+  for (int ancestor = parent; ancestor >= 0; ancestor = parents_[sparse_[ancestor & REGISTRY_SLOT_MASK]])
+  {
+    if (ancestor == handle)
+    {
+      std::cout << "ERROR: Entity " << handle << " can't be a child of its descendant " << parent << std::endl;
+      return 1;
+    }
+  }
+
+  attach(sparse_[handle & REGISTRY_SLOT_MASK], parent);
+  ordered_ = false;
+  return 0;
+}
+
+int Registry::parent(int handle)
+{
+  return parents_[sparse_[handle & REGISTRY_SLOT_MASK]];
+}
+
+Vec3 Registry::local(int handle)
+{
+  wait();
+  return locals_[sparse_[handle & REGISTRY_SLOT_MASK]];
+}
+
+void Registry::attach(int index, int parent)
+{
+  Vec3 *current = states_[front_].current;
+  Vec3 from = {0.0f, 0.0f, 0.0f};
+  Vec3 to = {0.0f, 0.0f, 0.0f};
+  if (parents_[index] >= 0)
+  {
+    int old = sparse_[parents_[index] & REGISTRY_SLOT_MASK];
+    from = current[old];
+    children_[old]--;
+  }
+  if (parent >= 0)
+  {
+    int next = sparse_[parent & REGISTRY_SLOT_MASK];
+    to = current[next];
+    children_[next]++;
+  }
+
+  // The relative positions change of frame, the world ones stay
+  Vec3 offset = from - to;
+  locals_[index] += offset;
+  orbits_[index].center += offset;
+  elements_[index].center += offset;
+  parents_[index] = parent;
+}
+
+void Registry::sortHierarchy()
+{
+  static std::vector<int> parents;
+  static std::vector<int> depths;
+  parents.resize(count_);
+
+  // The depth of an entity is the number of its ancestors
+  int max_depth = 0;
+  for (int i = 0; i < count_; i++)
+  {
+    parents[i] = parents_[i] >= 0 ? sparse_[parents_[i] & REGISTRY_SLOT_MASK] : -1;
+    int depth = 0;
+    for (int p = parents_[i]; p >= 0; p = parents_[sparse_[p & REGISTRY_SLOT_MASK]])
+      depth++;
+    order_[i] = depth;
+    max_depth = std::max(max_depth, depth);
+  }
+
+  // Counting sort by depth, the parents are one level above their children
+  depths.assign(max_depth + 2, 0);
+  for (int i = 0; i < count_; i++)
+    depths[order_[i] + 1]++;
+  for (int d = 0; d <= max_depth; d++)
+    depths[d + 1] += depths[d];
+  for (int i = 0; i < count_; i++)
+    orderParents_[depths[order_[i]]++] = i;
+  for (int k = 0; k < count_; k++)
+  {
+    order_[k] = orderParents_[k];
+    orderParents_[k] = parents[order_[k]];
+  }
+  ordered_ = true;
+}
+
+double Registry::time()
+{
+  return states_[front_].time;
+}
+
+Sim_Clock &Registry::clock()
+{
+  wait();
+  return clock_;
+}
+
+Vec3 *Registry::positions()
+{
+  return positions_;
+}
+
+Vec3 *Registry::scales()
+{
+  return scales_;
+}
+
+float *Registry::radii()
+{
+  return radii_;
+}
+
+Physics &Registry::physics()
+{
+  wait();
+  return physics_;
+}
+
+Vec3 Registry::orbitVelocity(int index, int primary)
+{
+  if (index == primary)
+    return {0.0f, 0.0f, 0.0f};
+
+  Vec3 axis = orbits_[index].angle;
+  if (orbits_[index].vel == 0.0f || axis.Magnitude() == 0.0f)
+    return physics_.velocity(primary);
+
+  Vec3 radius = physics_.position(index) - physics_.position(primary);
+  float distance = radius.Magnitude();
+  Vec3 tangent = Vec3::CrossProduct(axis, radius);
+  if (distance == 0.0f || tangent.Magnitude() == 0.0f)
+    return physics_.velocity(primary);
+
+  // v = sqrt(G M / r), perpendicular to the radius and to the axis of the orbit
+  float speed = sqrtf(Physics::settings_.gravity * physics_.mass(primary) / distance);
+  return physics_.velocity(primary) + tangent * (speed / tangent.Magnitude());
+}
+
+void Registry::startPhysics()
+{
+  wait();
+  seedPhysics();
+}
+
+void Registry::seedPhysics()
+{
+  if (count_ == 0)
+    return;
+
+  Vec3 *current = states_[front_].current;
+  int primary = 0;
+  for (int i = 0; i < count_; i++)
+  {
+    // The entities being destroyed don't pull the others
+    float mass = meshes_[i]->isDestroying() ? 0.0f : Body_Mass(scales_[i]);
+    physics_.set(i, current[i], {0.0f, 0.0f, 0.0f}, mass);
+    if (physics_.mass(i) > physics_.mass(primary))
+      primary = i;
+  }
+
+  // The children orbit their parent, which has its velocity already
+  if (!ordered_)
+    sortHierarchy();
+  for (int k = 0; k < count_; k++)
+  {
+    int i = order_[k];
+    int around = orderParents_[k] >= 0 ? orderParents_[k] : primary;
+    physics_.set(i, physics_.position(i), orbitVelocity(i, around), physics_.mass(i));
+  }
+}
+
+void Registry::update()
+{
+  update(clock_.elapsed());
+}
+
+void Registry::update(float elapsed)
+{
+  // The steps of the last frame are presented now
+  wait();
+  if (pending_)
+  {
+    front_ = 1 - front_;
+    pending_ = false;
+  }
+
+  // The merges of the presented steps, the survivor grows and the other one starts its destruction
+  for (const Registry_Merge &merge : merges_)
+  {
+    Entity *survivor = entity(merge.survivor);
+    Entity *absorbed = entity(merge.absorbed);
+    if (survivor)
+    {
+      survivor->scale({merge.scale, merge.scale, merge.scale});
+      scales_[sparse_[merge.survivor & REGISTRY_SLOT_MASK]] = survivor->getScale();
+    }
+    if (absorbed && !absorbed->isDestroying())
+      absorbed->startDestroy();
+  }
+  nMerges_ += (int)merges_.size();
+  merges_.clear();
+
+  // Removing swaps in an entity that was already checked
+  for (int i = count_ - 1; i >= 0; i--)
+  {
+    if (meshes_[i]->isDestroyed())
+      remove(handles_[i]);
+  }
+
+  // The entities moved by the controls take their state and their children with them
+  Registry_State &state = states_[front_];
+  std::vector<Vec3> shifts;
+  for (int i = 0; i < count_; i++)
+  {
+    Vec3 moved = meshes_[i]->mov_ - positions_[i];
+    if (moved.x == 0.0f && moved.y == 0.0f && moved.z == 0.0f)
+      continue;
+
+    if (shifts.empty())
+      shifts.assign(count_, {0.0f, 0.0f, 0.0f});
+    shifts[i] = moved;
+    locals_[i] += moved;
+  }
+  if (!ordered_)
+    sortHierarchy();
+  for (int k = 0; k < count_ && !shifts.empty(); k++)
+  {
+    int i = order_[k];
+    if (orderParents_[k] >= 0)
+      shifts[i] += shifts[orderParents_[k]];
+    Vec3 moved = shifts[i];
+    if (moved.x == 0.0f && moved.y == 0.0f && moved.z == 0.0f)
+      continue;
+
+    state.previous[i] += moved;
+    state.current[i] += moved;
+    if (simulating_)
+      physics_.set(i, physics_.position(i) + moved, physics_.velocity(i), physics_.mass(i));
+  }
+
+  if (!Sim_Clock::settings_.threaded)
+  {
+    simulate(elapsed);
+    front_ = 1 - front_;
+  }
+  present();
+
+  // The bounds follow the presented positions, the queries of this frame see what is drawn
+  for (int i = 0; i < count_; i++)
+  {
+    Vec3 previous = positions_[i];
+    positions_[i] = meshes_[i]->mov_;
+
+    // Scaled by the controls, the sphere grows with the mesh
+    Vec3 scale = meshes_[i]->getScale();
+    float before = Max_Scale(scales_[i]);
+    if (before > 0.0f && Max_Scale(scale) != before)
+      radii_[i] *= Max_Scale(scale) / before;
+    scales_[i] = scale;
+    if (meshes_[i]->isDestroying())
+    {
+      solid_[i] = false;
+
+      // The debris leaves with the last velocity of the entity
+      if (!shattered_[i] && Particles::settings_.enabled)
+      {
+        Vec3 velocity = elapsed > 0.0f ? (positions_[i] - previous) / elapsed : Vec3{0.0f, 0.0f, 0.0f};
+        meshes_[i]->debris(particles_, velocity, materials_[i]);
+      }
+      shattered_[i] = true;
+    }
+
+    bvh_.move(proxies_[i], positions_[i], radii_[i], positions_[i] - previous);
+  }
+  bvh_.update();
+  particles_.update(elapsed);
+
+  // The steps of this frame run while it is drawn, the next update presents them
+  if (Sim_Clock::settings_.threaded)
+  {
+    if (!worker_.joinable())
+      worker_ = std::thread(&Registry::work, this);
+    {
+      std::lock_guard<std::mutex> lock(jobMutex_);
+      jobElapsed_ = elapsed;
+      busy_ = true;
+    }
+    jobStart_.notify_one();
+    pending_ = true;
+  }
+}
+
+void Registry::wait()
+{
+  std::unique_lock<std::mutex> lock(jobMutex_);
+  jobDone_.wait(lock, [this]()
+                { return !busy_; });
+}
+
+void Registry::work()
+{
+  std::unique_lock<std::mutex> lock(jobMutex_);
+  while (true)
+  {
+    jobStart_.wait(lock, [this]()
+                   { return busy_ || stopping_; });
+    if (!busy_)
+      return;
+
+    // The owner only waits for the job, the components are not touched while it runs
+    float elapsed = jobElapsed_;
+    lock.unlock();
+    simulate(elapsed);
+    lock.lock();
+    busy_ = false;
+    jobDone_.notify_all();
+  }
+}
+
+void Registry::simulate(float elapsed)
+{
+  Registry_State &from = states_[front_];
+  Registry_State &to = states_[1 - front_];
+
+  if (!Physics::settings_.enabled)
+    simulating_ = false;
+  else if (!simulating_)
+  {
+    seedPhysics();
+    simulating_ = true;
+  }
+
+  int steps = clock_.advance(elapsed);
+  float step = clock_.step();
+  double time = from.time;
+  std::copy(from.current, from.current + count_, to.current);
+  if (steps == 0)
+    std::copy(from.previous, from.previous + count_, to.previous);
+
+  for (int s = 0; s < steps; s++)
+  {
+    // Only the last two steps are interpolated
+    if (s == steps - 1)
+      std::copy(to.current, to.current + count_, to.previous);
+    time += step;
+
+    if (simulating_)
+    {
+      physics_.step(step);
+      for (int i = 0; i < count_; i++)
+        to.current[i] = physics_.position(i);
+    }
+    else
+    {
+      // Parents first, a child is moved if it orbits or if its parent moved in this pass
+      pass_++;
+      for (int k = 0; k < count_; k++)
+      {
+        int i = order_[k];
+        int parent = orderParents_[k];
+        bool orbits = rails_[i] || Orbits(orbits_[i], parent >= 0);
+        if (orbits)
+          locals_[i] = rails_[i] ? Kepler_Position(elements_[i], time) : Orbit_Position(locals_[i], orbits_[i], step * ORBIT_RATE);
+        if (!orbits && (parent < 0 || changed_[parent] != pass_))
+          continue;
+
+        to.current[i] = parent >= 0 ? to.current[parent] + locals_[i] : locals_[i];
+        changed_[i] = pass_;
+      }
+    }
+
+    if (Collider::settings_.enabled)
+      collide(to);
+  }
+
+  // The gravity moves the world positions, the relative ones follow them
+  if (simulating_ && steps > 0)
+  {
+    for (int k = 0; k < count_; k++)
+    {
+      int i = order_[k];
+      int parent = orderParents_[k];
+      locals_[i] = parent >= 0 ? to.current[i] - to.current[parent] : to.current[i];
+    }
+  }
+
+  to.time = time;
+  to.alpha = clock_.alpha();
+  to.step = step;
+  to.steps = steps;
+}
+
+void Registry::collide(Registry_State &state)
+{
+  int found = collider_.detect(state.current, radii_, solid_, count_);
+  const Collision_Pair *pairs = collider_.pairs();
+
+  for (int p = 0; p < found; p++)
+  {
+    int a = pairs[p].a;
+    int b = pairs[p].b;
+
+    // An entity merges once per step, the pairs of the absorbed ones are skipped
+    if (!solid_[a] || !solid_[b])
+      continue;
+
+    int survivor = physics_.mass(b) > physics_.mass(a) ? b : a;
+    int absorbed = survivor == a ? b : a;
+    float ms = physics_.mass(survivor);
+    float ma = physics_.mass(absorbed);
+    float mass = ms + ma;
+
+    // The momentum is kept, the survivor moves to the center of mass
+    Vec3 position = physics_.position(survivor);
+    Vec3 velocity = physics_.velocity(survivor);
+    if (simulating_ && mass > 0.0f)
+    {
+      position = (physics_.position(survivor) * ms + physics_.position(absorbed) * ma) / mass;
+      velocity = (physics_.velocity(survivor) * ms + physics_.velocity(absorbed) * ma) / mass;
+      state.current[survivor] = position;
+    }
+    physics_.set(survivor, position, velocity, mass);
+    physics_.set(absorbed, physics_.position(absorbed), physics_.velocity(absorbed), 0.0f);
+    solid_[absorbed] = false;
+
+    // The volume is kept too
+    float rs = radii_[survivor];
+    float ra = radii_[absorbed];
+    float radius = cbrtf(rs * rs * rs + ra * ra * ra);
+    radii_[survivor] = radius;
+    merges_.push_back({handles_[survivor], handles_[absorbed], rs > 0.0f ? radius / rs : 1.0f});
+  }
+}
+
+void Registry::present()
+{
+  Registry_State &state = states_[front_];
+  for (int i = 0; i < count_; i++)
+  {
+    // An orbit also turns its entity, once for all the steps of the state
+    if (state.steps > 0 && !simulating_ && !rails_[i] && Orbits(orbits_[i], parents_[i] >= 0))
+    {
+      Entity_Orbit spin = orbits_[i];
+      spin.center = meshes_[i]->mov_;
+      spin.vel *= state.steps * state.step * ORBIT_RATE;
+      meshes_[i]->orbit(spin);
+    }
+
+    Vec3 position = state.previous[i] + (state.current[i] - state.previous[i]) * state.alpha;
+    meshes_[i]->translation(position - meshes_[i]->mov_);
+  }
+  state.steps = 0;
+}
+
+int Registry::pick(Render &drawRender, Vec2 screen)
+{
+  Vec3 origin, direction;
+  drawRender.screenRay(screen, origin, direction);
+
+  float distance = drawRender.getFar();
+  int handle = bvh_.raycast(origin, direction, distance);
+  return handle != BVH_NULL && valid(handle) ? handle : -1;
+}
+
+int Registry::query(Vec3 center, float radius, int *handles, int max)
+{
+  return bvh_.overlap(center, radius, handles, max);
+}
+
+int Registry::nearest(Vec3 point, int k, int *handles, float *distances)
+{
+  return bvh_.nearest(point, k, handles, distances);
+}
+
+Bvh &Registry::bvh()
+{
+  return bvh_;
+}
+
+Collider &Registry::collider()
+{
+  wait();
+  return collider_;
+}
+
+int Registry::merges()
+{
+  return nMerges_;
+}
+
+Particles &Registry::particles()
+{
+  return particles_;
+}
+
+int Registry::visible()
+{
+  return nVisible_;
+}
+
+#ifndef HEADLESS
+void Registry::draw(SDL_Renderer *render, Render &drawRender, Vec3 light)
+{
+  drawEntities(render, drawRender, light);
+  particles_.draw(render, drawRender);
+}
+
+void Registry::drawEntities(SDL_Renderer *render, Render &drawRender, Vec3 light)
+{
+  nVisible_ = 0;
+  if (count_ == 0)
+    return;
+
+  if (!Bvh::settings_.culling)
+  {
+    // Drawing order on screen
+    int *order = drawRender.getOrder(positions_, scales_, count_);
+    nVisible_ = count_;
+
+    for (int i = 0; i < count_; i++)
+      meshes_[order[i]]->draw(render, drawRender, light, materials_[order[i]], drawBuffers_);
+    return;
+  }
+
+  // Only the entities inside the camera are ordered and drawn
+  Vec3 points[6], normals[6];
+  drawRender.getFrustum(points, normals);
+  nVisible_ = bvh_.frustum(points, normals, 6, visible_);
+  if (nVisible_ == 0)
+    return;
+
+  for (int i = 0; i < nVisible_; i++)
+  {
+    int index = sparse_[visible_[i] & REGISTRY_SLOT_MASK];
+    visible_[i] = index;
+    visiblePositions_[i] = positions_[index];
+    visibleScales_[i] = scales_[index];
+  }
+  int *order = drawRender.getOrder(visiblePositions_, visibleScales_, nVisible_);
+
+  for (int i = 0; i < nVisible_; i++)
+  {
+    int index = visible_[order[i]];
+    meshes_[index]->draw(render, drawRender, light, materials_[index], drawBuffers_);
+  }
+}
+#endif
+
+Registry::~Registry()
+{
+  {
+    std::lock_guard<std::mutex> lock(jobMutex_);
+    stopping_ = true;
+  }
+  jobStart_.notify_one();
+  if (worker_.joinable())
+    worker_.join();
+
+  clear();
+  for (int i = 0; i < 2; i++)
+  {
+    DESTROY(states_[i].previous);
+    DESTROY(states_[i].current);
+  }
+  DESTROY(types_);
+  DESTROY(meshes_);
+  DESTROY(positions_);
+  DESTROY(scales_);
+  DESTROY(orbits_);
+  DESTROY(materials_);
+  DESTROY(elements_);
+  DESTROY(rails_);
+  DESTROY(handles_);
+  DESTROY(proxies_);
+  DESTROY(radii_);
+  DESTROY(solid_);
+  DESTROY(shattered_);
+  DESTROY(parents_);
+  DESTROY(children_);
+  DESTROY(locals_);
+  DESTROY(changed_);
+  DESTROY(order_);
+  DESTROY(orderParents_);
+  DESTROY(visible_);
+  DESTROY(visiblePositions_);
+  DESTROY(visibleScales_);
+  DESTROY(sparse_);
+  DESTROY(generations_);
+  DESTROY(free_);
+}
+
+int Registry_Stress(int bodies, int rounds)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  Sphere prototype;
+  prototype.init({255, 255, 255, 255}, true, 8);
+
+  Registry registry;
+  int *handles = (int *)calloc(bodies, sizeof(int));
+  uint32_t state = 0x9E3779B9u;
+  size_t first_rss = 0;
+  int ret = 0;
+
+  for (int round = 0; round < rounds && ret == 0; round++)
+  {
+    // Only the adds are timed, they move the copies
+    std::vector<Sphere> spheres(bodies, prototype);
+    for (int i = 0; i < bodies; i++)
+      spheres[i].mov_ = {(float)i, (float)round, 0.0f};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < bodies; i++)
+      handles[i] = registry.add(typeSphere, std::move(spheres[i]));
+    double create_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i < bodies; i++)
+    {
+      if (spheres[i].getFaces() != 0)
+      {
+        std::cout << "ERROR: The add copied the sphere " << i << ", it keeps its " << spheres[i].getFaces() << " faces" << std::endl;
+        ret = 1;
+        break;
+      }
+    }
+    spheres.clear();
+
+    // Removed in a random order, so the swaps move entities all over the arrays
+    for (int i = bodies - 1; i > 0; i--)
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      int j = state % (i + 1);
+      std::swap(handles[i], handles[j]);
+    }
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < bodies; i++)
+      registry.remove(handles[i]);
+    double remove_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i < bodies; i += std::max(1, bodies / 64))
+    {
+      if (registry.valid(handles[i]))
+      {
+        std::cout << "ERROR: Removed handle " << handles[i] << " still valid" << std::endl;
+        ret = 1;
+      }
+    }
+
+    size_t rss = Current_RSS();
+    if (round == 0)
+      first_rss = rss;
+    else if (rss > first_rss + first_rss / 10)
+    {
+      std::cout << "ERROR: Memory grows from " << first_rss / 1024 << " KB to " << rss / 1024 << " KB" << std::endl;
+      ret = 1;
+    }
+
+    printf("Round %d: %d bodies, create %.0f/s, remove %.0f/s, RSS %zu KB\n", round, bodies,
+           bodies / std::max(create_ms, 0.001) * 1000.0, bodies / std::max(remove_ms, 0.001) * 1000.0, rss / 1024);
+  }
+
+  DESTROY(handles);
+
+  return ret;
+}
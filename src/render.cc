@@ -6,12 +6,12 @@
 #include <algorithm>
 #include <functional>
 
-Vec2 Render::getRenderScale()
+Vec2 Render::getRenderScale() const
 {
   return render_scale_;
 };
 
-Vec2 Render::getRenderCenter()
+Vec2 Render::getRenderCenter() const
 {
   return {render_centers_.x,render_centers_.y};
 }
@@ -142,6 +142,7 @@ void Render::translation(Vec3 desp)
   }
 }
 
+#ifndef HEADLESS
 void Render::inputs()
 {
 
@@ -175,6 +176,7 @@ void Render::inputs()
   if (EVENT_DOWN(K_e))
     translation(up_);
 }
+#endif
 
 int *Render::getOrder(Vec3 *objects_mov, Vec3 *objects_scale, int max_order)
 {
@@ -274,7 +276,7 @@ SDL_Vertex renderSDLVertex(Vec3 light, Vec2 draw, Vec3 point, Vec3 desp, SDL_Col
     return SDL_Vertex{{draw.x, draw.y}, color, {0, 0}};
 }
 
-bool Render::active(Vec3 point)
+bool Render::active(Vec3 point) const
 {
   bool ret = true;
 
@@ -293,21 +295,25 @@ bool Render::active(Vec3 point)
 }
 
 // This is the normal one
-void Render::renderPoints(Render_Figure &figure, bool renderLight)
+void Render::renderPoints(Render_Figure &figure, bool renderLight) const
 {
   Render_Vert *in_vert = *figure.verts;
 
-  for(int i=0; i<figure.n_points; i++)
+  for(int j=0; j<figure.n_points; j++)
   {
+    int i = figure.indices != nullptr ? figure.indices[j] : j;
     renderPoint(in_vert[i], figure.point[i], figure.desp, figure.light, figure.color, figure.model, figure.forceRender, renderLight);
   }
 }
 
 // This render the points using threads
-void Render::renderThreadedPoints(Render_Figure &figure, bool renderLight)
+void Render::renderThreadedPoints(Render_Figure &figure, bool renderLight) const
 {
   Render_Vert *in_vert = *figure.verts;
 
+  if (figure.n_points <= 0)
+    return;
+
   std::vector<std::thread> threads;
 
   const int numThreads = std::min(current_threads_, figure.n_points);
@@ -326,8 +332,9 @@ void Render::renderThreadedPoints(Render_Figure &figure, bool renderLight)
 
     threads.push_back(std::thread([&, start, end]()
     {
-      for (int j = start; j < end; j++)
+      for (int k = start; k < end; k++)
       {
+        int j = figure.indices != nullptr ? figure.indices[k] : k;
         renderPoint(in_vert[j], figure.point[j], figure.desp, figure.light, figure.color, figure.model, figure.forceRender, renderLight);
       }
     }));
@@ -337,7 +344,7 @@ void Render::renderThreadedPoints(Render_Figure &figure, bool renderLight)
   for (auto &t : threads) t.join();
 }
 
-void Render::renderPoint(Render_Vert &ret_vert, Vec3 point, Vec3 desp, Vec3 light, SDL_Color color, Mat3 model, bool forceRender, bool renderLight)
+void Render::renderPoint(Render_Vert &ret_vert, Vec3 point, Vec3 desp, Vec3 light, SDL_Color color, Mat3 model, bool forceRender, bool renderLight) const
 {
   if (active(point) || forceRender)
   {
@@ -360,6 +367,7 @@ void Render::renderPoint(Render_Vert &ret_vert, Vec3 point, Vec3 desp, Vec3 ligh
     ret_vert = Render_Vert{{{0,0}, {0,0,0,0}, {0,0}}, false};
 }
 
+#ifndef HEADLESS
 void Render::cameraDraw(SDL_Renderer *render, Vec2 max_win, Vec3 light)
 {
   // 2D point transformation
@@ -391,8 +399,47 @@ void Render::cameraDraw(SDL_Renderer *render, Vec2 max_win, Vec3 light)
   SDL_RenderDrawLine(render, square[2].point.position.x, square[2].point.position.y, square[3].point.position.x, square[3].point.position.y);
   SDL_RenderDrawLine(render, square[3].point.position.x, square[3].point.position.y, square[0].point.position.x, square[0].point.position.y);
 }
+#endif
+
+float Render::projectedSize(Vec3 center, float radius) const
+{
+  // The projection divides by the distance to the camera before scaling to the window
+  float distance = std::max((center - camera_).Magnitude(), near_);
+  return radius * render_scale_.x / distance;
+}
 
 Vec3 Render::getUp()
 {
   return up_;
 }
+
+void Render::getAxes(Vec3 &xAxis, Vec3 &yAxis, Vec3 &zAxis)
+{
+  // The same axes of Mat4View
+  zAxis = front_.Normalized();
+  xAxis = Vec3::CrossProduct(up_, zAxis).Normalized();
+  yAxis = Vec3::CrossProduct(zAxis, xAxis).Normalized();
+}
+
+void Render::screenRay(Vec2 screen, Vec3 &origin, Vec3 &direction)
+{
+  // The projection divides x and y by the depth before scaling them
+  Vec3 xAxis, yAxis, zAxis;
+  getAxes(xAxis, yAxis, zAxis);
+
+  Vec2 center = getRenderCenter();
+  float x = (screen.x - center.x) / render_scale_.x;
+  float y = (screen.y - center.y) / render_scale_.y;
+
+  origin = camera_;
+  direction = (xAxis * x + yAxis * y + zAxis).Normalized();
+}
+
+void Render::getFrustum(Vec3 *points, Vec3 *normals)
+{
+  for (int i = 0; i < 6; i++)
+  {
+    points[i] = faces_centers_[i];
+    normals[i] = faces_vector_[i].Normalized();
+  }
+}
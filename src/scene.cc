@@ -0,0 +1,679 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <scene.h>
+#include <obj_stream.h>
+#include <map>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define SCENE_MAGIC "SSCN"
+#define SCENE_VERSION 4
+#define SCENE_BODY_LINE 5 ///< The bytes of the shortest body line of a text scene, "cube\n".
+
+static_assert(sizeof(Scene_Body) == 120, "Scene_Body is stored as is in the binary scenes");
+
+/**
+ * @struct Scene_Header.
+ *
+ * @brief First bytes of a binary scene.
+ */
+struct Scene_Header
+{
+  char magic[4];      ///< Always SCENE_MAGIC.
+  uint32_t version;   ///< The version of the format.
+  uint32_t n_meshes;  ///< The number of mesh paths after the header.
+  uint32_t n_bodies;  ///< The number of bodies after the mesh paths.
+  float camera[3];    ///< The camera position.
+  float near;         ///< The near plane distance.
+  float far;          ///< The far plane distance.
+  float light[3];     ///< The light point.
+  uint32_t has_light; ///< Non zero if the light is set.
+};
+
+static Scene_Body Default_Body(int type)
+{
+  Scene_Body body;
+  body.type = type;
+  body.mesh = -1;
+  body.color = {255, 255, 255, 255};
+  body.fill = 0;
+  body.res = 10;
+  body.subdivisions = -1;
+  body.scale = {1, 1, 1};
+  body.mov = {0, 0, 0};
+  body.rot = {0, 0, 0};
+  body.orbit = {0, 0, 0};
+  body.orbit_center = {0, 0, 0};
+  body.orbit_vel = 0.0f;
+  memset(body.kepler, 0, sizeof(body.kepler));
+  body.period = 0.0f;
+  body.parent = -1;
+  return body;
+}
+
+static void Default_Scene(Scene &scene)
+{
+  scene.camera = {0, 0, 100};
+  scene.near = 1;
+  scene.far = 1000;
+  scene.light = {0, 0, 0};
+  scene.has_light = false;
+  scene.meshes.clear();
+  scene.bodies.clear();
+}
+
+static bool Parse_Vec3(const char *value, Vec3 &vec)
+{
+  return sscanf(value, "%f,%f,%f", &vec.x, &vec.y, &vec.z) == 3;
+}
+
+// Splits the line in words, the line is modified
+static int Split_Words(char *line, char **words, int max_words)
+{
+  int n_words = 0;
+  char *c = line;
+  while (*c != '\0' && n_words < max_words)
+  {
+    while (*c == ' ' || *c == '\t')
+      *c++ = '\0';
+    if (*c == '\0' || *c == '#')
+      break;
+    words[n_words++] = c;
+    while (*c != '\0' && *c != ' ' && *c != '\t')
+      c++;
+  }
+  return n_words;
+}
+
+static int Load_Binary(const char *path, Scene &scene)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return 1;
+
+  Scene_Header header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, SCENE_MAGIC, 4) != 0 ||
+      header.version != SCENE_VERSION)
+  {
+    fclose(file);
+    return 2;
+  }
+
+  // The counts of the header must fit in the rest of the file, a mesh takes at least its length
+  long start = ftell(file);
+  long end = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+  if (start < 0 || end < start || fseek(file, start, SEEK_SET) != 0 ||
+      (uint64_t)header.n_meshes * sizeof(uint32_t) + (uint64_t)header.n_bodies * sizeof(Scene_Body) > (uint64_t)(end - start))
+  {
+    fclose(file);
+    return 2;
+  }
+
+  scene.camera = Vec3(header.camera);
+  scene.near = header.near;
+  scene.far = header.far;
+  scene.light = Vec3(header.light);
+  scene.has_light = header.has_light != 0;
+
+  scene.meshes.resize(header.n_meshes);
+  for (uint32_t i = 0; i < header.n_meshes; i++)
+  {
+    uint32_t length = 0;
+    if (fread(&length, sizeof(length), 1, file) != 1 || length > 4096)
+    {
+      fclose(file);
+      return 2;
+    }
+    scene.meshes[i].resize(length);
+    if (length > 0 && fread(&scene.meshes[i][0], 1, length, file) != length)
+    {
+      fclose(file);
+      return 2;
+    }
+  }
+
+  // The bodies are read at once in their final storage
+  if ((uint64_t)header.n_bodies * sizeof(Scene_Body) > (uint64_t)(end - ftell(file)))
+  {
+    fclose(file);
+    return 2;
+  }
+  scene.bodies.resize(header.n_bodies);
+  size_t read = header.n_bodies > 0 ? fread(scene.bodies.data(), sizeof(Scene_Body), header.n_bodies, file) : 0;
+  fclose(file);
+
+  if (read != header.n_bodies)
+    return 2;
+
+  for (const Scene_Body &body : scene.bodies)
+  {
+    if (body.type == typeFigure && (body.mesh < 0 || body.mesh >= (int)scene.meshes.size()))
+      return 2;
+  }
+
+  return 0;
+}
+
+static int Load_Text(const char *path, Scene &scene)
+{
+  std::map<std::string, int> mesh_names;
+  int line_number = 0;
+  int ret = 0;
+
+  // The count is a hint, no more bodies are reserved than the lines the file can hold
+  long size = -1;
+  FILE *file = fopen(path, "rb");
+  if (file != NULL)
+  {
+    if (fseek(file, 0, SEEK_END) == 0)
+      size = ftell(file);
+    fclose(file);
+  }
+  int max_bodies = size > 0 ? (int)std::min(size / SCENE_BODY_LINE, (long)INT_MAX) : 0;
+
+  auto parse_line = [&](char *line)
+  {
+    line_number++;
+    if (ret != 0)
+      return;
+
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", line);
+
+    char *words[32];
+    int n_words = Split_Words(line, words, 32);
+    if (n_words == 0)
+      return;
+
+    bool ok = true;
+    if (strcmp(words[0], "camera") == 0)
+    {
+      ok = n_words >= 4;
+      if (ok)
+        scene.camera = {(float)atof(words[1]), (float)atof(words[2]), (float)atof(words[3])};
+      if (ok && n_words >= 6)
+      {
+        scene.near = (float)atof(words[4]);
+        scene.far = (float)atof(words[5]);
+      }
+    }
+    else if (strcmp(words[0], "light") == 0)
+    {
+      ok = n_words >= 4;
+      if (ok)
+      {
+        scene.light = {(float)atof(words[1]), (float)atof(words[2]), (float)atof(words[3])};
+        scene.has_light = true;
+      }
+    }
+    else if (strcmp(words[0], "count") == 0)
+    {
+      ok = n_words >= 2 && atoi(words[1]) >= 0;
+      if (ok)
+        scene.bodies.reserve(std::min(atoi(words[1]), max_bodies));
+    }
+    else if (strcmp(words[0], "mesh") == 0)
+    {
+      ok = n_words >= 3;
+      if (ok)
+      {
+        mesh_names[words[1]] = (int)scene.meshes.size();
+        scene.meshes.push_back(words[2]);
+      }
+    }
+    else
+    {
+      int type = notSet;
+      if (strcmp(words[0], "sphere") == 0)
+        type = typeSphere;
+      else if (strcmp(words[0], "cube") == 0)
+        type = typeCube;
+      else if (strcmp(words[0], "figure") == 0)
+        type = typeFigure;
+      ok = type != notSet;
+
+      Scene_Body body = Default_Body(type);
+      for (int i = 1; ok && i < n_words; i++)
+      {
+        char *value = strchr(words[i], '=');
+        if (value == NULL)
+        {
+          ok = false;
+          break;
+        }
+        *value++ = '\0';
+        const char *key = words[i];
+
+        if (strcmp(key, "color") == 0)
+        {
+          int r, g, b, a = 255;
+          ok = sscanf(value, "%d,%d,%d,%d", &r, &g, &b, &a) >= 3;
+          body.color = {(Uint8)r, (Uint8)g, (Uint8)b, (Uint8)a};
+        }
+        else if (strcmp(key, "fill") == 0)
+          body.fill = atoi(value);
+        else if (strcmp(key, "res") == 0)
+          body.res = atoi(value);
+        else if (strcmp(key, "ico") == 0)
+          body.subdivisions = std::min(std::max(atoi(value), 0), MAX_ICO_LEVEL);
+        else if (strcmp(key, "scale") == 0)
+          ok = Parse_Vec3(value, body.scale);
+        else if (strcmp(key, "pos") == 0)
+          ok = Parse_Vec3(value, body.mov);
+        else if (strcmp(key, "rot") == 0)
+          ok = Parse_Vec3(value, body.rot);
+        else if (strcmp(key, "orbit") == 0)
+          ok = Parse_Vec3(value, body.orbit);
+        else if (strcmp(key, "center") == 0)
+          ok = Parse_Vec3(value, body.orbit_center);
+        else if (strcmp(key, "around") == 0)
+        {
+          int around = atoi(value);
+          ok = around >= 0 && around < (int)scene.bodies.size();
+          if (ok)
+          {
+            body.orbit_center = scene.bodies[around].mov;
+            body.parent = around;
+          }
+        }
+        else if (strcmp(key, "parent") == 0)
+        {
+          body.parent = atoi(value);
+          ok = body.parent >= -1 && body.parent < (int)scene.bodies.size();
+        }
+        else if (strcmp(key, "vel") == 0)
+          body.orbit_vel = (float)atof(value);
+        else if (strcmp(key, "kepler") == 0)
+        {
+          float *k = body.kepler;
+          ok = sscanf(value, "%f,%f,%f,%f,%f,%f", &k[0], &k[1], &k[2], &k[3], &k[4], &k[5]) == 6;
+        }
+        else if (strcmp(key, "period") == 0)
+          body.period = (float)atof(value);
+        else if (strcmp(key, "mesh") == 0)
+        {
+          // Unknown names are taken as the path of the mesh
+          std::map<std::string, int>::iterator mesh = mesh_names.find(value);
+          if (mesh == mesh_names.end())
+          {
+            mesh = mesh_names.insert({value, (int)scene.meshes.size()}).first;
+            scene.meshes.push_back(value);
+          }
+          body.mesh = mesh->second;
+        }
+        else
+          ok = false;
+      }
+
+      if (ok && type == typeFigure && body.mesh < 0)
+        ok = false;
+      if (ok)
+        scene.bodies.push_back(body);
+    }
+
+    if (!ok)
+    {
+      std::cout << "ERROR: Scene line " << line_number << " -> " << copy << std::endl;
+      ret = 2;
+    }
+  };
+
+  int stream = Stream_Lines(path, 64 * 1024, parse_line);
+  if (stream == 1)
+    return 1;
+  if (stream != 0)
+    return 2;
+  return ret;
+}
+
+int Scene_Load(const char *path, Scene &scene)
+{
+  Default_Scene(scene);
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return 1;
+  char magic[4] = {0, 0, 0, 0};
+  size_t read = fread(magic, 1, 4, file);
+  fclose(file);
+
+  if (read == 4 && memcmp(magic, SCENE_MAGIC, 4) == 0)
+    return Load_Binary(path, scene);
+  return Load_Text(path, scene);
+}
+
+int Scene_Save_Text(const char *path, const Scene &scene)
+{
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    return 1;
+
+  fprintf(file, "# Solar System scene\n");
+  fprintf(file, "camera %g %g %g %g %g\n", scene.camera.x, scene.camera.y, scene.camera.z, scene.near, scene.far);
+  if (scene.has_light)
+    fprintf(file, "light %g %g %g\n", scene.light.x, scene.light.y, scene.light.z);
+  fprintf(file, "count %d\n", (int)scene.bodies.size());
+  for (int i = 0; i < (int)scene.meshes.size(); i++)
+    fprintf(file, "mesh mesh_%d %s\n", i, scene.meshes[i].c_str());
+
+  const char *names[MAX_OBJECTS_TYPE] = {"", "sphere", "cube", "figure"};
+  for (const Scene_Body &body : scene.bodies)
+  {
+    if (body.type <= notSet || body.type >= MAX_OBJECTS_TYPE)
+      continue;
+
+    fprintf(file, "%s", names[body.type]);
+    if (body.type == typeFigure)
+      fprintf(file, " mesh=mesh_%d", body.mesh);
+    fprintf(file, " color=%d,%d,%d,%d fill=%d", body.color.r, body.color.g, body.color.b, body.color.a, body.fill != 0);
+    if (body.type == typeSphere && body.subdivisions >= 0)
+      fprintf(file, " ico=%d", body.subdivisions);
+    else if (body.type == typeSphere)
+      fprintf(file, " res=%d", body.res);
+    fprintf(file, " scale=%g,%g,%g pos=%g,%g,%g rot=%g,%g,%g orbit=%g,%g,%g center=%g,%g,%g vel=%g",
+            body.scale.x, body.scale.y, body.scale.z, body.mov.x, body.mov.y, body.mov.z,
+            body.rot.x, body.rot.y, body.rot.z, body.orbit.x, body.orbit.y, body.orbit.z,
+            body.orbit_center.x, body.orbit_center.y, body.orbit_center.z, body.orbit_vel);
+    if (body.period != 0.0f)
+      fprintf(file, " kepler=%g,%g,%g,%g,%g,%g period=%g", body.kepler[0], body.kepler[1], body.kepler[2],
+              body.kepler[3], body.kepler[4], body.kepler[5], body.period);
+    if (body.parent >= 0)
+      fprintf(file, " parent=%d", body.parent);
+    fprintf(file, "\n");
+  }
+
+  fclose(file);
+  return 0;
+}
+
+int Scene_Save_Binary(const char *path, const Scene &scene)
+{
+  FILE *file = fopen(path, "wb");
+  if (file == NULL)
+    return 1;
+
+  Scene_Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SCENE_MAGIC, 4);
+  header.version = SCENE_VERSION;
+  header.n_meshes = (uint32_t)scene.meshes.size();
+  header.n_bodies = (uint32_t)scene.bodies.size();
+  header.camera[0] = scene.camera.x;
+  header.camera[1] = scene.camera.y;
+  header.camera[2] = scene.camera.z;
+  header.near = scene.near;
+  header.far = scene.far;
+  header.light[0] = scene.light.x;
+  header.light[1] = scene.light.y;
+  header.light[2] = scene.light.z;
+  header.has_light = scene.has_light;
+  fwrite(&header, sizeof(header), 1, file);
+
+  for (const std::string &mesh : scene.meshes)
+  {
+    uint32_t length = (uint32_t)mesh.size();
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(mesh.data(), 1, length, file);
+  }
+
+  if (!scene.bodies.empty())
+    fwrite(scene.bodies.data(), sizeof(Scene_Body), scene.bodies.size(), file);
+
+  fclose(file);
+  return 0;
+}
+
+int Scene_Save(const char *path, const Scene &scene)
+{
+  size_t length = strlen(path);
+  if (length > 5 && strcmp(path + length - 5, ".scnb") == 0)
+    return Scene_Save_Binary(path, scene);
+  return Scene_Save_Text(path, scene);
+}
+
+// Xorshift, the scenes must be the same in every system
+static uint32_t Next_Random(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static float Random_Range(uint32_t &state, float min, float max)
+{
+  return min + (max - min) * (float)(Next_Random(state) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+void Scene_Generate(Scene &scene, int n_bodies, uint32_t seed, Vec3 center)
+{
+  Default_Scene(scene);
+  scene.camera = {center.x, center.y, 100};
+  scene.light = center;
+  scene.has_light = true;
+  scene.bodies.reserve(n_bodies + 1);
+
+  uint32_t state = seed != 0 ? seed : 1;
+
+  Scene_Body sun = Default_Body(typeSphere);
+  sun.color = {255, 255, 255, 100};
+  sun.fill = 1;
+  sun.res = 20;
+  sun.scale = {30, 30, 30};
+  sun.mov = center;
+  scene.bodies.push_back(sun);
+
+  // The rings grow with the number of bodies to keep their density
+  float max_radius = 50.0f + 3.0f * sqrtf((float)n_bodies);
+  for (int i = 0; i < n_bodies; i++)
+  {
+    Scene_Body body = Default_Body(i % 8 == 7 ? typeCube : typeSphere);
+    body.color = {(Uint8)Random_Range(state, 64, 255), (Uint8)Random_Range(state, 64, 255), (Uint8)Random_Range(state, 64, 255), 255};
+    body.fill = 1;
+    body.subdivisions = 1;
+    float size = Random_Range(state, 1.0f, 5.0f);
+    body.scale = {size, size, size};
+
+    float radius = Random_Range(state, 40.0f, max_radius);
+    float angle = Random_Range(state, 0.0f, 2.0f * PI);
+    float height = Random_Range(state, -0.2f, 0.2f) * radius;
+    body.mov = {center.x + radius * cosf(angle), center.y + height, center.z + radius * sinf(angle)};
+    body.orbit = {Random_Range(state, -0.01f, 0.01f), 0.01f, Random_Range(state, -0.01f, 0.01f)};
+    body.orbit_center = center;
+    body.orbit_vel = Random_Range(state, 20.0f, 60.0f);
+    body.parent = 0;
+    scene.bodies.push_back(body);
+  }
+}
+
+// Bodies with the same key share the built sphere
+static int Sphere_Key(const Scene_Body &body)
+{
+  if (body.subdivisions >= 0)
+    return 100 + std::min((int)body.subdivisions, MAX_ICO_LEVEL);
+  return std::min(std::max((int)body.res, 2), 50);
+}
+
+int Scene_Instantiate(const Scene &scene, Registry &registry, Vec3 &light, Render &drawRender, Vec2 max_win)
+{
+  std::cout << "Generating scene..." << std::endl;
+
+  // Every mesh is loaded once
+  std::vector<Figure> meshes(scene.meshes.size());
+  std::vector<bool> loaded(scene.meshes.size(), false);
+  for (int i = 0; i < (int)scene.meshes.size(); i++)
+    loaded[i] = meshes[i].init(scene.meshes[i].c_str(), {255, 255, 255, 255}) == 0;
+
+  // Every sphere tessellation is built once, the bodies that use every prototype are counted
+  std::map<int, Sphere> spheres;
+  std::map<int, int> sphere_uses;
+  std::vector<int> mesh_uses(scene.meshes.size(), 0);
+  Cube cube;
+  int cube_uses = 0;
+  int count = 0;
+  for (const Scene_Body &body : scene.bodies)
+  {
+    switch (body.type)
+    {
+    case typeSphere:
+    {
+      int key = Sphere_Key(body);
+      if (spheres.find(key) == spheres.end())
+      {
+        if (body.subdivisions >= 0)
+          spheres[key].initIcosphere({255, 255, 255, 255}, false, body.subdivisions);
+        else
+          spheres[key].init({255, 255, 255, 255}, false, key);
+      }
+      sphere_uses[key]++;
+      count++;
+      break;
+    }
+    case typeCube:
+      if (cube_uses == 0)
+        cube.init({255, 255, 255, 255});
+      cube_uses++;
+      count++;
+      break;
+    case typeFigure:
+      if (loaded[body.mesh])
+      {
+        mesh_uses[body.mesh]++;
+        count++;
+      }
+      break;
+    }
+  }
+
+  // The components are allocated once for every object
+  registry.clear();
+  registry.reserve(count);
+
+  // A copy of the prototype is moved into the registry, the last body of a prototype takes the prototype itself
+  std::vector<int> handles;
+  handles.reserve(scene.bodies.size());
+  auto place = [&registry, &handles](Entity &entity, const Scene_Body &body)
+  {
+    entity.place(body.color, body.fill != 0, body.scale, body.mov, body.rot, body.orbit, body.orbit_center);
+    entity.orbit_vel_ = body.orbit_vel;
+    int handle = registry.add(body.type, std::move(entity));
+    if (handle >= 0 && body.period != 0.0f)
+    {
+      const float *k = body.kepler;
+      registry.setRails(handle, Kepler_Elements(k[0], k[1], k[2], k[3], k[4], k[5], body.period, body.orbit_center));
+    }
+    handles.back() = handle;
+  };
+
+  for (const Scene_Body &body : scene.bodies)
+  {
+    handles.push_back(-1);
+    switch (body.type)
+    {
+    case typeSphere:
+    {
+      int key = Sphere_Key(body);
+      Sphere &prototype = spheres[key];
+      if (--sphere_uses[key] == 0)
+        place(prototype, body);
+      else
+      {
+        Sphere sphere = prototype;
+        place(sphere, body);
+      }
+      break;
+    }
+    case typeCube:
+      if (--cube_uses == 0)
+        place(cube, body);
+      else
+      {
+        Cube copy = cube;
+        place(copy, body);
+      }
+      break;
+    case typeFigure:
+      if (loaded[body.mesh])
+      {
+        if (--mesh_uses[body.mesh] == 0)
+          place(meshes[body.mesh], body);
+        else
+        {
+          Figure figure = meshes[body.mesh];
+          place(figure, body);
+        }
+      }
+      break;
+    }
+  }
+
+  // The parents are placed before their children, the world positions are kept
+  for (int i = 0; i < (int)scene.bodies.size(); i++)
+  {
+    int parent = scene.bodies[i].parent;
+    if (handles[i] >= 0 && parent >= 0 && parent < i && handles[parent] >= 0)
+      registry.setParent(handles[i], handles[parent]);
+  }
+
+  if (scene.has_light)
+    light = scene.light;
+  else if (registry.count() > 0)
+    light = registry.positions()[0];
+
+  drawRender.init(max_win, scene.camera, scene.near, scene.far);
+
+  std::cout << "Scene generated: " << count << " objects, " << scene.meshes.size() << " meshes" << std::endl;
+
+  return count;
+}
+
+int Scene_Benchmark(const char *path, int frames, Vec2 max_win)
+{
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  Scene scene;
+  int ret = Scene_Load(path, scene);
+  if (ret != 0)
+  {
+    std::cout << "ERROR: Loading scene " << path << " -> " << ret << std::endl;
+    return ret;
+  }
+  double load_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+  Registry registry;
+  Vec3 light;
+  Render drawRender;
+  start = std::chrono::steady_clock::now();
+  int count = Scene_Instantiate(scene, registry, light, drawRender, max_win);
+  double create_ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+  // The same update the main loop does, without drawing, a step of the clock per frame
+  double update_ms = 0.0;
+  double order_ms = 0.0;
+  long long faces = 0;
+  for (int frame = 0; frame < frames; frame++)
+  {
+    start = std::chrono::steady_clock::now();
+    registry.update(Sim_Clock::settings_.step);
+    for (int i = 0; i < registry.count(); i++)
+    {
+      Entity *entity = registry.entity(registry.handle(i));
+      faces += entity->getLodFaces(entity->selectLod(drawRender));
+    }
+    std::chrono::steady_clock::time_point sorted = std::chrono::steady_clock::now();
+    drawRender.getOrder(registry.positions(), registry.scales(), registry.count());
+    update_ms += Milliseconds(sorted - start).count();
+    order_ms += Milliseconds(std::chrono::steady_clock::now() - sorted).count();
+  }
+
+  frames = std::max(frames, 1);
+  printf("Scene %s: %d bodies, %d objects, %d meshes\n", path, (int)scene.bodies.size(), count, (int)scene.meshes.size());
+  printf("Load %.2f ms, create %.2f ms\n", load_ms, create_ms);
+  printf("Per frame: update %.3f ms, order %.3f ms, %lld faces selected\n", update_ms / frames, order_ms / frames, faces / frames);
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <sim_clock.h>
+#include <algorithm>
+
+Clock_Settings Sim_Clock::settings_ = {1.0f / 60.0f, 1.0f, false, 120, false};
+
+Sim_Clock::Sim_Clock()
+{
+  last_ = std::chrono::steady_clock::now();
+  accumulator_ = 0.0;
+  time_ = 0.0;
+  dropped_ = 0.0;
+  step_ = settings_.step;
+  requested_ = 0;
+}
+
+float Sim_Clock::elapsed()
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  float elapsed = std::chrono::duration<float>(now - last_).count();
+  last_ = now;
+
+  return std::min(elapsed, CLOCK_MAX_ELAPSED);
+}
+
+int Sim_Clock::advance(float elapsed)
+{
+  step_ = std::max(settings_.step, 0.0001f);
+  if (!settings_.paused)
+    accumulator_ += (double)std::max(elapsed, 0.0f) * std::max(settings_.time_scale, 0.0f);
+
+  // The accumulator is in double, a float loses the small steps of a long session
+  int steps = (int)(accumulator_ / step_);
+  accumulator_ -= steps * (double)step_;
+  steps += requested_;
+  requested_ = 0;
+
+  // Rather than falling behind more every frame, the time that doesn't fit is dropped
+  if (steps > settings_.max_steps)
+  {
+    dropped_ += (steps - settings_.max_steps) * (double)step_;
+    steps = std::max(settings_.max_steps, 1);
+  }
+  time_ += steps * (double)step_;
+
+  return steps;
+}
+
+void Sim_Clock::stepOnce()
+{
+  requested_++;
+}
+
+float Sim_Clock::step()
+{
+  return step_;
+}
+
+float Sim_Clock::alpha()
+{
+  return std::min((float)(accumulator_ / step_), 1.0f);
+}
+
+double Sim_Clock::time()
+{
+  return time_;
+}
+
+double Sim_Clock::dropped()
+{
+  return dropped_;
+}
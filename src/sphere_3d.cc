@@ -1,9 +1,101 @@
 /// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
 
 #include <sphere_3d.h>
+#include <vector>
+#include <map>
+#include <cstring>
+
+/**
+ * @struct Ico_Tables.
+ *
+ * @brief Points and triangles of the subdivided icosahedron, shared by every icosphere.
+ *
+ * Every subdivision appends the new points, so the points of a level are a prefix of the
+ * points of the next one and the triangles of any level index the points of any higher one.
+ */
+struct Ico_Tables
+{
+  std::vector<Vec3> points;               ///< The unit points of every level.
+  std::vector<int> nVertex;               ///< The number of points used by each level.
+  std::vector<std::vector<int>> triangles; ///< The triangles of each level, 3 indices per triangle.
+};
+
+// Tables built up to the level, the levels are built the first time they are used
+static const Ico_Tables &Ico_Level(int level)
+{
+  static Ico_Tables tables;
+
+  if (tables.triangles.empty())
+  {
+    float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+    Vec3 icosahedron[12] = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+                            {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+                            {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+    int faces[60] = {0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+                     1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+                     3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+                     4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1};
+    // Vec3::Normalize skips the vectors whose components add 0
+    for (int i = 0; i < 12; i++)
+      tables.points.push_back(icosahedron[i] / icosahedron[i].Magnitude());
+    tables.nVertex.push_back(12);
+    tables.triangles.push_back(std::vector<int>(faces, faces + 60));
+  }
+
+  while ((int)tables.triangles.size() <= level)
+  {
+    // Every triangle is split in 4, the midpoints are shared by the two triangles of the edge
+    const std::vector<int> &previous = tables.triangles.back();
+    std::vector<int> next;
+    next.reserve(previous.size() * 4);
+    std::map<long long, int> midpoints;
+    auto midpoint = [&](int a, int b)
+    {
+      long long key = (long long)std::min(a, b) << 32 | std::max(a, b);
+      std::map<long long, int>::iterator found = midpoints.find(key);
+      if (found != midpoints.end())
+        return found->second;
+      Vec3 point = tables.points[a] + tables.points[b];
+      tables.points.push_back(point / point.Magnitude());
+      midpoints[key] = (int)tables.points.size() - 1;
+      return (int)tables.points.size() - 1;
+    };
+
+    for (int i = 0; i < (int)previous.size(); i += 3)
+    {
+      int a = previous[i], b = previous[i + 1], c = previous[i + 2];
+      int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+      int split[12] = {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca};
+      next.insert(next.end(), split, split + 12);
+    }
+
+    tables.nVertex.push_back((int)tables.points.size());
+    tables.triangles.push_back(next);
+  }
+
+  return tables;
+}
+
+// Maximum distance between the faces and the unit sphere, measured at the face centers
+static float Tessellation_Error(const Vec3 *points, const int *indices, int nFaces, int n_points)
+{
+  float error = 0.0f;
+  for (int i = 0; i < nFaces; i++)
+  {
+    Vec3 center = {0, 0, 0};
+    for (int j = 0; j < n_points; j++)
+      center += points[indices[i * n_points + j]];
+    center /= (float)n_points;
+    error = std::max(error, 1.0f - center.Magnitude());
+  }
+  return error;
+}
 
 void Sphere::obtainSphere()
 {
+  // An initialized sphere releases its previous buffers
+  release();
+
   vertex_ = (2 * res_) * (res_ + 1);
 
   points_ = (Vec3 *)calloc(vertex_, sizeof(Vec3));
@@ -13,10 +105,11 @@ void Sphere::obtainSphere()
   nFaces_ = vertex_;
   faces_ = (Faces *)calloc(nFaces_, sizeof(Faces));
 
+  faceStorage_ = (int *)calloc(nFaces_ * 4, sizeof(int));
   for (int i = 0; i < nFaces_; ++i)
   {
     faces_[i].n_points = 4;
-    faces_[i].points = (int *)calloc(faces_[i].n_points, sizeof(int));
+    faces_[i].points = faceStorage_ + i * 4;
   }
 
   centers_ = (Vec3 *)calloc(nFaces_, sizeof(Vec3));
@@ -76,9 +169,93 @@ void Sphere::obtainSphere()
   }
 }
 
+void Sphere::obtainLods()
+{
+  clearLods();
+
+  int columns = res_ * 2;
+  for (int level = 1; level < MAX_LOD_LEVELS; level++)
+  {
+    int step = 1 << level;
+    if (res_ / step < 3)
+      break;
+
+    // Rows and columns of the full grid kept by the level, the poles are always kept
+    std::vector<int> rows;
+    for (int row = 0; row < res_; row += step)
+      rows.push_back(row);
+    rows.push_back(res_);
+
+    std::vector<int> cols;
+    for (int column = 0; column < columns; column += step)
+      cols.push_back(column);
+
+    std::vector<int> points;
+    for (int row = 0; row + 1 < (int)rows.size(); row++)
+    {
+      for (int column = 0; column < (int)cols.size(); column++)
+      {
+        int next = (column + 1) % (int)cols.size();
+        points.push_back(rows[row] * columns + cols[column]);
+        points.push_back(rows[row] * columns + cols[next]);
+        points.push_back(rows[row + 1] * columns + cols[next]);
+        points.push_back(rows[row + 1] * columns + cols[column]);
+      }
+    }
+
+    setLod(level, 4, points.data(), (int)points.size() / 4);
+  }
+}
+
+void Sphere::obtainIcosphere()
+{
+  release();
+
+  const Ico_Tables &tables = Ico_Level(subdivisions_);
+  const std::vector<int> &triangles = tables.triangles[subdivisions_];
+
+  vertex_ = tables.nVertex[subdivisions_];
+  points_ = (Vec3 *)calloc(vertex_, sizeof(Vec3));
+  for (int i = 0; i < vertex_; i++)
+    points_[i] = tables.points[i];
+
+  draw_sdl_ = (Render_Vert *)calloc(vertex_, sizeof(Render_Vert));
+
+  // The faces point to a single copy of the table triangles
+  nFaces_ = (int)triangles.size() / 3;
+  faces_ = (Faces *)calloc(nFaces_, sizeof(Faces));
+  faceStorage_ = (int *)calloc(triangles.size(), sizeof(int));
+  memcpy(faceStorage_, triangles.data(), triangles.size() * sizeof(int));
+  for (int i = 0; i < nFaces_; i++)
+  {
+    faces_[i].n_points = 3;
+    faces_[i].points = faceStorage_ + i * 3;
+  }
+
+  centers_ = (Vec3 *)calloc(nFaces_, sizeof(Vec3));
+
+  order_ = (int *)calloc(nFaces_, sizeof(int));
+
+  for (int i = 0; i < nFaces_; i++)
+  {
+    centers_[i] = points_[faces_[i].points[0]] - points_[faces_[i].points[2]];
+    centers_[i] *= 0.5f;
+    centers_[i] += points_[faces_[i].points[2]];
+  }
+
+  // Lower subdivisions index the same points
+  clearLods();
+  for (int level = 1; level < MAX_LOD_LEVELS && subdivisions_ - level >= 0; level++)
+  {
+    const std::vector<int> &lod = tables.triangles[subdivisions_ - level];
+    setLod(level, 3, lod.data(), (int)lod.size() / 3);
+  }
+}
+
 int Sphere::init(SDL_Color color, bool fill, int res, Vec3 p_scale, Vec3 mov, Vec3 rot, Vec3 orbit, Vec3 orbit_center)
 {
   res = std::min(res, 50);
+  subdivisions_ = -1;
 
   fillColor_ = color;
   linesColor_ = color;
@@ -95,6 +272,7 @@ int Sphere::init(SDL_Color color, bool fill, int res, Vec3 p_scale, Vec3 mov, Ve
 
   // Basic sphere
   obtainSphere();
+  obtainLods();
 
   standarize();
 
@@ -133,8 +311,114 @@ int Sphere::init(SDL_Color color, bool fill, int res, Vec3 p_scale, Vec3 mov, Ve
   bytesSize += sizeof(float);
   bytesSize += sizeof(bool);
   bytesSize += sizeof(bool);
+  bytesSize += lodSize();
 
   return 0;
 }
 
+int Sphere::initIcosphere(SDL_Color color, bool fill, int subdivisions, Vec3 p_scale, Vec3 mov, Vec3 rot, Vec3 orbit, Vec3 orbit_center)
+{
+  subdivisions_ = std::min(std::max(subdivisions, 0), MAX_ICO_LEVEL);
+
+  res_ = 0;
+  rotate_ = {0, 0, 0};
+  scale_ = {1, 1, 1};
+  dim_ = 1;
+  mov_ = {0, 0, 0};
+
+  // Icosphere from the shared tables
+  obtainIcosphere();
+
+  standarize();
+
+  place(color, fill, p_scale, mov, rot, orbit, orbit_center);
+
+  bytesSize = 0;
+  bytesSize += sizeof(Vec3);
+  bytesSize += sizeof(Vec3);
+  bytesSize += sizeof(int);
+  bytesSize += sizeof(int);
+  bytesSize += sizeof(Vec3) * vertex_;
+  bytesSize += sizeof(Vec3) * vertex_;
+  bytesSize += sizeof(Render_Vert) * vertex_;
+  bytesSize += sizeof(Faces) * nFaces_;
+  bytesSize += sizeof(int) * nFaces_ * 3;
+  bytesSize += sizeof(int);
+  bytesSize += sizeof(int) * vertex_;
+  bytesSize += sizeof(int);
+  bytesSize += sizeof(float);
+  bytesSize += sizeof(Vec3);
+  bytesSize += sizeof(Vec3);
+  bytesSize += sizeof(Vec3);
+  bytesSize += sizeof(SDL_Color);
+  bytesSize += sizeof(SDL_Color);
+  bytesSize += sizeof(bool);
+  bytesSize += sizeof(bool);
+  bytesSize += sizeof(float);
+  bytesSize += sizeof(bool);
+  bytesSize += sizeof(bool);
+  bytesSize += lodSize();
+
+  return 0;
+}
+
+int Sphere::getTriangles()
+{
+  return subdivisions_ >= 0 ? nFaces_ : nFaces_ * 2;
+}
+
+int Sphere::getSubdivisions()
+{
+  return subdivisions_;
+}
+
+void Sphere::TessellationReport()
+{
+  // Error of the UV spheres of every resolution, with the same points as obtainSphere
+  std::vector<float> uv_errors(51, 0.0f);
+  for (int res = 2; res <= 50; res++)
+  {
+    float increment = (PI / res);
+    std::vector<Vec3> points;
+    for (int row = 0; row <= res; row++)
+    {
+      for (int column = 0; column < (2 * res); column++)
+        points.push_back({sinf(row * increment) * sinf(column * increment), cosf(row * increment), sinf(row * increment) * cosf(column * increment)});
+    }
+    std::vector<int> quads;
+    for (int row = 0; row < res; row++)
+    {
+      for (int column = 0; column < (2 * res); column++)
+      {
+        int next = (column + 1) % (2 * res);
+        int quad[4] = {row * 2 * res + column, row * 2 * res + next, (row + 1) * 2 * res + next, (row + 1) * 2 * res + column};
+        quads.insert(quads.end(), quad, quad + 4);
+      }
+    }
+    uv_errors[res] = Tessellation_Error(points.data(), quads.data(), (int)quads.size() / 4, 4);
+  }
+
+  std::cout << "Icosphere vs UV sphere, triangles for the same error" << std::endl;
+  for (int level = 0; level <= MAX_ICO_LEVEL; level++)
+  {
+    const Ico_Tables &tables = Ico_Level(level);
+    const std::vector<int> &triangles = tables.triangles[level];
+    int nTriangles = (int)triangles.size() / 3;
+    float error = Tessellation_Error(tables.points.data(), triangles.data(), nTriangles, 3);
+
+    int res = 2;
+    while (res < 50 && uv_errors[res] > error)
+      res++;
+
+    // Triangles as counted for the UV spheres, 2 per face
+    int uv_triangles = 2 * (2 * res) * (res + 1);
+    if (uv_errors[res] > error)
+      printf("Level %d: %d triangles, %d points, error %.5f | UV res 50: %d triangles, error %.5f\n",
+             level, nTriangles, tables.nVertex[level], error, uv_triangles, uv_errors[res]);
+    else
+      printf("Level %d: %d triangles, %d points, error %.5f | UV res %d: %d triangles (x%.2f)\n",
+             level, nTriangles, tables.nVertex[level], error, res, uv_triangles, (float)uv_triangles / nTriangles);
+  }
+}
+
 void Sphere::print() {}
@@ -0,0 +1,77 @@
+/// @author F.c.o Javier Guinot Almenar <guinotal@esat-alumni.com>
+
+#include <thread_pool.h>
+
+Thread_Pool::Thread_Pool()
+{
+  job_ = nullptr;
+  ranges_ = 0;
+  pending_ = 0;
+  generation_ = 0;
+  stopping_ = false;
+}
+
+Thread_Pool::~Thread_Pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (std::thread &worker : workers_)
+    worker.join();
+}
+
+void Thread_Pool::run(int ranges, const std::function<void(int range)> &work)
+{
+  if (ranges <= 1)
+  {
+    if (ranges == 1)
+      work(0);
+    return;
+  }
+
+  // The workers are started once, the next jobs wake them
+  while ((int)workers_.size() < ranges - 1)
+    workers_.push_back(std::thread(&Thread_Pool::worker, this, (int)workers_.size(), generation_));
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &work;
+    ranges_ = ranges;
+    pending_ = ranges - 1;
+    generation_++;
+  }
+  start_.notify_all();
+
+  // This thread takes the last range
+  work(ranges - 1);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]()
+             { return pending_ == 0; });
+  job_ = nullptr;
+}
+
+void Thread_Pool::worker(int index, int generation)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    start_.wait(lock, [this, generation]()
+                { return stopping_ || generation_ != generation; });
+    if (stopping_)
+      return;
+    generation = generation_;
+
+    // A job of fewer ranges leaves the last workers waiting
+    if (index >= ranges_ - 1)
+      continue;
+    const std::function<void(int range)> &work = *job_;
+    lock.unlock();
+    work(index);
+    lock.lock();
+    if (--pending_ == 0)
+      done_.notify_one();
+  }
+}